@@ -0,0 +1,236 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023-2026 Underview
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UDO_FILE_BLK_H
+#define UDO_FILE_BLK_H
+
+#include <sys/types.h>
+
+#include "macros.h"
+
+/*
+ * Stores information about the udo_file_blk context.
+ */
+struct udo_file_blk;
+
+
+/*
+ * @brief enum udo_file_blk_codec_type (UDO File Block Codec Type)
+ *
+ *        Sets how blocks are compressed. Codecs other than
+ *        UDO_FILE_BLK_CODEC_NONE are only available if libudo
+ *        was built with the matching meson option enabled.
+ *
+ * @macro UDO_FILE_BLK_CODEC_NONE - Blocks are stored as is.
+ * @macro UDO_FILE_BLK_CODEC_LZ4  - Blocks are compressed with LZ4.
+ *                                  Requires -Dlz4=enabled.
+ * @macro UDO_FILE_BLK_CODEC_ZSTD - Blocks are compressed with zstd.
+ *                                  Requires -Dzstd=enabled.
+ */
+enum udo_file_blk_codec_type
+{
+	UDO_FILE_BLK_CODEC_NONE = 0x00,
+	UDO_FILE_BLK_CODEC_LZ4  = 0x01,
+	UDO_FILE_BLK_CODEC_ZSTD = 0x02,
+};
+
+
+/*
+ * @brief Structure passed to udo_file_blk_create() used
+ *        to define the block file to create or open.
+ *
+ * @member fname      - Full path to block file. Size in characters
+ *                      is restricted to 4096.
+ * @member block_size - Size in bytes of uncompressed data stored in
+ *                      every block except the last. Only used if
+ *                      @write is set. Opened files use the block
+ *                      size stored in their footer.
+ * @member codec      - enum udo_file_blk_codec_type used to compress
+ *                      blocks. Only used if @write is set. Blocks that
+ *                      don't shrink are stored uncompressed.
+ * @member level      - Compression level passed to zstd. If 0 zstd's
+ *                      default level is used.
+ * @member write      - If set @fname is truncated and data is written
+ *                      with udo_file_blk_append(3). Otherwise an existing
+ *                      block file is opened for reading.
+ */
+struct udo_file_blk_create_info
+{
+	const char *fname;
+	uint32_t   block_size;
+	uint8_t    codec;
+	int        level;
+	uint8_t    write : 1;
+};
+
+
+/*
+ * @brief Creates a new block file or opens an existing one.
+ *        Files are built on top of struct udo_file_ops. Each
+ *        block holds @block_size bytes of caller data that are
+ *        compressed and checksummed with CRC32C. A footer at the
+ *        end of the file stores the offset of every block. So,
+ *        reads only decompress the blocks they touch.
+ *
+ * @param blk      - May be NULL or a pointer to a struct udo_file_blk.
+ *                   If NULL memory will be allocated and return to
+ *                   caller. If not NULL address passed will be used
+ *                   to store the newly created struct udo_file_blk
+ *                   context.
+ * @param blk_info - Implementation uses a pointer to a
+ *                   struct udo_file_blk_create_info.
+ *
+ * @returns
+ * 	on success: Pointer to a struct udo_file_blk
+ * 	on failure: NULL
+ */
+UDO_API
+struct udo_file_blk *
+udo_file_blk_create (struct udo_file_blk *blk,
+                     const void *blk_info);
+
+
+/*
+ * @brief Copies @len bytes from caller defined buffer to the end
+ *        of the block file. Every time a block fills up it's
+ *        compressed and appended to the file.
+ *
+ * @param blk - Pointer to a valid struct udo_file_blk.
+ * @param buf - Pointer to buffer storing data to append.
+ * @param len - Size in bytes of @buf.
+ *
+ * @returns
+ * 	on success: Amount of bytes appended
+ * 	on failure: -1
+ */
+UDO_API
+ssize_t
+udo_file_blk_append (struct udo_file_blk *blk,
+                     const void *buf,
+                     const size_t len);
+
+
+/*
+ * @brief Writes the last partially filled block and the footer
+ *        index. Further appends fail. Called by udo_file_blk_destroy(3)
+ *        if caller hasn't already.
+ *
+ * @param blk - Pointer to a valid struct udo_file_blk.
+ *
+ * @returns
+ * 	on success: 0
+ * 	on failure: -1
+ */
+UDO_API
+int
+udo_file_blk_finish (struct udo_file_blk *blk);
+
+
+/*
+ * @brief Copies up to @len bytes of uncompressed data starting at
+ *        @offset into caller defined buffer. Only blocks overlapping
+ *        the range are read from the mapping. Their checksum is
+ *        verified and they're decompressed. The last block
+ *        decompressed is cached. So, small sequential reads
+ *        decompress each block once.
+ *
+ * @param blk    - Pointer to a valid struct udo_file_blk.
+ * @param offset - Byte offset within the uncompressed data.
+ * @param buf    - Pointer to buffer to store data in.
+ * @param len    - Size in bytes of @buf.
+ *
+ * @returns
+ * 	on success: Amount of bytes read. 0 if @offset is past the end.
+ * 	on failure: -1
+ */
+UDO_API
+ssize_t
+udo_file_blk_read (struct udo_file_blk *blk,
+                   const size_t offset,
+                   void *buf,
+                   const size_t len);
+
+
+/*
+ * @brief Returns size in bytes of the uncompressed
+ *        data stored in the block file.
+ *
+ * @param blk - Pointer to a valid struct udo_file_blk.
+ *
+ * @returns
+ * 	on success: Size of uncompressed data
+ * 	on failure: 0
+ */
+UDO_API
+size_t
+udo_file_blk_get_size (struct udo_file_blk *blk);
+
+
+/*
+ * @brief Frees any allocated memory and closes FD's (if open)
+ *        created after udo_file_blk_create() call. Block files
+ *        opened with @write set are finished first.
+ *
+ * @param blk - Pointer to a valid struct udo_file_blk.
+ */
+UDO_API
+void
+udo_file_blk_destroy (struct udo_file_blk *blk);
+
+
+/*
+ * @brief Returns size of the internal structure. So,
+ *        if caller decides to allocate memory outside
+ *        of API interface they know the exact amount
+ *        of bytes.
+ *
+ * @returns
+ * 	on success: sizeof(struct udo_file_blk)
+ * 	on failure: sizeof(struct udo_file_blk)
+ */
+UDO_API
+int
+udo_file_blk_get_sizeof (void);
+
+
+/*
+ * @brief Computes the CRC32C (Castagnoli) checksum of a buffer.
+ *        Uses the SSE4.2 or ARMv8 CRC32 instructions when the CPU
+ *        supports them. Blocks are checksummed with this function.
+ *
+ * @param crc - Checksum of previous data or 0 to start a new one.
+ * @param buf - Pointer to buffer storing data to checksum.
+ * @param len - Size in bytes of @buf.
+ *
+ * @returns
+ * 	on success: CRC32C of @buf
+ * 	on failure: CRC32C of @buf
+ */
+UDO_API
+uint32_t
+udo_file_blk_crc32c (const uint32_t crc,
+                     const void *buf,
+                     const size_t len);
+
+#endif /* UDO_FILE_BLK_H */
@@ -35,6 +35,25 @@
 struct udo_file_ops;
 
 
+/*
+ * Stores information about the udo_file_ops_iter context.
+ */
+struct udo_file_ops_iter;
+
+
+/*
+ * Stores information about the udo_file_ops_stream context.
+ */
+struct udo_file_ops_stream;
+
+
+/*
+ * Defined in jpool.h. Used to optionally fan
+ * udo_file_ops_walk(3) out across threads.
+ */
+struct udo_jpool;
+
+
 /*
  * @brief UDO File Operations Create Info Structure
  *
@@ -44,20 +63,41 @@ struct udo_file_ops;
  *                       If @create_pipe is true this member is ignored.
  * @member offset      - Offset within the file to mmap(2).
  *                       If @create_pipe is true this member is ignored.
+ * @member flush_size  - Amount of bytes appended with udo_file_ops_append(3)
+ *                       before a background thread starts write-back of the
+ *                       newly appended data. Bounds the amount of data lost
+ *                       on a crash without stalling writers. If 0 no thread
+ *                       is created.
+ *                       NOTE: Only udo_file_ops_append(3) bytes are counted.
+ *                       Writes made through udo_file_ops_get_data(3) are
+ *                       never written back by the thread. Use
+ *                       udo_file_ops_flush_range(3) for those.
  * @member create_pipe - Boolean to enable/disable creation of a pipe(2).
  * @member create_dir  - Boolean to enable/disable the creation of folders
  *                       @fname resides in.
  * @member protect     - Boolean to enable/disable setting of mmap(2) file
- *                       pages to read only or not.
+ *                       pages to read only or not. When opening an existing
+ *                       file with @size and @offset set to 0 the read only
+ *                       mapping is shared by every context that opened the
+ *                       same file (device, inode and modification time).
+ *                       Each open still costs an open(2) and fstat(2). So,
+ *                       sharing only saves the mmap(2).
+ * @member line_index  - Boolean to enable/disable building an index of line
+ *                       offsets on first call to udo_file_ops_get_line(3) or
+ *                       udo_file_ops_get_line_count(3). Further calls look
+ *                       up lines in constant time. Index is extended as
+ *                       data is appended with udo_file_ops_append(3).
  */
 struct udo_file_ops_create_info
 {
 	const char *fname;
 	size_t     size;
 	off_t      offset;
+	size_t     flush_size;
 	uint8_t    create_pipe : 1;
 	uint8_t    create_dir : 1;
 	uint8_t    protect : 1;
+	uint8_t    line_index : 1;
 };
 
 
@@ -113,7 +153,9 @@ struct udo_file_ops_zero_copy_info
  *                    struct udo_file_ops_zero_copy_info.
  *
  * @returns
- * 	on success: Amount of bytes splice(2) to/from a pipe(2)
+ * 	on success: Amount of bytes splice(2) to/from a pipe(2).
+ * 	            If writing to @out_fd fails part way returns the
+ * 	            bytes already written and the error is logged.
  * 	on failure: -1
  */
 UDO_API
@@ -122,6 +164,422 @@ udo_file_ops_zero_copy (struct udo_file_ops *flops,
                         const void *file_info);
 
 
+/*
+ * @brief Moves @size bytes between two file descriptors without
+ *        copying data into userspace. Unlike udo_file_ops_zero_copy(3)
+ *        loops until @size bytes are moved or end of input is reached.
+ *        Picks copy_file_range(2) between regular files, sendfile(2)
+ *        from a regular file to a socket and splice(2) through the
+ *        context's pipe otherwise. Pipe is created if the context
+ *        doesn't have one and grown with F_SETPIPE_SZ.
+ *
+ * @param flops     - Pointer to a valid struct udo_file_ops.
+ * @param file_info - Implementation uses a pointer to a
+ *                    struct udo_file_ops_zero_copy_info.
+ *
+ * @returns
+ * 	on success: Amount of bytes moved. If an error occurs after
+ * 	            some bytes were moved returns the bytes already
+ * 	            moved and the error is logged.
+ * 	on failure: -1
+ */
+UDO_API
+ssize_t
+udo_file_ops_transfer (struct udo_file_ops *flops,
+                       const void *file_info);
+
+
+/*
+ * @brief Ensures the file and its mmap(2) buffer can store
+ *        at least @size bytes. File blocks are allocated with
+ *        fallocate(2) and the mapping is extended with mremap(2).
+ *        Mapping may move. So, pointers previously returned from
+ *        udo_file_ops_get_data(3) and udo_file_ops_get_line(3)
+ *        must be acquired again.
+ *
+ * @param flops - Pointer to a valid struct udo_file_ops.
+ * @param size  - Minimum size in bytes of the mmap(2) buffer.
+ *
+ * @returns
+ * 	on success: 0
+ * 	on failure: -1
+ */
+UDO_API
+int
+udo_file_ops_reserve (struct udo_file_ops *flops,
+                      const size_t size);
+
+
+/*
+ * @brief Copies @len bytes from caller defined buffer to the
+ *        end of data within the open file. If the mmap(2) buffer
+ *        is to small it's grown to at least twice its size so that
+ *        remaps are amortized over many appends. File is truncated
+ *        to the size of its data on udo_file_ops_destroy(3).
+ *        Mapping may move. See udo_file_ops_reserve(3).
+ *
+ * @param flops - Pointer to a valid struct udo_file_ops.
+ * @param buf   - Pointer to buffer storing data to append.
+ * @param len   - Size in bytes of @buf.
+ *
+ * @returns
+ * 	on success: Amount of bytes appended
+ * 	on failure: -1
+ */
+UDO_API
+ssize_t
+udo_file_ops_append (struct udo_file_ops *flops,
+                     const void *buf,
+                     const size_t len);
+
+
+/*
+ * @brief Writes mapped file pages within a range back to disk.
+ *        Offset is rounded down to the start of its page.
+ *
+ * @param flops  - Pointer to a valid struct udo_file_ops.
+ * @param offset - Byte offset within the mapping where range starts.
+ * @param len    - Size in bytes of the range. If 0 range ends at
+ *                 the end of the mapping.
+ * @param async  - If set start write-back with sync_file_range(2)
+ *                 and return without waiting. Otherwise msync(2)
+ *                 waits for the pages to reach disk.
+ *
+ * @returns
+ * 	on success: 0
+ * 	on failure: -1
+ */
+UDO_API
+int
+udo_file_ops_flush_range (struct udo_file_ops *flops,
+                          const size_t offset,
+                          const size_t len,
+                          const uint8_t async);
+
+
+/*
+ * @brief enum udo_file_ops_advise_type (UDO File Operations Advise Type)
+ *
+ *        Sets how udo_file_ops_advise(3) expects a range
+ *        of the mapping to be accessed.
+ *
+ * @macro UDO_FILE_OPS_ADVISE_NORMAL        - Default kernel read ahead.
+ * @macro UDO_FILE_OPS_ADVISE_SEQUENTIAL    - Pages are accessed in order.
+ *                                            Read ahead aggressively.
+ * @macro UDO_FILE_OPS_ADVISE_RANDOM        - Pages are accessed randomly.
+ *                                            Disable read ahead.
+ * @macro UDO_FILE_OPS_ADVISE_WILLNEED      - Pages will be accessed soon.
+ *                                            Start reading them in the
+ *                                            background.
+ * @macro UDO_FILE_OPS_ADVISE_POPULATE_READ - Read pages and map them so
+ *                                            that touching them never
+ *                                            faults. Blocks until done.
+ * @macro UDO_FILE_OPS_ADVISE_READAHEAD     - Read pages into the page
+ *                                            cache with readahead(2).
+ */
+enum udo_file_ops_advise_type
+{
+	UDO_FILE_OPS_ADVISE_NORMAL        = 0x00,
+	UDO_FILE_OPS_ADVISE_SEQUENTIAL    = 0x01,
+	UDO_FILE_OPS_ADVISE_RANDOM        = 0x02,
+	UDO_FILE_OPS_ADVISE_WILLNEED      = 0x03,
+	UDO_FILE_OPS_ADVISE_POPULATE_READ = 0x04,
+	UDO_FILE_OPS_ADVISE_READAHEAD     = 0x05,
+};
+
+
+/*
+ * @brief Advises the kernel how a range of the mapping will be
+ *        accessed. Offset is rounded down to the start of its page.
+ *
+ * @param flops  - Pointer to a valid struct udo_file_ops.
+ * @param offset - Byte offset within the mapping where range starts.
+ * @param len    - Size in bytes of the range. If 0 range ends at
+ *                 the end of the mapping.
+ * @param advice - enum udo_file_ops_advise_type of access pattern.
+ *
+ * @returns
+ * 	on success: 0
+ * 	on failure: -1
+ */
+UDO_API
+int
+udo_file_ops_advise (struct udo_file_ops *flops,
+                     const size_t offset,
+                     const size_t len,
+                     const enum udo_file_ops_advise_type advice);
+
+
+/*
+ * @brief Structure defining a range of the mapping
+ *        passed to udo_file_ops_prefetch().
+ *
+ * @member offset - Byte offset within the mapping where range starts.
+ * @member size   - Size in bytes of the range.
+ */
+struct udo_file_ops_range
+{
+	size_t offset;
+	size_t size;
+};
+
+
+/*
+ * @brief Starts reading in the pages backing a list of ranges so
+ *        that later accesses don't take major faults. Ranges are
+ *        sorted and ranges touching the same pages are merged. So,
+ *        each page is advised once.
+ *
+ * @param flops  - Pointer to a valid struct udo_file_ops.
+ * @param ranges - Array of ranges to prefetch.
+ * @param count  - Amount of ranges in @ranges.
+ *
+ * @returns
+ * 	on success: 0
+ * 	on failure: -1
+ */
+UDO_API
+int
+udo_file_ops_prefetch (struct udo_file_ops *flops,
+                       const struct udo_file_ops_range *ranges,
+                       const uint32_t count);
+
+
+/*
+ * @brief UDO File Operations Iterator Create Info Structure
+ *
+ * @member flops       - Pointer to a valid struct udo_file_ops whose
+ *                       file is iterated. File doesn't need to be
+ *                       mapped in its entirety.
+ * @member offset      - Offset within the file of the first record.
+ * @member window_size - Amount of bytes to mmap(2) at a time. Window
+ *                       grows if a single record doesn't fit. If 0
+ *                       defaults to 16MiB.
+ * @member record_size - Size in bytes of fixed size records. If 0
+ *                       records are separated by @delim.
+ * @member delim       - Byte separating records. If 0 defaults to '\n'.
+ */
+struct udo_file_ops_iter_create_info
+{
+	struct udo_file_ops *flops;
+	size_t              offset;
+	size_t              window_size;
+	size_t              record_size;
+	char                delim;
+};
+
+
+/*
+ * @brief Creates an iterator returning records of a file
+ *        through a bounded mmap(2) window that slides over
+ *        the file. Window is advised for sequential access
+ *        and the next window is read ahead.
+ *
+ * @param iter      - May be NULL or a pointer to a struct udo_file_ops_iter.
+ *                    If NULL memory will be allocated and return to
+ *                    caller. If not NULL address passed will be used
+ *                    to store the newly created struct udo_file_ops_iter
+ *                    context.
+ * @param iter_info - Implementation uses a pointer to a
+ *                    struct udo_file_ops_iter_create_info.
+ *
+ * @returns
+ * 	on success: Pointer to a struct udo_file_ops_iter
+ * 	on failure: NULL
+ */
+UDO_API
+struct udo_file_ops_iter *
+udo_file_ops_iter_create (struct udo_file_ops_iter *iter,
+                          const void *iter_info);
+
+
+/*
+ * @brief Returns the next record of the file. Delimiter
+ *        isn't included in the record. Record is only valid
+ *        until the next call. Once the end of the file is
+ *        reached the file size is read again so that records
+ *        appended afterwards are returned by later calls.
+ *
+ * @code@
+ * size_t len;
+ * const void *ptr;
+ *
+ * while (udo_file_ops_iter_next(iter, &ptr, &len) == 1)
+ * 	fprintf(stdout, "%.*s\n", (int) len, (const char *) ptr);
+ * @endcode@
+ *
+ * @param iter - Pointer to a valid struct udo_file_ops_iter.
+ * @param ptr  - Pointer to store address of the record.
+ * @param len  - Pointer to store size in bytes of the record.
+ *
+ * @returns
+ * 	on success: 1 if a record was returned, 0 at end of file
+ * 	on failure: -1
+ */
+UDO_API
+int
+udo_file_ops_iter_next (struct udo_file_ops_iter *iter,
+                        const void **ptr,
+                        size_t *len);
+
+
+/*
+ * @brief Unmaps the window and frees any allocated memory
+ *        created after udo_file_ops_iter_create() call.
+ *
+ * @param iter - Pointer to a valid struct udo_file_ops_iter.
+ */
+UDO_API
+void
+udo_file_ops_iter_destroy (struct udo_file_ops_iter *iter);
+
+
+/*
+ * @brief Returns size of the internal iterator structure.
+ *        So, if caller decides to allocate memory outside
+ *        of API interface they know the exact amount
+ *        of bytes.
+ *
+ * @returns
+ *	on success: sizeof(struct udo_file_ops_iter)
+ *	on failure: sizeof(struct udo_file_ops_iter)
+ */
+UDO_API
+int
+udo_file_ops_iter_get_sizeof (void);
+
+
+/*
+ * @brief UDO File Operations Stream Create Info Structure
+ *
+ * @member fname       - Full path to file caller wants to stream to or from.
+ * @member buffer_size - Size in bytes of each of the two I/O buffers. Rounded
+ *                       up to a multiple of the page size. If 0 defaults
+ *                       to 1MiB.
+ * @member write       - Boolean to enable/disable writing. If set file is
+ *                       created or truncated. Otherwise file is read.
+ * @member dontneed    - Boolean to enable/disable dropping file pages from
+ *                       the page cache with posix_fadvise(2) once read or
+ *                       written. Only has an effect if the file system
+ *                       doesn't support O_DIRECT.
+ */
+struct udo_file_ops_stream_create_info
+{
+	const char *fname;
+	size_t     buffer_size;
+	uint8_t    write : 1;
+	uint8_t    dontneed : 1;
+};
+
+
+/*
+ * @brief Opens a file for large sequential I/O that bypasses the
+ *        page cache with O_DIRECT. File systems without O_DIRECT
+ *        support fall back to buffered I/O. I/O is double buffered
+ *        with a background thread reading ahead into, or writing
+ *        back from, one buffer while caller uses the other.
+ *
+ * @param stream      - May be NULL or a pointer to a struct udo_file_ops_stream.
+ *                      If NULL memory will be allocated and return to
+ *                      caller. If not NULL address passed will be used
+ *                      to store the newly created struct udo_file_ops_stream
+ *                      context.
+ * @param stream_info - Implementation uses a pointer to a
+ *                      struct udo_file_ops_stream_create_info.
+ *
+ * @returns
+ * 	on success: Pointer to a struct udo_file_ops_stream
+ * 	on failure: NULL
+ */
+UDO_API
+struct udo_file_ops_stream *
+udo_file_ops_stream_create (struct udo_file_ops_stream *stream,
+                            const void *stream_info);
+
+
+/*
+ * @brief Returns the next buffer of file data. Buffer is only
+ *        valid until the next call. While caller consumes the
+ *        buffer the following one is read in the background.
+ *
+ * @param stream - Pointer to a valid struct udo_file_ops_stream.
+ * @param buf    - Pointer to store address of the buffer.
+ *
+ * @returns
+ * 	on success: Amount of bytes in @buf, 0 at end of file
+ * 	on failure: -1
+ */
+UDO_API
+ssize_t
+udo_file_ops_stream_read (struct udo_file_ops_stream *stream,
+                          const void **buf);
+
+
+/*
+ * @brief Copies data into the current I/O buffer. Once the
+ *        buffer is full it's written in the background while
+ *        caller fills the other buffer.
+ *
+ * @param stream - Pointer to a valid struct udo_file_ops_stream.
+ * @param buf    - Pointer to buffer storing data to write.
+ * @param len    - Size in bytes of @buf.
+ *
+ * @returns
+ * 	on success: Amount of bytes copied
+ * 	on failure: -1
+ */
+UDO_API
+ssize_t
+udo_file_ops_stream_write (struct udo_file_ops_stream *stream,
+                           const void *buf,
+                           const size_t len);
+
+
+/*
+ * @brief Waits for background writes and writes any data left
+ *        in the current I/O buffer. If the stream uses O_DIRECT
+ *        and the data isn't a multiple of the page size the last
+ *        page is written zero padded and the file truncated back
+ *        to its length. That page is written again by later writes.
+ *
+ * @param stream - Pointer to a valid struct udo_file_ops_stream.
+ *
+ * @returns
+ * 	on success: 0
+ * 	on failure: -1
+ */
+UDO_API
+int
+udo_file_ops_stream_flush (struct udo_file_ops_stream *stream);
+
+
+/*
+ * @brief Flushes written data, stops the background thread
+ *        and frees any allocated memory created after
+ *        udo_file_ops_stream_create() call.
+ *
+ * @param stream - Pointer to a valid struct udo_file_ops_stream.
+ */
+UDO_API
+void
+udo_file_ops_stream_destroy (struct udo_file_ops_stream *stream);
+
+
+/*
+ * @brief Returns size of the internal stream structure.
+ *        So, if caller decides to allocate memory outside
+ *        of API interface they know the exact amount
+ *        of bytes.
+ *
+ * @returns
+ *	on success: sizeof(struct udo_file_ops_stream)
+ *	on failure: sizeof(struct udo_file_ops_stream)
+ */
+UDO_API
+int
+udo_file_ops_stream_get_sizeof (void);
+
+
 /*
  * @brief Returns file data stored at a given offset.
  *        Caller would have to copy into a secondary
@@ -182,6 +640,8 @@ udo_file_ops_get_data (struct udo_file_ops *flops,
  *
  * @param flops - Pointer to a valid struct udo_file_ops.
  * @param line  - Line number in file to get data from.
+ *                Lines past the last line return the data
+ *                following the last newline.
  *
  * @returns
  * 	on success: Pointer to file data at a given line
@@ -195,6 +655,8 @@ udo_file_ops_get_line (struct udo_file_ops *flops,
 
 /*
  * @brief Returns the amount of lines a file contains.
+ *        If struct udo_file_ops_create_info { @line_index }
+ *        is set returns the cached line count.
  *
  * @param flops - Pointer to a valid struct udo_file_ops.
  *
@@ -326,7 +788,9 @@ udo_file_ops_reset_full_path (struct udo_file_ops *flops);
  * @param flops   - Pointer to a valid struct udo_file_ops.
  * @param data_sz - Byte size to shrink or expand file data to.
  *                  Generally should be set to 0 unless caller
- *                  directly modifies mmap(2) file buffer.
+ *                  directly modifies mmap(2) file buffer. If 0
+ *                  and data was written with udo_file_ops_append(3)
+ *                  file is truncated to the size of its data.
  */
 UDO_API
 void
@@ -366,6 +830,59 @@ int
 udo_file_ops_set_fd_flags (const int fd, const int flags);
 
 
+/*
+ * @brief UDO File Operations Walk Info Structure
+ *
+ * @member entry - Function called for each entry of every directory walked.
+ *                 @dirfd is an open file descriptor of the directory
+ *                 containing @name. @type is a DT_* value from readdir(3).
+ *                 @depth is 1 for entries of the directory passed to
+ *                 udo_file_ops_walk(3). Return 0 to descend into
+ *                 directories, 1 to skip them or -1 on failure.
+ *                 If @jpool is set function is called concurrently.
+ * @member leave - Function called once every entry of a directory was
+ *                 walked. @dirfd is an open file descriptor of the
+ *                 directory containing @name. For the directory passed
+ *                 to udo_file_ops_walk(3) @dirfd is AT_FDCWD. Always
+ *                 called by the thread walking the tree. Return 0 on
+ *                 success or -1 on failure.
+ * @member arg   - Argument to pass to @entry and @leave.
+ * @member jpool - Optional pointer to a struct udo_jpool. If set each
+ *                 directory is read by the pool. Only the thread calling
+ *                 udo_file_ops_walk(3) may add jobs to the pool while
+ *                 walking. Ignored if libudo is built without jpool.
+ */
+struct udo_file_ops_walk_info
+{
+	int              (*entry)(void *arg, const int dirfd, const char *name,
+	                          const uint8_t type, const uint32_t depth);
+	int              (*leave)(void *arg, const int dirfd, const char *name,
+	                          const uint32_t depth);
+	void             *arg;
+	struct udo_jpool *jpool;
+};
+
+
+/*
+ * @brief Walks a directory tree with openat(2) relative to open
+ *        directory file descriptors. Entry types come from readdir(3)
+ *        d_type. So, fstatat(2) is only called on file systems that
+ *        don't report it. Symbolic links are never followed.
+ *
+ * @param dir       - Directory to walk.
+ * @param walk_info - Implementation uses a pointer to a
+ *                    struct udo_file_ops_walk_info.
+ *
+ * @returns
+ * 	on success: 0
+ * 	on failure: -1 (errno set to the first failure)
+ */
+UDO_API
+int
+udo_file_ops_walk (const char *dir,
+                   const void *walk_info);
+
+
 /*
  * @brief Recursively delete files and directories
  *        contained inside caller defined directory.
@@ -381,4 +898,23 @@ UDO_API
 int
 udo_file_ops_remove_dir (const char *dir);
 
+
+/*
+ * @brief Same as udo_file_ops_remove_dir(3). Except directories
+ *        are read and their files unlinked by a struct udo_jpool.
+ *        NOTE: Only defined if libudo is built with jpool support.
+ *
+ * @param dir   - Directory to delete.
+ * @param jpool - Pointer to a valid struct udo_jpool. If NULL
+ *                tree is deleted by the calling thread.
+ *
+ * @returns
+ * 	on success: 0
+ * 	on failure: -1
+ */
+UDO_API
+int
+udo_file_ops_remove_dir_jpool (const char *dir,
+                               struct udo_jpool *jpool);
+
 #endif /* UDO_FILE_OPS_H */
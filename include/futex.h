@@ -66,6 +66,24 @@ udo_atomic_u32 *
 udo_futex_create (const void *futex_info);
 
 
+/*
+ * @brief Priority inheritance variant of udo_futex_create(3).
+ *        Futexes are initialized in the unlocked state for
+ *        use with udo_futex_lock_pi(3) and udo_futex_unlock_pi(3).
+ *        Memory is released with udo_futex_destroy(3).
+ *
+ * @param futex_info - Implementation uses a pointer to a
+ *                     struct udo_futex_create_info.
+ *
+ * @returns
+ *	on success: Pointer to a udo_atomic_u32
+ *	on failure: NULL
+ */
+UDO_API
+udo_atomic_u32 *
+udo_futex_create_pi (const void *futex_info);
+
+
 /*
  * @brief Atomically updates futex value to the locked state.
  *        If value can't be changed inform kernel that a
@@ -81,6 +99,26 @@ void
 udo_futex_lock (udo_atomic_u32 *fux);
 
 
+/*
+ * @brief Priority inheritance variant of udo_futex_lock(3).
+ *        Atomically stores the callers thread ID in the
+ *        futex. If futex is owned by another thread inform
+ *        kernel that a process/thread needs to be put to
+ *        sleep. While sleeping the kernel temporarily boosts
+ *        the owner to the highest priority of all waiters.
+ *        Futex must be created with udo_futex_create_pi(3)
+ *        and may only be unlocked by the owning thread
+ *        via udo_futex_unlock_pi(3).
+ *        On failure errno is set by futex(2) FUTEX_LOCK_PI.
+ *
+ * @param fux - Pointer to 32-bit unsigned integer
+ *              storing futex value.
+ */
+UDO_API
+void
+udo_futex_lock_pi (udo_atomic_u32 *fux);
+
+
 /*
  * @brief Wait until the futex value is in the desired state.
  *        If value not in desired state inform kernel that a
@@ -149,6 +187,55 @@ __out:                                           \
 })
 
 
+/*
+ * Maximum amount of futexes that may be passed
+ * to a single udo_futex_waitv(3) call.
+ */
+#define UDO_FUTEX_WAITV_MAX (1<<7)
+
+/*
+ * @brief Structure passed to udo_futex_waitv(3) defining
+ *        a single futex to watch and the value it's
+ *        expected to store while the caller sleeps.
+ *
+ * @member fux - Pointer to 32-bit unsigned integer
+ *               storing futex value.
+ * @member val - Value futex is expected to store. If
+ *               the value at @fux differs the caller
+ *               is woken up.
+ */
+struct udo_futex_waiter
+{
+	udo_atomic_u32 *fux;
+	uint32_t       val;
+};
+
+
+/*
+ * @brief Wait until any of the futexes in @waiters no longer
+ *        store their expected value. If all values are as
+ *        expected inform kernel that a process/thread needs
+ *        to be put to sleep until one of the futexes is woken.
+ *        Uses futex_waitv(2) (Linux 5.16+) if available else
+ *        falls back to waiting on each futex in turn with a
+ *        small timeout. Sets errno to EINTR if a call to
+ *        udo_futex_unlock_force() is made on any futex.
+ *
+ * @param waiters - Pointer to an array of struct udo_futex_waiter.
+ * @param count   - Amount of elements in @waiters. Limited
+ *                  to UDO_FUTEX_WAITV_MAX.
+ *
+ * @returns
+ *	on success: Index in @waiters of the futex that changed
+ *	            or was woken up
+ *	on failure: -1
+ */
+UDO_API
+int
+udo_futex_waitv (const struct udo_futex_waiter *waiters,
+                 const uint32_t count);
+
+
 /*
  * @brief Atomically update futex value to the unlocked state.
  *        Then inform kernel to wake up all processes/threads
@@ -162,6 +249,22 @@ void
 udo_futex_unlock (udo_atomic_u32 *fux);
 
 
+/*
+ * @brief Priority inheritance variant of udo_futex_unlock(3).
+ *        Atomically update futex value to the unlocked state.
+ *        If processes/threads are waiting on the futex inform
+ *        kernel to hand ownership to the highest priority
+ *        waiter. Must be called by the thread that acquired
+ *        the futex with udo_futex_lock_pi(3).
+ *
+ * @param fux - Pointer to 32-bit unsigned integer
+ *              storing futex value.
+ */
+UDO_API
+void
+udo_futex_unlock_pi (udo_atomic_u32 *fux);
+
+
 /*
  * @brief Atomically update futex value to the force unlocked state.
  *        Then inform kernel to wake up all processes/threads
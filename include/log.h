@@ -81,6 +81,48 @@ void
 udo_log_set_write_fd (const int fd);
 
 
+/*
+ * @brief enum udo_log_sync_type (Log Sync Type)
+ *
+ *        Sets when the open file is flushed to disk with
+ *        fdatasync(2) after log messages are written.
+ *
+ * @macro UDO_LOG_SYNC_NEVER    - Leave write-back to the kernel.
+ * @macro UDO_LOG_SYNC_LINES    - Flush every @value messages.
+ * @macro UDO_LOG_SYNC_ERROR    - Flush after UDO_LOG_ERROR messages.
+ * @macro UDO_LOG_SYNC_INTERVAL - Flush when a message is written and
+ *                                the last flush was @value
+ *                                milliseconds ago or more.
+ */
+enum udo_log_sync_type
+{
+	UDO_LOG_SYNC_NEVER    = 0x00,
+	UDO_LOG_SYNC_LINES    = 0x01,
+	UDO_LOG_SYNC_ERROR    = 0x02,
+	UDO_LOG_SYNC_INTERVAL = 0x03,
+};
+
+
+/*
+ * @brief Sets when the open file is flushed to disk.
+ *
+ *        Default is set to UDO_LOG_SYNC_NEVER.
+ *
+ * @param type  - enum udo_log_sync_type policy to use.
+ * @param value - Amount of messages for UDO_LOG_SYNC_LINES or
+ *                milliseconds for UDO_LOG_SYNC_INTERVAL.
+ *                Ignored otherwise.
+ *
+ * @returns
+ * 	on success: 0
+ * 	on failure: -1
+ */
+UDO_API
+int
+udo_log_set_sync (const enum udo_log_sync_type type,
+                  const uint32_t value);
+
+
 /*
  * @brief Sets the internal global ansi color
  *        storage array to remove the ansi colors
@@ -190,7 +232,9 @@ udo_log_set_error_struct (void *context,
 /*
  * @brief Provides applications/library way to write to an open file
  *        with a time stamp and ansi color codes to colorize
- *        different message.
+ *        different message. Whole message is written with a
+ *        single write(2). See udo_log_set_sync(3) to flush
+ *        messages to disk.
  *
  * @param type - The type of color to use with log.
  * @param fmt  - Format of the log passed to va_args.
@@ -206,7 +250,9 @@ udo_log_time (enum udo_log_level_type type,
 /*
  * @brief Provides applications/library way to write to an open file
  *        without time stamp with ansi color codes to colorize
- *        different message.
+ *        different message. Whole message is written with a
+ *        single write(2). See udo_log_set_sync(3) to flush
+ *        messages to disk.
  *
  * @param type - The type of color to use with log.
  * @param fmt  - Format of the log passed to va_args.
@@ -219,6 +265,103 @@ udo_log_notime (enum udo_log_level_type type,
                 ...);
 
 
+/*
+ * @brief enum udo_log_overflow_type (Log Overflow Type)
+ *
+ *        Sets what udo_log_time(3) and udo_log_notime(3) do
+ *        when the asynchronous log ring is full.
+ *
+ * @macro UDO_LOG_OVERFLOW_DROP  - Discard message.
+ * @macro UDO_LOG_OVERFLOW_COUNT - Discard message and count it. The
+ *                                 amount discarded is logged once the
+ *                                 ring drains and may be acquired with
+ *                                 udo_log_get_dropped(3).
+ * @macro UDO_LOG_OVERFLOW_BLOCK - Wait until the ring has space.
+ */
+enum udo_log_overflow_type
+{
+	UDO_LOG_OVERFLOW_DROP  = 0x00,
+	UDO_LOG_OVERFLOW_COUNT = 0x01,
+	UDO_LOG_OVERFLOW_BLOCK = 0x02,
+};
+
+
+/*
+ * @brief Structure passed to udo_log_async_start(3) used
+ *        to define the asynchronous log ring.
+ *
+ * @member entries  - Amount of messages the ring stores. Rounded up
+ *                    to a power of two. If 0 1024 entries are used.
+ *                    Each entry is 1KiB and messages longer than an
+ *                    entry are truncated.
+ * @member overflow - enum udo_log_overflow_type defining what callers
+ *                    do when the ring is full.
+ */
+struct udo_log_async_info
+{
+	uint32_t entries;
+	uint8_t  overflow;
+};
+
+
+/*
+ * @brief Switches udo_log_time(3) and udo_log_notime(3) to
+ *        asynchronous mode. Callers format messages into a
+ *        lock-free ring and return. A background thread
+ *        batches messages from the ring into a single writev(2).
+ *
+ * @param async_info - Pointer to a struct udo_log_async_info.
+ *
+ * @returns
+ * 	on success: 0
+ * 	on failure: -1 and errno is set
+ */
+UDO_API
+int
+udo_log_async_start (const struct udo_log_async_info *async_info);
+
+
+/*
+ * @brief Waits until every message logged before the
+ *        call is written to the open file. Returns
+ *        immediately if asynchronous mode is off.
+ *
+ * @returns
+ * 	on success: 0
+ * 	on failure: -1
+ */
+UDO_API
+int
+udo_log_flush (void);
+
+
+/*
+ * @brief Writes every message still in the ring, stops the
+ *        background thread and switches back to synchronous
+ *        mode. Threads may keep logging while this function
+ *        runs. Messages logged after it starts are written
+ *        synchronously. Returns once threads already using the
+ *        ring are done with it.
+ */
+UDO_API
+void
+udo_log_async_stop (void);
+
+
+/*
+ * @brief Returns amount of messages discarded since
+ *        udo_log_async_start(3) with overflow set to
+ *        UDO_LOG_OVERFLOW_COUNT.
+ *
+ * @returns
+ * 	on success: Amount of messages discarded
+ * 	on failure: 0
+ */
+UDO_API
+uint32_t
+udo_log_get_dropped (void);
+
+
 /*
  * Should only be used by bellow macros
  */
@@ -119,6 +119,14 @@
 	((bytes+(power_two_align-1))&~(power_two_align-1))
 
 
+/*
+ * @brief Defines typical cache line size. Used to
+ *        keep data written by separate processes/threads
+ *        from sharing the same cache line.
+ */
+#define UDO_CACHE_LINE_SIZE (1<<6)
+
+
 /*
  * @brief Defines typical page size.
  */
@@ -175,6 +183,7 @@
 UDO_ATOMIC_DEF(udo_atomic_int, int)
 UDO_ATOMIC_DEF(udo_atomic_bool, uint8_t)
 UDO_ATOMIC_DEF(udo_atomic_u32, unsigned int)
+UDO_ATOMIC_DEF(udo_atomic_u64, uint64_t)
 UDO_ATOMIC_DEF(udo_atomic_addr, unsigned char *)
 
 
@@ -25,6 +25,8 @@
 #ifndef UDO_SHM_H
 #define UDO_SHM_H
 
+#include <sys/types.h>
+
 #include "macros.h"
 
 /*
@@ -38,18 +40,70 @@ struct udo_shm;
  *        to define shared memory file name, shm size,
  *        and process count.
  *
- * @param shm_file   - Shared memory file name. Must start
- *                     with the character '/'.
- * @param shm_size   - Size of shared memory.
- * @param proc_count - Amount of processes able to read and
- *                     write to and from the shared memory
- *                     block.
+ * @param shm_file        - Shared memory file name. Must start
+ *                          with the character '/'.
+ * @param shm_size        - Size of shared memory.
+ * @param proc_count      - Amount of processes able to read and
+ *                          write to and from the shared memory
+ *                          block.
+ * @param proc_sizes      - Optional array of @proc_count segment
+ *                          sizes. If NULL @shm_size is divided
+ *                          evenly amongst processes. Otherwise
+ *                          @shm_size may be zero and shared memory
+ *                          is sized to fit every segment.
+ * @param shm_fd          - File descriptor to shared memory created
+ *                          by a peer and received over a unix domain
+ *                          socket. Only used if @use_fd is set.
+ * @param bcast_skip_slow - Slow subscriber policy used by
+ *                          udo_shm_bcast_write(). If set records
+ *                          slow subscribers haven't read are
+ *                          overwritten and the subscriber skips
+ *                          ahead. Otherwise producer waits for
+ *                          the slowest subscriber (backpressure).
+ * @param memfd           - Back shared memory with memfd_create(2)
+ *                          instead of shm_open(3). Peers attach to the
+ *                          file descriptor returned from udo_shm_get_fd().
+ * @param hugetlb         - Back shared memory with huge pages. Uses
+ *                          MFD_HUGETLB if @memfd is set otherwise
+ *                          creates @shm_file under /dev/hugepages.
+ * @param populate        - Prefault pages with MAP_POPULATE so
+ *                          first access never page faults.
+ * @param lock            - Lock pages in memory with mlock(2) so
+ *                          they're never swapped out.
+ * @param use_fd          - Attach to @shm_fd instead of creating shared
+ *                          memory. @shm_file, @shm_size, @proc_count,
+ *                          @proc_sizes and @growable are ignored.
+ * @param growable        - Allow segments to be moved with udo_shm_grow(3).
+ *                          Every access then enters a per segment gate
+ *                          with an atomic read-modify-write. Otherwise
+ *                          accesses never write the shared directory.
+ *                          Set by the process creating shared memory.
+ * @param event_fds       - Optional array of @proc_count eventfd(2)
+ *                          file descriptors signalled each time data
+ *                          is written to the matching process segment.
+ *                          Entries set to -1 are skipped. The same
+ *                          eventfds must be used by every process
+ *                          (created before fork(2) or sent with
+ *                          udo_usock_tcp_send_fd()) so writes wake
+ *                          readers in other processes. Should be
+ *                          created with EFD_NONBLOCK. File descriptors
+ *                          are duplicated. See udo_shm_get_event_fd().
  */
 struct udo_shm_create_info
 {
-	const char *shm_file;
-	size_t     shm_size;
-	uint32_t   proc_count;
+	const char   *shm_file;
+	size_t       shm_size;
+	uint32_t     proc_count;
+	const size_t *proc_sizes;
+	int          shm_fd;
+	const int    *event_fds;
+	uint8_t      bcast_skip_slow : 1;
+	uint8_t      memfd : 1;
+	uint8_t      hugetlb : 1;
+	uint8_t      populate : 1;
+	uint8_t      lock : 1;
+	uint8_t      use_fd : 1;
+	uint8_t      growable : 1;
 };
 
 
@@ -59,6 +113,9 @@ struct udo_shm_create_info
  *        	1. Read futex (initialized to locked)
  *        	2. Write futex (initialized to unlocked)
  *        	3. Segment within shared memory to store data
+ *        Futexes and segment locations are stored in a
+ *        directory at the start of shared memory written
+ *        by the first process to attach.
  *
  * @param shm      - May be NULL or a pointer to a struct udo_shm.
  *                   If NULL memory will be allocated and return to
@@ -81,18 +138,26 @@ udo_shm_create (struct udo_shm *shm,
 /*
  * @brief Structure defining what operations to perform
  *        and data to retrieve during calls to
- *        udo_shm_data_read() and udo_shm_data_write().
+ *        udo_shm_data_read(), udo_shm_data_write(),
+ *        udo_shm_ring_read(), udo_shm_ring_write(),
+ *        udo_shm_bcast_write(), udo_shm_latest_write()
+ *        and udo_shm_latest_read().
  *
- * @member data       - Pointer to a buffer that will either be used
- *                      to store shm data or write to shm data.
- * @member size       - Size in bytes to read from or write to shared memory.
- * @member proc_index - Index of process to write data to or read data from.
+ * @member data         - Pointer to a buffer that will either be used
+ *                        to store shm data or write to shm data.
+ * @member size         - Size in bytes to read from or write to shared memory.
+ * @member proc_index   - Index of process to write data to or read data from.
+ * @member non_temporal - Copy large payloads with non-temporal (cache bypassing)
+ *                        stores during calls to udo_shm_data_read(),
+ *                        udo_shm_data_write() and udo_shm_latest_write().
+ *                        Only honored on x86.
  */
 struct udo_shm_data_info
 {
 	void     *data;
 	size_t   size;
 	uint32_t proc_index;
+	uint8_t  non_temporal : 1;
 };
 
 
@@ -132,6 +197,443 @@ udo_shm_data_write (struct udo_shm *shm,
                     const void *shm_info);
 
 
+/*
+ * @brief Writes a variable length record stored in a caller
+ *        defined buffer into a processes shared memory segment
+ *        used as a ring buffer. Unlike udo_shm_data_write(3) the
+ *        writer doesn't wait for the reader to consume previous
+ *        data. Caller only sleeps if the ring is full. Producer
+ *        and consumer positions are stored on separate cache
+ *        lines at the start of the segment. Producers claim
+ *        space with a compare exchange and records are
+ *        published in the order space was claimed. A process
+ *        that dies between claiming and publishing a record
+ *        stalls records claimed after it. A segment must only
+ *        be used with either udo_shm_ring_{read,write}(3) or
+ *        udo_shm_data_{read,write}(3). Record size is limited
+ *        to half of the ring. Threads may share @shm.
+ *
+ * @param shm      - Pointer to a valid struct udo_shm.
+ * @param shm_info - Must pass a pointer to a struct udo_shm_data_info.
+ *
+ * @returns
+ *	on success: Amount of bytes written
+ *	on failure: -1
+ */
+UDO_API
+ssize_t
+udo_shm_ring_write (struct udo_shm *shm,
+                    const void *shm_info);
+
+
+/*
+ * @brief Reads the next record stored in a processes shared
+ *        memory segment used as a ring buffer and writes into
+ *        a caller defined buffer. Caller only sleeps if the
+ *        ring is empty. If the record is larger than
+ *        struct udo_shm_data_info { @size } the record
+ *        isn't consumed and function fails. Threads may
+ *        share @shm.
+ *
+ * @param shm      - Pointer to a valid struct udo_shm.
+ * @param shm_info - Must pass a pointer to a struct udo_shm_data_info.
+ *
+ * @returns
+ *	on success: Size of the record read
+ *	on failure: -1
+ */
+UDO_API
+ssize_t
+udo_shm_ring_read (struct udo_shm *shm,
+                   const void *shm_info);
+
+
+/*
+ * @brief Reserves space for a record of @size bytes in a processes
+ *        shared memory segment used as a ring buffer. Caller
+ *        serializes data directly into the returned address then
+ *        publishes the record with udo_shm_write_commit(3). Caller
+ *        only sleeps if the ring is full. Records other producers
+ *        reserve afterwards aren't visible to consumers until
+ *        the record is committed. Fails if a record reserved
+ *        by the caller isn't committed yet. Segment isn't moved
+ *        by udo_shm_grow(3) while a record is reserved so the
+ *        returned address stays valid until udo_shm_write_commit(3).
+ *        NOTE: One record may be reserved per context at a time.
+ *        Threads must not share @shm for this call, each thread
+ *        creates its own context with udo_shm_create(3).
+ *
+ * @param shm        - Pointer to a valid struct udo_shm.
+ * @param proc_index - Index of process to write record to.
+ * @param size       - Size in bytes of the record.
+ *
+ * @returns
+ *	on success: Pointer to @size bytes of shared memory
+ *	on failure: NULL
+ */
+UDO_API
+void *
+udo_shm_write_reserve (struct udo_shm *shm,
+                       const uint32_t proc_index,
+                       const size_t size);
+
+
+/*
+ * @brief Publishes the record reserved with udo_shm_write_reserve(3)
+ *        to readers with a single release store.
+ *
+ * @param shm        - Pointer to a valid struct udo_shm.
+ * @param proc_index - Index of process record was reserved in.
+ *
+ * @returns
+ *	on success: 0
+ *	on failure: -1
+ */
+UDO_API
+int
+udo_shm_write_commit (struct udo_shm *shm,
+                      const uint32_t proc_index);
+
+
+/*
+ * @brief Returns address of the next record stored in a processes
+ *        shared memory segment used as a ring buffer. Caller parses
+ *        the record in place then frees the space with
+ *        udo_shm_read_release(3). Caller only sleeps if the ring
+ *        is empty. Space of records other consumers acquire
+ *        afterwards isn't reused until the record is released.
+ *        Fails if a record acquired by the caller isn't released
+ *        yet. Segment isn't moved by udo_shm_grow(3) while a
+ *        record is acquired so the returned address stays valid
+ *        until udo_shm_read_release(3). NOTE: One record may be
+ *        acquired per context at a time. Threads must not share
+ *        @shm for this call, each thread creates its own context
+ *        with udo_shm_create(3).
+ *
+ * @param shm        - Pointer to a valid struct udo_shm.
+ * @param proc_index - Index of process to read record from.
+ * @param size       - Pointer to store size in bytes of the record.
+ *
+ * @returns
+ *	on success: Pointer to the record in shared memory
+ *	on failure: NULL
+ */
+UDO_API
+const void *
+udo_shm_read_acquire (struct udo_shm *shm,
+                      const uint32_t proc_index,
+                      size_t *size);
+
+
+/*
+ * @brief Releases the record acquired with udo_shm_read_acquire(3)
+ *        so that its space may be reused by producers.
+ *
+ * @param shm        - Pointer to a valid struct udo_shm.
+ * @param proc_index - Index of process record was acquired from.
+ *
+ * @returns
+ *	on success: 0
+ *	on failure: -1
+ */
+UDO_API
+int
+udo_shm_read_release (struct udo_shm *shm,
+                      const uint32_t proc_index);
+
+
+/*
+ * @brief Publishes a record to every subscriber of a processes
+ *        shared memory segment used as a broadcast ring. The
+ *        payload is copied once regardless of the amount of
+ *        subscribers. If the ring is full, depending on
+ *        struct udo_shm_create_info { @bcast_skip_slow },
+ *        either waits for the slowest subscriber or overwrites
+ *        records it hasn't read.
+ *
+ * @param shm      - Pointer to a valid struct udo_shm.
+ * @param shm_info - Must pass a pointer to a struct udo_shm_data_info.
+ *
+ * @returns
+ *	on success: Size of the record written
+ *	on failure: -1
+ */
+UDO_API
+ssize_t
+udo_shm_bcast_write (struct udo_shm *shm,
+                     const void *shm_info);
+
+
+/*
+ * @brief Registers a subscriber to a processes broadcast
+ *        ring. Subscribers only receive records written
+ *        after subscribing.
+ *
+ * @param shm        - Pointer to a valid struct udo_shm.
+ * @param proc_index - Index of process to subscribe to.
+ *
+ * @returns
+ *	on success: Subscriber index
+ *	on failure: -1
+ */
+UDO_API
+int
+udo_shm_bcast_subscribe (struct udo_shm *shm,
+                         const uint32_t proc_index);
+
+
+/*
+ * @brief Removes a subscriber from a processes broadcast
+ *        ring so that producer no longer waits for it.
+ *
+ * @param shm        - Pointer to a valid struct udo_shm.
+ * @param proc_index - Index of process subscribed to.
+ * @param reader     - Subscriber index returned from
+ *                     udo_shm_bcast_subscribe().
+ *
+ * @returns
+ *	on success: 0
+ *	on failure: -1
+ */
+UDO_API
+int
+udo_shm_bcast_unsubscribe (struct udo_shm *shm,
+                           const uint32_t proc_index,
+                           const uint32_t reader);
+
+
+/*
+ * @brief Returns address of the next record in a processes
+ *        broadcast ring for the given subscriber. All
+ *        subscribers read the same record in place. Caller
+ *        only sleeps if no new records were written. Records
+ *        overwritten before being read are skipped. Fails if a
+ *        record acquired by the subscriber isn't released yet.
+ *        Segment isn't moved by udo_shm_grow(3) until the record
+ *        is released.
+ *
+ * @param shm        - Pointer to a valid struct udo_shm.
+ * @param proc_index - Index of process subscribed to.
+ * @param reader     - Subscriber index returned from
+ *                     udo_shm_bcast_subscribe().
+ * @param size       - Pointer to store size in bytes of the record.
+ *
+ * @returns
+ *	on success: Pointer to the record in shared memory
+ *	on failure: NULL
+ */
+UDO_API
+const void *
+udo_shm_bcast_read_acquire (struct udo_shm *shm,
+                            const uint32_t proc_index,
+                            const uint32_t reader,
+                            size_t *size);
+
+
+/*
+ * @brief Advances subscriber past the record returned from
+ *        udo_shm_bcast_read_acquire(). If producer skips slow
+ *        subscribers and overwrote the record while it was
+ *        being read function fails and the caller must discard
+ *        what it read.
+ *
+ * @param shm        - Pointer to a valid struct udo_shm.
+ * @param proc_index - Index of process subscribed to.
+ * @param reader     - Subscriber index returned from
+ *                     udo_shm_bcast_subscribe().
+ *
+ * @returns
+ *	on success: 0
+ *	on failure: -1
+ */
+UDO_API
+int
+udo_shm_bcast_read_release (struct udo_shm *shm,
+                            const uint32_t proc_index,
+                            const uint32_t reader);
+
+
+/*
+ * @brief Stores the latest value of a processes shared memory
+ *        segment used as a seqlock protected slot. Producer
+ *        never waits for readers. Only one producer may write
+ *        to a given segment.
+ *
+ * @param shm      - Pointer to a valid struct udo_shm.
+ * @param shm_info - Must pass a pointer to a struct udo_shm_data_info.
+ *
+ * @returns
+ *	on success: Size of the value written
+ *	on failure: -1
+ */
+UDO_API
+ssize_t
+udo_shm_latest_write (struct udo_shm *shm,
+                      const void *shm_info);
+
+
+/*
+ * @brief Copies the latest value stored in a processes shared
+ *        memory segment used as a seqlock protected slot into
+ *        a caller defined buffer. Value isn't consumed. Readers
+ *        never write to shared memory and retry if the value
+ *        changed while being copied.
+ *
+ * @param shm      - Pointer to a valid struct udo_shm.
+ * @param shm_info - Must pass a pointer to a struct udo_shm_data_info.
+ *
+ * @returns
+ *	on success: Size of the value read (0 if never written)
+ *	on failure: -1
+ */
+UDO_API
+ssize_t
+udo_shm_latest_read (struct udo_shm *shm,
+                     const void *shm_info);
+
+
+/*
+ * @brief Allocates a block of at least @size bytes from a processes
+ *        shared memory segment used as a heap. Blocks are referenced
+ *        by their offset from the start of the segment instead of an
+ *        address so that they may be shared with processes mapping
+ *        shared memory at a different address and survive calls to
+ *        udo_shm_grow(3). Allocation and release are lock-free and
+ *        may be called from any process attached to shared memory.
+ *        Blocks are served from power of two size class free lists
+ *        and are 16 byte aligned.
+ *
+ * @param shm        - Pointer to a valid struct udo_shm.
+ * @param proc_index - Index of process segment to allocate from.
+ * @param size       - Size in bytes of the block.
+ *
+ * @returns
+ *	on success: Offset of the block within the segment
+ *	on failure: 0
+ */
+UDO_API
+uint64_t
+udo_shm_mm_alloc (struct udo_shm *shm,
+                  const uint32_t proc_index,
+                  const size_t size);
+
+
+/*
+ * @brief Returns a block allocated with udo_shm_mm_alloc(3) to its
+ *        size class free list. Block may be released by a different
+ *        process than the one that allocated it.
+ *
+ * @param shm        - Pointer to a valid struct udo_shm.
+ * @param proc_index - Index of process segment block was allocated from.
+ * @param offset     - Offset returned from udo_shm_mm_alloc(3).
+ *
+ * @returns
+ *	on success: 0
+ *	on failure: -1
+ */
+UDO_API
+int
+udo_shm_mm_free (struct udo_shm *shm,
+                 const uint32_t proc_index,
+                 const uint64_t offset);
+
+
+/*
+ * @brief Converts an offset within a processes segment into
+ *        an address in the callers mapping of shared memory.
+ *        Addresses must be converted again after the segment
+ *        is grown.
+ *
+ * @param shm        - Pointer to a valid struct udo_shm.
+ * @param proc_index - Index of process segment.
+ * @param offset     - Offset returned from udo_shm_mm_alloc(3).
+ *
+ * @returns
+ *	on success: Pointer to shared memory
+ *	on failure: NULL
+ */
+UDO_API
+void *
+udo_shm_mm_get_addr (struct udo_shm *shm,
+                     const uint32_t proc_index,
+                     const uint64_t offset);
+
+
+/*
+ * @brief Converts an address in the callers mapping of a processes
+ *        segment into an offset that may be stored in shared memory
+ *        and resolved by other processes with udo_shm_mm_get_addr(3).
+ *
+ * @param shm        - Pointer to a valid struct udo_shm.
+ * @param proc_index - Index of process segment.
+ * @param addr       - Address within the segment.
+ *
+ * @returns
+ *	on success: Offset of @addr within the segment
+ *	on failure: 0
+ */
+UDO_API
+uint64_t
+udo_shm_mm_get_offset (struct udo_shm *shm,
+                       const uint32_t proc_index,
+                       const void *addr);
+
+
+/*
+ * @brief Grows a processes segment to @size bytes. Shared
+ *        memory is extended with ftruncate(2) and the segment
+ *        is moved to the end of shared memory. New accesses to
+ *        the segment block while it's moved, waiters sleeping
+ *        on a full or empty ring are woken and retry afterwards
+ *        and the move waits for reserved or acquired records
+ *        to be committed or released. Ring records are kept.
+ *        Pages of the old location are returned to the backing
+ *        file. Peers map the new location on their next call.
+ *        Addresses returned from udo_shm_get_data(3) and
+ *        udo_shm_mm_get_addr(3) must be retrieved again. Fails
+ *        if the caller holds a reserved or acquired record in
+ *        the segment or if shared memory wasn't created with
+ *        struct udo_shm_create_info { @growable }. A process
+ *        that exits while holding a record blocks growth of
+ *        the segment.
+ *
+ * @param shm        - Pointer to a valid struct udo_shm.
+ * @param proc_index - Index of process segment to grow.
+ * @param size       - New size in bytes of the segment. If
+ *                     smaller than current size nothing is done.
+ *
+ * @returns
+ *	on success: 0
+ *	on failure: -1
+ */
+UDO_API
+int
+udo_shm_grow (struct udo_shm *shm,
+              const uint32_t proc_index,
+              const size_t size);
+
+
+/*
+ * @brief Replaces eventfd(2) signalled when data is written to
+ *        a processes segment. Used to install the eventfd of the
+ *        process reading the segment after receiving it with
+ *        udo_usock_tcp_recv_fd(). File descriptor is duplicated.
+ *
+ * @param shm        - Pointer to a valid struct udo_shm.
+ * @param proc_index - Index of process segment.
+ * @param event_fd   - eventfd(2) file descriptor.
+ *
+ * @returns
+ *	on success: 0
+ *	on failure: -1
+ */
+UDO_API
+int
+udo_shm_set_event_fd (struct udo_shm *shm,
+                      const uint32_t proc_index,
+                      const int event_fd);
+
+
 /*
  * @brief Returns file descriptor to the POSIX shared memory
  *        created after call to udo_shm_create().
@@ -147,10 +649,34 @@ int
 udo_shm_get_fd (struct udo_shm *shm);
 
 
+/*
+ * @brief Returns eventfd(2) signalled each time data is written
+ *        to a processes segment with udo_shm_data_write(),
+ *        udo_shm_ring_write(), udo_shm_write_commit(),
+ *        udo_shm_bcast_write() or udo_shm_latest_write().
+ *        Duplicate of the eventfd passed in create info or with
+ *        udo_shm_set_event_fd(). May be added to an epoll(7)
+ *        set alongside sockets. Caller reads the
+ *        eventfd to reset it before reading the segment.
+ *
+ * @param shm        - Pointer to a valid struct udo_shm.
+ * @param proc_index - Index of process segment.
+ *
+ * @returns
+ *	on success: eventfd(2) file descriptor
+ *	on failure: -1
+ */
+UDO_API
+int
+udo_shm_get_event_fd (struct udo_shm *shm,
+                      const uint32_t proc_index);
+
+
 /*
  * @brief Returns starting address of a processes segment
  *        in the mmap(2) map'd POSIX shared memory buffer
- *        created after call to udo_shm_create().
+ *        created after call to udo_shm_create(). Address
+ *        is valid until the segment is grown.
  *
  * @param shm        - Pointer to a valid struct udo_shm.
  * @param proc_index - Process index to acquire it's shared
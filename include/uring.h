@@ -0,0 +1,284 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023-2026 Underview
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UDO_URING_H
+#define UDO_URING_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "macros.h"
+#include "jpool.h"
+
+/*
+ * Stores information about the udo_uring context.
+ */
+struct udo_uring;
+
+
+/*
+ * @brief enum udo_uring_op_type (UDO io_uring Operation Type)
+ *
+ *        Sets which operation udo_uring_prep(3) queues.
+ *
+ * @macro UDO_URING_READ   - read(2) from @fd at @offset into @buf.
+ * @macro UDO_URING_WRITE  - write(2) @buf to @fd at @offset.
+ * @macro UDO_URING_RECV   - recv(2) from socket @fd into @buf.
+ * @macro UDO_URING_SEND   - send(2) @buf to socket @fd.
+ * @macro UDO_URING_ACCEPT - accept(2) connection on socket @fd.
+ *                           Completion result is the client fd.
+ * @macro UDO_URING_SPLICE - splice(2) @size bytes from @fd at @offset
+ *                           to @out_fd at @out_offset.
+ * @macro UDO_URING_FSYNC  - fsync(2) @fd.
+ */
+enum udo_uring_op_type
+{
+	UDO_URING_READ   = 0x00,
+	UDO_URING_WRITE  = 0x01,
+	UDO_URING_RECV   = 0x02,
+	UDO_URING_SEND   = 0x03,
+	UDO_URING_ACCEPT = 0x04,
+	UDO_URING_SPLICE = 0x05,
+	UDO_URING_FSYNC  = 0x06,
+};
+
+
+/*
+ * @brief Structure passed to udo_uring_create() used
+ *        to define ring size and how completions are
+ *        handled.
+ *
+ * @member entries        - Amount of submission queue entries.
+ *                          Rounded up to a power of two by the kernel.
+ * @member sq_thread_idle - Milliseconds the kernel submission thread
+ *                          spins without work before sleeping. Only
+ *                          used if @sqpoll is set.
+ * @member jpool          - Optional pointer to a struct udo_jpool.
+ *                          If set completion callbacks are added as
+ *                          jobs instead of being called by the thread
+ *                          reaping completions.
+ *                          NOTE: Callbacks ran by @jpool must not call
+ *                          udo_uring_prep(3) or udo_uring_submit(3).
+ * @member sqpoll         - Create a kernel thread that polls the
+ *                          submission queue. Submitting entries then
+ *                          doesn't require a system call.
+ */
+struct udo_uring_create_info
+{
+	uint32_t         entries;
+	uint32_t         sq_thread_idle;
+	struct udo_jpool *jpool;
+	uint8_t          sqpoll : 1;
+};
+
+
+/*
+ * @brief Creates an io_uring(7) instance with io_uring_setup(2)
+ *        and maps its submission and completion queues.
+ *
+ * @param ring       - May be NULL or a pointer to a struct udo_uring.
+ *                     If NULL memory will be allocated and return to
+ *                     caller. If not NULL address passed will be used
+ *                     to store the newly created struct udo_uring
+ *                     context.
+ * @param ring_info  - Implementation uses a pointer to a
+ *                     struct udo_uring_create_info.
+ *
+ * @returns
+ *	on success: Pointer to a struct udo_uring
+ *	on failure: NULL
+ */
+UDO_API
+struct udo_uring *
+udo_uring_create (struct udo_uring *ring,
+                  const void *ring_info);
+
+
+/*
+ * @brief Registers buffers with the kernel so that reads and writes
+ *        with struct udo_uring_io_info { @fixed_buf } set skip
+ *        mapping user pages on every operation.
+ *
+ * @param ring  - Pointer to a valid struct udo_uring.
+ * @param iovs  - Array of buffers to register.
+ * @param count - Amount of buffers in @iovs.
+ *
+ * @returns
+ *	on success: 0
+ *	on failure: -1
+ */
+UDO_API
+int
+udo_uring_register_buffers (struct udo_uring *ring,
+                            const struct iovec *iovs,
+                            const uint32_t count);
+
+
+/*
+ * @brief Registers file descriptors with the kernel so that
+ *        operations with struct udo_uring_io_info { @fixed_file }
+ *        set skip looking up the file on every operation.
+ *
+ * @param ring  - Pointer to a valid struct udo_uring.
+ * @param fds   - Array of file descriptors to register.
+ * @param count - Amount of file descriptors in @fds.
+ *
+ * @returns
+ *	on success: 0
+ *	on failure: -1
+ */
+UDO_API
+int
+udo_uring_register_files (struct udo_uring *ring,
+                          const int *fds,
+                          const uint32_t count);
+
+
+/*
+ * @brief Structure defining an operation to queue
+ *        with udo_uring_prep().
+ *
+ * @member fd         - File descriptor to operate on or index of a
+ *                      registered file if @fixed_file is set. Input
+ *                      file descriptor for UDO_URING_SPLICE.
+ * @member buf        - Buffer to read into or write from.
+ * @member size       - Size in bytes of @buf or amount of bytes to splice.
+ * @member offset     - Offset within @fd. -1 uses the file position.
+ * @member out_fd     - Output file descriptor for UDO_URING_SPLICE.
+ * @member out_offset - Offset within @out_fd. -1 uses the file position.
+ * @member buf_index  - Index of a registered buffer @buf resides in.
+ * @member fixed_file - @fd and @out_fd are registered file indexes.
+ * @member fixed_buf  - @buf resides in registered buffer @buf_index.
+ * @member func       - Function called once the operation completes.
+ *                      @res is the operations return value or -errno.
+ * @member arg        - Argument to pass to @func.
+ */
+struct udo_uring_io_info
+{
+	int      fd;
+	void     *buf;
+	size_t   size;
+	off_t    offset;
+	int      out_fd;
+	off_t    out_offset;
+	uint16_t buf_index;
+	uint8_t  fixed_file : 1;
+	uint8_t  fixed_buf : 1;
+	void     (*func)(void *arg, const int res);
+	void     *arg;
+};
+
+
+/*
+ * @brief Queues an operation in the submission queue. Operation
+ *        isn't started until udo_uring_submit() is called. So,
+ *        many operations may be submitted with one system call.
+ *        NOTE: udo_uring_prep(3), udo_uring_submit(3) and
+ *        udo_uring_wait(3) aren't thread safe and must be called
+ *        by the thread owning the ring. Completion functions
+ *        called by udo_uring_wait(3) may queue another operation
+ *        unless they run as struct udo_jpool jobs.
+ *
+ * @param ring    - Pointer to a valid struct udo_uring.
+ * @param op      - enum udo_uring_op_type of operation to queue.
+ * @param io_info - Implementation uses a pointer to a
+ *                  struct udo_uring_io_info.
+ *
+ * @returns
+ *	on success: 0
+ *	on failure: -1 (Submission queue full or too many
+ *	            operations in flight)
+ */
+UDO_API
+int
+udo_uring_prep (struct udo_uring *ring,
+                const enum udo_uring_op_type op,
+                const void *io_info);
+
+
+/*
+ * @brief Submits queued operations to the kernel with a single
+ *        io_uring_enter(2). If the ring was created with
+ *        struct udo_uring_create_info { @sqpoll } the system
+ *        call is only made to wake the kernel thread.
+ *
+ * @param ring - Pointer to a valid struct udo_uring.
+ *
+ * @returns
+ *	on success: Amount of operations submitted
+ *	on failure: -1
+ */
+UDO_API
+int
+udo_uring_submit (struct udo_uring *ring);
+
+
+/*
+ * @brief Reaps completions calling each operations completion
+ *        function or adding it as a job to the struct udo_jpool
+ *        passed to udo_uring_create(). Caller sleeps until at
+ *        least @min_complete operations completed.
+ *
+ * @param ring         - Pointer to a valid struct udo_uring.
+ * @param min_complete - Minimum amount of completions to wait for.
+ *                       If 0 only completions already available
+ *                       are reaped.
+ *
+ * @returns
+ *	on success: Amount of completions reaped
+ *	on failure: -1
+ */
+UDO_API
+int
+udo_uring_wait (struct udo_uring *ring,
+                const uint32_t min_complete);
+
+
+/*
+ * @brief Unmaps queues, closes the io_uring(7) file descriptor and
+ *        frees any allocated memory created after udo_uring_create()
+ *        call. Operations still in flight are cancelled by the kernel.
+ *
+ * @param ring - Pointer to a valid struct udo_uring.
+ */
+UDO_API
+void
+udo_uring_destroy (struct udo_uring *ring);
+
+
+/*
+ * @brief Returns size of the internal structure. So,
+ *        if caller decides to allocate memory outside
+ *        of API interface they know the exact amount
+ *        of bytes.
+ *
+ * @returns
+ *	on success: sizeof(struct udo_uring)
+ *	on failure: sizeof(struct udo_uring)
+ */
+UDO_API
+int
+udo_uring_get_sizeof (void);
+
+#endif /* UDO_URING_H */
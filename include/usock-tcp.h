@@ -258,4 +258,38 @@ udo_usock_tcp_send_data (const int sock_fd,
                          const size_t size,
                          const void *usock_info);
 
+
+/*
+ * @brief Send an open file descriptor to the process
+ *        connected to socket file descriptor. Used to
+ *        share memfd_create(2) backed shared memory.
+ *
+ * @param sock_fd - Socket file descriptor to send file descriptor to.
+ * @param fd      - File descriptor to send.
+ *
+ * @returns
+ *	on success: Amount of bytes sent
+ *	on failure: # < 0
+ */
+UDO_API
+ssize_t
+udo_usock_tcp_send_fd (const int sock_fd,
+                       const int fd);
+
+
+/*
+ * @brief Receive an open file descriptor sent with
+ *        udo_usock_tcp_send_fd(). Caller owns the
+ *        returned file descriptor.
+ *
+ * @param sock_fd - Socket file descriptor to receive file descriptor from.
+ *
+ * @returns
+ *	on success: File descriptor received
+ *	on failure: # < 0
+ */
+UDO_API
+int
+udo_usock_tcp_recv_fd (const int sock_fd);
+
 #endif /* UDO_USOCK_TCP_H */
@@ -0,0 +1,904 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023-2026 Underview
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE 1
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include <sys/stat.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#ifdef UDO_FILE_BLK_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef UDO_FILE_BLK_ZSTD
+#include <zstd.h>
+#endif
+
+#include "log.h"
+#include "file-ops.h"
+#include "file-blk.h"
+
+/* "UDOB" stored in the last 4 bytes of every block file */
+#define FILE_BLK_MAGIC 0x424f4455
+
+#define FILE_BLK_INDEX_MIN (uint32_t)64
+
+/* Reflected CRC32C (Castagnoli) polynomial */
+#define FILE_BLK_CRC32C_POLY 0x82f63b78
+
+/*
+ * @brief Structure defining the header stored in front of every
+ *        block. Integers are stored in host byte order.
+ *
+ * @member crc      - CRC32C of the header members after @crc
+ *                    followed by the block payload.
+ * @member size     - Size in bytes of the payload following header.
+ * @member raw_size - Size in bytes of the payload once decompressed.
+ * @member codec    - enum udo_file_blk_codec_type payload is stored with.
+ * @member pad      - Reserved. Set to 0.
+ */
+struct udo_file_blk_hdr
+{
+	uint32_t crc;
+	uint32_t size;
+	uint32_t raw_size;
+	uint8_t  codec;
+	uint8_t  pad[3];
+};
+
+
+/*
+ * @brief Structure defining the footer stored at the end of
+ *        every block file. Directly preceded by an array of
+ *        @count uint64_t storing the file offset of each block
+ *        header.
+ *
+ * @member index_off  - File offset of the block offset array.
+ * @member raw_size   - Size in bytes of the uncompressed data.
+ * @member count      - Amount of blocks in the file.
+ * @member block_size - Size in bytes of uncompressed data stored
+ *                      in every block except the last.
+ * @member crc        - CRC32C of the block offset array followed
+ *                      by the footer members before @crc.
+ * @member magic      - FILE_BLK_MAGIC.
+ */
+struct udo_file_blk_footer
+{
+	uint64_t index_off;
+	uint64_t raw_size;
+	uint32_t count;
+	uint32_t block_size;
+	uint32_t crc;
+	uint32_t magic;
+};
+
+
+/*
+ * @brief Structure defining the udo_file_blk (UDO File Block) context.
+ *
+ * @member err        - Stores information about the error that occured
+ *                      for the given context and may later be retrieved
+ *                      by caller.
+ * @member free       - If structure allocated with calloc(3) member will be
+ *                      set to true so that, we know to call free(3) when
+ *                      destroying the context.
+ * @member flops      - File the blocks are stored in.
+ * @member write      - Set if file was created with udo_file_blk_append(3)
+ *                      allowed.
+ * @member finished   - Set once the footer was written.
+ * @member codec      - enum udo_file_blk_codec_type new blocks are
+ *                      compressed with.
+ * @member level      - zstd compression level.
+ * @member block_size - Size in bytes of uncompressed data in a block.
+ * @member count      - Amount of blocks written to the file.
+ * @member index_cap  - Amount of entries @index can store.
+ * @member index      - File offset of each block header.
+ * @member blocks_end - File offset where blocks end.
+ * @member raw_size   - Size in bytes of the uncompressed data.
+ * @member fill       - Amount of bytes in @pending.
+ * @member pending    - Data appended since the last block was written.
+ * @member scratch    - Buffer blocks are compressed into.
+ * @member scratch_sz - Size in bytes of @scratch.
+ * @member cache      - Last block decompressed by udo_file_blk_read(3).
+ * @member cache_idx  - Index of block stored in @cache. UINT32_MAX if none.
+ */
+struct udo_file_blk
+{
+	struct udo_log_error_struct err;
+	uint8_t                     free;
+	struct udo_file_ops         *flops;
+	uint8_t                     write : 1;
+	uint8_t                     finished : 1;
+	uint8_t                     codec;
+	int                         level;
+	uint32_t                    block_size;
+	uint32_t                    count;
+	uint32_t                    index_cap;
+	uint64_t                    *index;
+	size_t                      blocks_end;
+	size_t                      raw_size;
+	size_t                      fill;
+	void                        *pending;
+	void                        *scratch;
+	size_t                      scratch_sz;
+	void                        *cache;
+	uint32_t                    cache_idx;
+};
+
+
+/*****************************************
+ * Start of global to C source functions *
+ *****************************************/
+
+static uint32_t crc32c_table[256];
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+static void
+p_file_blk_crc32c_init (void)
+{
+	uint32_t i, k, c;
+
+	for (i = 0; i < 256; i++) {
+		for (c = i, k = 0; k < 8; k++)
+			c = (c & 1) ? (c >> 1) ^ FILE_BLK_CRC32C_POLY : c >> 1;
+		crc32c_table[i] = c;
+	}
+}
+
+
+static uint32_t
+p_file_blk_crc32c_sw (uint32_t crc,
+                      const uint8_t *buf,
+                      size_t len)
+{
+	pthread_once(&crc32c_once, p_file_blk_crc32c_init);
+
+	while (len--)
+		crc = crc32c_table[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t
+p_file_blk_crc32c_sse42 (uint32_t p_crc,
+                         const uint8_t *buf,
+                         size_t len)
+{
+	uint64_t crc = p_crc, val;
+
+	for (; len && ((uintptr_t)buf & 7); len--)
+		crc = _mm_crc32_u8(crc, *buf++);
+
+	for (; len >= sizeof(val); len -= sizeof(val), buf += sizeof(val)) {
+		memcpy(&val, buf, sizeof(val));
+		crc = _mm_crc32_u64(crc, val);
+	}
+
+	for (; len; len--)
+		crc = _mm_crc32_u8(crc, *buf++);
+
+	return crc;
+}
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+static uint32_t
+p_file_blk_crc32c_armv8 (uint32_t crc,
+                         const uint8_t *buf,
+                         size_t len)
+{
+	uint64_t val;
+
+	for (; len && ((uintptr_t)buf & 7); len--)
+		crc = __crc32cb(crc, *buf++);
+
+	for (; len >= sizeof(val); len -= sizeof(val), buf += sizeof(val)) {
+		memcpy(&val, buf, sizeof(val));
+		crc = __crc32cd(crc, val);
+	}
+
+	for (; len; len--)
+		crc = __crc32cb(crc, *buf++);
+
+	return crc;
+}
+#endif
+
+
+static int
+p_file_blk_codec_supported (const uint8_t codec)
+{
+	switch (codec) {
+		case UDO_FILE_BLK_CODEC_NONE:
+			return 1;
+#ifdef UDO_FILE_BLK_LZ4
+		case UDO_FILE_BLK_CODEC_LZ4:
+			return 1;
+#endif
+#ifdef UDO_FILE_BLK_ZSTD
+		case UDO_FILE_BLK_CODEC_ZSTD:
+			return 1;
+#endif
+		default:
+			return 0;
+	}
+}
+
+
+static size_t
+p_file_blk_compress_bound (const uint8_t codec,
+                           const size_t size)
+{
+	switch (codec) {
+#ifdef UDO_FILE_BLK_LZ4
+		case UDO_FILE_BLK_CODEC_LZ4:
+			return LZ4_compressBound(size);
+#endif
+#ifdef UDO_FILE_BLK_ZSTD
+		case UDO_FILE_BLK_CODEC_ZSTD:
+			return ZSTD_compressBound(size);
+#endif
+		default:
+			(void)size;
+			return 0;
+	}
+}
+
+
+/*
+ * Returns size of the compressed data in @blk->scratch
+ * or 0 if data should be stored uncompressed.
+ */
+static size_t
+p_file_blk_compress (struct udo_file_blk *blk,
+                     const void *src,
+                     const size_t len)
+{
+	size_t ret = 0;
+
+	switch (blk->codec) {
+#ifdef UDO_FILE_BLK_LZ4
+		case UDO_FILE_BLK_CODEC_LZ4:
+			ret = LZ4_compress_default(src, blk->scratch, len, blk->scratch_sz);
+			break;
+#endif
+#ifdef UDO_FILE_BLK_ZSTD
+		case UDO_FILE_BLK_CODEC_ZSTD:
+			ret = ZSTD_compress(blk->scratch, blk->scratch_sz, src, len, blk->level);
+			if (ZSTD_isError(ret))
+				ret = 0;
+			break;
+#endif
+		default:
+			(void)src;
+			break;
+	}
+
+	return (ret < len) ? ret : 0;
+}
+
+
+static int
+p_file_blk_decompress (struct udo_file_blk *blk,
+                       const struct udo_file_blk_hdr *hdr,
+                       const void *src,
+                       void *dst)
+{
+	size_t ret = 0;
+
+	switch (hdr->codec) {
+#ifdef UDO_FILE_BLK_LZ4
+		case UDO_FILE_BLK_CODEC_LZ4:
+			ret = LZ4_decompress_safe(src, dst, hdr->size, hdr->raw_size);
+			break;
+#endif
+#ifdef UDO_FILE_BLK_ZSTD
+		case UDO_FILE_BLK_CODEC_ZSTD:
+			ret = ZSTD_decompress(dst, hdr->raw_size, src, hdr->size);
+			break;
+#endif
+		default:
+			(void)src; (void)dst;
+			udo_log_set_error(blk, UDO_LOG_ERR_INCORRECT_DATA,
+			                  "Codec (%u) not supported", hdr->codec);
+			return -1;
+	}
+
+	if (ret != hdr->raw_size) {
+		udo_log_set_error(blk, UDO_LOG_ERR_INCORRECT_DATA,
+		                  "Block failed to decompress");
+		return -1;
+	}
+
+	return 0;
+}
+
+
+static uint32_t
+p_file_blk_hdr_crc (const struct udo_file_blk_hdr *hdr,
+                    const void *payload)
+{
+	uint32_t crc;
+
+	crc = udo_file_blk_crc32c(0, &(hdr->size), sizeof(*hdr) - offsetof(struct udo_file_blk_hdr, size));
+	return udo_file_blk_crc32c(crc, payload, hdr->size);
+}
+
+
+static ssize_t
+p_file_blk_append (struct udo_file_blk *blk,
+                   const void *buf,
+                   const size_t len)
+{
+	ssize_t ret;
+
+	ret = udo_file_ops_append(blk->flops, buf, len);
+	if (ret == -1) {
+		udo_log_set_error(blk, udo_log_get_error_code(blk->flops),
+		                  "%s", udo_log_get_error(blk->flops));
+		return -1;
+	}
+
+	return ret;
+}
+
+/***************************************
+ * End of global to C source functions *
+ ***************************************/
+
+
+/******************************************
+ * Start of udo_file_blk_create functions *
+ ******************************************/
+
+static int
+p_file_blk_open (struct udo_file_blk *blk,
+                 const struct udo_file_blk_create_info *blk_info)
+{
+	size_t size;
+	uint32_t crc;
+
+	const void *data = NULL;
+
+	struct udo_file_blk_footer footer;
+	struct udo_file_ops_create_info file_info;
+
+	memset(&file_info, 0, sizeof(file_info));
+	file_info.fname = blk_info->fname;
+	file_info.protect = true;
+	blk->flops = udo_file_ops_create(NULL, &file_info);
+	if (!(blk->flops))
+		return -1;
+
+	size = udo_file_ops_get_data_size(blk->flops);
+	if (size < sizeof(footer)) {
+		udo_log_error("'%s' isn't a block file\n", blk_info->fname);
+		return -1;
+	}
+
+	data = udo_file_ops_get_data(blk->flops, size - sizeof(footer));
+	if (!data) {
+		udo_log_error("'%s' isn't a block file\n", blk_info->fname);
+		return -1;
+	}
+
+	memcpy(&footer, data, sizeof(footer));
+
+	/* Compare against what's left so a huge @index_off can't wrap */
+	if (footer.magic != FILE_BLK_MAGIC || \
+	    !(footer.block_size) || \
+	    footer.index_off > size - sizeof(footer) || \
+	    (size - sizeof(footer)) - footer.index_off != (uint64_t) footer.count * sizeof(uint64_t) || \
+	    footer.raw_size > (uint64_t) footer.count * footer.block_size || \
+	    (footer.count && footer.raw_size <= (uint64_t) (footer.count - 1) * footer.block_size))
+	{
+		udo_log_error("'%s' isn't a block file\n", blk_info->fname);
+		return -1;
+	}
+
+	blk->index = malloc(((size_t) footer.count + 1) * sizeof(uint64_t));
+	if (!(blk->index)) {
+		udo_log_error("malloc: %s\n", strerror(errno));
+		return -1;
+	}
+
+	if (footer.count) {
+		data = udo_file_ops_get_data(blk->flops, footer.index_off);
+		if (!data) {
+			udo_log_error("'%s' isn't a block file\n", blk_info->fname);
+			return -1;
+		}
+
+		memcpy(blk->index, data, footer.count * sizeof(uint64_t));
+	}
+
+	crc = udo_file_blk_crc32c(0, blk->index, footer.count * sizeof(uint64_t));
+	crc = udo_file_blk_crc32c(crc, &footer, offsetof(struct udo_file_blk_footer, crc));
+	if (crc != footer.crc) {
+		udo_log_error("'%s' footer checksum mismatch\n", blk_info->fname);
+		return -1;
+	}
+
+	blk->count = blk->index_cap = footer.count;
+	blk->block_size = footer.block_size;
+	blk->raw_size = footer.raw_size;
+	blk->blocks_end = footer.index_off;
+	blk->finished = true;
+
+	return 0;
+}
+
+
+static int
+p_file_blk_new (struct udo_file_blk *blk,
+                const struct udo_file_blk_create_info *blk_info)
+{
+	struct udo_file_ops_create_info file_info;
+
+	if (!p_file_blk_codec_supported(blk_info->codec)) {
+		udo_log_error("Codec (%u) not supported\n", blk_info->codec);
+		return -1;
+	}
+
+	blk->codec = blk_info->codec;
+	blk->level = blk_info->level;
+	blk->block_size = blk_info->block_size;
+	blk->write = true;
+
+	memset(&file_info, 0, sizeof(file_info));
+	file_info.fname = blk_info->fname;
+	file_info.size = blk->block_size;
+	blk->flops = udo_file_ops_create(NULL, &file_info);
+	if (!(blk->flops))
+		return -1;
+
+	blk->pending = malloc(blk->block_size);
+	if (!(blk->pending)) {
+		udo_log_error("malloc: %s\n", strerror(errno));
+		return -1;
+	}
+
+	if (blk->codec != UDO_FILE_BLK_CODEC_NONE) {
+		blk->scratch_sz = p_file_blk_compress_bound(blk->codec, blk->block_size);
+		blk->scratch = malloc(blk->scratch_sz);
+		if (!(blk->scratch)) {
+			udo_log_error("malloc: %s\n", strerror(errno));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+struct udo_file_blk *
+udo_file_blk_create (struct udo_file_blk *p_blk,
+                     const void *p_blk_info)
+{
+	int ret = -1;
+
+	struct stat fstats;
+
+	struct udo_file_blk *blk = p_blk;
+
+	const struct udo_file_blk_create_info *blk_info = p_blk_info;
+
+	if (!blk_info || \
+	    !(blk_info->fname) || \
+	    (blk_info->write && !(blk_info->block_size)))
+	{
+		udo_log_error("Incorrect data passed\n");
+		return NULL;
+	}
+
+	if (!(blk_info->write) && stat(blk_info->fname, &fstats) == -1) {
+		udo_log_error("stat: %s\n", strerror(errno));
+		return NULL;
+	}
+
+	if (!blk) {
+		blk = calloc(1, sizeof(struct udo_file_blk));
+		if (!blk) {
+			udo_log_error("calloc: %s\n", strerror(errno));
+			return NULL;
+		}
+
+		blk->free = true;
+	}
+
+	blk->cache_idx = UINT32_MAX;
+
+	if (blk_info->write) {
+		ret = p_file_blk_new(blk, blk_info);
+	} else {
+		ret = p_file_blk_open(blk, blk_info);
+	}
+
+	if (ret == -1) {
+		udo_file_blk_destroy(blk);
+		return NULL;
+	}
+
+	return blk;
+}
+
+/****************************************
+ * End of udo_file_blk_create functions *
+ ****************************************/
+
+
+/******************************************
+ * Start of udo_file_blk_append functions *
+ ******************************************/
+
+static int
+p_file_blk_write_block (struct udo_file_blk *blk)
+{
+	size_t size;
+	uint64_t *index = NULL;
+
+	const void *payload = blk->pending;
+
+	struct udo_file_blk_hdr hdr;
+
+	if (!(blk->fill))
+		return 0;
+
+	if (blk->count == blk->index_cap) {
+		blk->index_cap = UDO_MAX(blk->index_cap << 1, FILE_BLK_INDEX_MIN);
+		index = realloc(blk->index, blk->index_cap * sizeof(uint64_t));
+		if (!index) {
+			udo_log_set_error(blk, errno, "realloc: %s", strerror(errno));
+			return -1;
+		}
+
+		blk->index = index;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.codec = UDO_FILE_BLK_CODEC_NONE;
+	hdr.size = hdr.raw_size = blk->fill;
+
+	size = p_file_blk_compress(blk, blk->pending, blk->fill);
+	if (size) {
+		hdr.codec = blk->codec;
+		hdr.size = size;
+		payload = blk->scratch;
+	}
+
+	hdr.crc = p_file_blk_hdr_crc(&hdr, payload);
+
+	blk->index[blk->count] = udo_file_ops_get_data_size(blk->flops);
+
+	if (p_file_blk_append(blk, &hdr, sizeof(hdr)) == -1 || \
+	    p_file_blk_append(blk, payload, hdr.size) == -1)
+	{
+		return -1;
+	}
+
+	blk->count++;
+	blk->fill = 0;
+	blk->blocks_end = udo_file_ops_get_data_size(blk->flops);
+
+	return 0;
+}
+
+
+ssize_t
+udo_file_blk_append (struct udo_file_blk *blk,
+                     const void *p_buf,
+                     const size_t len)
+{
+	size_t copied, size;
+
+	const char *buf = p_buf;
+
+	if (!blk)
+		return -1;
+
+	if (!p_buf || \
+	    !(blk->write) || \
+	    blk->finished)
+	{
+		udo_log_set_error(blk, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	for (copied = 0; copied < len; copied += size) {
+		size = UDO_MIN(len - copied, blk->block_size - blk->fill);
+		memcpy((char*)blk->pending + blk->fill, buf + copied, size);
+		blk->fill += size;
+		blk->raw_size += size;
+
+		if (blk->fill == blk->block_size && p_file_blk_write_block(blk) == -1)
+			return -1;
+	}
+
+	return len;
+}
+
+/****************************************
+ * End of udo_file_blk_append functions *
+ ****************************************/
+
+
+/******************************************
+ * Start of udo_file_blk_finish functions *
+ ******************************************/
+
+int
+udo_file_blk_finish (struct udo_file_blk *blk)
+{
+	struct udo_file_blk_footer footer;
+
+	if (!blk)
+		return -1;
+
+	if (!(blk->write) || blk->finished) {
+		udo_log_set_error(blk, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	if (p_file_blk_write_block(blk) == -1)
+		return -1;
+
+	memset(&footer, 0, sizeof(footer));
+	footer.index_off = udo_file_ops_get_data_size(blk->flops);
+	footer.raw_size = blk->raw_size;
+	footer.count = blk->count;
+	footer.block_size = blk->block_size;
+	footer.magic = FILE_BLK_MAGIC;
+	footer.crc = udo_file_blk_crc32c(0, blk->index, blk->count * sizeof(uint64_t));
+	footer.crc = udo_file_blk_crc32c(footer.crc, &footer, offsetof(struct udo_file_blk_footer, crc));
+
+	if ((blk->count && \
+	     p_file_blk_append(blk, blk->index, blk->count * sizeof(uint64_t)) == -1) || \
+	    p_file_blk_append(blk, &footer, sizeof(footer)) == -1)
+	{
+		return -1;
+	}
+
+	blk->finished = true;
+
+	return 0;
+}
+
+/****************************************
+ * End of udo_file_blk_finish functions *
+ ****************************************/
+
+
+/****************************************
+ * Start of udo_file_blk_read functions *
+ ****************************************/
+
+/*
+ * Returns pointer to the uncompressed data of block @idx. Data of
+ * uncompressed blocks is returned straight from the mapping.
+ */
+static const void *
+p_file_blk_load (struct udo_file_blk *blk,
+                 const uint32_t idx)
+{
+	size_t raw_size;
+
+	const char *data = NULL;
+
+	struct udo_file_blk_hdr hdr;
+
+	if (idx == blk->count)
+		return blk->pending;
+
+	if (idx == blk->cache_idx)
+		return blk->cache;
+
+	raw_size = (idx == blk->count - 1 && !(blk->fill)) ? \
+		blk->raw_size - ((size_t) idx * blk->block_size) : blk->block_size;
+
+	data = udo_file_ops_get_data(blk->flops, blk->index[idx]);
+	if (!data || blk->index[idx] + sizeof(hdr) > blk->blocks_end) {
+		udo_log_set_error(blk, UDO_LOG_ERR_INCORRECT_DATA,
+		                  "Block (%u) offset is corrupt", idx);
+		return NULL;
+	}
+
+	memcpy(&hdr, data, sizeof(hdr));
+	data += sizeof(hdr);
+
+	if (hdr.raw_size != raw_size || \
+	    hdr.size > blk->blocks_end - blk->index[idx] - sizeof(hdr) || \
+	    p_file_blk_hdr_crc(&hdr, data) != hdr.crc)
+	{
+		udo_log_set_error(blk, UDO_LOG_ERR_INCORRECT_DATA,
+		                  "Block (%u) checksum mismatch", idx);
+		return NULL;
+	}
+
+	if (hdr.codec == UDO_FILE_BLK_CODEC_NONE) {
+		if (hdr.size != hdr.raw_size) {
+			udo_log_set_error(blk, UDO_LOG_ERR_INCORRECT_DATA,
+			                  "Block (%u) size is corrupt", idx);
+			return NULL;
+		}
+
+		return data;
+	}
+
+	if (!(blk->cache)) {
+		blk->cache = malloc(blk->block_size);
+		if (!(blk->cache)) {
+			udo_log_set_error(blk, errno, "malloc: %s", strerror(errno));
+			return NULL;
+		}
+	}
+
+	blk->cache_idx = UINT32_MAX;
+	if (p_file_blk_decompress(blk, &hdr, data, blk->cache) == -1)
+		return NULL;
+
+	blk->cache_idx = idx;
+
+	return blk->cache;
+}
+
+
+ssize_t
+udo_file_blk_read (struct udo_file_blk *blk,
+                   const size_t offset,
+                   void *p_buf,
+                   const size_t p_len)
+{
+	uint32_t idx;
+	size_t copied, len, off, size;
+
+	char *buf = p_buf;
+	const char *data = NULL;
+
+	if (!blk)
+		return -1;
+
+	if (!p_buf) {
+		udo_log_set_error(blk, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	if (offset >= blk->raw_size)
+		return 0;
+
+	len = UDO_MIN(p_len, blk->raw_size - offset);
+
+	for (copied = 0; copied < len; copied += size) {
+		idx = (offset + copied) / blk->block_size;
+		off = (offset + copied) % blk->block_size;
+		size = UDO_MIN(len - copied, blk->block_size - off);
+
+		data = p_file_blk_load(blk, idx);
+		if (!data)
+			return -1;
+
+		memcpy(buf + copied, data + off, size);
+	}
+
+	return len;
+}
+
+/**************************************
+ * End of udo_file_blk_read functions *
+ **************************************/
+
+
+/********************************************
+ * Start of udo_file_blk_get_size functions *
+ ********************************************/
+
+size_t
+udo_file_blk_get_size (struct udo_file_blk *blk)
+{
+	if (!blk)
+		return 0;
+
+	return blk->raw_size;
+}
+
+/******************************************
+ * End of udo_file_blk_get_size functions *
+ ******************************************/
+
+
+/*******************************************
+ * Start of udo_file_blk_destroy functions *
+ *******************************************/
+
+void
+udo_file_blk_destroy (struct udo_file_blk *blk)
+{
+	if (!blk)
+		return;
+
+	if (blk->write && \
+	    blk->flops && \
+	    !(blk->finished) && \
+	    udo_file_blk_finish(blk) == -1)
+	{
+		udo_log_error("udo_file_blk_finish: %s\n", udo_log_get_error(blk));
+	}
+
+	udo_file_ops_destroy(blk->flops, 0);
+	free(blk->index);
+	free(blk->pending);
+	free(blk->scratch);
+	free(blk->cache);
+
+	if (blk->free) {
+		free(blk);
+	} else {
+		memset(blk, 0, sizeof(struct udo_file_blk));
+	}
+}
+
+/*****************************************
+ * End of udo_file_blk_destroy functions *
+ *****************************************/
+
+
+/****************************************************
+ * Start of non struct udo_file_blk param functions *
+ ****************************************************/
+
+int
+udo_file_blk_get_sizeof (void)
+{
+	return sizeof(struct udo_file_blk);
+}
+
+
+uint32_t
+udo_file_blk_crc32c (const uint32_t crc,
+                     const void *buf,
+                     const size_t len)
+{
+#if defined(__x86_64__)
+	if (__builtin_cpu_supports("sse4.2"))
+		return ~p_file_blk_crc32c_sse42(~crc, buf, len);
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+	return ~p_file_blk_crc32c_armv8(~crc, buf, len);
+#endif
+	return ~p_file_blk_crc32c_sw(~crc, buf, len);
+}
+
+/**************************************************
+ * End of non struct udo_file_blk param functions *
+ **************************************************/
@@ -29,39 +29,177 @@
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <dirent.h>
+#include <pthread.h>
+#include <poll.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>  /* Definition of SYS_* constants */
+#include <linux/futex.h>  /* Definition of FUTEX_* constants */
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 #include "log.h"
 #include "file-ops.h"
 
+#ifdef UDO_JPOOL
+#include "jpool.h"
+#endif
+
 #define PIPE_MAX_BUFF_SIZE (size_t)(1<<16)
 
+/*
+ * Pipe capacity requested with F_SETPIPE_SZ before
+ * splicing. Unprivileged callers are limited by
+ * /proc/sys/fs/pipe-max-size (1MiB by default).
+ */
+#define PIPE_GROW_BUFF_SIZE (1<<20)
+
+/*
+ * Mapping grows by at least this factor on calls to
+ * udo_file_ops_append(3) so that remaps are amortized.
+ */
+#define FILE_OPS_GROWTH_FACTOR 2
+
+/*
+ * Initial amount of entries in the line index.
+ */
+#define FILE_OPS_LINE_INDEX_MIN (size_t)(1<<8)
+
+/*
+ * Vector byte counters are 8-bits wide. So, they're
+ * summed into 64-bit lanes every 255 iterations.
+ */
+#define FILE_OPS_COUNT_ITER_MAX 255
+
+/*
+ * Default amount of bytes udo_file_ops_iter_next(3)
+ * maps at a time.
+ */
+#define FILE_OPS_ITER_WINDOW_SIZE (size_t)(1<<24)
+
+/*
+ * States of struct udo_file_ops { @flush_req }.
+ */
+#define FILE_OPS_FLUSH_IDLE 0
+#define FILE_OPS_FLUSH_PENDING 1
+
+/*
+ * Amount of buckets in the read only mapping cache.
+ */
+#define FILE_OPS_MAP_CACHE_BUCKETS 64
+
+/*
+ * Default size of each struct udo_file_ops_stream buffer.
+ */
+#define FILE_OPS_STREAM_BUFFER_SIZE (size_t)(1<<20)
+
+/*
+ * States of struct udo_file_ops_stream { @states }.
+ * Caller owns FREE and READY buffers. Background
+ * thread owns PENDING buffers.
+ */
+#define FILE_OPS_STREAM_FREE 0
+#define FILE_OPS_STREAM_PENDING 1
+#define FILE_OPS_STREAM_READY 2
+
+/*
+ * Maximum amount of directories udo_file_ops_walk(3)
+ * reads at the same time. Directories are taken off
+ * the pending stack depth first so that the amount
+ * of open directory file descriptors stays bounded.
+ */
+#define FILE_OPS_WALK_INFLIGHT_MAX 64
+
+/*
+ * Added in Linux 5.14. Older kernels fail
+ * with EINVAL and MADV_WILLNEED is used.
+ */
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ 22
+#endif
+
+/*
+ * @brief Structure defining a read only file mapping shared
+ *        by every struct udo_file_ops context that opened the
+ *        same file with struct udo_file_ops_create_info
+ *        { @protect } set.
+ *
+ * @member dev  - ID of device containing the file.
+ * @member ino  - Inode number of the file.
+ * @member mtim - Time of the files last modification. Files
+ *                modified after being mapped get a new mapping.
+ * @member size - Amount of bytes mapped.
+ * @member data - Pointer to mmap(2) file data.
+ * @member refs - Amount of contexts using @data.
+ * @member next - Next mapping in the same cache bucket.
+ */
+struct udo_file_ops_map
+{
+	dev_t                   dev;
+	ino_t                   ino;
+	struct timespec         mtim;
+	size_t                  size;
+	void                    *data;
+	uint32_t                refs;
+	struct udo_file_ops_map *next;
+};
+
+
 /*
  * @brief Structure defining UDO File Operations context.
  *
- * @member err       - Stores information about the error that occured
- *                     for the given context and may later be retrieved
- *                     by caller.
- * @member free      - If structure allocated with calloc(3) member will be
- *                     set to true so that, we know to call free(3) when
- *                     destroying the context.
- * @member fd        - File descriptor to open file.
- * @member pipe_fds  - File descriptors associated with an open pipe.
- *                     pipe_fds[0] - Read end of the pipe
- *                     pipe_fds[1] - Write end of the pipe
- * @member alloc_sz  - Total size of the file that was mapped with mmap(2).
- * @member data_sz   - Total size of data written to file. Used when destroying
- *                     the struct udo_file_ops context to truncate(2) file to a
- *                     smaller size than @alloc_sz.
- * @member data      - Pointer to mmap(2) file data.
- * @member fname_off - Offset in the @full_path buffer that stores the file name.
- * @member full_path - Buffer storing string representing the full path to
- *                     file. This buffer is split in two by storing the '\0'
- *                     between the file name and directory path.
+ * @member err         - Stores information about the error that occured
+ *                       for the given context and may later be retrieved
+ *                       by caller.
+ * @member free        - If structure allocated with calloc(3) member will be
+ *                       set to true so that, we know to call free(3) when
+ *                       destroying the context.
+ * @member fd          - File descriptor to open file.
+ * @member pipe_fds    - File descriptors associated with an open pipe.
+ *                       pipe_fds[0] - Read end of the pipe
+ *                       pipe_fds[1] - Write end of the pipe
+ * @member pipe_sz     - Capacity of the pipe after growing it with
+ *                       F_SETPIPE_SZ. 0 if not grown yet.
+ * @member alloc_sz    - Total size of the file that was mapped with mmap(2).
+ * @member data_sz     - Total size of data written to file. Used when destroying
+ *                       the struct udo_file_ops context to truncate(2) file to a
+ *                       smaller size than @alloc_sz.
+ * @member data        - Pointer to mmap(2) file data.
+ * @member offset      - Offset within the file @data is mapped from.
+ * @member protect     - Set if file pages are mapped read only.
+ * @member map         - Shared read only mapping @data points into.
+ *                       NULL if @data isn't shared.
+ * @member appended    - Set once data has been written with
+ *                       udo_file_ops_append(3). File is then truncated
+ *                       to @data_sz when destroying the context.
+ * @member flush_tid   - POSIX thread ID of the background flusher.
+ * @member flush_size  - Amount of appended bytes that wakes @flush_tid.
+ * @member flush_dirty - Amount of bytes appended since @flush_tid was woken.
+ * @member flush_end   - Offset within the mapping @flush_tid writes back up to.
+ * @member flush_req   - Futex @flush_tid sleeps on until write-back is requested.
+ * @member flush_stop  - Set when destroying the context to stop @flush_tid.
+ * @member flusher     - Set if @flush_tid was created.
+ * @member lines       - Line index. Byte offset of the start of each line.
+ *                       NULL if struct udo_file_ops_create_info { @line_index }
+ *                       isn't set or index isn't built yet.
+ * @member line_cnt    - Amount of entries stored in @lines.
+ * @member line_cap    - Amount of entries @lines can store.
+ * @member line_scan   - Amount of bytes of file data already indexed. Index
+ *                       is extended past @line_scan after appends.
+ * @member line_index  - Set if line functions use @lines.
+ * @member fname_off   - Offset in the @full_path buffer that stores the file name.
+ * @member full_path   - Buffer storing string representing the full path to
+ *                       file. This buffer is split in two by storing the '\0'
+ *                       between the file name and directory path.
  */
 struct udo_file_ops
 {
@@ -69,13 +207,317 @@ struct udo_file_ops
 	uint8_t                     free;
 	int                         fd;
 	int                         pipe_fds[2];
+	size_t                      pipe_sz;
 	size_t                      alloc_sz;
 	size_t                      data_sz;
 	void                        *data;
+	off_t                       offset;
+	uint8_t                     protect : 1;
+	uint8_t                     appended : 1;
+	struct udo_file_ops_map     *map;
+	pthread_t                   flush_tid;
+	size_t                      flush_size;
+	size_t                      flush_dirty;
+	size_t                      flush_end;
+	udo_atomic_u32              flush_req;
+	udo_atomic_u32              flush_stop;
+	uint8_t                     flusher : 1;
+	size_t                      *lines;
+	size_t                      line_cnt;
+	size_t                      line_cap;
+	size_t                      line_scan;
+	uint8_t                     line_index : 1;
 	uint16_t                    fname_off;
 	char                        full_path[UDO_FILE_PATH_MAX];
 };
 
+/*
+ * @brief Structure defining UDO File Operations Iterator context.
+ *
+ * @member err       - Stores information about the error that occured
+ *                     for the given context and may later be retrieved
+ *                     by caller.
+ * @member free      - If structure allocated with calloc(3) member will be
+ *                     set to true so that, we know to call free(3) when
+ *                     destroying the context.
+ * @member flops     - Context of the file being iterated.
+ * @member fd        - File descriptor of the file being iterated.
+ * @member delim     - Byte separating records.
+ * @member record_sz - Size in bytes of fixed size records. If 0
+ *                     records are separated by @delim.
+ * @member window_sz - Amount of bytes mapped at a time.
+ * @member win       - Pointer to mmap(2) window of file data.
+ * @member win_off   - Page aligned offset within the file @win maps.
+ * @member win_sz    - Amount of bytes mapped by @win.
+ * @member pos       - Offset within the file of the next record.
+ * @member file_sz   - Size of the file data. Updated once @pos reaches
+ *                     it so that appended records are returned.
+ */
+struct udo_file_ops_iter
+{
+	struct udo_log_error_struct err;
+	uint8_t                     free;
+	struct udo_file_ops         *flops;
+	int                         fd;
+	char                        delim;
+	size_t                      record_sz;
+	size_t                      window_sz;
+	void                        *win;
+	size_t                      win_off;
+	size_t                      win_sz;
+	size_t                      pos;
+	size_t                      file_sz;
+};
+
+
+/*
+ * @brief Structure defining UDO File Operations Stream context.
+ *
+ * @member err      - Stores information about the error that occured
+ *                    for the given context and may later be retrieved
+ *                    by caller.
+ * @member free     - If structure allocated with calloc(3) member will be
+ *                    set to true so that, we know to call free(3) when
+ *                    destroying the context.
+ * @member fd       - File descriptor of the file being streamed.
+ * @member direct   - Set if @fd was opened with O_DIRECT.
+ * @member write    - Set if stream writes to @fd.
+ * @member dontneed - Set if pages are dropped from the page cache
+ *                    after being read or written.
+ * @member eof      - Set once the end of the file was returned.
+ * @member held     - Set if caller holds buffer @cur.
+ * @member thread   - Set if @tid was created.
+ * @member tid      - POSIX thread ID of the background I/O thread.
+ * @member stop     - Set when destroying the context to stop @tid.
+ * @member io_err   - errno of the last failed background I/O.
+ * @member buf_sz   - Size in bytes of each buffer in @bufs.
+ * @member bufs     - Page aligned I/O buffers.
+ * @member lens     - Amount of bytes read into or to write from @bufs.
+ * @member states   - Futexes storing which thread owns each buffer.
+ * @member cur      - Index of the buffer caller uses.
+ * @member fill     - Amount of bytes copied into the current write buffer.
+ * @member pos      - Offset within the file of the next background I/O.
+ */
+struct udo_file_ops_stream
+{
+	struct udo_log_error_struct err;
+	uint8_t                     free;
+	int                         fd;
+	uint8_t                     direct : 1;
+	uint8_t                     write : 1;
+	uint8_t                     dontneed : 1;
+	uint8_t                     eof : 1;
+	uint8_t                     held : 1;
+	uint8_t                     thread : 1;
+	pthread_t                   tid;
+	udo_atomic_u32              stop;
+	int                         io_err;
+	size_t                      buf_sz;
+	void                        *bufs[2];
+	ssize_t                     lens[2];
+	udo_atomic_u32              states[2];
+	uint8_t                     cur;
+	size_t                      fill;
+	off_t                       pos;
+};
+
+
+/*
+ * @brief Structure defining a directory found by udo_file_ops_walk(3).
+ *
+ * @member parent   - Directory containing this directory. NULL for
+ *                    the directory passed to udo_file_ops_walk(3).
+ * @member next     - Next directory in the pending stack, completed
+ *                    list or @parent's children list.
+ * @member walk     - Walk this directory belongs to.
+ * @member children - Directories found while reading this directory.
+ * @member fd       - Open file descriptor of this directory. Kept open
+ *                    until @pending reaches 0 so that children are
+ *                    opened and removed relative to it.
+ * @member err      - errno of the first failure while reading this directory.
+ * @member depth    - Depth of this directory within the tree.
+ * @member pending  - Amount of children directories not yet left.
+ * @member name     - Name of directory relative to @parent.
+ */
+struct udo_file_ops_walk_dir
+{
+	struct udo_file_ops_walk_dir *parent;
+	struct udo_file_ops_walk_dir *next;
+	struct udo_file_ops_walk     *walk;
+	struct udo_file_ops_walk_dir *children;
+	int                          fd;
+	int                          err;
+	uint32_t                     depth;
+	uint32_t                     pending;
+	char                         name[];
+};
+
+
+/*
+ * @brief Structure defining state shared between
+ *        the thread walking a tree and the threads
+ *        reading directories.
+ *
+ * @member info - Caller defined callbacks.
+ * @member lock - Protects @done.
+ * @member cond - Signaled when a directory is added to @done.
+ * @member done - List of directories that were read.
+ */
+struct udo_file_ops_walk
+{
+	const struct udo_file_ops_walk_info *info;
+	pthread_mutex_t                     lock;
+	pthread_cond_t                      cond;
+	struct udo_file_ops_walk_dir        *done;
+};
+
+
+static pthread_mutex_t map_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct udo_file_ops_map *map_cache[FILE_OPS_MAP_CACHE_BUCKETS];
+
+
+/*****************************************
+ * Start of global to C source functions *
+ *****************************************/
+
+static size_t
+p_file_ops_count_byte_memchr (const char *buf,
+                              const size_t len,
+                              const char c)
+{
+	size_t count = 0;
+	const char *end = buf + len;
+
+	while ((buf = memchr(buf, c, end - buf))) {
+		count++; buf++;
+	}
+
+	return count;
+}
+
+
+#if defined(__x86_64__)
+/*
+ * Compares 32 bytes at a time. Matches are accumulated
+ * by subtracting compare results (0xFF == -1) from byte
+ * counters that are periodically summed with psadbw.
+ */
+__attribute__((target("avx2")))
+static size_t
+p_file_ops_count_byte_avx2 (const char *buf,
+                            const size_t len,
+                            const char c)
+{
+	uint32_t iter;
+	size_t off = 0, count = 0;
+
+	__m256i acc, sum = _mm256_setzero_si256();
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i needle = _mm256_set1_epi8(c);
+
+	while (off + sizeof(__m256i) <= len) {
+		acc = _mm256_setzero_si256();
+		for (iter = 0; iter < FILE_OPS_COUNT_ITER_MAX && \
+		     off + sizeof(__m256i) <= len; iter++, off += sizeof(__m256i))
+		{
+			acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(needle, \
+				_mm256_loadu_si256((const __m256i *)(buf + off))));
+		}
+
+		sum = _mm256_add_epi64(sum, _mm256_sad_epu8(acc, zero));
+	}
+
+	count = _mm256_extract_epi64(sum, 0) + _mm256_extract_epi64(sum, 1) + \
+		_mm256_extract_epi64(sum, 2) + _mm256_extract_epi64(sum, 3);
+
+	return count + p_file_ops_count_byte_memchr(buf + off, len - off, c);
+}
+
+
+static size_t
+p_file_ops_count_byte_sse2 (const char *buf,
+                            const size_t len,
+                            const char c)
+{
+	uint32_t iter;
+	size_t off = 0, count = 0;
+
+	__m128i acc, sum = _mm_setzero_si128();
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i needle = _mm_set1_epi8(c);
+
+	while (off + sizeof(__m128i) <= len) {
+		acc = _mm_setzero_si128();
+		for (iter = 0; iter < FILE_OPS_COUNT_ITER_MAX && \
+		     off + sizeof(__m128i) <= len; iter++, off += sizeof(__m128i))
+		{
+			acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(needle, \
+				_mm_loadu_si128((const __m128i *)(buf + off))));
+		}
+
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(acc, zero));
+	}
+
+	count = _mm_cvtsi128_si64(sum) + \
+		_mm_cvtsi128_si64(_mm_unpackhi_epi64(sum, sum));
+
+	return count + p_file_ops_count_byte_memchr(buf + off, len - off, c);
+}
+#elif defined(__aarch64__)
+static size_t
+p_file_ops_count_byte_neon (const char *buf,
+                            const size_t len,
+                            const char c)
+{
+	uint32_t iter;
+	size_t off = 0, count = 0;
+
+	uint8x16_t acc;
+	const uint8x16_t needle = vdupq_n_u8((uint8_t)c);
+
+	while (off + sizeof(uint8x16_t) <= len) {
+		acc = vdupq_n_u8(0);
+		for (iter = 0; iter < FILE_OPS_COUNT_ITER_MAX && \
+		     off + sizeof(uint8x16_t) <= len; iter++, off += sizeof(uint8x16_t))
+		{
+			acc = vsubq_u8(acc, vceqq_u8(needle, \
+				vld1q_u8((const uint8_t *)(buf + off))));
+		}
+
+		count += vaddlvq_u8(acc);
+	}
+
+	return count + p_file_ops_count_byte_memchr(buf + off, len - off, c);
+}
+#endif
+
+
+/*
+ * Returns amount of times @c occurs in @buf. Picks the
+ * widest vector kernel the CPU supports at runtime.
+ * Searching for a single byte is left to memchr(3)
+ * which libc already vectorizes.
+ */
+static size_t
+p_file_ops_count_byte (const char *buf,
+                       const size_t len,
+                       const char c)
+{
+#if defined(__x86_64__)
+	if (__builtin_cpu_supports("avx2"))
+		return p_file_ops_count_byte_avx2(buf, len, c);
+	return p_file_ops_count_byte_sse2(buf, len, c);
+#elif defined(__aarch64__)
+	return p_file_ops_count_byte_neon(buf, len, c);
+#else
+	return p_file_ops_count_byte_memchr(buf, len, c);
+#endif
+}
+
+/***************************************
+ * End of global to C source functions *
+ ***************************************/
+
 /******************************************
  * Start of udo_file_ops_create functions *
  ******************************************/
@@ -113,6 +555,145 @@ p_set_fname_off (struct udo_file_ops *flops,
 }
 
 
+UDO_STATIC_INLINE
+struct udo_file_ops_map **
+p_file_ops_map_bucket (const dev_t dev,
+                       const ino_t ino)
+{
+	return &map_cache[(dev ^ ino) % FILE_OPS_MAP_CACHE_BUCKETS];
+}
+
+
+/*
+ * Looks up the read only mapping of the file in the
+ * mapping cache. Creating it if the file wasn't mapped
+ * yet or was modified since it was mapped. @fstats comes
+ * from fstat(2) of @flops fd. Callers still pay for
+ * open(2) and fstat(2), a hit only saves the mmap(2).
+ */
+static int
+p_file_ops_map_get (struct udo_file_ops *flops,
+                    const struct stat *fstats)
+{
+	struct udo_file_ops_map *map, **bucket;
+
+	pthread_mutex_lock(&map_cache_lock);
+
+	bucket = p_file_ops_map_bucket(fstats->st_dev, fstats->st_ino);
+	for (map = *bucket; map; map = map->next) {
+		if (map->dev == fstats->st_dev && \
+		    map->ino == fstats->st_ino && \
+		    map->size == flops->alloc_sz && \
+		    map->mtim.tv_sec == fstats->st_mtim.tv_sec && \
+		    map->mtim.tv_nsec == fstats->st_mtim.tv_nsec)
+		{
+			break;
+		}
+	}
+
+	if (!map) {
+		map = calloc(1, sizeof(struct udo_file_ops_map));
+		if (!map) {
+			pthread_mutex_unlock(&map_cache_lock);
+			udo_log_error("calloc: %s\n", strerror(errno));
+			return -1;
+		}
+
+		map->data = mmap(NULL, flops->alloc_sz, PROT_READ,
+		                 MAP_SHARED, flops->fd, 0);
+		if (map->data == (void*)-1) {
+			pthread_mutex_unlock(&map_cache_lock);
+			udo_log_error("mmap: %s\n", strerror(errno));
+			free(map);
+			return -1;
+		}
+
+		map->dev = fstats->st_dev;
+		map->ino = fstats->st_ino;
+		map->mtim = fstats->st_mtim;
+		map->size = flops->alloc_sz;
+		map->next = *bucket;
+		*bucket = map;
+	}
+
+	map->refs++;
+	flops->map = map;
+	flops->data = map->data;
+
+	pthread_mutex_unlock(&map_cache_lock);
+
+	return 0;
+}
+
+
+/*
+ * Sleeps until @fux equals @desired. Unlike udo_futex_wait(3)
+ * doesn't spin before sleeping. Waiters here sleep for as long
+ * as it takes to fill a buffer or a flush threshold.
+ */
+UDO_STATIC_INLINE
+void
+p_file_ops_futex_wait (udo_atomic_u32 *fux,
+                       const uint32_t desired)
+{
+	uint32_t val;
+
+	while ((val = __atomic_load_n(fux, __ATOMIC_ACQUIRE)) != desired)
+		syscall(SYS_futex, fux, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+
+UDO_STATIC_INLINE
+void
+p_file_ops_futex_wake (udo_atomic_u32 *fux,
+                       const uint32_t desired)
+{
+	__atomic_store_n(fux, desired, __ATOMIC_RELEASE);
+	syscall(SYS_futex, fux, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+
+/*
+ * Background flusher. Writes back appended data up to
+ * @flush_end each time udo_file_ops_append(3) wakes it.
+ * Only the file descriptor is used. So, remapping the
+ * file while write-back is in progress is safe. Bytes
+ * written through the mapping are never counted, those
+ * behind @flush_end are left to the kernel.
+ */
+static void *
+p_file_ops_flusher (void *arg)
+{
+	size_t start = 0, end;
+
+	struct udo_file_ops *flops = arg;
+
+	while (1) {
+		p_file_ops_futex_wait(&(flops->flush_req), FILE_OPS_FLUSH_PENDING);
+
+		/*
+		 * Exchange instead of store so that a stop request
+		 * made after our last check is never overwritten.
+		 */
+		__atomic_exchange_n(&(flops->flush_req), FILE_OPS_FLUSH_IDLE, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&(flops->flush_stop), __ATOMIC_SEQ_CST))
+			break;
+
+		end = __atomic_load_n(&(flops->flush_end), __ATOMIC_ACQUIRE);
+		if (end <= start)
+			continue;
+
+		sync_file_range(flops->fd, flops->offset + start, end - start,
+		                SYNC_FILE_RANGE_WAIT_BEFORE | \
+		                SYNC_FILE_RANGE_WRITE | \
+		                SYNC_FILE_RANGE_WAIT_AFTER);
+		start = end;
+	}
+
+	return NULL;
+}
+
+
 struct udo_file_ops *
 udo_file_ops_create (struct udo_file_ops *p_flops,
                      const void *p_file_info)
@@ -132,144 +713,1472 @@ udo_file_ops_create (struct udo_file_ops *p_flops,
 		return NULL;
 	}
 
-	if (!flops) {
-		flops = calloc(1, sizeof(struct udo_file_ops));
-		if (!flops) {
-			udo_log_error("calloc: %s\n", strerror(errno));
-			return NULL;
+	if (!flops) {
+		flops = calloc(1, sizeof(struct udo_file_ops));
+		if (!flops) {
+			udo_log_error("calloc: %s\n", strerror(errno));
+			return NULL;
+		}
+
+		flops->free = true;
+	}
+
+	if (file_info->fname) {
+		memccpy(flops->full_path, file_info->fname, '\n', UDO_FILE_PATH_MAX);
+		length = strnlen(flops->full_path, UDO_FILE_PATH_MAX);
+
+		if (file_info->create_dir)
+			p_create_directories(flops->full_path, length);
+
+		flops->fd = open(flops->full_path, O_CREAT|O_RDWR, 0644);
+		if (flops->fd == -1) {
+			udo_log_error("open: %s\n", strerror(errno));
+			udo_file_ops_destroy(flops, 0);
+			return NULL;
+		}
+
+		/*
+		 * fstat(2) the open file. So, the size and mapping
+		 * cache key belong to the file that was opened even
+		 * if the path was replaced in between.
+		 */
+		ret = fstat(flops->fd, &fstats);
+		if (ret == -1) {
+			udo_log_error("fstat: %s\n", strerror(errno));
+			udo_file_ops_destroy(flops, 0);
+			return NULL;
+		}
+
+		p_set_fname_off(flops, length);
+
+		/*
+		 * If caller defined file_info->size set to 0.
+		 * 	- Then set internal alloc_sz and data_sz to equal
+		 *        the size of the file. Which is 0 for newly
+		 *        created files.
+		 * 	- Else set internal alloc_sz to equal the caller
+		 *        defined size. Set data_sz to 0 as file is
+		 *        truncated to the caller defined size.
+		 */
+		if (!(file_info->size)) {
+			flops->alloc_sz = flops->data_sz = fstats.st_size;
+		} else {
+			flops->data_sz = 0;
+			flops->alloc_sz = file_info->size;
+		}
+
+		flops->alloc_sz = UDO_BYTE_ALIGN(flops->alloc_sz, UDO_PAGE_SIZE);
+		flops->offset = file_info->offset;
+		flops->protect = file_info->protect;
+		flops->line_index = file_info->line_index;
+	}
+
+	if (file_info->create_pipe) {
+		ret = pipe(flops->pipe_fds);
+		if (ret == -1) {
+			udo_log_error("pipe: %s\n", strerror(errno));
+			udo_file_ops_destroy(flops, 0);
+			return NULL;
+		}
+	} else {
+		if (!(flops->data_sz)) {
+			ret = ftruncate(flops->fd, flops->alloc_sz);
+			if (ret == -1) {
+				udo_log_error("%s\n", strerror(errno));
+				udo_file_ops_destroy(flops, 0);
+				return NULL;
+			}
+		}
+
+		/* Share read only mappings of whole existing files */
+		if (file_info->protect && \
+		    flops->data_sz && \
+		    !(file_info->offset))
+		{
+			ret = p_file_ops_map_get(flops, &fstats);
+			if (ret == -1) {
+				udo_file_ops_destroy(flops, 0);
+				return NULL;
+			}
+
+			return flops;
+		}
+
+		flops->data = mmap(NULL, flops->alloc_sz, \
+				   (file_info->protect) ? \
+				   PROT_READ : PROT_READ|PROT_WRITE, \
+				   MAP_SHARED, flops->fd, file_info->offset);
+		if (flops->data == (void*)-1 && flops->alloc_sz) {
+			udo_log_error("mmap: %s\n", strerror(errno));
+			udo_file_ops_destroy(flops, 0);
+			return NULL;
+		}
+
+		if (file_info->flush_size && !(file_info->protect)) {
+			flops->flush_size = file_info->flush_size;
+			ret = pthread_create(&(flops->flush_tid), NULL, p_file_ops_flusher, flops);
+			if (ret) {
+				udo_log_error("pthread_create: %s\n", strerror(ret));
+				udo_file_ops_destroy(flops, 0);
+				return NULL;
+			}
+
+			flops->flusher = true;
+		}
+	}
+
+	return flops;
+}
+
+/****************************************
+ * End of udo_file_ops_create functions *
+ ****************************************/
+
+
+/*********************************************
+ * Start of udo_file_ops_zero_copy functions *
+ *********************************************/
+
+/*
+ * Bytes left in the pipe after a failed drain would be
+ * written out at the start of the next transfer. Replace
+ * the pipe with an empty one. If pipe(2) fails the fds are
+ * cleared so p_file_ops_grow_pipe() retries creating it.
+ */
+static void
+p_file_ops_reset_pipe (struct udo_file_ops *flops)
+{
+	close(flops->pipe_fds[0]);
+	close(flops->pipe_fds[1]);
+	flops->pipe_fds[0] = flops->pipe_fds[1] = 0;
+	flops->pipe_sz = 0;
+
+	if (pipe(flops->pipe_fds) == -1)
+		flops->pipe_fds[0] = flops->pipe_fds[1] = 0;
+}
+
+
+/*
+ * Writes @size bytes already spliced into the pipe to the
+ * output fd. EINTR is retried and EAGAIN waits for the
+ * output to become writable. On any other error the pipe
+ * is reset. Returns amount of bytes written to the output.
+ */
+static size_t
+p_file_ops_splice_drain (struct udo_file_ops *flops,
+                         const struct udo_file_ops_zero_copy_info *file_info,
+                         const size_t size)
+{
+	ssize_t out;
+	size_t moved = 0;
+	struct pollfd pfd;
+
+	while (moved < size) {
+		out = splice(flops->pipe_fds[0], NULL,
+		             file_info->out_fd, file_info->out_off,
+		             size - moved, SPLICE_F_MOVE|SPLICE_F_MORE);
+		if (out > 0) {
+			moved += out;
+			continue;
+		}
+
+		if (out == -1 && errno == EINTR)
+			continue;
+
+		if (out == -1 && errno == EAGAIN) {
+			pfd.fd = file_info->out_fd;
+			pfd.events = POLLOUT;
+			if (poll(&pfd, 1, -1) != -1 || errno == EINTR)
+				continue;
+		}
+
+		if (out == 0)
+			errno = EPIPE;
+
+		udo_log_set_error(flops, errno, "splice: %s", strerror(errno));
+		p_file_ops_reset_pipe(flops);
+		break;
+	}
+
+	return moved;
+}
+
+
+ssize_t
+udo_file_ops_zero_copy (struct udo_file_ops *flops,
+                        const void *p_file_info)
+{
+	ssize_t ret;
+	size_t moved;
+
+	const struct udo_file_ops_zero_copy_info *file_info = p_file_info;
+
+	if (!flops)
+		return -1;
+
+	if (!file_info || \
+	    file_info->size == 0)
+	{
+		udo_log_set_error(flops, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	do {
+		ret = splice(file_info->in_fd,
+			     file_info->in_off,
+			     flops->pipe_fds[1], 0,
+			     UDO_MIN(file_info->size, PIPE_MAX_BUFF_SIZE),
+			     SPLICE_F_MOVE|SPLICE_F_MORE);
+	} while (ret == -1 && errno == EINTR);
+
+	if (ret == 0) {
+		return 0;
+	} else if (ret == -1) {
+		udo_log_set_error(flops, errno, "splice: %s", strerror(errno));
+		return -1;
+	}
+
+	/* Drain everything spliced into the pipe */
+	moved = p_file_ops_splice_drain(flops, file_info, ret);
+
+	return (moved) ? (ssize_t) moved : -1;
+}
+
+
+static int
+p_file_ops_grow_pipe (struct udo_file_ops *flops)
+{
+	int ret = -1;
+
+	if (flops->pipe_sz)
+		return 0;
+
+	if (!(flops->pipe_fds[0]) && !(flops->pipe_fds[1])) {
+		ret = pipe(flops->pipe_fds);
+		if (ret == -1) {
+			udo_log_set_error(flops, errno, "pipe: %s", strerror(errno));
+			return -1;
+		}
+	}
+
+	/* Failing to grow isn't fatal. Keep current capacity. */
+	fcntl(flops->pipe_fds[1], F_SETPIPE_SZ, PIPE_GROW_BUFF_SIZE);
+
+	ret = fcntl(flops->pipe_fds[1], F_GETPIPE_SZ);
+	flops->pipe_sz = (ret == -1) ? PIPE_MAX_BUFF_SIZE : (size_t)ret;
+
+	return 0;
+}
+
+
+static ssize_t
+p_file_ops_splice (struct udo_file_ops *flops,
+                   const struct udo_file_ops_zero_copy_info *file_info)
+{
+	ssize_t in = 0;
+	size_t out, total = 0;
+
+	if (p_file_ops_grow_pipe(flops) == -1)
+		return -1;
+
+	while (total < file_info->size) {
+		in = splice(file_info->in_fd, file_info->in_off,
+		            flops->pipe_fds[1], NULL,
+		            UDO_MIN(file_info->size - total, flops->pipe_sz),
+		            SPLICE_F_MOVE|SPLICE_F_MORE);
+		if (in == 0) {
+			break;
+		} else if (in == -1) {
+			if (errno == EINTR)
+				continue;
+			udo_log_set_error(flops, errno, "splice: %s", strerror(errno));
+			break;
+		}
+
+		/* Data left in the pipe would be stranded */
+		out = p_file_ops_splice_drain(flops, file_info, in);
+		total += out;
+		if (out != (size_t) in)
+			break;
+	}
+
+	return (total || in == 0) ? (ssize_t) total : -1;
+}
+
+
+/*
+ * Returns amount of bytes moved or -1 if the kernel can't
+ * copy between the two files in which case caller
+ * falls back to splice(2).
+ */
+static ssize_t
+p_file_ops_copy_file_range (struct udo_file_ops *flops,
+                            const struct udo_file_ops_zero_copy_info *file_info)
+{
+	ssize_t ret;
+	size_t total = 0;
+
+	while (total < file_info->size) {
+		ret = copy_file_range(file_info->in_fd, file_info->in_off,
+		                      file_info->out_fd, file_info->out_off,
+		                      file_info->size - total, 0);
+		if (ret == 0) {
+			break;
+		} else if (ret == -1) {
+			if (!total && (errno == EXDEV || errno == EINVAL || \
+			    errno == ENOSYS || errno == EOPNOTSUPP))
+			{
+				return -1;
+			}
+
+			udo_log_set_error(flops, errno, "copy_file_range: %s", strerror(errno));
+			return (total) ? (ssize_t) total : -2;
+		}
+
+		total += ret;
+	}
+
+	return total;
+}
+
+
+static ssize_t
+p_file_ops_sendfile (struct udo_file_ops *flops,
+                     const struct udo_file_ops_zero_copy_info *file_info)
+{
+	ssize_t ret;
+	size_t total = 0;
+
+	while (total < file_info->size) {
+		ret = sendfile(file_info->out_fd, file_info->in_fd,
+		               file_info->in_off, file_info->size - total);
+		if (ret == 0) {
+			break;
+		} else if (ret == -1) {
+			if (!total && (errno == EINVAL || errno == ENOSYS))
+				return -1;
+
+			udo_log_set_error(flops, errno, "sendfile: %s", strerror(errno));
+			return (total) ? (ssize_t) total : -2;
+		}
+
+		total += ret;
+	}
+
+	return total;
+}
+
+
+ssize_t
+udo_file_ops_transfer (struct udo_file_ops *flops,
+                       const void *p_file_info)
+{
+	ssize_t ret = -1;
+
+	struct stat in_stats, out_stats;
+
+	const struct udo_file_ops_zero_copy_info *file_info = p_file_info;
+
+	if (!flops)
+		return -1;
+
+	if (!file_info || \
+	    file_info->size == 0)
+	{
+		udo_log_set_error(flops, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	if (fstat(file_info->in_fd, &in_stats) == -1 || \
+	    fstat(file_info->out_fd, &out_stats) == -1)
+	{
+		udo_log_set_error(flops, errno, "fstat: %s", strerror(errno));
+		return -1;
+	}
+
+	/*
+	 * -1 means the faster path isn't supported between the
+	 * two file descriptors. -2 means it failed outright.
+	 */
+	if (S_ISREG(in_stats.st_mode) && S_ISREG(out_stats.st_mode)) {
+		ret = p_file_ops_copy_file_range(flops, file_info);
+	} else if (S_ISREG(in_stats.st_mode) && S_ISSOCK(out_stats.st_mode)) {
+		ret = p_file_ops_sendfile(flops, file_info);
+	}
+
+	if (ret == -2)
+		return -1;
+
+	if (ret == -1)
+		ret = p_file_ops_splice(flops, file_info);
+
+	return ret;
+}
+
+/*******************************************
+ * End of udo_file_ops_zero_copy functions *
+ *******************************************/
+
+
+/******************************************
+ * Start of udo_file_ops_append functions *
+ ******************************************/
+
+/*
+ * Ensures file blocks backing the first @size bytes of
+ * the mapping exist so that writes never raise SIGBUS.
+ * Falls back to ftruncate(2) on file systems without
+ * fallocate(2) support.
+ */
+static int
+p_file_ops_allocate (struct udo_file_ops *flops,
+                     const size_t size)
+{
+	int ret = -1;
+
+	struct stat fstats;
+
+	ret = fallocate(flops->fd, 0, flops->offset, size);
+	if (ret == -1 && errno != EOPNOTSUPP) {
+		udo_log_set_error(flops, errno, "fallocate: %s", strerror(errno));
+		return -1;
+	} else if (ret == 0) {
+		return 0;
+	}
+
+	ret = fstat(flops->fd, &fstats);
+	if (ret == -1) {
+		udo_log_set_error(flops, errno, "fstat: %s", strerror(errno));
+		return -1;
+	}
+
+	if (fstats.st_size >= (off_t)(flops->offset + size))
+		return 0;
+
+	ret = ftruncate(flops->fd, flops->offset + size);
+	if (ret == -1) {
+		udo_log_set_error(flops, errno, "ftruncate: %s", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+
+static int
+p_file_ops_remap (struct udo_file_ops *flops,
+                  const size_t size)
+{
+	void *data = NULL;
+
+	if (p_file_ops_allocate(flops, size) == -1)
+		return -1;
+
+	if (flops->data == (void*)-1) {
+		data = mmap(NULL, size, PROT_READ|PROT_WRITE,
+		            MAP_SHARED, flops->fd, flops->offset);
+		if (data == (void*)-1) {
+			udo_log_set_error(flops, errno, "mmap: %s", strerror(errno));
+			return -1;
+		}
+	} else {
+		data = mremap(flops->data, flops->alloc_sz, size, MREMAP_MAYMOVE);
+		if (data == (void*)-1) {
+			udo_log_set_error(flops, errno, "mremap: %s", strerror(errno));
+			return -1;
+		}
+	}
+
+	flops->data = data;
+	flops->alloc_sz = size;
+
+	return 0;
+}
+
+
+UDO_STATIC_INLINE
+uint8_t
+p_check_writable (struct udo_file_ops *flops)
+{
+	return !(flops->data) || flops->protect;
+}
+
+
+int
+udo_file_ops_reserve (struct udo_file_ops *flops,
+                      const size_t size)
+{
+	if (!flops)
+		return -1;
+
+	if (p_check_writable(flops)) {
+		udo_log_set_error(flops, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	if (size <= flops->alloc_sz)
+		return 0;
+
+	return p_file_ops_remap(flops, UDO_BYTE_ALIGN(size, UDO_PAGE_SIZE));
+}
+
+
+ssize_t
+udo_file_ops_append (struct udo_file_ops *flops,
+                     const void *buf,
+                     const size_t len)
+{
+	size_t size;
+
+	if (!flops)
+		return -1;
+
+	if (!buf || \
+	    !len || \
+	    p_check_writable(flops))
+	{
+		udo_log_set_error(flops, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	size = flops->data_sz + len;
+	if (size > flops->alloc_sz) {
+		size = UDO_MAX(size, flops->alloc_sz * FILE_OPS_GROWTH_FACTOR);
+		if (p_file_ops_remap(flops, UDO_BYTE_ALIGN(size, UDO_PAGE_SIZE)) == -1)
+			return -1;
+	} else if (!(flops->appended)) {
+		/* Existing files may end before the last mapped page */
+		if (p_file_ops_allocate(flops, flops->alloc_sz) == -1)
+			return -1;
+	}
+
+	memcpy((char*)flops->data + flops->data_sz, buf, len);
+	flops->data_sz += len;
+	flops->appended = true;
+
+	if (flops->flusher) {
+		flops->flush_dirty += len;
+		if (flops->flush_dirty >= flops->flush_size) {
+			__atomic_store_n(&(flops->flush_end), flops->data_sz, __ATOMIC_RELEASE);
+			p_file_ops_futex_wake(&(flops->flush_req), FILE_OPS_FLUSH_PENDING);
+			flops->flush_dirty = 0;
+		}
+	}
+
+	return len;
+}
+
+/****************************************
+ * End of udo_file_ops_append functions *
+ ****************************************/
+
+
+/*****************************************
+ * Start of udo_file_ops_flush functions *
+ *****************************************/
+
+int
+udo_file_ops_flush_range (struct udo_file_ops *flops,
+                          const size_t offset,
+                          const size_t len,
+                          const uint8_t async)
+{
+	int ret = -1;
+	size_t start, size;
+
+	if (!flops)
+		return -1;
+
+	if (!(flops->data) || \
+	    flops->data == (void*)-1 || \
+	    offset >= flops->alloc_sz || \
+	    len > (flops->alloc_sz - offset))
+	{
+		udo_log_set_error(flops, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	/* msync(2) requires a page aligned address */
+	start = offset - (offset % UDO_PAGE_SIZE);
+	size = ((len) ? offset + len : flops->alloc_sz) - start;
+
+	/*
+	 * msync(2) MS_ASYNC is a no-op on Linux. Dirty pages of
+	 * shared mappings are tracked in the page cache. So,
+	 * sync_file_range(2) may start their write-back.
+	 */
+	if (async) {
+		ret = sync_file_range(flops->fd, flops->offset + start,
+		                      size, SYNC_FILE_RANGE_WRITE);
+		if (ret == -1) {
+			udo_log_set_error(flops, errno, "sync_file_range: %s", strerror(errno));
+			return -1;
+		}
+	} else {
+		ret = msync((char*)flops->data + start, size, MS_SYNC);
+		if (ret == -1) {
+			udo_log_set_error(flops, errno, "msync: %s", strerror(errno));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/***************************************
+ * End of udo_file_ops_flush functions *
+ ***************************************/
+
+
+/******************************************
+ * Start of udo_file_ops_advise functions *
+ ******************************************/
+
+static int
+p_file_ops_check_range (struct udo_file_ops *flops,
+                        const size_t offset,
+                        const size_t len)
+{
+	return !(flops->data) || \
+	       flops->data == (void*)-1 || \
+	       offset >= flops->alloc_sz || \
+	       len > (flops->alloc_sz - offset);
+}
+
+
+static int
+p_file_ops_madvise (struct udo_file_ops *flops,
+                    const size_t start,
+                    const size_t size,
+                    const int advice)
+{
+	int ret = -1;
+
+	ret = madvise((char*)flops->data + start, size, advice);
+	if (ret == -1 && advice == MADV_POPULATE_READ && errno == EINVAL)
+		ret = madvise((char*)flops->data + start, size, MADV_WILLNEED);
+
+	if (ret == -1) {
+		udo_log_set_error(flops, errno, "madvise: %s", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+
+int
+udo_file_ops_advise (struct udo_file_ops *flops,
+                     const size_t offset,
+                     const size_t len,
+                     const enum udo_file_ops_advise_type advice)
+{
+	int ret = -1;
+	size_t start, size;
+
+	if (!flops)
+		return -1;
+
+	if (p_file_ops_check_range(flops, offset, len) || \
+	    advice > UDO_FILE_OPS_ADVISE_READAHEAD)
+	{
+		udo_log_set_error(flops, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	/* madvise(2) requires a page aligned address */
+	start = offset - (offset % UDO_PAGE_SIZE);
+	size = ((len) ? offset + len : flops->alloc_sz) - start;
+
+	switch (advice) {
+		case UDO_FILE_OPS_ADVISE_NORMAL:
+			return p_file_ops_madvise(flops, start, size, MADV_NORMAL);
+		case UDO_FILE_OPS_ADVISE_SEQUENTIAL:
+			return p_file_ops_madvise(flops, start, size, MADV_SEQUENTIAL);
+		case UDO_FILE_OPS_ADVISE_RANDOM:
+			return p_file_ops_madvise(flops, start, size, MADV_RANDOM);
+		case UDO_FILE_OPS_ADVISE_WILLNEED:
+			return p_file_ops_madvise(flops, start, size, MADV_WILLNEED);
+		case UDO_FILE_OPS_ADVISE_POPULATE_READ:
+			return p_file_ops_madvise(flops, start, size, MADV_POPULATE_READ);
+		case UDO_FILE_OPS_ADVISE_READAHEAD:
+			break;
+	}
+
+	ret = readahead(flops->fd, flops->offset + start, size);
+	if (ret == -1) {
+		udo_log_set_error(flops, errno, "readahead: %s", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+
+static int
+p_file_ops_range_cmp (const void *a,
+                      const void *b)
+{
+	const struct udo_file_ops_range *ra = a, *rb = b;
+
+	return (ra->offset > rb->offset) - (ra->offset < rb->offset);
+}
+
+
+int
+udo_file_ops_prefetch (struct udo_file_ops *flops,
+                       const struct udo_file_ops_range *p_ranges,
+                       const uint32_t count)
+{
+	uint32_t r;
+	size_t start, end, rstart, rend;
+
+	struct udo_file_ops_range *ranges = NULL;
+
+	if (!flops)
+		return -1;
+
+	if (!p_ranges || !count) {
+		udo_log_set_error(flops, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	for (r = 0; r < count; r++) {
+		if (!(p_ranges[r].size) || \
+		    p_file_ops_check_range(flops, p_ranges[r].offset, p_ranges[r].size))
+		{
+			udo_log_set_error(flops, UDO_LOG_ERR_INCORRECT_DATA, "");
+			return -1;
+		}
+	}
+
+	ranges = malloc(count * sizeof(struct udo_file_ops_range));
+	if (!ranges) {
+		udo_log_set_error(flops, errno, "malloc: %s", strerror(errno));
+		return -1;
+	}
+
+	memcpy(ranges, p_ranges, count * sizeof(struct udo_file_ops_range));
+	qsort(ranges, count, sizeof(struct udo_file_ops_range), p_file_ops_range_cmp);
+
+	/* Merge page ranges so that each run is one madvise(2) */
+	start = ranges[0].offset - (ranges[0].offset % UDO_PAGE_SIZE);
+	end = UDO_BYTE_ALIGN(ranges[0].offset + ranges[0].size, UDO_PAGE_SIZE);
+	for (r = 1; r <= count; r++) {
+		if (r < count) {
+			rstart = ranges[r].offset - (ranges[r].offset % UDO_PAGE_SIZE);
+			rend = UDO_BYTE_ALIGN(ranges[r].offset + ranges[r].size, UDO_PAGE_SIZE);
+			if (rstart <= end) {
+				end = UDO_MAX(end, rend);
+				continue;
+			}
+		}
+
+		if (p_file_ops_madvise(flops, start, end - start, MADV_WILLNEED) == -1) {
+			free(ranges);
+			return -1;
+		}
+
+		if (r < count) {
+			start = rstart;
+			end = rend;
+		}
+	}
+
+	free(ranges);
+
+	return 0;
+}
+
+/****************************************
+ * End of udo_file_ops_advise functions *
+ ****************************************/
+
+
+/****************************************
+ * Start of udo_file_ops_iter functions *
+ ****************************************/
+
+struct udo_file_ops_iter *
+udo_file_ops_iter_create (struct udo_file_ops_iter *p_iter,
+                          const void *p_iter_info)
+{
+	struct udo_file_ops_iter *iter = p_iter;
+
+	const struct udo_file_ops_iter_create_info *iter_info = p_iter_info;
+
+	if (!iter_info || \
+	    !(iter_info->flops))
+	{
+		udo_log_error("Incorrect data passed\n");
+		return NULL;
+	}
+
+	if (!iter) {
+		iter = calloc(1, sizeof(struct udo_file_ops_iter));
+		if (!iter) {
+			udo_log_error("calloc: %s\n", strerror(errno));
+			return NULL;
+		}
+
+		iter->free = true;
+	}
+
+	iter->flops = iter_info->flops;
+	iter->fd = iter_info->flops->fd;
+	iter->delim = (iter_info->delim) ? iter_info->delim : '\n';
+	iter->record_sz = iter_info->record_size;
+	iter->window_sz = (iter_info->window_size) ? \
+		UDO_BYTE_ALIGN(iter_info->window_size, UDO_PAGE_SIZE) : \
+		FILE_OPS_ITER_WINDOW_SIZE;
+	iter->pos = iter_info->offset;
+
+	return iter;
+}
+
+
+/*
+ * Files written with udo_file_ops_append(3) have blocks
+ * allocated past the end of their data until destroyed.
+ */
+static int
+p_file_ops_iter_stat (struct udo_file_ops_iter *iter)
+{
+	struct stat fstats;
+
+	if (iter->flops->appended) {
+		iter->file_sz = iter->flops->offset + iter->flops->data_sz;
+		return 0;
+	}
+
+	if (fstat(iter->fd, &fstats) == -1) {
+		udo_log_set_error(iter, errno, "fstat: %s", strerror(errno));
+		return -1;
+	}
+
+	iter->file_sz = fstats.st_size;
+
+	return 0;
+}
+
+
+/*
+ * Maps up to @size bytes of the file starting at the
+ * page containing @offset. Hints to the kernel that
+ * the window is read sequentially and that the next
+ * window will be needed soon.
+ */
+static int
+p_file_ops_iter_map (struct udo_file_ops_iter *iter,
+                     const size_t offset,
+                     const size_t size)
+{
+	void *win;
+	size_t win_off, win_sz;
+
+	if (iter->win) {
+		munmap(iter->win, iter->win_sz);
+		iter->win = NULL;
+	}
+
+	win_off = offset & ~((size_t)UDO_PAGE_SIZE-1);
+	win_sz = UDO_MIN(size, iter->file_sz - win_off);
+
+	win = mmap(NULL, win_sz, PROT_READ, MAP_SHARED, iter->fd, win_off);
+	if (win == (void*)-1) {
+		udo_log_set_error(iter, errno, "mmap: %s", strerror(errno));
+		return -1;
+	}
+
+	madvise(win, win_sz, MADV_SEQUENTIAL);
+	posix_fadvise(iter->fd, win_off + win_sz,
+	              iter->window_sz, POSIX_FADV_WILLNEED);
+
+	iter->win = win;
+	iter->win_off = win_off;
+	iter->win_sz = win_sz;
+
+	return 0;
+}
+
+
+int
+udo_file_ops_iter_next (struct udo_file_ops_iter *iter,
+                        const void **ptr,
+                        size_t *len)
+{
+	const char *data, *delim;
+	size_t avail, size, skip;
+
+	if (!iter)
+		return -1;
+
+	if (!ptr || !len) {
+		udo_log_set_error(iter, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	if (iter->pos >= iter->file_sz && \
+	    p_file_ops_iter_stat(iter) == -1)
+	{
+		return -1;
+	}
+
+	if (iter->pos >= iter->file_sz)
+		return 0;
+
+	size = iter->window_sz;
+	if (!(iter->win) || \
+	    iter->pos < iter->win_off || \
+	    iter->pos >= iter->win_off + iter->win_sz)
+	{
+		if (p_file_ops_iter_map(iter, iter->pos, size) == -1)
+			return -1;
+	}
+
+	for (;;) {
+		data = (const char *)iter->win + (iter->pos - iter->win_off);
+		avail = iter->win_off + iter->win_sz - iter->pos;
+
+		if (iter->record_sz) {
+			*len = skip = UDO_MIN(iter->record_sz, iter->file_sz - iter->pos);
+			if (*len <= avail)
+				break;
+		} else {
+			delim = memchr(data, iter->delim, avail);
+			if (delim) {
+				*len = delim - data;
+				skip = *len + 1;
+				break;
+			}
+
+			/* Last record may not end with a delimiter */
+			if (iter->win_off + iter->win_sz >= iter->file_sz) {
+				*len = skip = avail;
+				break;
+			}
+		}
+
+		/*
+		 * Record crosses the end of the window. Slide window
+		 * to the start of the record or if record is larger
+		 * than the window, grow the window.
+		 */
+		if ((iter->pos & ~((size_t)UDO_PAGE_SIZE-1)) == iter->win_off)
+			size = UDO_MAX(size << 1, UDO_BYTE_ALIGN(iter->record_sz + \
+			               UDO_PAGE_SIZE, UDO_PAGE_SIZE));
+
+		if (p_file_ops_iter_map(iter, iter->pos, size) == -1)
+			return -1;
+	}
+
+	*ptr = data;
+	iter->pos += skip;
+
+	return 1;
+}
+
+
+void
+udo_file_ops_iter_destroy (struct udo_file_ops_iter *iter)
+{
+	if (!iter)
+		return;
+
+	if (iter->win)
+		munmap(iter->win, iter->win_sz);
+
+	if (iter->free) {
+		free(iter);
+	} else {
+		memset(iter, 0, sizeof(struct udo_file_ops_iter));
+	}
+}
+
+
+int
+udo_file_ops_iter_get_sizeof (void)
+{
+	return sizeof(struct udo_file_ops_iter);
+}
+
+/**************************************
+ * End of udo_file_ops_iter functions *
+ **************************************/
+
+
+/******************************************
+ * Start of udo_file_ops_stream functions *
+ ******************************************/
+
+static int
+p_file_ops_pwrite_all (const int fd,
+                       const char *buf,
+                       size_t len,
+                       off_t offset)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = pwrite(fd, buf, len, offset);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		buf += ret;
+		len -= ret;
+		offset += ret;
+	}
+
+	return 0;
+}
+
+
+/*
+ * With O_DIRECT pages never enter the page cache. Buffered
+ * fallback writes back dirty pages first as posix_fadvise(2)
+ * doesn't drop them.
+ */
+static void
+p_file_ops_stream_dontneed (struct udo_file_ops_stream *stream,
+                            const off_t offset,
+                            const size_t len)
+{
+	if (stream->direct || !(stream->dontneed) || !len)
+		return;
+
+	if (stream->write) {
+		sync_file_range(stream->fd, offset, len,
+		                SYNC_FILE_RANGE_WAIT_BEFORE | \
+		                SYNC_FILE_RANGE_WRITE | \
+		                SYNC_FILE_RANGE_WAIT_AFTER);
+	}
+
+	posix_fadvise(stream->fd, offset, len, POSIX_FADV_DONTNEED);
+}
+
+
+/*
+ * Background I/O thread. Buffers are handed over in
+ * order. So, thread alternates between them.
+ */
+static void *
+p_file_ops_stream_run (void *arg)
+{
+	int i = 0;
+	ssize_t ret;
+	uint8_t eof = 0;
+
+	struct udo_file_ops_stream *stream = arg;
+
+	while (1) {
+		p_file_ops_futex_wait(&(stream->states[i]), FILE_OPS_STREAM_PENDING);
+		if (__atomic_load_n(&(stream->stop), __ATOMIC_ACQUIRE))
+			break;
+
+		if (stream->write) {
+			ret = p_file_ops_pwrite_all(stream->fd, stream->bufs[i],
+			                            stream->lens[i], stream->pos);
+			ret = (ret == -1) ? -1 : stream->lens[i];
+		} else if (eof) {
+			ret = 0;
+		} else {
+			do {
+				ret = pread(stream->fd, stream->bufs[i],
+				            stream->buf_sz, stream->pos);
+			} while (ret == -1 && errno == EINTR);
+
+			/* O_DIRECT reads past a short read aren't aligned */
+			eof = (ret != (ssize_t) stream->buf_sz);
+		}
+
+		if (ret == -1) {
+			__atomic_store_n(&(stream->io_err), errno, __ATOMIC_RELAXED);
+		} else {
+			p_file_ops_stream_dontneed(stream, stream->pos, ret);
+			stream->pos += ret;
+		}
+
+		stream->lens[i] = ret;
+		p_file_ops_futex_wake(&(stream->states[i]), (stream->write) ? \
+		               FILE_OPS_STREAM_FREE : FILE_OPS_STREAM_READY);
+		i ^= 1;
+	}
+
+	return NULL;
+}
+
+
+static int
+p_file_ops_stream_open (struct udo_file_ops_stream *stream,
+                        const char *fname)
+{
+	int flags;
+
+	flags = (stream->write) ? O_CREAT|O_WRONLY|O_TRUNC : O_RDONLY;
+
+	stream->direct = true;
+	stream->fd = open(fname, flags|O_DIRECT, 0644);
+	if (stream->fd == -1 && errno == EINVAL) {
+		/* File system doesn't support O_DIRECT */
+		stream->direct = false;
+		stream->fd = open(fname, flags, 0644);
+	}
+
+	if (stream->fd == -1) {
+		udo_log_error("open: %s\n", strerror(errno));
+		return -1;
+	}
+
+	if (!(stream->direct) && !(stream->write))
+		posix_fadvise(stream->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	return 0;
+}
+
+
+struct udo_file_ops_stream *
+udo_file_ops_stream_create (struct udo_file_ops_stream *p_stream,
+                            const void *p_stream_info)
+{
+	int ret = -1;
+
+	void *bufs = NULL;
+
+	struct udo_file_ops_stream *stream = p_stream;
+
+	const struct udo_file_ops_stream_create_info *stream_info = p_stream_info;
+
+	if (!stream_info || \
+	    !(stream_info->fname))
+	{
+		udo_log_error("Incorrect data passed\n");
+		return NULL;
+	}
+
+	if (!stream) {
+		stream = calloc(1, sizeof(struct udo_file_ops_stream));
+		if (!stream) {
+			udo_log_error("calloc: %s\n", strerror(errno));
+			return NULL;
+		}
+
+		stream->free = true;
+	}
+
+	stream->write = stream_info->write;
+	stream->dontneed = stream_info->dontneed;
+	stream->buf_sz = (stream_info->buffer_size) ? \
+		UDO_BYTE_ALIGN(stream_info->buffer_size, UDO_PAGE_SIZE) : \
+		FILE_OPS_STREAM_BUFFER_SIZE;
+
+	ret = p_file_ops_stream_open(stream, stream_info->fname);
+	if (ret == -1) {
+		udo_file_ops_stream_destroy(stream);
+		return NULL;
+	}
+
+	ret = posix_memalign(&bufs, UDO_PAGE_SIZE, stream->buf_sz * 2);
+	if (ret) {
+		udo_log_error("posix_memalign: %s\n", strerror(ret));
+		udo_file_ops_stream_destroy(stream);
+		return NULL;
+	}
+
+	stream->bufs[0] = bufs;
+	stream->bufs[1] = (char*)bufs + stream->buf_sz;
+
+	/* Reads start right away filling both buffers */
+	if (!(stream->write)) {
+		stream->states[0] = FILE_OPS_STREAM_PENDING;
+		stream->states[1] = FILE_OPS_STREAM_PENDING;
+	}
+
+	ret = pthread_create(&(stream->tid), NULL, p_file_ops_stream_run, stream);
+	if (ret) {
+		udo_log_error("pthread_create: %s\n", strerror(ret));
+		udo_file_ops_stream_destroy(stream);
+		return NULL;
+	}
+
+	stream->thread = true;
+
+	return stream;
+}
+
+
+ssize_t
+udo_file_ops_stream_read (struct udo_file_ops_stream *stream,
+                          const void **buf)
+{
+	ssize_t len;
+
+	if (!stream)
+		return -1;
+
+	if (!buf || stream->write) {
+		udo_log_set_error(stream, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	/* Hand previous buffer back to be read into */
+	if (stream->held) {
+		p_file_ops_futex_wake(&(stream->states[stream->cur]), FILE_OPS_STREAM_PENDING);
+		stream->cur ^= 1;
+		stream->held = false;
+	}
+
+	if (stream->eof)
+		return 0;
+
+	p_file_ops_futex_wait(&(stream->states[stream->cur]), FILE_OPS_STREAM_READY);
+
+	len = stream->lens[stream->cur];
+	if (len == -1) {
+		len = __atomic_load_n(&(stream->io_err), __ATOMIC_RELAXED);
+		udo_log_set_error(stream, len, "pread: %s", strerror(len));
+		return -1;
+	} else if (len == 0) {
+		stream->eof = true;
+		return 0;
+	}
+
+	*buf = stream->bufs[stream->cur];
+	stream->held = true;
+
+	return len;
+}
+
+
+/*
+ * Hands current buffer to the background thread and waits
+ * for the other buffer to finish being written.
+ */
+static int
+p_file_ops_stream_submit (struct udo_file_ops_stream *stream)
+{
+	int err;
+
+	stream->lens[stream->cur] = stream->fill;
+	p_file_ops_futex_wake(&(stream->states[stream->cur]), FILE_OPS_STREAM_PENDING);
+
+	stream->cur ^= 1;
+	stream->fill = 0;
+
+	p_file_ops_futex_wait(&(stream->states[stream->cur]), FILE_OPS_STREAM_FREE);
+	if (stream->lens[stream->cur] == -1) {
+		err = __atomic_load_n(&(stream->io_err), __ATOMIC_RELAXED);
+		udo_log_set_error(stream, err, "pwrite: %s", strerror(err));
+		stream->lens[stream->cur] = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
+
+ssize_t
+udo_file_ops_stream_write (struct udo_file_ops_stream *stream,
+                           const void *buf,
+                           const size_t len)
+{
+	size_t size, copied = 0;
+
+	if (!stream)
+		return -1;
+
+	if (!buf || !len || !(stream->write)) {
+		udo_log_set_error(stream, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	while (copied < len) {
+		size = UDO_MIN(len - copied, stream->buf_sz - stream->fill);
+		memcpy((char*)stream->bufs[stream->cur] + stream->fill,
+		       (const char*)buf + copied, size);
+		stream->fill += size;
+		copied += size;
+
+		if (stream->fill == stream->buf_sz && \
+		    p_file_ops_stream_submit(stream) == -1)
+		{
+			return -1;
+		}
+	}
+
+	return len;
+}
+
+
+int
+udo_file_ops_stream_flush (struct udo_file_ops_stream *stream)
+{
+	int ret = -1;
+	size_t size;
+
+	if (!stream)
+		return -1;
+
+	if (!(stream->write)) {
+		udo_log_set_error(stream, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	/* Background thread is idle once other buffer is free */
+	p_file_ops_futex_wait(&(stream->states[stream->cur ^ 1]), FILE_OPS_STREAM_FREE);
+	if (stream->lens[stream->cur ^ 1] == -1) {
+		ret = __atomic_load_n(&(stream->io_err), __ATOMIC_RELAXED);
+		udo_log_set_error(stream, ret, "pwrite: %s", strerror(ret));
+		stream->lens[stream->cur ^ 1] = 0;
+		return -1;
+	}
+
+	if (!(stream->fill))
+		return 0;
+
+	/*
+	 * Keep O_DIRECT. Tail is padded to a page and the file
+	 * truncated back to its length. Partial page stays at
+	 * the start of the buffer so later writes rewrite it at
+	 * a page aligned offset.
+	 */
+	size = stream->fill;
+	if (stream->direct && (size % UDO_PAGE_SIZE)) {
+		size = UDO_BYTE_ALIGN(size, UDO_PAGE_SIZE);
+		memset((char*)stream->bufs[stream->cur] + stream->fill, 0, size - stream->fill);
+	}
+
+	ret = p_file_ops_pwrite_all(stream->fd, stream->bufs[stream->cur],
+	                            size, stream->pos);
+	if (ret == -1) {
+		udo_log_set_error(stream, errno, "pwrite: %s", strerror(errno));
+		return -1;
+	}
+
+	if (size != stream->fill) {
+		ret = ftruncate(stream->fd, stream->pos + stream->fill);
+		if (ret == -1) {
+			udo_log_set_error(stream, errno, "ftruncate: %s", strerror(errno));
+			return -1;
 		}
-
-		flops->free = true;
 	}
 
-	if (file_info->fname) {
-		/* Check if file exist */
-		ret = stat(file_info->fname, &fstats);
-		memccpy(flops->full_path, file_info->fname, '\n', UDO_FILE_PATH_MAX);
-		length = strnlen(flops->full_path, UDO_FILE_PATH_MAX);
+	p_file_ops_stream_dontneed(stream, stream->pos, stream->fill);
 
-		if (file_info->create_dir)
-			p_create_directories(flops->full_path, length);
+	size = (stream->direct) ? stream->fill % UDO_PAGE_SIZE : 0;
+	memmove(stream->bufs[stream->cur],
+	        (char*)stream->bufs[stream->cur] + stream->fill - size, size);
+	stream->pos += stream->fill - size;
+	stream->fill = size;
 
-		flops->fd = open(flops->full_path, O_CREAT|O_RDWR, 0644);
-		if (flops->fd == -1) {
-			udo_log_error("open: %s\n", strerror(errno));
-			udo_file_ops_destroy(flops, 0);
-			return NULL;
-		}
+	return 0;
+}
 
-		p_set_fname_off(flops, length);
 
-		/*
-		 * If file exists and caller defined file_info->size set to 0.
-		 * 	- Then set internal alloc_sz and data_sz to equal
-		 *        the size of the file.
-		 * 	- Else set internal alloc_sz to equal the caller
-		 *        defined size. Set data_sz to 0 as file doesn't
-		 *        exists. Thus, it can't have a data. So, size
-		 *        is 0.
-		 */
-		if (!ret && !(file_info->size)) {
-			flops->alloc_sz = flops->data_sz = fstats.st_size;
-		} else {
-			flops->data_sz = 0;
-			flops->alloc_sz = file_info->size;
-		}
+void
+udo_file_ops_stream_destroy (struct udo_file_ops_stream *stream)
+{
+	if (!stream)
+		return;
 
-		flops->alloc_sz = UDO_BYTE_ALIGN(flops->alloc_sz, UDO_PAGE_SIZE);
+	if (stream->thread) {
+		if (stream->write)
+			udo_file_ops_stream_flush(stream);
+
+		__atomic_store_n(&(stream->stop), 1, __ATOMIC_RELEASE);
+		p_file_ops_futex_wake(&(stream->states[0]), FILE_OPS_STREAM_PENDING);
+		p_file_ops_futex_wake(&(stream->states[1]), FILE_OPS_STREAM_PENDING);
+		pthread_join(stream->tid, NULL);
 	}
 
-	if (file_info->create_pipe) {
-		ret = pipe(flops->pipe_fds);
-		if (ret == -1) {
-			udo_log_error("pipe: %s\n", strerror(errno));
-			udo_file_ops_destroy(flops, 0);
-			return NULL;
-		}
-	} else {
-		if (!(flops->data_sz)) {
-			ret = ftruncate(flops->fd, flops->alloc_sz);
-			if (ret == -1) {
-				udo_log_error("%s\n", strerror(errno));
-				udo_file_ops_destroy(flops, 0);
-				return NULL;
-			}
-		}
+	if (stream->fd > 0)
+		close(stream->fd);
 
-		flops->data = mmap(NULL, flops->alloc_sz, \
-				   (file_info->protect) ? \
-				   PROT_READ : PROT_READ|PROT_WRITE, \
-				   MAP_SHARED, flops->fd, file_info->offset);
-		if (flops->data == (void*)-1 && flops->alloc_sz) {
-			udo_log_error("mmap: %s\n", strerror(errno));
-			udo_file_ops_destroy(flops, 0);
-			return NULL;
-		}
+	free(stream->bufs[0]);
+
+	if (stream->free) {
+		free(stream);
+	} else {
+		memset(stream, 0, sizeof(struct udo_file_ops_stream));
 	}
+}
 
-	return flops;
+
+int
+udo_file_ops_stream_get_sizeof (void)
+{
+	return sizeof(struct udo_file_ops_stream);
 }
 
 /****************************************
- * End of udo_file_ops_create functions *
+ * End of udo_file_ops_stream functions *
  ****************************************/
 
 
-/*********************************************
- * Start of udo_file_ops_zero_copy functions *
- *********************************************/
+/***************************************
+ * Start of udo_file_ops_get functions *
+ ***************************************/
 
-ssize_t
-udo_file_ops_zero_copy (struct udo_file_ops *flops,
-                        const void *p_file_info)
+static int
+p_file_ops_push_line (struct udo_file_ops *flops,
+                      const size_t offset)
 {
-	ssize_t ret;
+	size_t cap;
+	size_t *lines = NULL;
+
+	if (flops->line_cnt == flops->line_cap) {
+		cap = UDO_MAX(flops->line_cap * FILE_OPS_GROWTH_FACTOR, \
+		              FILE_OPS_LINE_INDEX_MIN);
+		lines = realloc(flops->lines, cap * sizeof(size_t));
+		if (!lines) {
+			udo_log_set_error(flops, errno, "realloc: %s", strerror(errno));
+			return -1;
+		}
 
-	const struct udo_file_ops_zero_copy_info *file_info = p_file_info;
+		flops->lines = lines;
+		flops->line_cap = cap;
+	}
 
-	if (!flops)
-		return -1;
+	flops->lines[flops->line_cnt++] = offset;
 
-	if (!file_info || \
-	    file_info->size == 0)
+	return 0;
+}
+
+
+/*
+ * Extends line index to cover data appended since
+ * the last call. Index is built on first access.
+ */
+static int
+p_file_ops_index_lines (struct udo_file_ops *flops)
+{
+	const char *data, *end, *nl;
+
+	if (!(flops->line_cnt) && \
+	    p_file_ops_push_line(flops, 0) == -1)
 	{
-		udo_log_set_error(flops, UDO_LOG_ERR_INCORRECT_DATA, "");
 		return -1;
 	}
 
-	ret = splice(file_info->in_fd,
-		     file_info->in_off,
-		     flops->pipe_fds[1], 0,
-		     UDO_MIN(file_info->size, PIPE_MAX_BUFF_SIZE),
-		     SPLICE_F_MOVE|SPLICE_F_MORE);
-	if (ret == 0) {
-		return 0;
-	} else if (ret == -1) {
-		udo_log_set_error(flops, errno, "splice: %s", strerror(errno));
-		return -1;
-	}
+	data = (const char *) flops->data;
+	end = data + flops->data_sz;
+	nl = data + flops->line_scan;
+	while ((nl = memchr(nl, '\n', end - nl))) {
+		if (p_file_ops_push_line(flops, (nl - data) + 1) == -1) {
+			flops->line_scan = nl - data;
+			return -1;
+		}
 
-	ret = splice(flops->pipe_fds[0], 0,
-		     file_info->out_fd,
-		     file_info->out_off,
-		     UDO_MIN(file_info->size, PIPE_MAX_BUFF_SIZE),
-		     SPLICE_F_MOVE|SPLICE_F_MORE);
-	if (ret == -1) {
-		udo_log_set_error(flops, errno, "splice: %s", strerror(errno));
-		return -1;
+		nl++;
 	}
 
-	return ret;
-}
-
-/*******************************************
- * End of udo_file_ops_zero_copy functions *
- *******************************************/
+	flops->line_scan = flops->data_sz;
 
+	return 0;
+}
 
-/***************************************
- * Start of udo_file_ops_get functions *
- ***************************************/
 
 const void *
 udo_file_ops_get_data (struct udo_file_ops *flops,
@@ -293,7 +2202,9 @@ const char *
 udo_file_ops_get_line (struct udo_file_ops *flops,
                        const size_t p_line)
 {
-	size_t offset, c, line = 0;
+	size_t line;
+
+	const char *data, *end, *nl;
 
 	if (!flops)
 		return NULL;
@@ -305,28 +2216,33 @@ udo_file_ops_get_line (struct udo_file_ops *flops,
 		return NULL;
 	}
 
-	for (offset = 0, c = 0; offset < flops->data_sz; offset++,c++) {
-		if (*(((char*)flops->data)+offset) == '\n') {
-			line++;
+	if (flops->line_index) {
+		if (p_file_ops_index_lines(flops) == -1)
+			return NULL;
 
-			if (line == p_line) {
-				break;
-			} else {
-				c = 0;
-			}
-		}
+		/* Like the scan below lines past the end give data after the last newline */
+		line = UDO_MIN(p_line, flops->line_cnt);
+		return ((char*)flops->data)+flops->lines[line-1];
+	}
+
+	/* Hop from newline to newline with libc's vectorized memchr(3) */
+	data = (const char *) flops->data;
+	end = data + flops->data_sz;
+	for (line = 1; line < p_line; line++) {
+		nl = memchr(data, '\n', end - data);
+		if (!nl)
+			break;
+
+		data = nl + 1;
 	}
 
-	c -= (p_line == 1) ? 0 : 1;
-	return ((char*)flops->data)+(offset-c);
+	return data;
 }
 
 
 size_t
 udo_file_ops_get_line_count (struct udo_file_ops *flops)
 {
-	size_t offset, line = 0;
-
 	if (!flops)
 		return -1;
 
@@ -336,11 +2252,15 @@ udo_file_ops_get_line_count (struct udo_file_ops *flops)
 		return -1;
 	}
 
-	for (offset = 0; offset < flops->data_sz; offset++)
-		if (*((char*)flops->data + offset) == '\n')
-			line++;
+	if (flops->line_index) {
+		if (p_file_ops_index_lines(flops) == -1)
+			return -1;
+
+		/* First entry is the start of the file */
+		return flops->line_cnt - 1;
+	}
 
-	return line;
+	return p_file_ops_count_byte(flops->data, flops->data_sz, '\n');
 }
 
 
@@ -439,6 +2359,30 @@ udo_file_ops_reset_full_path (struct udo_file_ops *flops)
  * Start of udo_file_ops_destroy functions *
  *******************************************/
 
+static void
+p_file_ops_map_put (struct udo_file_ops *flops)
+{
+	struct udo_file_ops_map *map = flops->map, **entry;
+
+	pthread_mutex_lock(&map_cache_lock);
+
+	if (--map->refs) {
+		pthread_mutex_unlock(&map_cache_lock);
+		return;
+	}
+
+	entry = p_file_ops_map_bucket(map->dev, map->ino);
+	while (*entry != map)
+		entry = &((*entry)->next);
+	*entry = map->next;
+
+	pthread_mutex_unlock(&map_cache_lock);
+
+	munmap(map->data, map->size);
+	free(map);
+}
+
+
 void
 udo_file_ops_destroy (struct udo_file_ops *flops,
                       const size_t data_sz)
@@ -446,14 +2390,28 @@ udo_file_ops_destroy (struct udo_file_ops *flops,
 	if (!flops)
 		return;
 
-	munmap(flops->data, flops->alloc_sz);
+	if (flops->flusher) {
+		__atomic_store_n(&(flops->flush_stop), 1, __ATOMIC_SEQ_CST);
+		p_file_ops_futex_wake(&(flops->flush_req), FILE_OPS_FLUSH_PENDING);
+		pthread_join(flops->flush_tid, NULL);
+	}
+
+	if (flops->map) {
+		p_file_ops_map_put(flops);
+	} else {
+		munmap(flops->data, flops->alloc_sz);
+	}
 
-	if (data_sz)
+	if (data_sz) {
 		(void)!ftruncate(flops->fd, data_sz);
+	} else if (flops->appended) {
+		(void)!ftruncate(flops->fd, flops->offset + flops->data_sz);
+	}
 
 	close(flops->pipe_fds[0]);
 	close(flops->pipe_fds[1]);
 	close(flops->fd);
+	free(flops->lines);
 
 	if (flops->free) {
 		free(flops);
@@ -500,52 +2458,297 @@ udo_file_ops_set_fd_flags (const int fd, const int flags)
 }
 
 
-int
-udo_file_ops_remove_dir (const char *dir)
+static struct udo_file_ops_walk_dir *
+p_file_ops_walk_dir_alloc (struct udo_file_ops_walk *walk,
+                           struct udo_file_ops_walk_dir *parent,
+                           const char *name)
+{
+	size_t len;
+	struct udo_file_ops_walk_dir *wdir;
+
+	len = strlen(name);
+	wdir = calloc(1, sizeof(struct udo_file_ops_walk_dir) + len + 1);
+	if (!wdir)
+		return NULL;
+
+	memcpy(wdir->name, name, len);
+	wdir->walk = walk;
+	wdir->parent = parent;
+	wdir->depth = (parent) ? parent->depth + 1 : 0;
+	wdir->fd = -1;
+
+	return wdir;
+}
+
+
+static int
+p_file_ops_walk_dir_read (struct udo_file_ops_walk_dir *wdir)
 {
+	int ret, fd;
+	uint8_t type;
+
 	DIR *d;
 	struct stat st;
 	struct dirent *de;
-	char path[UDO_FILE_PATH_MAX];
+	struct udo_file_ops_walk_dir *child;
+
+	const struct udo_file_ops_walk_info *info = wdir->walk->info;
 
-	d = opendir(dir);
+	wdir->fd = openat((wdir->parent) ? wdir->parent->fd : AT_FDCWD, wdir->name,
+	                  O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC);
+	if (wdir->fd == -1)
+		return errno;
+
+	/* closedir(3) closes the duplicate keeping @fd open for children */
+	fd = dup(wdir->fd);
+	if (fd == -1)
+		return errno;
+
+	d = fdopendir(fd);
 	if (!d) {
-		udo_log_error("opendir: %s\n", strerror(errno));
-		return -1;
+		close(fd);
+		return errno;
 	}
 
 	while ((de=readdir(d))) {
-		switch (UDO_STRTOU(de->d_name)) {
-			case 46: /* "." */
-			case 92: /* ".." */
+		if (de->d_name[0] == '.' && \
+		    (!de->d_name[1] || (de->d_name[1] == '.' && !de->d_name[2])))
+		{
+			continue;
+		}
+
+		type = de->d_type;
+		if (type == DT_UNKNOWN) {
+			if (fstatat(wdir->fd, de->d_name, &st, AT_SYMLINK_NOFOLLOW) == -1) {
+				wdir->err = (wdir->err) ? wdir->err : errno;
 				continue;
-			default:
-				break;
+			}
+
+			type = IFTODT(st.st_mode);
 		}
 
-		memset(path,0,sizeof(path));
-		snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
-		if (stat(path, &st) == -1) {
-			udo_log_error("stat: %s\n", strerror(errno));
+		ret = (info->entry) ? \
+			info->entry(info->arg, wdir->fd, de->d_name, type, wdir->depth + 1) : 0;
+		if (ret == -1) {
+			wdir->err = (wdir->err) ? wdir->err : errno;
 			continue;
 		}
 
-		if (S_ISDIR(st.st_mode)) {
-			udo_file_ops_remove_dir(path);
-		} else {
-			/* Remove file */
-			remove(path);
+		if (ret || type != DT_DIR)
+			continue;
+
+		child = p_file_ops_walk_dir_alloc(wdir->walk, wdir, de->d_name);
+		if (!child) {
+			wdir->err = (wdir->err) ? wdir->err : errno;
+			continue;
 		}
+
+		child->next = wdir->children;
+		wdir->children = child;
+		wdir->pending++;
 	}
 
 	closedir(d);
 
-	/* Remove the empty directory itself */
-	rmdir(dir);
+	return wdir->err;
+}
+
+
+/*
+ * Job reading a directory. May run in any thread.
+ * Results are handed back to the walking thread.
+ */
+static void
+p_file_ops_walk_dir_run (void *arg)
+{
+	struct udo_file_ops_walk_dir *wdir = arg;
+	struct udo_file_ops_walk *walk = wdir->walk;
+
+	wdir->err = p_file_ops_walk_dir_read(wdir);
+
+	pthread_mutex_lock(&(walk->lock));
+	wdir->next = walk->done;
+	walk->done = wdir;
+	pthread_cond_signal(&(walk->cond));
+	pthread_mutex_unlock(&(walk->lock));
+}
+
+
+/*
+ * Leaves directories whose children were all left. Walking
+ * up the tree until a directory with pending children.
+ */
+static int
+p_file_ops_walk_dir_leave (struct udo_file_ops_walk_dir *wdir,
+                           int err)
+{
+	struct udo_file_ops_walk_dir *parent;
+
+	const struct udo_file_ops_walk_info *info = wdir->walk->info;
+
+	while (wdir && !(wdir->pending)) {
+		parent = wdir->parent;
+
+		if (wdir->fd != -1)
+			close(wdir->fd);
+
+		if (info->leave && \
+		    info->leave(info->arg, (parent) ? parent->fd : AT_FDCWD,
+		                wdir->name, wdir->depth) == -1)
+		{
+			err = (err) ? err : errno;
+		}
+
+		free(wdir);
+
+		if (parent)
+			parent->pending--;
+		wdir = parent;
+	}
+
+	return err;
+}
+
+
+int
+udo_file_ops_walk (const char *dir,
+                   const void *p_walk_info)
+{
+	int err = 0;
+	uint32_t inflight = 0;
+
+	struct udo_file_ops_walk walk;
+	struct udo_file_ops_walk_dir *pending, *done, *wdir, *child;
+
+	const struct udo_file_ops_walk_info *walk_info = p_walk_info;
+
+	if (!dir || !walk_info) {
+		udo_log_error("Incorrect data passed\n");
+		return -1;
+	}
+
+	memset(&walk, 0, sizeof(walk));
+	walk.info = walk_info;
+	pthread_mutex_init(&(walk.lock), NULL);
+	pthread_cond_init(&(walk.cond), NULL);
+
+	pending = p_file_ops_walk_dir_alloc(&walk, NULL, dir);
+	if (!pending) {
+		udo_log_error("calloc: %s\n", strerror(errno));
+		return -1;
+	}
+
+	while (pending || inflight) {
+		while (pending && inflight < FILE_OPS_WALK_INFLIGHT_MAX) {
+			wdir = pending;
+			pending = pending->next;
+			inflight++;
+
+#ifdef UDO_JPOOL
+			if (walk_info->jpool && \
+			    udo_jpool_add_job(walk_info->jpool, p_file_ops_walk_dir_run, wdir) == 0)
+			{
+				continue;
+			}
+#endif
+
+			p_file_ops_walk_dir_run(wdir);
+		}
+
+		pthread_mutex_lock(&(walk.lock));
+		while (!(walk.done))
+			pthread_cond_wait(&(walk.cond), &(walk.lock));
+		done = walk.done;
+		walk.done = NULL;
+		pthread_mutex_unlock(&(walk.lock));
+
+		while (done) {
+			wdir = done;
+			done = done->next;
+			inflight--;
+
+			if (wdir->err) {
+				udo_log_error("%s: %s\n", wdir->name, strerror(wdir->err));
+				err = (err) ? err : wdir->err;
+			}
+
+			/* Stack children so that the tree is walked depth first */
+			while (wdir->children) {
+				child = wdir->children;
+				wdir->children = child->next;
+				child->next = pending;
+				pending = child;
+			}
+
+			err = p_file_ops_walk_dir_leave(wdir, err);
+		}
+	}
+
+	pthread_cond_destroy(&(walk.cond));
+	pthread_mutex_destroy(&(walk.lock));
+
+	if (err) {
+		errno = err;
+		return -1;
+	}
 
 	return 0;
 }
 
+
+static int
+p_file_ops_remove_entry (void UDO_UNUSED *arg,
+                         const int dirfd,
+                         const char *name,
+                         const uint8_t type,
+                         const uint32_t UDO_UNUSED depth)
+{
+	if (type == DT_DIR)
+		return 0;
+
+	return unlinkat(dirfd, name, 0);
+}
+
+
+static int
+p_file_ops_remove_leave (void UDO_UNUSED *arg,
+                         const int dirfd,
+                         const char *name,
+                         const uint32_t UDO_UNUSED depth)
+{
+	return unlinkat(dirfd, name, AT_REMOVEDIR);
+}
+
+
+int
+udo_file_ops_remove_dir (const char *dir)
+{
+	struct udo_file_ops_walk_info walk_info;
+
+	memset(&walk_info, 0, sizeof(walk_info));
+	walk_info.entry = p_file_ops_remove_entry;
+	walk_info.leave = p_file_ops_remove_leave;
+
+	return udo_file_ops_walk(dir, &walk_info);
+}
+
+
+#ifdef UDO_JPOOL
+int
+udo_file_ops_remove_dir_jpool (const char *dir,
+                               struct udo_jpool *jpool)
+{
+	struct udo_file_ops_walk_info walk_info;
+
+	memset(&walk_info, 0, sizeof(walk_info));
+	walk_info.entry = p_file_ops_remove_entry;
+	walk_info.leave = p_file_ops_remove_leave;
+	walk_info.jpool = jpool;
+
+	return udo_file_ops_walk(dir, &walk_info);
+}
+#endif
+
 /**************************************************
  * End of non struct udo_file_ops param functions *
  **************************************************/
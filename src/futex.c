@@ -38,11 +38,26 @@
 #define UDO_FUTEX_UNLOCK 0
 #define UDO_FUTEX_UNLOCK_FORCE 0x66AFB55C
 #define CONTENTION_LOOP_CNT 999999999
+#define FUTEX_WAITV_FALLBACK_NS 1000000
+
+/*
+ * Set once futex_waitv(2) is known to be
+ * unsupported by the running kernel.
+ */
+static uint8_t futex_waitv_unsupported = 0;
 
 /*****************************************
  * Start of global to C source functions *
  *****************************************/
 
+UDO_STATIC_INLINE
+uint32_t
+p_get_tid (void)
+{
+	return (uint32_t) syscall(SYS_gettid);
+}
+
+
 UDO_STATIC_INLINE
 int
 futex (void *uaddr,
@@ -56,6 +71,21 @@ futex (void *uaddr,
 	               timeout, uaddr2, val3);
 }
 
+
+#ifdef SYS_futex_waitv
+UDO_STATIC_INLINE
+int
+futex_waitv (struct futex_waitv *waiters,
+             unsigned int nr_futexes,
+             unsigned int flags,
+             struct timespec *timeout,
+             clockid_t clockid)
+{
+	return syscall(SYS_futex_waitv, waiters, nr_futexes,
+	               flags, timeout, clockid);
+}
+#endif
+
 /***************************************
  * End of global to C source functions *
  ***************************************/
@@ -65,8 +95,9 @@ futex (void *uaddr,
  * Start of udo_futex_create functions *
  ***************************************/
 
-udo_atomic_u32 *
-udo_futex_create (const void *p_futex_info)
+static udo_atomic_u32 *
+p_futex_create (const void *p_futex_info,
+                const uint32_t value)
 {
 	uint32_t f;
 
@@ -96,12 +127,27 @@ udo_futex_create (const void *p_futex_info)
 	for (f = 0; f < futex_info->count; f++) {
 		__atomic_store_n((udo_atomic_u32 *) \
 			((char*)fux+(f*sizeof(udo_atomic_u32))),
-			1, __ATOMIC_RELEASE);
+			value, __ATOMIC_RELEASE);
 	}
 
 	return fux;
 }
 
+
+udo_atomic_u32 *
+udo_futex_create (const void *futex_info)
+{
+	return p_futex_create(futex_info, UDO_FUTEX_LOCK);
+}
+
+
+udo_atomic_u32 *
+udo_futex_create_pi (const void *futex_info)
+{
+	/* PI futexes store owner TID, 0 means unlocked */
+	return p_futex_create(futex_info, UDO_FUTEX_UNLOCK);
+}
+
 /*************************************
  * End of udo_futex_create functions *
  *************************************/
@@ -158,6 +204,37 @@ udo_futex_lock (udo_atomic_u32 *fux)
 }
 
 
+void
+udo_futex_lock_pi (udo_atomic_u32 *fux)
+{
+	int ret;
+
+	uint32_t tid;
+
+	if (!fux)
+		return;
+
+	tid = p_get_tid();
+
+	/*
+	 * Don't spin on contention. Spinning is what
+	 * starves a lower priority owner. Let the
+	 * kernel boost the owner instead.
+	 */
+	if (__atomic_compare_exchange_n(fux, \
+		&(udo_atomic_u32){UDO_FUTEX_UNLOCK}, \
+		tid, 0, __ATOMIC_SEQ_CST, \
+		__ATOMIC_SEQ_CST))
+	{
+		return;
+	}
+
+	do {
+		ret = futex(fux, FUTEX_LOCK_PI, 0, NULL, NULL, 0);
+	} while (ret == -1 && errno == EAGAIN);
+}
+
+
 void
 udo_futex_wait (udo_atomic_u32 *fux,
                 const uint32_t desired)
@@ -192,6 +269,121 @@ udo_futex_wait (udo_atomic_u32 *fux,
 }
 
 
+/*
+ * Returns index of the first futex not storing its
+ * expected value, -1 if all match or -2 if a futex
+ * was force unlocked.
+ */
+static int
+p_futex_waitv_check (const struct udo_futex_waiter *waiters,
+                     const uint32_t count)
+{
+	uint32_t w, val;
+
+	for (w = 0; w < count; w++) {
+		val = __atomic_load_n(waiters[w].fux, __ATOMIC_ACQUIRE);
+		if (val == UDO_FUTEX_UNLOCK_FORCE) {
+			return -2;
+		} else if (val != waiters[w].val) {
+			return w;
+		}
+	}
+
+	return -1;
+}
+
+
+static int
+p_futex_waitv_fallback (const struct udo_futex_waiter *waiters,
+                        const uint32_t count)
+{
+	int ret;
+
+	uint32_t w;
+
+	struct timespec timeout = { .tv_sec = 0, .tv_nsec = FUTEX_WAITV_FALLBACK_NS };
+
+	for (w = 0;; w = (w + 1) % count) {
+		ret = p_futex_waitv_check(waiters, count);
+		if (ret != -1)
+			return ret;
+
+		/*
+		 * Single futex may sleep until woken. Multiple
+		 * futexes sleep on each in turn for a short time
+		 * so that changes to the others are noticed.
+		 */
+		ret = futex(waiters[w].fux, FUTEX_WAIT, waiters[w].val,
+		            (count == 1) ? NULL : &timeout, NULL, 0);
+		if (ret == 0)
+			return w;
+	}
+}
+
+
+int
+udo_futex_waitv (const struct udo_futex_waiter *waiters,
+                 const uint32_t count)
+{
+	int ret;
+
+#ifdef SYS_futex_waitv
+	uint32_t w;
+
+	struct futex_waitv fwaiters[UDO_FUTEX_WAITV_MAX];
+#endif
+
+	if (!waiters || !count || count > UDO_FUTEX_WAITV_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	while (1) {
+		ret = p_futex_waitv_check(waiters, count);
+		if (ret == -2) {
+			errno = EINTR;
+			return -1;
+		} else if (ret >= 0) {
+			return ret;
+		}
+
+#ifdef SYS_futex_waitv
+		if (__atomic_load_n(&futex_waitv_unsupported, __ATOMIC_RELAXED))
+			break;
+
+		for (w = 0; w < count; w++) {
+			fwaiters[w].val = waiters[w].val;
+			fwaiters[w].uaddr = (uintptr_t) waiters[w].fux;
+			fwaiters[w].flags = FUTEX_32;
+			fwaiters[w].__reserved = 0;
+		}
+
+		ret = futex_waitv(fwaiters, count, 0, NULL, CLOCK_MONOTONIC);
+		if (ret >= 0) {
+			return ret;
+		} else if (errno == ENOSYS) {
+			__atomic_store_n(&futex_waitv_unsupported, 1, __ATOMIC_RELAXED);
+			break;
+		} else if (errno != EAGAIN && errno != EINTR) {
+			return -1;
+		}
+
+		/* Value changed or signal caught. Recheck values. */
+#else
+		break;
+#endif
+	}
+
+	ret = p_futex_waitv_fallback(waiters, count);
+	if (ret == -2) {
+		errno = EINTR;
+		return -1;
+	}
+
+	return ret;
+}
+
+
 void
 p_udo_futex_wait_cond(udo_atomic_u32 *fux)
 {
@@ -219,6 +411,28 @@ udo_futex_unlock (udo_atomic_u32 *fux)
 }
 
 
+void
+udo_futex_unlock_pi (udo_atomic_u32 *fux)
+{
+	if (!fux)
+		return;
+
+	/*
+	 * If FUTEX_WAITERS bit is set compare exchange
+	 * fails and the kernel must select the next owner.
+	 */
+	if (__atomic_compare_exchange_n(fux, \
+		&(udo_atomic_u32){p_get_tid()}, \
+		UDO_FUTEX_UNLOCK, 0, __ATOMIC_SEQ_CST, \
+		__ATOMIC_SEQ_CST))
+	{
+		return;
+	}
+
+	futex(fux, FUTEX_UNLOCK_PI, 0, NULL, NULL, 0);
+}
+
+
 void
 udo_futex_unlock_force (udo_atomic_u32 *fux)
 {
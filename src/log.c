@@ -29,7 +29,12 @@
 #include <libgen.h>
 #include <stdint.h>
 #include <stdarg.h>
-#include <sys/file.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>  /* Definition of SYS_* constants */
+#include <linux/futex.h>  /* Definition of FUTEX_* constants */
 #define HAVE_POSIX_TIMER
 #include <time.h>
 #ifdef CLOCK_MONOTONIC
@@ -40,8 +45,84 @@
 
 #include "log.h"
 
+#define LOG_ASYNC_ENTRIES_DEFAULT (1<<10)
+#define LOG_ASYNC_ENTRIES_MAX (1<<20)
+#define LOG_ASYNC_SLOT_SIZE (1<<10)
+#define LOG_ASYNC_BATCH_MAX 64
+
+/* Records longer than this are formatted on the heap */
+#define LOG_RECORD_SIZE (1<<10)
+
+/*
+ * @brief Structure defining a message in the asynchronous log ring.
+ *
+ * @member seq  - Position in the ring slot may be claimed at. Set to
+ *                position + 1 once message is stored and to position
+ *                + ring size once message is written.
+ * @member len  - Length in bytes of @data.
+ * @member type - enum udo_log_level_type of message.
+ * @member data - Formatted message.
+ */
+struct udo_log_async_slot
+{
+	udo_atomic_u32 seq;
+	uint32_t       len;
+	uint32_t       type;
+	char           data[LOG_ASYNC_SLOT_SIZE-(sizeof(uint32_t)*3)];
+};
+
+
+/*
+ * @brief Structure defining the asynchronous log ring. Bounded
+ *        multi-producer queue where each slot carries a sequence
+ *        number. So, producers only contend on @tail.
+ *
+ * @member tail     - Position of the next slot producers claim.
+ * @member written  - Positions before are written to the open file.
+ * @member wake     - Futex background thread sleeps on.
+ * @member sleeping - Set while background thread is about to sleep.
+ * @member done     - Futex blocked producers and flushers sleep on.
+ * @member waiters  - Amount of threads sleeping on @done.
+ * @member dropped  - Amount of messages discarded.
+ * @member reported - Amount of discarded messages already logged.
+ * @member stop     - Set to stop background thread.
+ * @member mask     - Amount of slots - 1.
+ * @member overflow - enum udo_log_overflow_type.
+ * @member tid      - Background thread writing messages.
+ * @member slots    - Ring of messages.
+ */
+struct udo_log_async
+{
+	udo_atomic_u32            tail __attribute__((aligned(UDO_CACHE_LINE_SIZE)));
+	udo_atomic_u32            written __attribute__((aligned(UDO_CACHE_LINE_SIZE)));
+	udo_atomic_u32            wake;
+	udo_atomic_u32            sleeping;
+	udo_atomic_u32            done;
+	udo_atomic_u32            waiters;
+	udo_atomic_u32            dropped;
+	uint32_t                  reported;
+	udo_atomic_u32            stop;
+	uint32_t                  mask;
+	uint8_t                   overflow;
+	pthread_t                 tid;
+	struct udo_log_async_slot *slots;
+};
+
 static int writefd = STDOUT_FILENO;
 static enum udo_log_level_type log_level = UDO_LOG_NONE;
+static struct udo_log_async *async = NULL;
+
+/*
+ * Amount of threads using the ring @async pointed to. Ring
+ * is only freed once every thread that loaded it left.
+ */
+static udo_atomic_u32 async_refs = 0;
+static udo_atomic_u32 async_stopping = 0;
+
+static enum udo_log_sync_type sync_type = UDO_LOG_SYNC_NEVER;
+static uint32_t sync_value = 0;
+static udo_atomic_u32 sync_lines = 0;
+static uint64_t sync_last = 0;
 
 /* ANSI Escape Codes, terminal colors */
 static const char *tcolors[] =
@@ -70,6 +151,381 @@ p_get_error (const uint32_t code)
 }
 
 
+UDO_STATIC_INLINE
+void
+p_log_futex_wait (udo_atomic_u32 *fux,
+                  const uint32_t val)
+{
+	syscall(SYS_futex, fux, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+
+UDO_STATIC_INLINE
+void
+p_log_futex_wake (udo_atomic_u32 *fux)
+{
+	__atomic_add_fetch(fux, 1, __ATOMIC_SEQ_CST);
+	syscall(SYS_futex, fux, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+
+static void
+p_log_async_put (void)
+{
+	if (!__atomic_sub_fetch(&async_refs, 1, __ATOMIC_SEQ_CST) && \
+	    __atomic_load_n(&async_stopping, __ATOMIC_SEQ_CST))
+	{
+		syscall(SYS_futex, &async_refs, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+	}
+}
+
+
+/*
+ * Takes a reference to the asynchronous log ring. Returns
+ * NULL if asynchronous mode is off. Reference is taken
+ * before loading @async. So, udo_log_async_stop(3) either
+ * sees the reference or this thread sees NULL.
+ */
+static struct udo_log_async *
+p_log_async_get (void)
+{
+	struct udo_log_async *ring = NULL;
+
+	/* Synchronous mode doesn't touch the shared count */
+	if (!__atomic_load_n(&async, __ATOMIC_RELAXED))
+		return NULL;
+
+	__atomic_add_fetch(&async_refs, 1, __ATOMIC_SEQ_CST);
+	ring = __atomic_load_n(&async, __ATOMIC_SEQ_CST);
+	if (!ring)
+		p_log_async_put();
+
+	return ring;
+}
+
+
+/*
+ * Formats a whole record with an optional time stamp and
+ * terminal colors reset at the end. Returns length of
+ * record stored in @buf. If @need is set it's assigned
+ * the size @buf must be for the record to fit. Records
+ * that don't fit are truncated and end in a newline.
+ */
+static uint32_t
+p_log_format (char *buf,
+              const uint32_t size,
+              const char *prefix,
+              const uint8_t stamp,
+              const char *fmt,
+              va_list args,
+              size_t *need)
+{
+	int ret;
+	size_t plen;
+	time_t rawtime;
+	uint32_t len = 0, reset_len, avail;
+
+	const char *reset = tcolors[UDO_LOG_RESET];
+
+	reset_len = strlen(reset);
+
+	if (stamp) {
+		rawtime = time(NULL);
+		len = strftime(buf, size, "%F %T ", \
+			localtime_r(&rawtime, &(struct tm){}));
+	}
+
+	plen = UDO_MIN(strlen(prefix), (size_t) (size-len-reset_len-1));
+	memcpy(buf+len, prefix, plen);
+	len += plen;
+
+	avail = size - len - reset_len;
+	ret = vsnprintf(buf+len, avail, fmt, args);
+	if (need)
+		*need = len + ((ret > 0) ? ret : 0) + reset_len + 1;
+
+	if (ret > 0 && (uint32_t) ret >= avail) {
+		len += avail - 1;
+		buf[len-1] = '\n';
+	} else if (ret > 0) {
+		len += ret;
+	}
+
+	memcpy(buf+len, reset, reset_len);
+
+	return len + reset_len;
+}
+
+
+UDO_STATIC_INLINE
+uint64_t
+p_log_now_ms (void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCKID, &now);
+
+	return ((uint64_t) now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+
+/*
+ * Called after @lines records were written. Flushes
+ * the open file to disk if the sync policy says so.
+ */
+static void
+p_log_sync (const uint32_t type,
+            const uint32_t lines)
+{
+	uint64_t now, last;
+
+	switch (sync_type) {
+		case UDO_LOG_SYNC_LINES:
+			if (__atomic_add_fetch(&sync_lines, lines, __ATOMIC_RELAXED) < sync_value)
+				return;
+			__atomic_store_n(&sync_lines, 0, __ATOMIC_RELAXED);
+			break;
+		case UDO_LOG_SYNC_ERROR:
+			if (!(type & UDO_LOG_ERROR))
+				return;
+			break;
+		case UDO_LOG_SYNC_INTERVAL:
+			now = p_log_now_ms();
+			last = __atomic_load_n(&sync_last, __ATOMIC_RELAXED);
+			if (now - last < sync_value || \
+			    !__atomic_compare_exchange_n(&sync_last, &last, now, 0, \
+			                                 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				return;
+			}
+			break;
+		default:
+			return;
+	}
+
+	fdatasync(writefd);
+}
+
+
+static ssize_t
+p_log_writev (struct iovec *iov,
+              int count)
+{
+	ssize_t ret, total = 0;
+
+	while (count) {
+		ret = writev(writefd, iov, count);
+		if (ret == -1 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+
+		total += ret;
+		for (; count && (size_t) ret >= iov->iov_len; iov++, count--)
+			ret -= iov->iov_len;
+
+		if (count) {
+			iov->iov_base = (char*)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+
+	return total;
+}
+
+
+/*
+ * Formats a record and writes it to the open
+ * file with a single write(2).
+ */
+static void
+p_log_write (const uint32_t type,
+             const char *prefix,
+             const uint8_t stamp,
+             const char *fmt,
+             va_list args)
+{
+	size_t need;
+	va_list copy;
+
+	char buf[LOG_RECORD_SIZE];
+
+	struct iovec iov;
+
+	va_copy(copy, args);
+	iov.iov_base = buf;
+	iov.iov_len = p_log_format(buf, sizeof(buf), prefix, stamp, fmt, args, &need);
+
+	if (need > sizeof(buf)) {
+		iov.iov_base = malloc(need);
+		if (iov.iov_base) {
+			iov.iov_len = p_log_format(iov.iov_base, need, prefix, stamp, fmt, copy, NULL);
+		} else {
+			iov.iov_base = buf;
+		}
+	}
+
+	va_end(copy);
+
+	p_log_writev(&iov, 1);
+	if (iov.iov_base != buf)
+		free(iov.iov_base);
+
+	p_log_sync(type, 1);
+}
+
+
+/*
+ * Claims a slot in the ring. Returns NULL if the
+ * ring is full and messages are discarded.
+ */
+static struct udo_log_async_slot *
+p_log_async_claim (struct udo_log_async *ring,
+                   uint32_t *p_pos)
+{
+	int32_t diff;
+	uint32_t pos, done;
+
+	struct udo_log_async_slot *slot = NULL;
+
+	pos = __atomic_load_n(&(ring->tail), __ATOMIC_RELAXED);
+	while (1) {
+		slot = &(ring->slots[pos & ring->mask]);
+		diff = (int32_t) (__atomic_load_n(&(slot->seq), __ATOMIC_ACQUIRE) - pos);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&(ring->tail), &pos, pos+1, 1, \
+			                                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				*p_pos = pos;
+				return slot;
+			}
+		} else if (diff > 0) {
+			pos = __atomic_load_n(&(ring->tail), __ATOMIC_RELAXED);
+		} else if (ring->overflow == UDO_LOG_OVERFLOW_BLOCK) {
+			/* Ring is full. Wait for background thread to write a batch */
+			__atomic_add_fetch(&(ring->waiters), 1, __ATOMIC_SEQ_CST);
+			done = __atomic_load_n(&(ring->done), __ATOMIC_SEQ_CST);
+			if ((int32_t) (__atomic_load_n(&(slot->seq), __ATOMIC_SEQ_CST) - pos) < 0)
+				p_log_futex_wait(&(ring->done), done);
+			__atomic_sub_fetch(&(ring->waiters), 1, __ATOMIC_SEQ_CST);
+			pos = __atomic_load_n(&(ring->tail), __ATOMIC_RELAXED);
+		} else {
+			if (ring->overflow == UDO_LOG_OVERFLOW_COUNT)
+				__atomic_add_fetch(&(ring->dropped), 1, __ATOMIC_RELAXED);
+			return NULL;
+		}
+	}
+}
+
+
+static void
+p_log_async_push (struct udo_log_async *ring,
+                  const uint32_t type,
+                  const char *prefix,
+                  const uint8_t stamp,
+                  const char *fmt,
+                  va_list args)
+{
+	uint32_t pos = 0;
+
+	struct udo_log_async_slot *slot = NULL;
+
+	slot = p_log_async_claim(ring, &pos);
+	if (!slot)
+		return;
+
+	slot->type = type;
+	slot->len = p_log_format(slot->data, sizeof(slot->data), prefix, stamp, fmt, args, NULL);
+	__atomic_store_n(&(slot->seq), pos+1, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&(ring->sleeping), __ATOMIC_SEQ_CST))
+		p_log_futex_wake(&(ring->wake));
+}
+
+
+static void
+p_log_async_dropped (struct udo_log_async *ring)
+{
+	int len;
+	uint32_t dropped;
+
+	char buf[64];
+
+	struct iovec iov;
+
+	dropped = __atomic_load_n(&(ring->dropped), __ATOMIC_RELAXED);
+	if (dropped == ring->reported)
+		return;
+
+	len = snprintf(buf, sizeof(buf), "%u log messages dropped\n", dropped - ring->reported);
+	iov.iov_base = buf;
+	iov.iov_len = len;
+	p_log_writev(&iov, 1);
+
+	ring->reported = dropped;
+}
+
+
+static void *
+p_log_async_writer (void *arg)
+{
+	int count;
+	uint32_t head, wake, type;
+
+	struct iovec iov[LOG_ASYNC_BATCH_MAX];
+
+	struct udo_log_async *ring = arg;
+	struct udo_log_async_slot *slot = NULL;
+
+	head = 0;
+	while (1) {
+		for (type = 0, count = 0; count < LOG_ASYNC_BATCH_MAX; count++) {
+			slot = &(ring->slots[(head + count) & ring->mask]);
+			if (__atomic_load_n(&(slot->seq), __ATOMIC_ACQUIRE) != head + count + 1)
+				break;
+
+			iov[count].iov_base = slot->data;
+			iov[count].iov_len = slot->len;
+			type |= slot->type;
+		}
+
+		if (count) {
+			p_log_writev(iov, count);
+			p_log_sync(type, count);
+
+			for (wake = 0; wake < (uint32_t) count; wake++) {
+				slot = &(ring->slots[(head + wake) & ring->mask]);
+				__atomic_store_n(&(slot->seq), head + wake + ring->mask + 1, __ATOMIC_SEQ_CST);
+			}
+
+			head += count;
+			__atomic_store_n(&(ring->written), head, __ATOMIC_SEQ_CST);
+			if (__atomic_load_n(&(ring->waiters), __ATOMIC_SEQ_CST))
+				p_log_futex_wake(&(ring->done));
+
+			continue;
+		}
+
+		p_log_async_dropped(ring);
+
+		if (__atomic_load_n(&(ring->stop), __ATOMIC_ACQUIRE))
+			break;
+
+		/* Sleep until a producer stores a message */
+		wake = __atomic_load_n(&(ring->wake), __ATOMIC_SEQ_CST);
+		__atomic_store_n(&(ring->sleeping), 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&(slot->seq), __ATOMIC_SEQ_CST) != head + 1 && \
+		    !__atomic_load_n(&(ring->stop), __ATOMIC_SEQ_CST))
+		{
+			p_log_futex_wait(&(ring->wake), wake);
+		}
+		__atomic_store_n(&(ring->sleeping), 0, __ATOMIC_SEQ_CST);
+	}
+
+	return NULL;
+}
+
+
 void
 udo_log_set_level (enum udo_log_level_type level)
 {
@@ -161,30 +617,23 @@ udo_log_time (enum udo_log_level_type type,
               ...)
 {
 	va_list args;
-	time_t rawtime;
 
-	char buffer[26];
+	struct udo_log_async *ring = NULL;
 
 	if (!(type & log_level))
 		return;
 
-	/* create message time stamp */
-	rawtime = time(NULL);
+	va_start(args, fmt);
 
-	/* generate time */
-	strftime(buffer, sizeof(buffer), "%F %T ", \
-		localtime_r(&rawtime, &(struct tm){}));
-	flock(writefd, LOCK_EX);
-	dprintf(writefd, "%s", buffer);
+	ring = p_log_async_get();
+	if (ring) {
+		p_log_async_push(ring, type, "", 1, fmt, args);
+		p_log_async_put();
+	} else {
+		p_log_write(type, "", 1, fmt, args);
+	}
 
-	va_start(args, fmt);
-	vdprintf(writefd, fmt, args);
 	va_end(args);
-
-	/* Reset terminal colors */
-	dprintf(writefd, "%s", tcolors[UDO_LOG_RESET]);
-	fsync(writefd);
-	flock(writefd, LOCK_UN);
 }
 
 
@@ -195,19 +644,174 @@ udo_log_notime (enum udo_log_level_type type,
 {
 	va_list args;
 
+	struct udo_log_async *ring = NULL;
+
 	if (!(type & log_level))
 		return;
 
-	/* Set terminal color */
-	dprintf(writefd, "%s", tcolors[type]);
-
 	va_start(args, fmt);
-	vdprintf(writefd, fmt, args);
+
+	ring = p_log_async_get();
+	if (ring) {
+		p_log_async_push(ring, type, tcolors[type], 0, fmt, args);
+		p_log_async_put();
+	} else {
+		p_log_write(type, tcolors[type], 0, fmt, args);
+	}
+
 	va_end(args);
+}
+
+
+int
+udo_log_set_sync (const enum udo_log_sync_type type,
+                  const uint32_t value)
+{
+	if (type > UDO_LOG_SYNC_INTERVAL || \
+	    ((type == UDO_LOG_SYNC_LINES || type == UDO_LOG_SYNC_INTERVAL) && !value))
+	{
+		return -1;
+	}
+
+	sync_type = type;
+	sync_value = value;
+	__atomic_store_n(&sync_lines, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&sync_last, p_log_now_ms(), __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+
+int
+udo_log_async_start (const struct udo_log_async_info *async_info)
+{
+	int ret = -1;
+	uint32_t i, entries;
+
+	struct udo_log_async *ring = NULL;
+
+	if (!async_info || \
+	    async_info->entries > LOG_ASYNC_ENTRIES_MAX || \
+	    async_info->overflow > UDO_LOG_OVERFLOW_BLOCK)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (__atomic_load_n(&async, __ATOMIC_ACQUIRE)) {
+		errno = EALREADY;
+		return -1;
+	}
+
+	entries = (async_info->entries) ? async_info->entries : LOG_ASYNC_ENTRIES_DEFAULT;
+	for (i = 1; i < entries; i <<= 1);
+	entries = i;
+
+	ring = aligned_alloc(UDO_CACHE_LINE_SIZE, UDO_BYTE_ALIGN(sizeof(struct udo_log_async), UDO_CACHE_LINE_SIZE));
+	if (!ring)
+		return -1;
+
+	memset(ring, 0, sizeof(struct udo_log_async));
+	ring->mask = entries - 1;
+	ring->overflow = async_info->overflow;
+
+	ring->slots = aligned_alloc(UDO_CACHE_LINE_SIZE, entries * sizeof(struct udo_log_async_slot));
+	if (!(ring->slots)) {
+		free(ring);
+		return -1;
+	}
+
+	for (i = 0; i < entries; i++)
+		__atomic_store_n(&(ring->slots[i].seq), i, __ATOMIC_RELAXED);
+
+	ret = pthread_create(&(ring->tid), NULL, p_log_async_writer, ring);
+	if (ret) {
+		free(ring->slots);
+		free(ring);
+		errno = ret;
+		return -1;
+	}
+
+	__atomic_store_n(&async, ring, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+
+int
+udo_log_flush (void)
+{
+	uint32_t pos, done;
+
+	struct udo_log_async *ring = NULL;
+
+	ring = p_log_async_get();
+	if (!ring)
+		return 0;
+
+	pos = __atomic_load_n(&(ring->tail), __ATOMIC_SEQ_CST);
+
+	__atomic_add_fetch(&(ring->waiters), 1, __ATOMIC_SEQ_CST);
+	while (1) {
+		done = __atomic_load_n(&(ring->done), __ATOMIC_SEQ_CST);
+		if ((int32_t) (__atomic_load_n(&(ring->written), __ATOMIC_SEQ_CST) - pos) >= 0)
+			break;
+
+		p_log_futex_wait(&(ring->done), done);
+	}
+	__atomic_sub_fetch(&(ring->waiters), 1, __ATOMIC_SEQ_CST);
+
+	p_log_async_put();
+
+	return 0;
+}
+
+
+void
+udo_log_async_stop (void)
+{
+	uint32_t refs;
+
+	struct udo_log_async *ring = NULL;
+
+	ring = __atomic_exchange_n(&async, NULL, __ATOMIC_SEQ_CST);
+	if (!ring)
+		return;
+
+	/*
+	 * New messages are written synchronously. Threads still
+	 * pushing, blocked on a full ring or flushing finish while
+	 * the background thread keeps writing.
+	 */
+	__atomic_add_fetch(&async_stopping, 1, __ATOMIC_SEQ_CST);
+	while ((refs = __atomic_load_n(&async_refs, __ATOMIC_SEQ_CST)))
+		syscall(SYS_futex, &async_refs, FUTEX_WAIT_PRIVATE, refs, NULL, NULL, 0);
+	__atomic_sub_fetch(&async_stopping, 1, __ATOMIC_SEQ_CST);
+
+	__atomic_store_n(&(ring->stop), 1, __ATOMIC_SEQ_CST);
+	p_log_futex_wake(&(ring->wake));
+	pthread_join(ring->tid, NULL);
+
+	free(ring->slots);
+	free(ring);
+}
+
+
+uint32_t
+udo_log_get_dropped (void)
+{
+	uint32_t dropped;
+
+	struct udo_log_async *ring = NULL;
+
+	ring = p_log_async_get();
+	if (!ring)
+		return 0;
+
+	dropped = __atomic_load_n(&(ring->dropped), __ATOMIC_RELAXED);
+	p_log_async_put();
 
-	/* Reset terminal colors */
-	dprintf(writefd, "%s", tcolors[UDO_LOG_RESET]);
-	fsync(writefd);
+	return dropped;
 }
 
 
@@ -22,345 +22,2984 @@
  * SOFTWARE.
  */
 
+#define _GNU_SOURCE 1
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <limits.h>
+#include <linux/futex.h>  /* Definition of FUTEX_* constants */
+#include <sys/syscall.h>  /* Definition of SYS_* constants */
 
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/eventfd.h>
 #include <fcntl.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "log.h"
 #include "futex.h"
 #include "shm.h"
 
 /*
- * Maximum amount of processes
- * allowed to watch shared memory.
+ * Maximum amount of processes
+ * allowed to watch shared memory.
+ */
+#define SHM_PROC_MAX (1<<12)
+#define SHM_FILE_NAME_MAX (1<<5)
+
+/*
+ * Header initialization states. Only the first
+ * process to attach initializes the directory.
+ */
+#define SHM_HDR_UNINIT 0
+#define SHM_HDR_INIT 1
+#define SHM_HDR_READY 2
+
+/*
+ * What shared memory file descriptor refers to. Decides
+ * how shared memory is removed once every process detaches.
+ */
+#define SHM_BACKING_POSIX 0
+#define SHM_BACKING_HUGETLBFS 1
+#define SHM_BACKING_MEMFD 2
+#define SHM_BACKING_FD 3
+
+/*
+ * Mount point files are created in when huge pages
+ * are requested without memfd_create(2).
+ */
+#define SHM_HUGETLBFS_DIR "/dev/hugepages"
+
+/*
+ * Shared memory is mapped inside a reserved address range
+ * so that growing it never moves the mapping. Limits the
+ * total size shared memory may grow to.
+ */
+#if UINTPTR_MAX > UINT32_MAX
+#define SHM_MAP_MAX ((size_t)1 << 40)
+#else
+#define SHM_MAP_MAX ((size_t)1 << 30)
+#endif
+
+/*
+ * Segment gate. Low bits count accesses in progress,
+ * high bit is set while udo_shm_grow(3) moves the segment.
+ */
+#define SHM_GATE_MOVING (1U << 31)
+
+/*
+ * How a segment was last accessed. Decides how
+ * udo_shm_grow(3) copies it to its new location.
+ */
+#define SHM_MODE_DATA 0
+#define SHM_MODE_RING 1
+#define SHM_MODE_BCAST 2
+#define SHM_MODE_LATEST 3
+#define SHM_MODE_MM 4
+
+#define UDO_FUTEX_LOCK 1
+#define UDO_FUTEX_UNLOCK 0
+
+/*
+ * Ring records start with an 8 byte header storing
+ * the record size. Records are padded to 8 bytes.
+ * A header storing SHM_RING_WRAP informs consumers
+ * that the next record starts at the front of the ring.
+ */
+#define SHM_RING_HDR_SIZE sizeof(uint64_t)
+#define SHM_RING_WRAP UINT32_MAX
+#define SHM_RING_SPIN_CNT (1<<10)
+
+/*
+ * Maximum amount of subscribers reading
+ * a processes broadcast segment.
+ */
+#define SHM_BCAST_READER_MAX (1<<4)
+#define SHM_BCAST_READER_FREE 0
+#define SHM_BCAST_READER_ACTIVE 1
+#define SHM_BCAST_READER_JOINING 2
+
+/*
+ * Allocator blocks are power of two sized starting at
+ * 1 << SHM_MM_CLASS_SHIFT bytes and include a block header.
+ * Free lists link blocks by their offset divided by
+ * SHM_MM_ALIGN so that a free list head stores a 32-bit
+ * block index and a 32-bit ABA tag in a single word.
+ */
+#define SHM_MM_ALIGN (1<<4)
+#define SHM_MM_CLASS_SHIFT 4
+#define SHM_MM_CLASS_MAX 28
+#define SHM_MM_HEAP_MAX ((uint64_t)UINT32_MAX * SHM_MM_ALIGN)
+#define SHM_MM_BLK_USED 0x75646f55
+#define SHM_MM_BLK_FREE 0x75646f46
+
+/*
+ * @brief Structure defining a directory entry stored in the
+ *        shared memory header. One entry per process. Entries
+ *        are padded to a cache line so that futex and gate
+ *        writes to one segment never invalidate a neighbours.
+ *
+ * @member rd_fux - Given process read futex.
+ * @member wr_fux - Given process write futex.
+ * @member gate   - Amount of accesses to the segment in progress.
+ *                  SHM_GATE_MOVING is set while segment is moved.
+ *                  Only used if shared memory is growable.
+ * @member gen    - Generation counter incremented each time the
+ *                  segment is moved. Peers remap on change.
+ * @member mode   - SHM_MODE_{DATA,RING,BCAST,LATEST,MM}.
+ * @member pad    - Keeps @off 8 byte aligned.
+ * @member off    - Byte offset of the processes segment from
+ *                  the start of shared memory.
+ * @member size   - Byte size of the processes segment.
+ */
+struct udo_shm_dir_entry
+{
+	udo_atomic_u32 rd_fux;
+	udo_atomic_u32 wr_fux;
+	udo_atomic_u32 gate;
+	udo_atomic_u32 gen;
+	udo_atomic_u32 mode;
+	uint32_t       pad;
+	udo_atomic_u64 off;
+	udo_atomic_u64 size;
+} __attribute__((aligned(UDO_CACHE_LINE_SIZE)));
+
+/*
+ * @brief Structure defining the header stored at the start
+ *        of shared memory. Every process maps segments
+ *        from the directory instead of computing them.
+ *
+ * @member attached   - Amount of processes attached to shared memory.
+ * @member proc_count - Amount of entries in @dir.
+ * @member state      - SHM_HDR_{UNINIT,INIT,READY}.
+ * @member grow_lock  - Serializes udo_shm_grow(3) callers.
+ * @member growable   - Set if segments may be moved by udo_shm_grow(3).
+ * @member size       - Total size of shared memory.
+ * @member dir        - Per process futexes and segment location.
+ */
+struct udo_shm_hdr
+{
+	udo_atomic_u32           attached;
+	udo_atomic_u32           proc_count;
+	udo_atomic_u32           state;
+	udo_atomic_u32           grow_lock;
+	udo_atomic_u32           growable;
+	udo_atomic_u64           size;
+	struct udo_shm_dir_entry dir[];
+};
+
+/*
+ * @brief Structure defining the ring control block stored
+ *        at the start of a processes shared memory segment
+ *        when used with udo_shm_ring_{read,write}(3). Members
+ *        written by producers and consumers are kept on
+ *        separate cache lines. Producers claim space by
+ *        compare exchanging @wr_head and consumers claim
+ *        records by compare exchanging @rd_tail. Claims
+ *        are published in the order they were made.
+ *
+ * @member wr_head    - Total amount of bytes reserved by producers.
+ * @member head       - Total amount of bytes committed by producers.
+ *                      Consumers only read records stored before @head.
+ * @member head_fux   - Futex consumers sleep on while ring is empty.
+ * @member rd_waiting - Amount of consumers sleeping on @head_fux.
+ * @member rd_tail    - Total amount of bytes claimed by consumers.
+ * @member tail       - Total amount of bytes released by consumers.
+ *                      Producers only overwrite records stored before @tail.
+ * @member tail_fux   - Futex producers sleep on while ring is full.
+ * @member wr_waiting - Amount of producers sleeping on @tail_fux.
+ */
+struct udo_shm_ring
+{
+	udo_atomic_u64 wr_head;
+	udo_atomic_u64 head;
+	udo_atomic_u32 head_fux;
+	udo_atomic_u32 rd_waiting;
+	udo_atomic_u64 rd_tail __attribute__((aligned(UDO_CACHE_LINE_SIZE)));
+	udo_atomic_u64 tail;
+	udo_atomic_u32 tail_fux;
+	udo_atomic_u32 wr_waiting;
+} __attribute__((aligned(UDO_CACHE_LINE_SIZE)));
+
+/*
+ * @brief Structure defining a subscriber cursor stored in the
+ *        broadcast control block. Each cursor occupies its own
+ *        cache line and is only written by its subscriber.
+ *
+ * @member pos    - Position of the next record to read. Published
+ *                  so that the producer may apply backpressure.
+ * @member next   - Position after the record currently acquired.
+ * @member active - SHM_BCAST_READER_{FREE,ACTIVE,JOINING}.
+ */
+struct udo_shm_bcast_reader
+{
+	udo_atomic_u64 pos;
+	udo_atomic_u64 next;
+	udo_atomic_u32 active;
+} __attribute__((aligned(UDO_CACHE_LINE_SIZE)));
+
+/*
+ * @brief Structure defining the broadcast control block stored
+ *        at the start of a processes shared memory segment
+ *        when used with udo_shm_bcast_{write,read_acquire}(3).
+ *        Records use the same layout as struct udo_shm_ring.
+ *
+ * @member head       - Total amount of bytes written into the ring.
+ * @member head_fux   - Futex subscribers sleep on while caught up.
+ * @member rd_waiting - Amount of subscribers sleeping on @head_fux.
+ * @member wr_lock    - Serializes multiple producers.
+ * @member tail       - Position of the oldest record still stored.
+ *                      Only written by the producer.
+ * @member tail_fux   - Futex producer sleeps on while waiting for
+ *                      the slowest subscriber.
+ * @member wr_waiting - Amount of producers sleeping on @tail_fux.
+ * @member readers    - Subscriber cursors.
+ */
+struct udo_shm_bcast
+{
+	udo_atomic_u64              head;
+	udo_atomic_u32              head_fux;
+	udo_atomic_u32              rd_waiting;
+	udo_atomic_u32              wr_lock;
+	udo_atomic_u64              tail __attribute__((aligned(UDO_CACHE_LINE_SIZE)));
+	udo_atomic_u32              tail_fux;
+	udo_atomic_u32              wr_waiting;
+	struct udo_shm_bcast_reader readers[SHM_BCAST_READER_MAX];
+} __attribute__((aligned(UDO_CACHE_LINE_SIZE)));
+
+/*
+ * @brief Structure defining the seqlock control block stored
+ *        at the start of a processes shared memory segment
+ *        when used with udo_shm_latest_{read,write}(3).
+ *
+ * @member seq  - Sequence counter. Odd while producer is
+ *                writing a new value.
+ * @member size - Size in bytes of the stored value.
+ */
+struct udo_shm_latest
+{
+	udo_atomic_u32 seq;
+	udo_atomic_u32 size;
+} __attribute__((aligned(UDO_CACHE_LINE_SIZE)));
+
+/*
+ * @brief Structure defining the header stored in front of
+ *        every block handed out by udo_shm_mm_alloc(3).
+ *
+ * @member state - SHM_MM_BLK_{USED,FREE}.
+ * @member cls   - Size class of the block.
+ * @member next  - Index of the next block in the size class
+ *                 free list. Only valid while block is free.
+ */
+struct udo_shm_mm_blk
+{
+	udo_atomic_u32 state;
+	udo_atomic_u32 cls;
+	udo_atomic_u32 next;
+	uint32_t       pad;
+};
+
+/*
+ * @brief Structure defining the allocator control block
+ *        stored at the start of a processes shared memory
+ *        segment when used with udo_shm_mm_{alloc,free}(3).
+ *        Memory never referenced by a block is handed out
+ *        by bumping @brk.
+ *
+ * @member brk  - Byte offset from the end of the control block
+ *                of the first byte never handed out.
+ * @member free - Per size class free list heads. Upper 32-bits
+ *                store a tag incremented on every update, lower
+ *                32-bits store the index of the first free block.
+ */
+struct udo_shm_mm
+{
+	udo_atomic_u64 brk;
+	udo_atomic_u64 free[SHM_MM_CLASS_MAX];
+} __attribute__((aligned(UDO_CACHE_LINE_SIZE)));
+
+/*
+ * @brief Structure defining the udo_shm_proc
+ *        (UDO Shared Memory Process) context.
+ *
+ * @member entry       - Pointer to the processes directory entry.
+ * @member gen         - Segment generation @data was computed from.
+ * @member growable    - Copy of the headers @growable. If not set
+ *                       the segment gate is never entered.
+ * @member rd_fux      - Pointer to a given process read futex
+ *                       stored in front segment of shared memory.
+ * @member wr_fux      - Pointer to a given process write futex
+ *                       stored in front segment of shared memory.
+ * @member data        - Pointer to an unsigned char storing location
+ *                       within shared memory. This pointer is a
+ *                       given processes shared memory segment
+ *                       staring address.
+ * @member data_sz     - Stores the size of a given processes
+ *                       shared memory segment.
+ * @member ring        - Pointer to cache line aligned ring control
+ *                       block within the processes segment. NULL
+ *                       if segment is to small to store a ring.
+ * @member ring_sz     - Byte size of the ring buffer stored
+ *                       directly after @ring.
+ * @member wr_pos      - Ring position the reserved record starts at.
+ * @member wr_next     - Ring head position published on
+ *                       udo_shm_write_commit(3).
+ * @member rd_pos      - Ring position the acquired record starts at.
+ * @member rd_next     - Ring tail position published on
+ *                       udo_shm_read_release(3).
+ * @member wr_reserved - Set while a record reserved with
+ *                       udo_shm_write_reserve(3) isn't committed.
+ * @member rd_acquired - Set while a record acquired with
+ *                       udo_shm_read_acquire(3) isn't released.
+ * @member bcast_acquired - Bit per subscriber set while a record
+ *                          acquired with udo_shm_bcast_read_acquire(3)
+ *                          isn't released.
+ * @member bcast       - Pointer to cache line aligned broadcast
+ *                       control block within the processes segment.
+ *                       NULL if segment is to small to store one.
+ * @member bcast_sz    - Byte size of the ring buffer stored
+ *                       directly after @bcast.
+ * @member latest      - Pointer to cache line aligned seqlock
+ *                       control block within the processes segment.
+ *                       NULL if segment is to small to store one.
+ * @member latest_sz   - Byte size of the value buffer stored
+ *                       directly after @latest.
+ * @member mm          - Pointer to cache line aligned allocator control
+ *                       block within the processes segment. NULL if
+ *                       segment is to small to store one.
+ * @member mm_sz       - Byte size of the heap stored directly after @mm.
+ * @member event_fd    - eventfd(2) signalled each time data is written
+ *                       to the segment. -1 if not used.
+ */
+struct udo_shm_proc
+{
+	struct udo_shm_dir_entry *entry;
+	udo_atomic_u32        gen;
+	uint8_t               growable;
+	udo_atomic_u32        *rd_fux;
+	udo_atomic_u32        *wr_fux;
+	udo_atomic_addr       data;
+	size_t                data_sz;
+	struct udo_shm_ring   *ring;
+	size_t                ring_sz;
+	uint64_t              wr_pos;
+	uint64_t              wr_next;
+	uint64_t              rd_pos;
+	uint64_t              rd_next;
+	uint8_t               wr_reserved;
+	uint8_t               rd_acquired;
+	udo_atomic_u32        bcast_acquired;
+	struct udo_shm_bcast  *bcast;
+	size_t                bcast_sz;
+	struct udo_shm_latest *latest;
+	size_t                latest_sz;
+	struct udo_shm_mm     *mm;
+	size_t                mm_sz;
+	int                   event_fd;
+};
+
+
+/*
+ * @brief Structure defining the udo_shm
+ *        (UDO Shared Memory) context.
+ *
+ * @member err             - Stores information about the error that occured
+ *                           for the given context and may later be retrieved
+ *                           by caller.
+ * @member free            - If structure allocated with calloc(3) member will be
+ *                           set to true so that, we know to call free(3) when
+ *                           destroying the context.
+ * @member fd              - Open file descriptor to POSIX shared memory.
+ * @member shm_file        - Name of the POSIX shared memory file starting with '/'.
+ * @member map             - Start of the address range reserved for shared memory.
+ * @member map_sz          - Byte size of the reserved address range.
+ * @member data            - Pointer to mmap(2) map'd shared memory data. Never
+ *                           moves as shared memory grows.
+ * @member data_sz         - Total size of the shared memory region mapped with mmap(2).
+ * @member sync_lock       - Serializes threads mapping memory peers grew.
+ * @member proc_count      - Amount of processes stored in @procs.
+ * @member procs           - An array storing the shared memory locations
+ *                           of each processes futexes and data.
+ * @member bcast_skip_slow - Producer overwrites records slow broadcast
+ *                           subscribers haven't read instead of waiting.
+ * @member backing         - SHM_BACKING_{POSIX,HUGETLBFS,MEMFD,FD}.
+ * @member page_sz         - Page size of the backing file. Shared
+ *                           memory size is always a multiple of it.
+ * @member populate        - Prefault pages when mapping shared memory.
+ * @member lock            - Lock pages into RAM when mapping shared memory.
+ * @member attached        - Set once this context is counted in the
+ *                           headers attached count.
+ */
+struct udo_shm
+{
+	struct udo_log_error_struct err;
+	uint8_t                     free;
+	int                         fd;
+	char                        shm_file[SHM_FILE_NAME_MAX];
+	void                        *map;
+	size_t                      map_sz;
+	void                        *data;
+	size_t                      data_sz;
+	udo_atomic_u32              sync_lock;
+	uint32_t                    proc_count;
+	struct udo_shm_proc         *procs;
+	uint8_t                     bcast_skip_slow;
+	uint8_t                     backing;
+	size_t                      page_sz;
+	uint8_t                     populate;
+	uint8_t                     lock;
+	uint8_t                     attached;
+};
+
+
+/*****************************************
+ * Start of global to C source functions *
+ *****************************************/
+
+UDO_STATIC_INLINE
+int
+futex (void *uaddr,
+       int op,
+       uint32_t val,
+       const struct timespec *timeout,
+       void *uaddr2,
+       uint32_t val3)
+{
+	return syscall(SYS_futex, uaddr, op, val,
+	               timeout, uaddr2, val3);
+}
+
+
+/*
+ * Informs readers polling the segments
+ * eventfd that new data is available.
+ */
+UDO_STATIC_INLINE
+void
+p_shm_signal (const struct udo_shm_proc *shm_proc)
+{
+	if (shm_proc->event_fd != -1)
+		eventfd_write(shm_proc->event_fd, 1);
+}
+
+
+/*
+ * Lock only contended when multiple producers share a
+ * broadcast ring, multiple processes grow segments or
+ * multiple threads map memory peers grew.
+ * 0 (unlocked), 1 (locked), 2 (locked with sleeping waiters).
+ */
+static void
+p_shm_lock (udo_atomic_u32 *lock)
+{
+	uint32_t c = 0;
+
+	if (__atomic_compare_exchange_n(lock, &c, 1, 0, \
+		__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+	{
+		return;
+	}
+
+	if (c != 2)
+		c = __atomic_exchange_n(lock, 2, __ATOMIC_ACQUIRE);
+
+	while (c != 0) {
+		futex(lock, FUTEX_WAIT, 2, NULL, NULL, 0);
+		c = __atomic_exchange_n(lock, 2, __ATOMIC_ACQUIRE);
+	}
+}
+
+
+UDO_STATIC_INLINE
+void
+p_shm_unlock (udo_atomic_u32 *lock)
+{
+	if (__atomic_exchange_n(lock, 0, __ATOMIC_RELEASE) == 2)
+		futex(lock, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/***************************************
+ * End of global to C source functions *
+ ***************************************/
+
+
+/*************************************
+ * Start of udo_shm_create functions *
+ *************************************/
+
+/*
+ * Places a cache line aligned control block of @ctrl_sz
+ * bytes at the start of a processes segment. Returns
+ * size of the buffer stored after the control block or
+ * zero if segment is to small.
+ */
+static size_t
+p_shm_ctrl_init (const struct udo_shm_proc *shm_proc,
+                 const size_t ctrl_sz,
+                 void **ctrl)
+{
+	size_t ctrl_off;
+
+	ctrl_off = UDO_BYTE_ALIGN((uintptr_t)shm_proc->data, \
+		UDO_CACHE_LINE_SIZE) - (uintptr_t)shm_proc->data;
+
+	if (shm_proc->data_sz <= ctrl_off + ctrl_sz + \
+	    (4 * SHM_RING_HDR_SIZE))
+	{
+		*ctrl = NULL;
+		return 0;
+	}
+
+	*ctrl = (char*)shm_proc->data + ctrl_off;
+
+	return (shm_proc->data_sz - ctrl_off - ctrl_sz) & \
+		~(SHM_RING_HDR_SIZE-1);
+}
+
+
+static void
+p_shm_proc_init (struct udo_shm_proc *shm_proc)
+{
+	shm_proc->ring_sz = p_shm_ctrl_init(shm_proc,
+		sizeof(struct udo_shm_ring), (void**)&(shm_proc->ring));
+	shm_proc->bcast_sz = p_shm_ctrl_init(shm_proc,
+		sizeof(struct udo_shm_bcast), (void**)&(shm_proc->bcast));
+	shm_proc->latest_sz = p_shm_ctrl_init(shm_proc,
+		sizeof(struct udo_shm_latest), (void**)&(shm_proc->latest));
+	shm_proc->mm_sz = p_shm_ctrl_init(shm_proc,
+		sizeof(struct udo_shm_mm), (void**)&(shm_proc->mm));
+	shm_proc->mm_sz = UDO_MIN(shm_proc->mm_sz, SHM_MM_HEAP_MAX) & \
+		~(SHM_MM_ALIGN-1);
+}
+
+
+UDO_STATIC_INLINE
+struct udo_shm_hdr *
+p_shm_get_hdr (const struct udo_shm *shm)
+{
+	return (struct udo_shm_hdr *) shm->data;
+}
+
+
+UDO_STATIC_INLINE
+size_t
+p_shm_get_hdr_size (const uint32_t proc_count)
+{
+	return UDO_BYTE_ALIGN(sizeof(struct udo_shm_hdr) + \
+		(proc_count * sizeof(struct udo_shm_dir_entry)), \
+		UDO_CACHE_LINE_SIZE);
+}
+
+
+/*
+ * Maps shared memory up to @size bytes. The first call
+ * reserves an address range large enough to grow into.
+ * Later calls only map what a peer appended so that
+ * addresses other threads are using never move.
+ */
+static int
+p_shm_map (struct udo_shm *shm,
+           const size_t size)
+{
+	void *data;
+
+	if (!shm->map) {
+		shm->map_sz = SHM_MAP_MAX + shm->page_sz;
+		shm->map = mmap(NULL, shm->map_sz, PROT_NONE,
+		                MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+		if (shm->map == MAP_FAILED) {
+			shm->map = NULL;
+			udo_log_set_error(shm, errno, "mmap: %s", strerror(errno));
+			return -1;
+		}
+
+		/* Huge page mappings must start on a huge page boundary */
+		shm->data = (void *) UDO_BYTE_ALIGN((uintptr_t) shm->map, shm->page_sz);
+	}
+
+	if (size <= shm->data_sz)
+		return 0;
+
+	if (size > SHM_MAP_MAX) {
+		udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+		                  "Shared memory size (%zu) exceeds limit (%zu)",
+		                  size, SHM_MAP_MAX);
+		return -1;
+	}
+
+	data = mmap((char*)shm->data + shm->data_sz, size - shm->data_sz,
+	            PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED| \
+	            (shm->populate ? MAP_POPULATE : 0), shm->fd, shm->data_sz);
+	if (data == MAP_FAILED) {
+		udo_log_set_error(shm, errno, "mmap: %s", strerror(errno));
+		return -1;
+	}
+
+	/* Every page stays resident, including pages mapped after growth */
+	if (shm->lock && mlock(data, size - shm->data_sz) == -1) {
+		udo_log_set_error(shm, errno, "mlock: %s", strerror(errno));
+		return -1;
+	}
+
+	shm->data_sz = size;
+
+	return 0;
+}
+
+
+/*
+ * Computes a processes futex and segment addresses
+ * from its directory entry. Generation is read first
+ * so that a segment moved while reading is remapped
+ * on next access.
+ */
+static void
+p_shm_map_proc (struct udo_shm *shm,
+                struct udo_shm_proc *shm_proc)
+{
+	uint32_t gen;
+
+	struct udo_shm_dir_entry *entry = shm_proc->entry;
+
+	gen = __atomic_load_n(&entry->gen, __ATOMIC_ACQUIRE);
+
+	shm_proc->data = (udo_atomic_addr) shm->data + \
+		__atomic_load_n(&entry->off, __ATOMIC_RELAXED);
+	shm_proc->data_sz = __atomic_load_n(&entry->size, __ATOMIC_RELAXED);
+	p_shm_proc_init(shm_proc);
+
+	__atomic_store_n(&shm_proc->gen, gen, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * Maps a segment a peer moved since last accessed.
+ * Caller is inside the segments gate so it can't
+ * move again while being mapped.
+ */
+static int
+p_shm_sync (struct udo_shm *shm,
+            struct udo_shm_proc *shm_proc)
+{
+	int err = -1;
+
+	p_shm_lock(&shm->sync_lock);
+
+	err = p_shm_map(shm, __atomic_load_n(&(p_shm_get_hdr(shm)->size), \
+		__ATOMIC_ACQUIRE));
+	if (err == 0 && \
+	    __atomic_load_n(&shm_proc->gen, __ATOMIC_RELAXED) != \
+	    __atomic_load_n(&(shm_proc->entry->gen), __ATOMIC_ACQUIRE))
+	{
+		p_shm_map_proc(shm, shm_proc);
+	}
+
+	p_shm_unlock(&shm->sync_lock);
+
+	return err;
+}
+
+
+UDO_STATIC_INLINE
+void
+p_shm_leave (struct udo_shm_proc *shm_proc)
+{
+	udo_atomic_u32 *gate = &(shm_proc->entry->gate);
+
+	if (!shm_proc->growable)
+		return;
+
+	/* Last access out wakes udo_shm_grow(3) */
+	if (__atomic_sub_fetch(gate, 1, __ATOMIC_RELEASE) == SHM_GATE_MOVING)
+		futex(gate, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+
+/*
+ * Every access to a processes segment happens between
+ * p_shm_enter() and p_shm_leave(). udo_shm_grow(3) only
+ * moves a segment while nobody is inside its gate. A
+ * segment moved since last accessed is remapped. Gate
+ * is entered even on failure. Segments that never move
+ * skip the gate so that accesses only read the entry.
+ */
+static int
+p_shm_enter (struct udo_shm *shm,
+             struct udo_shm_proc *shm_proc)
+{
+	uint32_t cur;
+
+	udo_atomic_u32 *gate = &(shm_proc->entry->gate);
+
+	cur = __atomic_load_n(gate, __ATOMIC_RELAXED);
+	while (shm_proc->growable) {
+		if (cur & SHM_GATE_MOVING) {
+			futex(gate, FUTEX_WAIT, cur, NULL, NULL, 0);
+			cur = __atomic_load_n(gate, __ATOMIC_RELAXED);
+			continue;
+		}
+
+		if (__atomic_compare_exchange_n(gate, &cur, cur + 1, 1, \
+			__ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		{
+			break;
+		}
+	}
+
+	if (__atomic_load_n(&shm_proc->gen, __ATOMIC_ACQUIRE) == \
+	    __atomic_load_n(&(shm_proc->entry->gen), __ATOMIC_ACQUIRE))
+	{
+		return 0;
+	}
+
+	return p_shm_sync(shm, shm_proc);
+}
+
+
+/*
+ * Called by waiters that stopped waiting because their
+ * segment is being moved. Blocks until the segment is
+ * moved then maps its new location.
+ */
+UDO_STATIC_INLINE
+int
+p_shm_reenter (struct udo_shm *shm,
+               struct udo_shm_proc *shm_proc)
+{
+	p_shm_leave(shm_proc);
+	return p_shm_enter(shm, shm_proc);
+}
+
+
+/*
+ * Returns total size of shared memory required
+ * to store the header and each processes segment.
+ */
+static size_t
+p_shm_get_total_size (struct udo_shm *shm,
+                      const struct udo_shm_create_info *shm_info)
+{
+	uint32_t p;
+
+	size_t total, hdr_sz, seg_sz;
+
+	hdr_sz = p_shm_get_hdr_size(shm_info->proc_count);
+
+	if (!(shm_info->proc_sizes)) {
+		if (shm_info->shm_size <= hdr_sz + \
+		    (shm_info->proc_count * UDO_CACHE_LINE_SIZE))
+		{
+			udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+			                  "Shared memory size (%zu) to small for (%u) processes",
+			                  shm_info->shm_size, shm_info->proc_count);
+			return 0;
+		}
+
+		return shm_info->shm_size;
+	}
+
+	for (p = 0, total = hdr_sz; p < shm_info->proc_count; p++) {
+		seg_sz = shm_info->proc_sizes[p];
+		if (!seg_sz) {
+			udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+			                  "Process (%u) segment size must not be zero", p);
+			return 0;
+		}
+
+		total += UDO_BYTE_ALIGN(seg_sz, UDO_CACHE_LINE_SIZE);
+	}
+
+	return total;
+}
+
+
+/*
+ * Writes the directory. Segments are cache line
+ * aligned. Without per process sizes the region
+ * is divided evenly.
+ */
+static void
+p_shm_init_hdr (struct udo_shm *shm,
+                const struct udo_shm_create_info *shm_info,
+                const size_t total)
+{
+	uint32_t p;
+
+	size_t off, seg_sz = 0;
+
+	struct udo_shm_hdr *hdr = p_shm_get_hdr(shm);
+
+	off = p_shm_get_hdr_size(shm_info->proc_count);
+	if (!(shm_info->proc_sizes)) {
+		seg_sz = ((total - off) / shm_info->proc_count) & \
+			~((size_t) UDO_CACHE_LINE_SIZE-1);
+	}
+
+	for (p = 0; p < shm_info->proc_count; p++) {
+		if (shm_info->proc_sizes)
+			seg_sz = shm_info->proc_sizes[p];
+
+		/* Read futex initialized to lock state */
+		__atomic_store_n(&(hdr->dir[p].rd_fux), UDO_FUTEX_LOCK, __ATOMIC_RELAXED);
+		__atomic_store_n(&(hdr->dir[p].wr_fux), UDO_FUTEX_UNLOCK, __ATOMIC_RELAXED);
+		__atomic_store_n(&(hdr->dir[p].off), off, __ATOMIC_RELAXED);
+		__atomic_store_n(&(hdr->dir[p].size), seg_sz, __ATOMIC_RELAXED);
+
+		off += UDO_BYTE_ALIGN(seg_sz, UDO_CACHE_LINE_SIZE);
+	}
+
+	__atomic_store_n(&hdr->proc_count, shm_info->proc_count, __ATOMIC_RELAXED);
+	__atomic_store_n(&hdr->growable, shm_info->growable, __ATOMIC_RELAXED);
+	__atomic_store_n(&hdr->size, total, __ATOMIC_RELAXED);
+	__atomic_store_n(&hdr->state, SHM_HDR_READY, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * Returns file descriptor backing shared memory.
+ */
+static int
+p_shm_open (struct udo_shm *shm,
+            const struct udo_shm_create_info *shm_info)
+{
+	int fd = -1;
+
+	char path[UDO_FILE_PATH_MAX];
+
+	if (shm_info->use_fd) {
+		shm->backing = SHM_BACKING_FD;
+		fd = fcntl(shm_info->shm_fd, F_DUPFD_CLOEXEC, 0);
+		if (fd == -1) {
+			udo_log_set_error(shm, errno, "fcntl: %s", strerror(errno));
+			return -1;
+		}
+	} else if (shm_info->memfd) {
+		shm->backing = SHM_BACKING_MEMFD;
+		fd = memfd_create(shm->shm_file+1, MFD_CLOEXEC | \
+			(shm_info->hugetlb ? MFD_HUGETLB : 0));
+		if (fd == -1) {
+			udo_log_set_error(shm, errno, "memfd_create: %s", strerror(errno));
+			return -1;
+		}
+	} else if (shm_info->hugetlb) {
+		shm->backing = SHM_BACKING_HUGETLBFS;
+		snprintf(path, sizeof(path), "%s%s", SHM_HUGETLBFS_DIR, shm->shm_file);
+		fd = open(path, O_RDWR|O_CREAT|O_CLOEXEC, 0644);
+		if (fd == -1) {
+			udo_log_set_error(shm, errno, "open: %s", strerror(errno));
+			return -1;
+		}
+	} else {
+		shm->backing = SHM_BACKING_POSIX;
+		fd = shm_open(shm->shm_file, O_RDWR|O_CREAT, 0644);
+		if (fd == -1) {
+			udo_log_set_error(shm, errno, "shm_open: %s", strerror(errno));
+			return -1;
+		}
+	}
+
+	return fd;
+}
+
+
+static int
+p_shm_create (struct udo_shm *shm,
+              const struct udo_shm_create_info *shm_info)
+{
+	uint32_t p;
+
+	int err = -1, len;
+
+	size_t total = 0;
+
+	struct stat st;
+
+	struct udo_shm_hdr *hdr;
+
+	if (!shm_info) {
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	/* Peers attaching to a received descriptor read everything from the header */
+	if (!(shm_info->use_fd)) {
+		if (!(shm_info->proc_count) || \
+		    shm_info->proc_count >= SHM_PROC_MAX)
+		{
+			udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+			                  "Unsupported process count (%u:%u)",
+			                  shm_info->proc_count, SHM_PROC_MAX);
+			return -1;
+		}
+
+		if (!(shm_info->shm_size) && !(shm_info->proc_sizes)) {
+			udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+			                  "Shared memory size must not be zero",
+			                  shm_info->shm_size);
+			return -1;
+		}
+
+		if (!(shm_info->shm_file) || shm_info->shm_file[0] != '/') {
+			udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+			                  "Shared memory file name '%s' doesn't start with '/'",
+			                  shm_info->shm_file);
+			return -1;
+		}
+
+		len = strnlen(shm_info->shm_file, SHM_FILE_NAME_MAX);
+		if (len >= SHM_FILE_NAME_MAX) {
+			udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+			                  "Shared memory '%s' name length to long",
+			                  shm_info->shm_file);
+			return -1;
+		}
+
+		total = p_shm_get_total_size(shm, shm_info);
+		if (!total)
+			return -1;
+
+		strncpy(shm->shm_file, shm_info->shm_file, len);
+	}
+
+	shm->fd = p_shm_open(shm, shm_info);
+	if (shm->fd == -1)
+		return -1;
+
+	err = fstat(shm->fd, &st);
+	if (err == -1) {
+		udo_log_set_error(shm, errno, "fstat: %s", strerror(errno));
+		return -1;
+	}
+
+	/* hugetlbfs reports huge page size as block size */
+	shm->page_sz = UDO_MAX((size_t) st.st_blksize, (size_t) UDO_PAGE_SIZE);
+	total = UDO_BYTE_ALIGN(total, shm->page_sz);
+
+	/* Never shrink shared memory a peer may have grown */
+	if ((size_t) st.st_size < total) {
+		err = ftruncate(shm->fd, total);
+		if (err == -1) {
+			udo_log_set_error(shm, errno, "ftruncate: %s", strerror(errno));
+			return -1;
+		}
+	} else {
+		total = st.st_size;
+	}
+
+	shm->populate = shm_info->populate;
+	shm->lock = shm_info->lock;
+	err = p_shm_map(shm, total);
+	if (err == -1)
+		return -1;
+
+	if (shm_info->use_fd && \
+	    __atomic_load_n(&(p_shm_get_hdr(shm)->state), \
+	                    __ATOMIC_ACQUIRE) != SHM_HDR_READY)
+	{
+		udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+		                  "Shared memory file descriptor (%d) not initialized",
+		                  shm_info->shm_fd);
+		return -1;
+	}
+
+	/*
+	 * First process to attach writes the directory.
+	 * Everyone else waits until the directory is ready.
+	 */
+	hdr = p_shm_get_hdr(shm);
+	if (__atomic_compare_exchange_n(&hdr->state, \
+		&(udo_atomic_u32){SHM_HDR_UNINIT}, SHM_HDR_INIT, \
+		0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+	{
+		p_shm_init_hdr(shm, shm_info, total);
+	}
+
+	while (__atomic_load_n(&hdr->state, __ATOMIC_ACQUIRE) != SHM_HDR_READY)
+		UDO_CPU_RELAX();
+
+	shm->proc_count = __atomic_load_n(&hdr->proc_count, __ATOMIC_RELAXED);
+	if (__atomic_load_n(&hdr->attached, __ATOMIC_ACQUIRE) >= shm->proc_count) {
+		udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+		                  "Unsupported process count (%u:%u)",
+		                  shm_info->proc_count, shm->proc_count);
+		return -1;
+	}
+
+	shm->procs = calloc(shm->proc_count, sizeof(struct udo_shm_proc));
+	if (!shm->procs) {
+		udo_log_set_error(shm, errno, "calloc: %s", strerror(errno));
+		return -1;
+	}
+
+	/* Segments are mapped on first access */
+	for (p = 0; p < shm->proc_count; p++) {
+		shm->procs[p].entry = &(hdr->dir[p]);
+		shm->procs[p].gen = __atomic_load_n(&(hdr->dir[p].gen), __ATOMIC_ACQUIRE) - 1;
+		shm->procs[p].growable = __atomic_load_n(&hdr->growable, __ATOMIC_RELAXED);
+		shm->procs[p].rd_fux = &(hdr->dir[p].rd_fux);
+		shm->procs[p].wr_fux = &(hdr->dir[p].wr_fux);
+		shm->procs[p].event_fd = -1;
+	}
+
+	/* Duplicated so caller may close its copy of the shared eventfds */
+	for (p = 0; shm_info->event_fds && p < shm->proc_count; p++) {
+		if (shm_info->event_fds[p] < 0)
+			continue;
+
+		shm->procs[p].event_fd = fcntl(shm_info->event_fds[p], F_DUPFD_CLOEXEC, 0);
+		if (shm->procs[p].event_fd == -1) {
+			udo_log_set_error(shm, errno, "fcntl: %s", strerror(errno));
+			return -1;
+		}
+	}
+
+	__atomic_add_fetch(&hdr->attached, 1, __ATOMIC_SEQ_CST);
+	shm->attached = 1;
+
+	shm->bcast_skip_slow = shm_info->bcast_skip_slow;
+
+	return 0;
+}
+
+
+struct udo_shm *
+udo_shm_create (struct udo_shm *p_shm,
+                const void *p_shm_info)
+{
+	int err = -1;
+
+	struct udo_shm *shm = p_shm;
+
+	const struct udo_shm_create_info *shm_info = p_shm_info;
+
+	if (!shm) {
+		shm = calloc(1, sizeof(struct udo_shm));
+		if (!shm) {
+			udo_log_error("calloc: %s\n", strerror(errno));
+			return NULL;
+		}
+
+		shm->free = true;
+	}
+
+	err = p_shm_create(shm, shm_info);
+	if (err == -1) {
+		udo_log_error("%s\n", udo_log_get_error(shm));
+		udo_shm_destroy(shm);
+		return NULL;
+	}
+
+	return shm;
+}
+
+/***********************************
+ * End of udo_shm_create functions *
+ ***********************************/
+
+
+/***********************************
+ * Start of udo_shm_data functions *
+ ***********************************/
+
+UDO_STATIC_INLINE
+uint8_t
+p_check_proc_index (struct udo_shm *shm,
+                    const uint32_t proc_index)
+{
+	return proc_index >= shm->proc_count;
+}
+
+
+/*
+ * Enters the gate of a processes segment. Returns NULL
+ * without entering if @proc_index is out of range, the
+ * segment can't be mapped or is to small to store the
+ * control block @mode requires.
+ */
+static struct udo_shm_proc *
+p_shm_enter_mode (struct udo_shm *shm,
+                  const uint32_t proc_index,
+                  const uint32_t mode)
+{
+	void *ctrl;
+
+	struct udo_shm_proc *shm_proc;
+
+	if (p_check_proc_index(shm, proc_index))
+		return NULL;
+
+	shm_proc = &(shm->procs[proc_index]);
+	if (p_shm_enter(shm, shm_proc) == -1) {
+		p_shm_leave(shm_proc);
+		return NULL;
+	}
+
+	switch (mode) {
+		case SHM_MODE_RING:
+			ctrl = shm_proc->ring;
+			break;
+		case SHM_MODE_BCAST:
+			ctrl = shm_proc->bcast;
+			break;
+		case SHM_MODE_LATEST:
+			ctrl = shm_proc->latest;
+			break;
+		case SHM_MODE_MM:
+			ctrl = shm_proc->mm;
+			break;
+		default:
+			return shm_proc;
+	}
+
+	if (!ctrl) {
+		p_shm_leave(shm_proc);
+		return NULL;
+	}
+
+	/* Inform udo_shm_grow(3) how to copy the segment */
+	if (__atomic_load_n(&(shm_proc->entry->mode), __ATOMIC_RELAXED) != mode)
+		__atomic_store_n(&(shm_proc->entry->mode), mode, __ATOMIC_RELAXED);
+
+	return shm_proc;
+}
+
+
+/*
+ * Bulk copy between caller buffer and shared memory segment.
+ * Callers frame copy with a single acquire (after taking the
+ * futex) and a single release (before waking the peer).
+ * libc memcpy(3) already selects the widest vector unit at
+ * runtime. Non-temporal stores bypass the cache for large
+ * payloads the copying process won't touch again.
+ */
+static void
+p_shm_copy (void *dst,
+            const void *src,
+            size_t size,
+            const uint8_t non_temporal)
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+#if defined(__AVX2__)
+	const size_t vsz = sizeof(__m256i);
+#else
+	const size_t vsz = sizeof(__m128i);
+#endif
+	size_t head;
+
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+
+	if (!non_temporal || size < (vsz << 2)) {
+		memcpy(dst, src, size);
+		return;
+	}
+
+	/* Stream stores require aligned destination */
+	head = (vsz - ((uintptr_t) d & (vsz - 1))) & (vsz - 1);
+	memcpy(d, s, head);
+	d += head; s += head; size -= head;
+
+	for (; size >= vsz; d += vsz, s += vsz, size -= vsz) {
+#if defined(__AVX2__)
+		_mm256_stream_si256((__m256i*) d, \
+			_mm256_loadu_si256((const __m256i*) s));
+#else
+		_mm_stream_si128((__m128i*) d, \
+			_mm_loadu_si128((const __m128i*) s));
+#endif
+	}
+
+	memcpy(d, s, size);
+
+	/* Non-temporal stores are weakly ordered */
+	_mm_sfence();
+#else
+	(void) non_temporal;
+	memcpy(dst, src, size);
+#endif
+}
+
+
+int
+udo_shm_data_read (struct udo_shm *shm,
+                   const void *p_shm_info)
+{
+	size_t data_sz;
+
+	struct udo_shm_proc *shm_proc;
+	const struct udo_shm_data_info *shm_info = p_shm_info;
+
+	if (!shm)
+		return -1;
+
+	if (!shm_info || \
+	    !(shm_info->data) || \
+	    p_check_proc_index(shm, shm_info->proc_index))
+	{
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	/* Segments only ever grow */
+	shm_proc = &(shm->procs[shm_info->proc_index]);
+	data_sz = __atomic_load_n(&(shm_proc->entry->size), __ATOMIC_RELAXED);
+	if (shm_info->size > data_sz) {
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA,
+		                  "Data size (%zu) exceeds segment size (%zu)",
+		                  shm_info->size, data_sz);
+		return -1;
+	}
+
+	udo_futex_lock(shm_proc->rd_fux);
+	if (errno == EINTR)
+		return -errno;
+
+	/* Segment may be moved while waiting on futex */
+	if (p_shm_enter(shm, shm_proc) == -1) {
+		p_shm_leave(shm_proc);
+		udo_futex_unlock(shm_proc->rd_fux);
+		return -1;
+	}
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	p_shm_copy(shm_info->data, shm_proc->data,
+	           shm_info->size, shm_info->non_temporal);
+	memset(shm_proc->data, 0, shm_info->size);
+
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	p_shm_leave(shm_proc);
+	udo_futex_unlock(shm_proc->wr_fux);
+
+	return 0;
+}
+
+
+int
+udo_shm_data_write (struct udo_shm *shm,
+                    const void *p_shm_info)
+{
+	size_t data_sz;
+
+	struct udo_shm_proc *shm_proc;
+	const struct udo_shm_data_info *shm_info = p_shm_info;
+
+	if (!shm)
+		return -1;
+
+	if (!shm_info || \
+	    !(shm_info->data) || \
+	    p_check_proc_index(shm, shm_info->proc_index))
+	{
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	/* Segments only ever grow */
+	shm_proc = &(shm->procs[shm_info->proc_index]);
+	data_sz = __atomic_load_n(&(shm_proc->entry->size), __ATOMIC_RELAXED);
+	if (shm_info->size > data_sz) {
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA,
+		                  "Data size (%zu) exceeds segment size (%zu)",
+		                  shm_info->size, data_sz);
+		return -1;
+	}
+
+	udo_futex_lock(shm_proc->wr_fux);
+	if (errno == EINTR)
+		return -errno;
+
+	/* Segment may be moved while waiting on futex */
+	if (p_shm_enter(shm, shm_proc) == -1) {
+		p_shm_leave(shm_proc);
+		udo_futex_unlock(shm_proc->wr_fux);
+		return -1;
+	}
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	p_shm_copy(shm_proc->data, shm_info->data,
+	           shm_info->size, shm_info->non_temporal);
+
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	p_shm_leave(shm_proc);
+	udo_futex_unlock(shm_proc->rd_fux);
+	p_shm_signal(shm_proc);
+
+	return 0;
+}
+
+/*********************************
+ * End of udo_shm_data functions *
+ *********************************/
+
+
+/***********************************
+ * Start of udo_shm_ring functions *
+ ***********************************/
+
+/*
+ * Sleeps until @pos no longer equals @seen. Waiter count
+ * is incremented before @pos is rechecked so that the
+ * other side always observes a sleeper. If @shm_proc is
+ * given returns -1 without sleeping once its segment is
+ * being moved so that the caller may leave the gate.
+ */
+static int
+p_shm_ring_sleep (const struct udo_shm_proc *shm_proc,
+                  udo_atomic_u32 *fux,
+                  udo_atomic_u32 *waiting,
+                  udo_atomic_u64 *pos,
+                  const uint64_t seen)
+{
+	int ret = 0;
+
+	uint32_t val;
+
+	__atomic_add_fetch(waiting, 1, __ATOMIC_SEQ_CST);
+
+	val = __atomic_load_n(fux, __ATOMIC_SEQ_CST);
+	if (shm_proc && (__atomic_load_n(&(shm_proc->entry->gate), \
+	    __ATOMIC_SEQ_CST) & SHM_GATE_MOVING))
+	{
+		ret = -1;
+	} else if (__atomic_load_n(pos, __ATOMIC_SEQ_CST) == seen) {
+		futex(fux, FUTEX_WAIT, val, NULL, NULL, 0);
+	}
+
+	__atomic_sub_fetch(waiting, 1, __ATOMIC_SEQ_CST);
+
+	return ret;
+}
+
+
+/*
+ * Only enter the kernel if the other side is asleep.
+ */
+UDO_STATIC_INLINE
+void
+p_shm_ring_wake (udo_atomic_u32 *fux,
+                 udo_atomic_u32 *waiting)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(waiting, __ATOMIC_RELAXED)) {
+		__atomic_add_fetch(fux, 1, __ATOMIC_RELEASE);
+		futex(fux, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	}
+}
+
+
+UDO_STATIC_INLINE
+udo_atomic_u32 *
+p_shm_ring_get_hdr (const struct udo_shm_proc *shm_proc,
+                    const uint64_t off)
+{
+	return (udo_atomic_u32 *) ((char*)(shm_proc->ring+1) + off);
+}
+
+
+/*
+ * Claims are published in the order they were made. Waits
+ * until every claim started before @pos is published then
+ * publishes @next. Never waits with a single producer or
+ * a single consumer. Claims are made inside the gate so
+ * the segment isn't moved until every claim is published.
+ */
+static void
+p_shm_ring_publish (udo_atomic_u64 *cur,
+                    udo_atomic_u32 *fux,
+                    udo_atomic_u32 *waiting,
+                    const uint64_t pos,
+                    const uint64_t next)
+{
+	uint32_t s;
+
+	uint64_t seen;
+
+	for (s = 0;; s++) {
+		seen = __atomic_load_n(cur, __ATOMIC_RELAXED);
+		if (seen == pos)
+			break;
+
+		if (s < SHM_RING_SPIN_CNT) {
+			UDO_CPU_RELAX();
+			continue;
+		}
+
+		p_shm_ring_sleep(NULL, fux, waiting, cur, seen);
+	}
+
+	__atomic_store_n(cur, next, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * Returns address to write record data into. Space is
+ * claimed with a compare exchange on the producer index.
+ * Record becomes visible on p_shm_ring_write_commit().
+ * Claimed positions are stored in @pos and @next so
+ * threads sharing @shm_proc never overwrite each others.
+ * Caller is inside the gate and stays inside until
+ * the record is committed.
+ */
+static void *
+p_shm_ring_write_reserve (struct udo_shm *shm,
+                          struct udo_shm_proc *shm_proc,
+                          const size_t size,
+                          uint64_t *pos,
+                          uint64_t *next)
+{
+	uint32_t s;
+
+	uint64_t head, tail, off, pad, need;
+
+	struct udo_shm_ring *ring = shm_proc->ring;
+
+	/*
+	 * Limiting records to half the ring guarantees
+	 * a record plus wrap padding always fits into
+	 * an empty ring.
+	 */
+	need = UDO_BYTE_ALIGN(SHM_RING_HDR_SIZE + size, SHM_RING_HDR_SIZE);
+	if (need > (shm_proc->ring_sz >> 1)) {
+		udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+		                  "Record size (%zu) exceeds ring limit (%zu)",
+		                  size, (shm_proc->ring_sz >> 1) - \
+		                  SHM_RING_HDR_SIZE);
+		return NULL;
+	}
+
+	head = __atomic_load_n(&ring->wr_head, __ATOMIC_RELAXED);
+
+	for (s = 0;;) {
+		off = head % shm_proc->ring_sz;
+		pad = (off + need > shm_proc->ring_sz) ? shm_proc->ring_sz - off : 0;
+
+		/*
+		 * Only sleep if ring is full. A stale @head never
+		 * reports a full ring as having space and fails
+		 * the compare exchange.
+		 */
+		tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		if (tail <= head && head + pad + need - tail > shm_proc->ring_sz) {
+			if (s++ < SHM_RING_SPIN_CNT) {
+				UDO_CPU_RELAX();
+			} else if (p_shm_ring_sleep(shm_proc, &ring->tail_fux, \
+			           &ring->wr_waiting, &ring->tail, tail) == -1)
+			{
+				/* Nothing claimed yet, retry at new location */
+				if (p_shm_reenter(shm, shm_proc) == -1)
+					return NULL;
+				ring = shm_proc->ring;
+			}
+
+			head = __atomic_load_n(&ring->wr_head, __ATOMIC_RELAXED);
+			continue;
+		}
+
+		if (__atomic_compare_exchange_n(&ring->wr_head, &head, \
+			head + pad + need, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		{
+			break;
+		}
+	}
+
+	if (pad) {
+		__atomic_store_n(p_shm_ring_get_hdr(shm_proc, off), \
+		                 SHM_RING_WRAP, __ATOMIC_RELAXED);
+		off = 0;
+	}
+
+	__atomic_store_n(p_shm_ring_get_hdr(shm_proc, off), size, __ATOMIC_RELAXED);
+	*pos = head;
+	*next = head + pad + need;
+
+	return (char*)p_shm_ring_get_hdr(shm_proc, off) + SHM_RING_HDR_SIZE;
+}
+
+
+/*
+ * Leaves the gate entered on reserve.
+ */
+static void
+p_shm_ring_write_commit (struct udo_shm_proc *shm_proc,
+                         const uint64_t pos,
+                         const uint64_t next)
+{
+	struct udo_shm_ring *ring = shm_proc->ring;
+
+	/* Waiting producers sleep on the consumer futex */
+	p_shm_ring_publish(&ring->head, &ring->head_fux, &ring->rd_waiting,
+	                   pos, next);
+
+	p_shm_ring_wake(&ring->head_fux, &ring->rd_waiting);
+	p_shm_signal(shm_proc);
+	p_shm_leave(shm_proc);
+}
+
+
+/*
+ * Returns address of the next record. Record is claimed
+ * with a compare exchange on the consumer index. Space is
+ * reused after p_shm_ring_read_release(). If the record
+ * is larger than @max it isn't claimed, NULL is returned
+ * and @size stores the record size. Claimed positions are
+ * stored in @pos and @next. Caller is inside the gate and
+ * stays inside until the record is released.
+ */
+static const void *
+p_shm_ring_read_acquire (struct udo_shm *shm,
+                         struct udo_shm_proc *shm_proc,
+                         const size_t max,
+                         size_t *size,
+                         uint64_t *pos,
+                         uint64_t *next)
+{
+	uint32_t s, hdr;
+
+	uint64_t head, tail, cur, off, end;
+
+	struct udo_shm_ring *ring = shm_proc->ring;
+
+	tail = __atomic_load_n(&ring->rd_tail, __ATOMIC_RELAXED);
+
+	for (s = 0;;) {
+		/* Only sleep if ring is empty */
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			if (s++ < SHM_RING_SPIN_CNT) {
+				UDO_CPU_RELAX();
+			} else if (p_shm_ring_sleep(shm_proc, &ring->head_fux, \
+			           &ring->rd_waiting, &ring->head, head) == -1)
+			{
+				/* Nothing claimed yet, retry at new location */
+				if (p_shm_reenter(shm, shm_proc) == -1)
+					return NULL;
+				ring = shm_proc->ring;
+			}
+
+			tail = __atomic_load_n(&ring->rd_tail, __ATOMIC_RELAXED);
+			continue;
+		}
+
+		/*
+		 * Header of a stale @tail may be overwritten while
+		 * being read. Compare exchange then fails and the
+		 * value read is discarded.
+		 */
+		cur = tail;
+		off = cur % shm_proc->ring_sz;
+		hdr = __atomic_load_n(p_shm_ring_get_hdr(shm_proc, off), __ATOMIC_RELAXED);
+		if (hdr == SHM_RING_WRAP) {
+			cur += shm_proc->ring_sz - off;
+			off = 0;
+			hdr = __atomic_load_n(p_shm_ring_get_hdr(shm_proc, off), __ATOMIC_RELAXED);
+		}
+
+		end = cur + UDO_BYTE_ALIGN(SHM_RING_HDR_SIZE + \
+			(uint64_t) hdr, SHM_RING_HDR_SIZE);
+
+		if (hdr > max) {
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(&ring->rd_tail, __ATOMIC_RELAXED) != tail) {
+				tail = __atomic_load_n(&ring->rd_tail, __ATOMIC_RELAXED);
+				continue;
+			}
+
+			*size = hdr;
+			return NULL;
+		}
+
+		if (__atomic_compare_exchange_n(&ring->rd_tail, &tail, end, 1, \
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			break;
+		}
+	}
+
+	*pos = tail;
+	*next = end;
+	*size = hdr;
+
+	return (char*)p_shm_ring_get_hdr(shm_proc, off) + SHM_RING_HDR_SIZE;
+}
+
+
+/*
+ * Leaves the gate entered on acquire.
+ */
+static void
+p_shm_ring_read_release (struct udo_shm_proc *shm_proc,
+                         const uint64_t pos,
+                         const uint64_t next)
+{
+	struct udo_shm_ring *ring = shm_proc->ring;
+
+	/* Waiting consumers sleep on the producer futex */
+	p_shm_ring_publish(&ring->tail, &ring->tail_fux, &ring->wr_waiting,
+	                   pos, next);
+
+	p_shm_ring_wake(&ring->tail_fux, &ring->wr_waiting);
+	p_shm_leave(shm_proc);
+}
+
+
+/*
+ * Copies records stored between @tail and @head of the
+ * @src ring buffer to the front of the @dst ring buffer.
+ * Positions are rebased so that @tail lands on a multiple
+ * of @dst_sz. Up to SHM_BCAST_READER_MAX+1 positions
+ * in @pos are rebased in place. Returns rebased @head.
+ */
+static uint64_t
+p_shm_ring_copy (unsigned char *dst,
+                 const size_t dst_sz,
+                 const unsigned char *src,
+                 const size_t src_sz,
+                 const uint64_t tail,
+                 const uint64_t head,
+                 uint64_t *pos,
+                 const uint32_t pos_cnt)
+{
+	uint32_t r, hdr;
+
+	uint64_t cur, off, len, base, rec_sz;
+
+	uint64_t moved[SHM_BCAST_READER_MAX+1];
+
+	base = ((tail + dst_sz - 1) / dst_sz) * dst_sz;
+
+	/* Positions behind @tail were already skipped over */
+	for (r = 0; r < pos_cnt; r++)
+		moved[r] = base;
+
+	for (cur = tail, len = 0;; cur += rec_sz) {
+		for (r = 0; r < pos_cnt; r++) {
+			if (pos[r] == cur)
+				moved[r] = base + len;
+		}
+
+		if (cur >= head)
+			break;
+
+		off = cur % src_sz;
+		memcpy(&hdr, src + off, sizeof(hdr));
+		if (hdr == SHM_RING_WRAP) {
+			rec_sz = src_sz - off;
+			continue;
+		}
+
+		rec_sz = UDO_BYTE_ALIGN(SHM_RING_HDR_SIZE + \
+			(uint64_t) hdr, SHM_RING_HDR_SIZE);
+		memcpy(dst + len, src + off, rec_sz);
+		len += rec_sz;
+	}
+
+	for (r = 0; r < pos_cnt; r++)
+		pos[r] = moved[r];
+
+	return base + len;
+}
+
+
+/*
+ * Copies a quiescent ring to a grown segment.
+ */
+static void
+p_shm_ring_move (struct udo_shm_proc *dst,
+                 const struct udo_shm_proc *src)
+{
+	uint64_t head, tail;
+
+	tail = __atomic_load_n(&(src->ring->tail), __ATOMIC_RELAXED);
+	head = __atomic_load_n(&(src->ring->head), __ATOMIC_RELAXED);
+
+	head = p_shm_ring_copy((unsigned char *)(dst->ring+1), dst->ring_sz,
+	                       (const unsigned char *)(src->ring+1), src->ring_sz,
+	                       tail, head, &tail, 1);
+
+	__atomic_store_n(&(dst->ring->wr_head), head, __ATOMIC_RELAXED);
+	__atomic_store_n(&(dst->ring->head), head, __ATOMIC_RELAXED);
+	__atomic_store_n(&(dst->ring->rd_tail), tail, __ATOMIC_RELAXED);
+	__atomic_store_n(&(dst->ring->tail), tail, __ATOMIC_RELAXED);
+}
+
+
+ssize_t
+udo_shm_ring_write (struct udo_shm *shm,
+                    const void *p_shm_info)
+{
+	void *data;
+
+	uint64_t pos, next;
+
+	struct udo_shm_proc *shm_proc;
+	const struct udo_shm_data_info *shm_info = p_shm_info;
+
+	if (!shm)
+		return -1;
+
+	shm_proc = (shm_info && shm_info->data) ? \
+		p_shm_enter_mode(shm, shm_info->proc_index, SHM_MODE_RING) : NULL;
+
+	/* Commit would wait on the callers own reserved record */
+	if (!shm_proc || shm_proc->wr_reserved) {
+		if (shm_proc)
+			p_shm_leave(shm_proc);
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	/* Positions kept on the stack so threads may share @shm */
+	data = p_shm_ring_write_reserve(shm, shm_proc, shm_info->size, &pos, &next);
+	if (!data) {
+		p_shm_leave(shm_proc);
+		return -1;
+	}
+
+	memcpy(data, shm_info->data, shm_info->size);
+	p_shm_ring_write_commit(shm_proc, pos, next);
+
+	return shm_info->size;
+}
+
+
+ssize_t
+udo_shm_ring_read (struct udo_shm *shm,
+                   const void *p_shm_info)
+{
+	size_t size = 0;
+
+	const void *data;
+
+	uint64_t pos, next;
+
+	struct udo_shm_proc *shm_proc;
+	const struct udo_shm_data_info *shm_info = p_shm_info;
+
+	if (!shm)
+		return -1;
+
+	shm_proc = (shm_info && shm_info->data) ? \
+		p_shm_enter_mode(shm, shm_info->proc_index, SHM_MODE_RING) : NULL;
+	if (!shm_proc || shm_proc->rd_acquired) {
+		if (shm_proc)
+			p_shm_leave(shm_proc);
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	data = p_shm_ring_read_acquire(shm, shm_proc, shm_info->size,
+	                               &size, &pos, &next);
+	if (!data) {
+		p_shm_leave(shm_proc);
+		if (size > shm_info->size) {
+			udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+			                  "Record size (%zu) larger than buffer size (%zu)",
+			                  size, shm_info->size);
+		}
+		return -1;
+	}
+
+	memcpy(shm_info->data, data, size);
+	p_shm_ring_read_release(shm_proc, pos, next);
+
+	return size;
+}
+
+
+void *
+udo_shm_write_reserve (struct udo_shm *shm,
+                       const uint32_t proc_index,
+                       const size_t size)
+{
+	void *data;
+
+	struct udo_shm_proc *shm_proc;
+
+	if (!shm)
+		return NULL;
+
+	shm_proc = p_shm_enter_mode(shm, proc_index, SHM_MODE_RING);
+	if (!shm_proc) {
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return NULL;
+	}
+
+	/* One outstanding record per context */
+	if (shm_proc->wr_reserved) {
+		p_shm_leave(shm_proc);
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA,
+		                  "Record already reserved and not committed");
+		return NULL;
+	}
+
+	/* Segment isn't moved until record is committed */
+	data = p_shm_ring_write_reserve(shm, shm_proc, size,
+	                                &(shm_proc->wr_pos),
+	                                &(shm_proc->wr_next));
+	if (!data) {
+		p_shm_leave(shm_proc);
+		return NULL;
+	}
+
+	shm_proc->wr_reserved = 1;
+
+	return data;
+}
+
+
+int
+udo_shm_write_commit (struct udo_shm *shm,
+                      const uint32_t proc_index)
+{
+	if (!shm)
+		return -1;
+
+	if (p_check_proc_index(shm, proc_index) || \
+	    !(shm->procs[proc_index].wr_reserved))
+	{
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	shm->procs[proc_index].wr_reserved = 0;
+	p_shm_ring_write_commit(&(shm->procs[proc_index]),
+	                        shm->procs[proc_index].wr_pos,
+	                        shm->procs[proc_index].wr_next);
+
+	return 0;
+}
+
+
+const void *
+udo_shm_read_acquire (struct udo_shm *shm,
+                      const uint32_t proc_index,
+                      size_t *size)
+{
+	const void *data;
+
+	struct udo_shm_proc *shm_proc;
+
+	if (!shm)
+		return NULL;
+
+	shm_proc = (size) ? p_shm_enter_mode(shm, proc_index, SHM_MODE_RING) : NULL;
+
+	/* Second acquire would wait on its own release */
+	if (!shm_proc || shm_proc->rd_acquired) {
+		if (shm_proc)
+			p_shm_leave(shm_proc);
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return NULL;
+	}
+
+	/* Segment isn't moved until record is released */
+	data = p_shm_ring_read_acquire(shm, shm_proc, SIZE_MAX, size,
+	                               &(shm_proc->rd_pos),
+	                               &(shm_proc->rd_next));
+	if (!data) {
+		p_shm_leave(shm_proc);
+		return NULL;
+	}
+
+	shm_proc->rd_acquired = 1;
+
+	return data;
+}
+
+
+int
+udo_shm_read_release (struct udo_shm *shm,
+                      const uint32_t proc_index)
+{
+	if (!shm)
+		return -1;
+
+	if (p_check_proc_index(shm, proc_index) || \
+	    !(shm->procs[proc_index].rd_acquired))
+	{
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	shm->procs[proc_index].rd_acquired = 0;
+	p_shm_ring_read_release(&(shm->procs[proc_index]),
+	                        shm->procs[proc_index].rd_pos,
+	                        shm->procs[proc_index].rd_next);
+
+	return 0;
+}
+
+/*********************************
+ * End of udo_shm_ring functions *
+ *********************************/
+
+
+/************************************
+ * Start of udo_shm_bcast functions *
+ ************************************/
+
+UDO_STATIC_INLINE
+uint32_t *
+p_shm_bcast_get_hdr (const struct udo_shm_proc *shm_proc,
+                     const uint64_t off)
+{
+	return (uint32_t *) ((char*)(shm_proc->bcast+1) + off);
+}
+
+
+/*
+ * Enters the gate of a processes broadcast segment if
+ * @reader is subscribed. Returns NULL without entering
+ * otherwise.
+ */
+static struct udo_shm_proc *
+p_shm_enter_bcast_reader (struct udo_shm *shm,
+                          const uint32_t proc_index,
+                          const uint32_t reader)
+{
+	struct udo_shm_proc *shm_proc;
+
+	shm_proc = p_shm_enter_mode(shm, proc_index, SHM_MODE_BCAST);
+	if (!shm_proc)
+		return NULL;
+
+	if (reader >= SHM_BCAST_READER_MAX || \
+	    __atomic_load_n(&(shm_proc->bcast->readers[reader].active), \
+	                    __ATOMIC_ACQUIRE) != SHM_BCAST_READER_ACTIVE)
+	{
+		p_shm_leave(shm_proc);
+		return NULL;
+	}
+
+	return shm_proc;
+}
+
+
+/*
+ * Returns position of the slowest subscriber still
+ * reading stored records. Subscribers that fell
+ * behind @tail were already skipped over.
+ */
+static uint64_t
+p_shm_bcast_slowest (struct udo_shm_bcast *bcast,
+                     const uint64_t tail)
+{
+	uint32_t r;
+
+	uint64_t pos, slowest = UINT64_MAX;
+
+	for (r = 0; r < SHM_BCAST_READER_MAX; r++) {
+		if (__atomic_load_n(&bcast->readers[r].active, \
+		    __ATOMIC_ACQUIRE) != SHM_BCAST_READER_ACTIVE)
+		{
+			continue;
+		}
+
+		pos = __atomic_load_n(&bcast->readers[r].pos, __ATOMIC_ACQUIRE);
+		if (pos >= tail && pos < slowest)
+			slowest = pos;
+	}
+
+	return slowest;
+}
+
+
+/*
+ * Returns position of the record stored after @pos.
+ */
+static uint64_t
+p_shm_bcast_next (const struct udo_shm_proc *shm_proc,
+                  const uint64_t pos)
+{
+	uint32_t hdr;
+
+	uint64_t off = pos % shm_proc->bcast_sz;
+
+	hdr = *p_shm_bcast_get_hdr(shm_proc, off);
+	if (hdr == SHM_RING_WRAP)
+		return pos + shm_proc->bcast_sz - off;
+
+	return pos + UDO_BYTE_ALIGN(SHM_RING_HDR_SIZE + hdr, SHM_RING_HDR_SIZE);
+}
+
+
+/*
+ * Copies a quiescent broadcast ring to a grown segment.
+ * Subscriber positions are rebased along with records.
+ */
+static void
+p_shm_bcast_move (struct udo_shm_proc *dst,
+                  const struct udo_shm_proc *src)
+{
+	uint32_t r;
+
+	uint64_t head, pos[SHM_BCAST_READER_MAX+1];
+
+	for (r = 0; r < SHM_BCAST_READER_MAX; r++)
+		pos[r] = __atomic_load_n(&(src->bcast->readers[r].pos), __ATOMIC_RELAXED);
+
+	pos[r] = __atomic_load_n(&(src->bcast->tail), __ATOMIC_RELAXED);
+	head = __atomic_load_n(&(src->bcast->head), __ATOMIC_RELAXED);
+
+	head = p_shm_ring_copy((unsigned char *)(dst->bcast+1), dst->bcast_sz,
+	                       (const unsigned char *)(src->bcast+1), src->bcast_sz,
+	                       pos[r], head, pos, SHM_BCAST_READER_MAX+1);
+
+	for (r = 0; r < SHM_BCAST_READER_MAX; r++) {
+		__atomic_store_n(&(dst->bcast->readers[r].pos), pos[r], __ATOMIC_RELAXED);
+		__atomic_store_n(&(dst->bcast->readers[r].next), pos[r], __ATOMIC_RELAXED);
+		__atomic_store_n(&(dst->bcast->readers[r].active), \
+			__atomic_load_n(&(src->bcast->readers[r].active), \
+			                __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+	}
+
+	__atomic_store_n(&(dst->bcast->tail), pos[r], __ATOMIC_RELAXED);
+	__atomic_store_n(&(dst->bcast->head), head, __ATOMIC_RELAXED);
+}
+
+
+ssize_t
+udo_shm_bcast_write (struct udo_shm *shm,
+                     const void *p_shm_info)
+{
+	uint32_t s, val, moving;
+
+	uint64_t head, tail, slowest, off, pad, need;
+
+	struct udo_shm_bcast *bcast;
+	struct udo_shm_proc *shm_proc;
+	const struct udo_shm_data_info *shm_info = p_shm_info;
+
+	if (!shm)
+		return -1;
+
+	shm_proc = (shm_info && shm_info->data) ? \
+		p_shm_enter_mode(shm, shm_info->proc_index, SHM_MODE_BCAST) : NULL;
+	if (!shm_proc) {
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	bcast = shm_proc->bcast;
+
+	need = UDO_BYTE_ALIGN(SHM_RING_HDR_SIZE + shm_info->size, SHM_RING_HDR_SIZE);
+	if (need > (shm_proc->bcast_sz >> 1)) {
+		p_shm_leave(shm_proc);
+		udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+		                  "Record size (%zu) exceeds ring limit (%zu)",
+		                  shm_info->size, (shm_proc->bcast_sz >> 1) - \
+		                  SHM_RING_HDR_SIZE);
+		return -1;
+	}
+
+	p_shm_lock(&bcast->wr_lock);
+
+	/*
+	 * Reclaim oldest records until the new record fits. Records
+	 * the slowest subscriber hasn't read are only reclaimed
+	 * if the producer was told to skip slow subscribers.
+	 */
+	for (s = 0;;) {
+		head = __atomic_load_n(&bcast->head, __ATOMIC_RELAXED);
+		tail = __atomic_load_n(&bcast->tail, __ATOMIC_RELAXED);
+		off = head % shm_proc->bcast_sz;
+		pad = (off + need > shm_proc->bcast_sz) ? shm_proc->bcast_sz - off : 0;
+		if (head + pad + need - tail <= shm_proc->bcast_sz)
+			break;
+
+		slowest = p_shm_bcast_slowest(bcast, tail);
+		if (shm->bcast_skip_slow || tail < slowest) {
+			__atomic_store_n(&bcast->tail, p_shm_bcast_next(shm_proc, tail), \
+			                 __ATOMIC_RELEASE);
+			continue;
+		}
+
+		if (s++ < SHM_RING_SPIN_CNT) {
+			UDO_CPU_RELAX();
+			continue;
+		}
+
+		__atomic_add_fetch(&bcast->wr_waiting, 1, __ATOMIC_SEQ_CST);
+
+		val = __atomic_load_n(&bcast->tail_fux, __ATOMIC_SEQ_CST);
+		moving = __atomic_load_n(&(shm_proc->entry->gate), \
+			__ATOMIC_SEQ_CST) & SHM_GATE_MOVING;
+		if (!moving && p_shm_bcast_slowest(bcast, tail) == slowest)
+			futex(&bcast->tail_fux, FUTEX_WAIT, val, NULL, NULL, 0);
+
+		__atomic_sub_fetch(&bcast->wr_waiting, 1, __ATOMIC_SEQ_CST);
+
+		if (!moving)
+			continue;
+
+		/* Nothing written yet, retry at new location */
+		p_shm_unlock(&bcast->wr_lock);
+		if (p_shm_reenter(shm, shm_proc) == -1) {
+			p_shm_leave(shm_proc);
+			return -1;
+		}
+
+		bcast = shm_proc->bcast;
+		p_shm_lock(&bcast->wr_lock);
+	}
+
+	/*
+	 * Order tail store before overwriting reclaimed records
+	 * so that subscribers may detect torn reads.
+	 */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	if (pad) {
+		*p_shm_bcast_get_hdr(shm_proc, off) = SHM_RING_WRAP;
+		off = 0;
+	}
+
+	*p_shm_bcast_get_hdr(shm_proc, off) = shm_info->size;
+	memcpy((char*)p_shm_bcast_get_hdr(shm_proc, off) + SHM_RING_HDR_SIZE, \
+	       shm_info->data, shm_info->size);
+
+	__atomic_store_n(&bcast->head, head + pad + need, __ATOMIC_RELEASE);
+
+	p_shm_unlock(&bcast->wr_lock);
+	p_shm_ring_wake(&bcast->head_fux, &bcast->rd_waiting);
+	p_shm_signal(shm_proc);
+	p_shm_leave(shm_proc);
+
+	return shm_info->size;
+}
+
+
+int
+udo_shm_bcast_subscribe (struct udo_shm *shm,
+                         const uint32_t proc_index)
+{
+	uint32_t r;
+
+	uint64_t head;
+
+	struct udo_shm_proc *shm_proc;
+	struct udo_shm_bcast *bcast;
+	struct udo_shm_bcast_reader *reader;
+
+	if (!shm)
+		return -1;
+
+	shm_proc = p_shm_enter_mode(shm, proc_index, SHM_MODE_BCAST);
+	if (!shm_proc) {
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	bcast = shm_proc->bcast;
+
+	for (r = 0; r < SHM_BCAST_READER_MAX; r++) {
+		reader = &(bcast->readers[r]);
+		if (!__atomic_compare_exchange_n(&reader->active, \
+			&(udo_atomic_u32){SHM_BCAST_READER_FREE}, \
+			SHM_BCAST_READER_JOINING, 0, __ATOMIC_ACQUIRE, \
+			__ATOMIC_RELAXED))
+		{
+			continue;
+		}
+
+		/* New subscribers only receive future records */
+		head = __atomic_load_n(&bcast->head, __ATOMIC_ACQUIRE);
+		__atomic_store_n(&reader->pos, head, __ATOMIC_RELAXED);
+		__atomic_store_n(&reader->next, head, __ATOMIC_RELAXED);
+		__atomic_store_n(&reader->active, SHM_BCAST_READER_ACTIVE, \
+		                 __ATOMIC_RELEASE);
+
+		p_shm_leave(shm_proc);
+		return r;
+	}
+
+	p_shm_leave(shm_proc);
+	udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+	                  "Subscriber limit (%u) reached",
+	                  SHM_BCAST_READER_MAX);
+
+	return -1;
+}
+
+
+int
+udo_shm_bcast_unsubscribe (struct udo_shm *shm,
+                           const uint32_t proc_index,
+                           const uint32_t reader)
+{
+	struct udo_shm_proc *shm_proc;
+	struct udo_shm_bcast *bcast;
+
+	if (!shm)
+		return -1;
+
+	shm_proc = p_shm_enter_bcast_reader(shm, proc_index, reader);
+	if (!shm_proc) {
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	bcast = shm_proc->bcast;
+
+	__atomic_store_n(&(bcast->readers[reader].active), \
+	                 SHM_BCAST_READER_FREE, __ATOMIC_RELEASE);
+	p_shm_ring_wake(&bcast->tail_fux, &bcast->wr_waiting);
+	p_shm_leave(shm_proc);
+
+	return 0;
+}
+
+
+const void *
+udo_shm_bcast_read_acquire (struct udo_shm *shm,
+                            const uint32_t proc_index,
+                            const uint32_t reader,
+                            size_t *size)
+{
+	uint32_t s, hdr;
+
+	uint64_t head, tail, pos, off;
+
+	struct udo_shm_proc *shm_proc;
+	struct udo_shm_bcast *bcast;
+	struct udo_shm_bcast_reader *rd;
+
+	if (!shm)
+		return NULL;
+
+	shm_proc = (size) ? p_shm_enter_bcast_reader(shm, proc_index, reader) : NULL;
+
+	/* Second acquire would skip the acquired record */
+	if (!shm_proc || \
+	    (__atomic_load_n(&shm_proc->bcast_acquired, __ATOMIC_RELAXED) & (1U << reader)))
+	{
+		if (shm_proc)
+			p_shm_leave(shm_proc);
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return NULL;
+	}
+
+	bcast = shm_proc->bcast;
+	rd = &(bcast->readers[reader]);
+
+	pos = __atomic_load_n(&rd->pos, __ATOMIC_RELAXED);
+
+	for (s = 0;;) {
+		/* Only sleep if caught up with producer */
+		head = __atomic_load_n(&bcast->head, __ATOMIC_ACQUIRE);
+		if (head == pos) {
+			if (s++ < SHM_RING_SPIN_CNT) {
+				UDO_CPU_RELAX();
+			} else if (p_shm_ring_sleep(shm_proc, &bcast->head_fux, \
+			           &bcast->rd_waiting, &bcast->head, head) == -1)
+			{
+				/* Nothing read yet, retry at new location */
+				if (p_shm_reenter(shm, shm_proc) == -1) {
+					p_shm_leave(shm_proc);
+					return NULL;
+				}
+
+				bcast = shm_proc->bcast;
+				rd = &(bcast->readers[reader]);
+				pos = __atomic_load_n(&rd->pos, __ATOMIC_RELAXED);
+			}
+			continue;
+		}
+
+		/* Producer reclaimed records not yet read */
+		tail = __atomic_load_n(&bcast->tail, __ATOMIC_ACQUIRE);
+		if (pos < tail)
+			pos = tail;
+
+		off = pos % shm_proc->bcast_sz;
+		hdr = *p_shm_bcast_get_hdr(shm_proc, off);
+
+		/* Header may be overwritten while being read */
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (pos < __atomic_load_n(&bcast->tail, __ATOMIC_RELAXED))
+			continue;
+
+		if (hdr == SHM_RING_WRAP) {
+			pos += shm_proc->bcast_sz - off;
+			continue;
+		}
+
+		break;
+	}
+
+	__atomic_store_n(&rd->pos, pos, __ATOMIC_RELEASE);
+	__atomic_store_n(&rd->next, pos + UDO_BYTE_ALIGN(SHM_RING_HDR_SIZE + \
+		hdr, SHM_RING_HDR_SIZE), __ATOMIC_RELAXED);
+	__atomic_or_fetch(&shm_proc->bcast_acquired, 1U << reader, __ATOMIC_RELAXED);
+
+	*size = hdr;
+
+	/* Segment isn't moved until record is released */
+	return (char*)p_shm_bcast_get_hdr(shm_proc, off) + SHM_RING_HDR_SIZE;
+}
+
+
+int
+udo_shm_bcast_read_release (struct udo_shm *shm,
+                            const uint32_t proc_index,
+                            const uint32_t reader)
+{
+	int ret = 0;
+
+	uint64_t pos;
+
+	struct udo_shm_proc *shm_proc;
+	struct udo_shm_bcast *bcast;
+	struct udo_shm_bcast_reader *rd;
+
+	if (!shm)
+		return -1;
+
+	if (p_check_proc_index(shm, proc_index) || \
+	    reader >= SHM_BCAST_READER_MAX || \
+	    !(__atomic_load_n(&(shm->procs[proc_index].bcast_acquired), \
+	                      __ATOMIC_RELAXED) & (1U << reader)))
+	{
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	/* Gate was entered on acquire */
+	shm_proc = &(shm->procs[proc_index]);
+	__atomic_and_fetch(&shm_proc->bcast_acquired, ~(1U << reader), __ATOMIC_RELAXED);
+
+	bcast = shm_proc->bcast;
+	rd = &(bcast->readers[reader]);
+
+	pos = __atomic_load_n(&rd->pos, __ATOMIC_RELAXED);
+
+	/*
+	 * Pairs with the producers release fence. If the
+	 * producer reclaimed the record while it was being
+	 * read the caller must discard what it read.
+	 */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (pos < __atomic_load_n(&bcast->tail, __ATOMIC_RELAXED)) {
+		__atomic_store_n(&rd->pos, \
+			__atomic_load_n(&bcast->tail, __ATOMIC_RELAXED), \
+			__ATOMIC_RELEASE);
+		udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+		                  "Record overwritten before release");
+		ret = -1;
+	} else {
+		__atomic_store_n(&rd->pos, __atomic_load_n(&rd->next, \
+			__ATOMIC_RELAXED), __ATOMIC_RELEASE);
+		p_shm_ring_wake(&bcast->tail_fux, &bcast->wr_waiting);
+	}
+
+	p_shm_leave(shm_proc);
+
+	return ret;
+}
+
+/**********************************
+ * End of udo_shm_bcast functions *
+ **********************************/
+
+
+/*************************************
+ * Start of udo_shm_latest functions *
+ *************************************/
+
+ssize_t
+udo_shm_latest_write (struct udo_shm *shm,
+                      const void *p_shm_info)
+{
+	uint32_t seq;
+
+	struct udo_shm_proc *shm_proc;
+	struct udo_shm_latest *latest;
+	const struct udo_shm_data_info *shm_info = p_shm_info;
+
+	if (!shm)
+		return -1;
+
+	shm_proc = (shm_info && shm_info->data) ? \
+		p_shm_enter_mode(shm, shm_info->proc_index, SHM_MODE_LATEST) : NULL;
+	if (!shm_proc) {
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	latest = shm_proc->latest;
+
+	if (shm_info->size > shm_proc->latest_sz) {
+		p_shm_leave(shm_proc);
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA,
+		                  "Data size (%zu) exceeds segment size (%zu)",
+		                  shm_info->size, shm_proc->latest_sz);
+		return -1;
+	}
+
+	/* Odd sequence informs readers a write is in progress */
+	seq = __atomic_load_n(&latest->seq, __ATOMIC_RELAXED);
+	__atomic_store_n(&latest->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	__atomic_store_n(&latest->size, shm_info->size, __ATOMIC_RELAXED);
+	p_shm_copy(latest+1, shm_info->data,
+	           shm_info->size, shm_info->non_temporal);
+
+	__atomic_store_n(&latest->seq, seq + 2, __ATOMIC_RELEASE);
+	p_shm_signal(shm_proc);
+	p_shm_leave(shm_proc);
+
+	return shm_info->size;
+}
+
+
+ssize_t
+udo_shm_latest_read (struct udo_shm *shm,
+                     const void *p_shm_info)
+{
+	uint32_t seq, size;
+
+	struct udo_shm_proc *shm_proc;
+	struct udo_shm_latest *latest;
+	const struct udo_shm_data_info *shm_info = p_shm_info;
+
+	if (!shm)
+		return -1;
+
+	shm_proc = (shm_info && shm_info->data) ? \
+		p_shm_enter_mode(shm, shm_info->proc_index, SHM_MODE_LATEST) : NULL;
+	if (!shm_proc) {
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	latest = shm_proc->latest;
+
+	/* Retry if producer wrote a new value while copying */
+	for (;;) {
+		seq = __atomic_load_n(&latest->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			UDO_CPU_RELAX();
+			continue;
+		}
+
+		size = __atomic_load_n(&latest->size, __ATOMIC_RELAXED);
+		if (size <= shm_info->size)
+			memcpy(shm_info->data, latest+1, size);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&latest->seq, __ATOMIC_RELAXED) == seq)
+			break;
+	}
+
+	p_shm_leave(shm_proc);
+
+	if (size > shm_info->size) {
+		udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+		                  "Value size (%u) larger than buffer size (%zu)",
+		                  size, shm_info->size);
+		return -1;
+	}
+
+	return size;
+}
+
+/***********************************
+ * End of udo_shm_latest functions *
+ ***********************************/
+
+
+/*********************************
+ * Start of udo_shm_mm functions *
+ *********************************/
+
+/*
+ * Returns byte offset of the heap from the
+ * start of a processes segment.
  */
-#define SHM_PROC_MAX (1<<4)
-#define SHM_FILE_NAME_MAX (1<<5)
+UDO_STATIC_INLINE
+uint64_t
+p_shm_mm_heap_off (const struct udo_shm_proc *shm_proc)
+{
+	return (uintptr_t)(shm_proc->mm+1) - (uintptr_t)shm_proc->data;
+}
+
+
+UDO_STATIC_INLINE
+struct udo_shm_mm_blk *
+p_shm_mm_get_blk (const struct udo_shm_proc *shm_proc,
+                  const uint64_t offset)
+{
+	return (struct udo_shm_mm_blk *) \
+		((char*)shm_proc->data + offset - sizeof(struct udo_shm_mm_blk));
+}
 
-#define UDO_FUTEX_LOCK 1
-#define UDO_FUTEX_UNLOCK 0
 
 /*
- * @brief Structure defining the udo_shm_proc
- *        (UDO Shared Memory Process) context.
- *
- * @member rd_fux  - Pointer to a given process read futex
- *                   stored in front segment of shared memory.
- * @member wr_fux  - Pointer to a given process write futex
- *                   stored in front segment of shared memory.
- * @member data    - Pointer to an unsigned char storing location
- *                   within shared memory. This pointer is a
- *                   given processes shared memory segment
- *                   staring address.
- * @member data_sz - Stores the size of a given processes
- *                   shared memory segment.
+ * Returns offset of a free block popped from
+ * the size class free list or zero if empty.
  */
-struct udo_shm_proc
+static uint64_t
+p_shm_mm_pop (struct udo_shm_proc *shm_proc,
+              const uint32_t cls)
 {
-	udo_atomic_u32  *rd_fux;
-	udo_atomic_u32  *wr_fux;
-	udo_atomic_addr data;
-	size_t          data_sz;
-};
+	uint32_t index;
+	uint64_t head, next;
+
+	struct udo_shm_mm_blk *blk;
+	struct udo_shm_mm *mm = shm_proc->mm;
+
+	head = __atomic_load_n(&(mm->free[cls]), __ATOMIC_ACQUIRE);
+	for (;;) {
+		index = (uint32_t) head;
+		if (!index)
+			return 0;
+
+		/*
+		 * Block may be popped and reused by another process
+		 * before the compare exchange. Next index read is
+		 * then stale but tag mismatch causes a retry.
+		 */
+		blk = p_shm_mm_get_blk(shm_proc, (uint64_t)index * SHM_MM_ALIGN);
+		next = __atomic_load_n(&blk->next, __ATOMIC_RELAXED);
+		next |= ((head >> 32) + 1) << 32;
+
+		if (__atomic_compare_exchange_n(&(mm->free[cls]), &head, next, 1,
+		                                __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+		{
+			return (uint64_t)index * SHM_MM_ALIGN;
+		}
+	}
+}
+
+
+static void
+p_shm_mm_push (struct udo_shm_proc *shm_proc,
+               const uint32_t cls,
+               const uint64_t offset)
+{
+	uint64_t head, next;
+
+	struct udo_shm_mm_blk *blk;
+	struct udo_shm_mm *mm = shm_proc->mm;
+
+	blk = p_shm_mm_get_blk(shm_proc, offset);
+	head = __atomic_load_n(&(mm->free[cls]), __ATOMIC_RELAXED);
+	do {
+		__atomic_store_n(&blk->next, (uint32_t)head, __ATOMIC_RELAXED);
+		next = (((head >> 32) + 1) << 32) | (offset / SHM_MM_ALIGN);
+	} while (!__atomic_compare_exchange_n(&(mm->free[cls]), &head, next, 1,
+	                                      __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
 
 
 /*
- * @brief Structure defining the udo_shm
- *        (UDO Shared Memory) context.
- *
- * @member err      - Stores information about the error that occured
- *                    for the given context and may later be retrieved
- *                    by caller.
- * @member free     - If structure allocated with calloc(3) member will be
- *                    set to true so that, we know to call free(3) when
- *                    destroying the context.
- * @member fd       - Open file descriptor to POSIX shared memory.
- * @member shm_file - Name of the POSIX shared memory file starting with '/'.
- * @member data     - Pointer to mmap(2) map'd shared memory data.
- * @member data_sz  - Total size of the shared memory region mapped with mmap(2).
- * @member procs    - An array storing the shared memory locations
- *                    of each processes futexes and data.
+ * Returns offset of a block carved from memory
+ * never handed out or zero if heap is exhausted.
  */
-struct udo_shm
+static uint64_t
+p_shm_mm_bump (struct udo_shm_proc *shm_proc,
+               const uint32_t cls)
 {
-	struct udo_log_error_struct err;
-	uint8_t                     free;
-	int                         fd;
-	char                        shm_file[SHM_FILE_NAME_MAX];
-	void                        *data;
-	size_t                      data_sz;
-	struct udo_shm_proc         procs[SHM_PROC_MAX];
-};
+	uint64_t brk, blk_sz, offset;
 
+	struct udo_shm_mm_blk *blk;
+	struct udo_shm_mm *mm = shm_proc->mm;
 
-/*************************************
- * Start of udo_shm_create functions *
- *************************************/
+	blk_sz = 1ULL << (cls + SHM_MM_CLASS_SHIFT);
+	brk = __atomic_load_n(&mm->brk, __ATOMIC_RELAXED);
+	do {
+		if (brk + blk_sz > shm_proc->mm_sz)
+			return 0;
+	} while (!__atomic_compare_exchange_n(&mm->brk, &brk, brk + blk_sz, 1,
+	                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED));
 
-static int
-p_shm_create (struct udo_shm *shm,
-              const struct udo_shm_create_info *shm_info)
+	offset = p_shm_mm_heap_off(shm_proc) + brk + sizeof(struct udo_shm_mm_blk);
+	blk = p_shm_mm_get_blk(shm_proc, offset);
+	__atomic_store_n(&blk->cls, cls, __ATOMIC_RELAXED);
+
+	return offset;
+}
+
+
+uint64_t
+udo_shm_mm_alloc (struct udo_shm *shm,
+                  const uint32_t proc_index,
+                  const size_t size)
 {
-	uint32_t p;
+	uint32_t cls;
+	uint64_t offset;
 
-	int err = -1, len;
+	struct udo_shm_proc *shm_proc;
 
-	size_t data_off, fux_off, proc_data_sz;
+	if (!shm)
+		return 0;
 
-	if (!shm_info) {
+	shm_proc = (size && \
+	            size <= (1ULL << (SHM_MM_CLASS_MAX + SHM_MM_CLASS_SHIFT - 1)) - \
+	                    sizeof(struct udo_shm_mm_blk)) ? \
+		p_shm_enter_mode(shm, proc_index, SHM_MODE_MM) : NULL;
+	if (!shm_proc) {
 		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
-		return -1;
+		return 0;
 	}
 
-	if (!(shm_info->proc_count) || \
-	    shm_info->proc_count >= SHM_PROC_MAX)
-	{
-		udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
-		                  "Unsupported process count (%u:%u)",
-		                  shm_info->proc_count, SHM_PROC_MAX);
-		return -1;
-	}
+	/* Smallest power of two fitting both header and payload */
+	cls = (64 - __builtin_clzll(size + sizeof(struct udo_shm_mm_blk) - 1)) - \
+		SHM_MM_CLASS_SHIFT;
 
-	if (!(shm_info->shm_size)) {
-		udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
-		                  "Shared memory size must not be zero",
-		                  shm_info->shm_size);
-		return -1;
-	}
+	offset = p_shm_mm_pop(shm_proc, cls);
+	if (!offset)
+		offset = p_shm_mm_bump(shm_proc, cls);
 
-	if (shm_info->shm_file[0] != '/') {
+	if (!offset) {
+		p_shm_leave(shm_proc);
 		udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
-		                  "Shared memory file name '%s' doesn't start with '/'",
-		                  shm_info->shm_file);
-		return -1;
+		                  "Allocation of %zu bytes exceeds free segment space",
+		                  size);
+		return 0;
 	}
 
-	len = strnlen(shm_info->shm_file, SHM_FILE_NAME_MAX);
-	if (len >= SHM_FILE_NAME_MAX) {
-		udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
-		                  "Shared memory '%s' name length to long",
-		                  shm_info->shm_file);
-		return -1;
-	}
+	__atomic_store_n(&(p_shm_mm_get_blk(shm_proc, offset)->state),
+	                 SHM_MM_BLK_USED, __ATOMIC_RELAXED);
+	p_shm_leave(shm_proc);
+
+	return offset;
+}
 
-	strncpy(shm->shm_file, shm_info->shm_file, len);
-	shm->fd = shm_open(shm->shm_file, O_RDWR|O_CREAT, 0644);
-	if (shm->fd == -1) {
-		udo_log_set_error(shm, errno, "shm_open: %s", strerror(errno));
+
+int
+udo_shm_mm_free (struct udo_shm *shm,
+                 const uint32_t proc_index,
+                 const uint64_t offset)
+{
+	uint32_t cls, state = SHM_MM_BLK_USED;
+
+	struct udo_shm_mm_blk *blk;
+	struct udo_shm_proc *shm_proc;
+
+	if (!shm)
 		return -1;
-	}
 
-	shm->data_sz = shm_info->shm_size;
-	err = ftruncate(shm->fd, shm->data_sz);
-	if (err == -1) {
-		udo_log_set_error(shm, errno, "ftruncate: %s", strerror(errno));
+	shm_proc = p_shm_enter_mode(shm, proc_index, SHM_MODE_MM);
+	if (!shm_proc) {
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
 		return -1;
 	}
 
-	shm->data = mmap(NULL, shm->data_sz,
-	                 PROT_READ|PROT_WRITE,
-	                 MAP_SHARED, shm->fd, 0);
-	if (err == -1) {
-		udo_log_set_error(shm, errno, "mmap: %s", strerror(errno));
+	if (offset & (SHM_MM_ALIGN-1) || \
+	    offset < p_shm_mm_heap_off(shm_proc) + sizeof(struct udo_shm_mm_blk) || \
+	    offset >= p_shm_mm_heap_off(shm_proc) + \
+	              __atomic_load_n(&(shm_proc->mm->brk), __ATOMIC_RELAXED))
+	{
+		p_shm_leave(shm_proc);
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA,
+		                  "Offset (%lu) not allocated from segment",
+		                  offset);
 		return -1;
 	}
 
-	/*
-	 * First 4 bytes of shared memory used to store
-	 * amount of processes watching shared memory.
-	 *
-	 * The next X amount of bytes (2 * 4 * proc_count)
-	 * stores each processes read/write futexes.
-	 */
-	if (__atomic_load_n((udo_atomic_u32*)shm->data, \
-	    __ATOMIC_ACQUIRE) >= shm_info->proc_count)
+	/* Catches double frees without taking a lock */
+	blk = p_shm_mm_get_blk(shm_proc, offset);
+	if (!__atomic_compare_exchange_n(&blk->state, &state, SHM_MM_BLK_FREE, 0,
+	                                 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
 	{
-		udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
-		                  "Unsupported process count (%u:%u)",
-		                  shm_info->proc_count, SHM_PROC_MAX);
+		p_shm_leave(shm_proc);
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA,
+		                  "Offset (%lu) isn't an allocated block",
+		                  offset);
 		return -1;
 	}
 
-	__atomic_add_fetch((udo_atomic_u32*)shm->data, 1, __ATOMIC_SEQ_CST);
+	cls = __atomic_load_n(&blk->cls, __ATOMIC_RELAXED);
+	p_shm_mm_push(shm_proc, cls, offset);
+	p_shm_leave(shm_proc);
 
-	fux_off = sizeof(udo_atomic_u32);
-	data_off = fux_off + (2 * sizeof(udo_atomic_u32) * shm_info->proc_count);
-	proc_data_sz = (shm->data_sz - data_off) / shm_info->proc_count;
+	return 0;
+}
 
-	for (p = 0; p < shm_info->proc_count; p++) {
-		shm->procs[p].data_sz = proc_data_sz;
-		shm->procs[p].data = (udo_atomic_addr)((char*)shm->data + data_off);
 
-		shm->procs[p].rd_fux = (udo_atomic_u32*)((char*)shm->data + fux_off);
-		shm->procs[p].wr_fux = (udo_atomic_u32*)((char*)shm->data + \
-				fux_off + sizeof(udo_atomic_u32));
+void *
+udo_shm_mm_get_addr (struct udo_shm *shm,
+                     const uint32_t proc_index,
+                     const uint64_t offset)
+{
+	void *addr;
 
-		/* Initialize read futex to lock state */
-		__atomic_compare_exchange_n(shm->procs[p].rd_fux, \
-			&(udo_atomic_u32){UDO_FUTEX_UNLOCK}, \
-			UDO_FUTEX_LOCK, 0, __ATOMIC_SEQ_CST, \
-			__ATOMIC_SEQ_CST);
+	struct udo_shm_proc *shm_proc;
 
-		/* Initialize write futex to unlocked state (just in case). */
-		__atomic_compare_exchange_n(shm->procs[p].wr_fux, \
-			&(udo_atomic_u32){UDO_FUTEX_UNLOCK}, \
-			UDO_FUTEX_UNLOCK, 0, __ATOMIC_SEQ_CST, \
-			__ATOMIC_SEQ_CST);
+	if (!shm)
+		return NULL;
 
-		data_off += proc_data_sz;
-		fux_off += (2 * sizeof(udo_atomic_u32));
+	shm_proc = (offset) ? p_shm_enter_mode(shm, proc_index, SHM_MODE_MM) : NULL;
+	if (!shm_proc || offset >= shm_proc->data_sz) {
+		if (shm_proc)
+			p_shm_leave(shm_proc);
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return NULL;
 	}
 
-	return 0;
+	/* Address is valid until segment is grown */
+	addr = (char*)shm_proc->data + offset;
+	p_shm_leave(shm_proc);
+
+	return addr;
 }
 
 
-struct udo_shm *
-udo_shm_create (struct udo_shm *p_shm,
-                const void *p_shm_info)
+uint64_t
+udo_shm_mm_get_offset (struct udo_shm *shm,
+                       const uint32_t proc_index,
+                       const void *addr)
 {
-	int err = -1;
+	uint64_t offset;
 
-	struct udo_shm *shm = p_shm;
-
-	const struct udo_shm_create_info *shm_info = p_shm_info;
+	struct udo_shm_proc *shm_proc;
 
-	if (!shm) {
-		shm = calloc(1, sizeof(struct udo_shm));
-		if (!shm) {
-			udo_log_error("calloc: %s\n", strerror(errno));
-			return NULL;
-		}
+	if (!shm)
+		return 0;
 
-		shm->free = true;
+	shm_proc = p_shm_enter_mode(shm, proc_index, SHM_MODE_MM);
+	if (!shm_proc || \
+	    (uintptr_t)addr <= (uintptr_t)shm_proc->data || \
+	    (uintptr_t)addr >= (uintptr_t)shm_proc->data + shm_proc->data_sz)
+	{
+		if (shm_proc)
+			p_shm_leave(shm_proc);
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return 0;
 	}
 
-	err = p_shm_create(shm, shm_info);
-	if (err == -1) {
-		udo_log_error("%s\n", udo_log_get_error(shm));
-		udo_shm_destroy(shm);
-		return NULL;
-	}
+	offset = (uintptr_t)addr - (uintptr_t)shm_proc->data;
+	p_shm_leave(shm_proc);
 
-	return shm;
+	return offset;
 }
 
-/***********************************
- * End of udo_shm_create functions *
- ***********************************/
+/*******************************
+ * End of udo_shm_mm functions *
+ *******************************/
 
 
 /***********************************
- * Start of udo_shm_data functions *
+ * Start of udo_shm_grow functions *
  ***********************************/
 
-UDO_STATIC_INLINE
-uint8_t
-p_check_proc_index (struct udo_shm *shm,
-                    const uint32_t proc_index)
+/*
+ * Wakes waiters sleeping inside the gate of a segment
+ * being moved so that they leave the gate.
+ */
+static void
+p_shm_grow_wake (const struct udo_shm_proc *shm_proc,
+                 const uint32_t mode)
 {
-	return proc_index > __atomic_load_n((udo_atomic_u32*) \
-			shm->data, __ATOMIC_ACQUIRE);
+	if (mode == SHM_MODE_RING) {
+		p_shm_ring_wake(&(shm_proc->ring->head_fux), &(shm_proc->ring->rd_waiting));
+		p_shm_ring_wake(&(shm_proc->ring->tail_fux), &(shm_proc->ring->wr_waiting));
+	} else if (mode == SHM_MODE_BCAST) {
+		p_shm_ring_wake(&(shm_proc->bcast->head_fux), &(shm_proc->bcast->rd_waiting));
+		p_shm_ring_wake(&(shm_proc->bcast->tail_fux), &(shm_proc->bcast->wr_waiting));
+	}
 }
 
 
-int
-udo_shm_data_read (struct udo_shm *shm,
-                   const void *p_shm_info)
+/*
+ * Caller holds the grow lock. Grown segment is appended
+ * to the end of shared memory. Peers are kept out of the
+ * segment while it's copied and remap on next access.
+ */
+static int
+p_shm_grow (struct udo_shm *shm,
+            struct udo_shm_proc *shm_proc,
+            const size_t size)
 {
-	int data;
+	int err = -1;
 
-	size_t s;
+	uint32_t gate, mode;
 
-	const struct udo_shm_proc *shm_proc;
-	const struct udo_shm_data_info *shm_info = p_shm_info;
+	size_t off, total, start, end;
 
-	if (!shm)
+	struct udo_shm_proc src, dst;
+
+	struct udo_shm_hdr *hdr = p_shm_get_hdr(shm);
+	struct udo_shm_dir_entry *entry = shm_proc->entry;
+
+	memset(&src, 0, sizeof(src));
+	memset(&dst, 0, sizeof(dst));
+
+	/* Peer may have grown segment while waiting on lock */
+	src.data_sz = __atomic_load_n(&entry->size, __ATOMIC_RELAXED);
+	if (size <= src.data_sz)
+		return 0;
+
+	off = UDO_BYTE_ALIGN(__atomic_load_n(&hdr->size, __ATOMIC_RELAXED), \
+		UDO_CACHE_LINE_SIZE);
+	total = UDO_BYTE_ALIGN(off + size, shm->page_sz);
+	if (total > SHM_MAP_MAX) {
+		udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+		                  "Shared memory size (%zu) exceeds limit (%zu)",
+		                  total, SHM_MAP_MAX);
 		return -1;
+	}
 
-	if (!shm_info || \
-	    !(shm_info->data) || \
-	    p_check_proc_index(shm, shm_info->proc_index))
-	{
-		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+	err = ftruncate(shm->fd, total);
+	if (err == -1) {
+		udo_log_set_error(shm, errno, "ftruncate: %s", strerror(errno));
 		return -1;
 	}
 
-	shm_proc = &(shm->procs[shm_info->proc_index]);
+	p_shm_lock(&shm->sync_lock);
+	err = p_shm_map(shm, total);
+	p_shm_unlock(&shm->sync_lock);
+	if (err == -1)
+		return -1;
 
-	udo_futex_lock(shm_proc->rd_fux);
-	if (errno == EINTR)
-		return -errno;
+	src.data = (udo_atomic_addr) shm->data + \
+		__atomic_load_n(&entry->off, __ATOMIC_RELAXED);
+	dst.data = (udo_atomic_addr) shm->data + off;
+	dst.data_sz = size;
+	p_shm_proc_init(&src);
+	p_shm_proc_init(&dst);
 
-	for (s = 0; s < shm_info->size; s += sizeof(int)) {
-		data = __atomic_load_n((udo_atomic_int*) \
-			((char*)shm_proc->data + s), \
-			__ATOMIC_ACQUIRE);
+	/*
+	 * Keep new accesses out, wake waiters so that they leave
+	 * and wait for reserved or acquired records to be
+	 * committed or released.
+	 */
+	gate = __atomic_or_fetch(&entry->gate, SHM_GATE_MOVING, __ATOMIC_SEQ_CST);
+	p_shm_grow_wake(&src, __atomic_load_n(&entry->mode, __ATOMIC_RELAXED));
 
-		__atomic_store_n((udo_atomic_int*) \
-			((char*)shm_info->data + s), \
-			data, __ATOMIC_RELEASE);
+	while (gate != SHM_GATE_MOVING) {
+		futex(&entry->gate, FUTEX_WAIT, gate, NULL, NULL, 0);
+		gate = __atomic_load_n(&entry->gate, __ATOMIC_ACQUIRE);
+	}
 
-		__atomic_clear((udo_atomic_int*) \
-			((char*)shm_proc->data + s),
-			__ATOMIC_RELEASE);
+	/* Ring records are laid out again to fit the new ring size */
+	mode = __atomic_load_n(&entry->mode, __ATOMIC_RELAXED);
+	if (mode == SHM_MODE_RING) {
+		p_shm_ring_move(&dst, &src);
+	} else if (mode == SHM_MODE_BCAST) {
+		p_shm_bcast_move(&dst, &src);
+	} else {
+		memcpy(dst.data, src.data, src.data_sz);
 	}
 
-	udo_futex_unlock(shm_proc->wr_fux);
+	__atomic_store_n(&entry->off, off, __ATOMIC_RELAXED);
+	__atomic_store_n(&entry->size, size, __ATOMIC_RELAXED);
+	__atomic_store_n(&hdr->size, total, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&entry->gen, 1, __ATOMIC_RELEASE);
+
+	__atomic_and_fetch(&entry->gate, ~SHM_GATE_MOVING, __ATOMIC_RELEASE);
+	futex(&entry->gate, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+
+	/* Return pages only the old location used to the backing file */
+	start = UDO_BYTE_ALIGN((uintptr_t) src.data - (uintptr_t) shm->data, shm->page_sz);
+	end = ((uintptr_t) src.data - (uintptr_t) shm->data + src.data_sz) & ~(shm->page_sz-1);
+	if (end > start)
+		fallocate(shm->fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE, start, end - start);
 
 	return 0;
 }
 
 
 int
-udo_shm_data_write (struct udo_shm *shm,
-                    const void *p_shm_info)
+udo_shm_grow (struct udo_shm *shm,
+              const uint32_t proc_index,
+              const size_t size)
 {
-	size_t s;
+	int err = -1;
 
-	const struct udo_shm_proc *shm_proc;
-	const struct udo_shm_data_info *shm_info = p_shm_info;
+	struct udo_shm_proc *shm_proc;
 
 	if (!shm)
 		return -1;
 
-	if (!shm_info || \
-	    !(shm_info->data) || \
-	    p_check_proc_index(shm, shm_info->proc_index))
-	{
+	if (!size || p_check_proc_index(shm, proc_index)) {
 		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
 		return -1;
 	}
 
-	shm_proc = &(shm->procs[shm_info->proc_index]);
-
-	udo_futex_lock(shm_proc->wr_fux);
-	if (errno == EINTR)
-		return -errno;
+	shm_proc = &(shm->procs[proc_index]);
+	if (!shm_proc->growable) {
+		udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+		                  "Shared memory not created growable");
+		return -1;
+	}
 
-	for (s = 0; s < shm_info->size; s += sizeof(int)) {
-		__atomic_store_n((udo_atomic_int*) \
-			((char*)shm_proc->data + s), \
-			*((int*)((char*)shm_info->data + s)), \
-			__ATOMIC_RELEASE);
+	/* Growth waits for records this process holds */
+	if (shm_proc->wr_reserved || shm_proc->rd_acquired || \
+	    __atomic_load_n(&shm_proc->bcast_acquired, __ATOMIC_RELAXED))
+	{
+		udo_log_set_error(shm, UDO_LOG_ERR_UNCOMMON,
+		                  "Segment (%u) has records reserved or acquired",
+		                  proc_index);
+		return -1;
 	}
 
-	udo_futex_unlock(shm_proc->rd_fux);
+	p_shm_lock(&(p_shm_get_hdr(shm)->grow_lock));
+	err = p_shm_grow(shm, shm_proc, size);
+	p_shm_unlock(&(p_shm_get_hdr(shm)->grow_lock));
 
-	return 0;
+	return err;
 }
 
 /*********************************
- * End of udo_shm_data functions *
+ * End of udo_shm_grow functions *
  *********************************/
 
 
+/**********************************
+ * Start of udo_shm_set functions *
+ **********************************/
+
+int
+udo_shm_set_event_fd (struct udo_shm *shm,
+                      const uint32_t proc_index,
+                      const int event_fd)
+{
+	int fd = -1;
+
+	struct udo_shm_proc *shm_proc;
+
+	if (!shm)
+		return -1;
+
+	if (event_fd < 0 || p_check_proc_index(shm, proc_index)) {
+		udo_log_set_error(shm, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	fd = fcntl(event_fd, F_DUPFD_CLOEXEC, 0);
+	if (fd == -1) {
+		udo_log_set_error(shm, errno, "fcntl: %s", strerror(errno));
+		return -1;
+	}
+
+	shm_proc = &(shm->procs[proc_index]);
+	if (shm_proc->event_fd != -1)
+		close(shm_proc->event_fd);
+
+	shm_proc->event_fd = fd;
+
+	return 0;
+}
+
+/********************************
+ * End of udo_shm_set functions *
+ ********************************/
+
+
 /**********************************
  * Start of udo_shm_get functions *
  **********************************/
@@ -375,14 +3014,37 @@ udo_shm_get_fd (struct udo_shm *shm)
 }
 
 
+int
+udo_shm_get_event_fd (struct udo_shm *shm,
+                      const uint32_t proc_index)
+{
+	if (!shm || p_check_proc_index(shm, proc_index))
+		return -1;
+
+	return shm->procs[proc_index].event_fd;
+}
+
+
 void *
 udo_shm_get_data (struct udo_shm *shm,
                   const uint32_t proc_index)
 {
-	if (!shm || p_check_proc_index(shm, proc_index))
+	void *data;
+
+	struct udo_shm_proc *shm_proc;
+
+	if (!shm)
+		return NULL;
+
+	shm_proc = p_shm_enter_mode(shm, proc_index, SHM_MODE_DATA);
+	if (!shm_proc)
 		return NULL;
 
-	return shm->procs[proc_index].data;
+	/* Address is valid until segment is grown */
+	data = shm_proc->data;
+	p_shm_leave(shm_proc);
+
+	return data;
 }
 
 
@@ -393,7 +3055,7 @@ udo_shm_get_data_size (struct udo_shm *shm,
 	if (!shm || p_check_proc_index(shm, proc_index))
 		return -1;
 
-	return shm->procs[proc_index].data_sz;
+	return __atomic_load_n(&(shm->procs[proc_index].entry->size), __ATOMIC_RELAXED);
 }
 
 /**********************************
@@ -408,21 +3070,39 @@ udo_shm_get_data_size (struct udo_shm *shm,
 void
 udo_shm_destroy (struct udo_shm *shm)
 {
+	uint32_t p;
+
 	int value = -1;
 
+	char path[UDO_FILE_PATH_MAX];
+
 	if (!shm)
 		return;
 
-	if (shm->data) {
-		value = (int) __atomic_sub_fetch((udo_atomic_u32*) \
-			shm->data, 1, __ATOMIC_SEQ_CST);
-		munmap(shm->data, shm->data_sz);
+	if (shm->map) {
+		if (shm->attached) {
+			value = (int) __atomic_sub_fetch( \
+				&(p_shm_get_hdr(shm)->attached), \
+				1, __ATOMIC_SEQ_CST);
+		}
+
+		munmap(shm->map, shm->map_sz);
+	}
+
+	for (p = 0; shm->procs && p < shm->proc_count; p++) {
+		if (shm->procs[p].event_fd != -1)
+			close(shm->procs[p].event_fd);
 	}
 
+	free(shm->procs);
 	close(shm->fd);
 
-	if (value == 0)
+	if (value == 0 && shm->backing == SHM_BACKING_POSIX) {
 		shm_unlink(shm->shm_file);
+	} else if (value == 0 && shm->backing == SHM_BACKING_HUGETLBFS) {
+		snprintf(path, sizeof(path), "%s%s", SHM_HUGETLBFS_DIR, shm->shm_file);
+		unlink(path);
+	}
 
 	if (shm->free) {
 		free(shm);
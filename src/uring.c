@@ -0,0 +1,691 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023-2026 Underview
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE 1
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>  /* Definition of SYS_* constants */
+#include <linux/io_uring.h>
+
+#include "log.h"
+#include "uring.h"
+
+/*
+ * Completion queue is twice the size of the submission
+ * queue. Operations in flight are tracked per completion
+ * queue entry so that completions never overflow.
+ */
+#define URING_REQ_FREE 0
+#define URING_REQ_BUSY 1
+
+/*
+ * @brief Structure defining an operation in flight. Index
+ *        in struct udo_uring { @reqs } is stored in the
+ *        submission queue entries user_data.
+ *
+ * @member func - Function called once the operation completes.
+ * @member arg  - Argument to pass to @func.
+ * @member res  - Result of the operation.
+ * @member busy - URING_REQ_{FREE,BUSY}. Released by whichever
+ *                thread runs @func.
+ */
+struct udo_uring_req
+{
+	void           (*func)(void *arg, const int res);
+	void           *arg;
+	int            res;
+	udo_atomic_u32 busy;
+};
+
+
+/*
+ * @brief Structure defining the udo_uring
+ *        (UDO io_uring) context.
+ *
+ * @member err        - Stores information about the error that occured
+ *                      for the given context and may later be retrieved
+ *                      by caller.
+ * @member free       - If structure allocated with calloc(3) member will be
+ *                      set to true so that, we know to call free(3) when
+ *                      destroying the context.
+ * @member fd         - File descriptor returned from io_uring_setup(2).
+ * @member sqpoll     - Set if kernel thread polls the submission queue.
+ * @member jpool      - Optional pool completion functions are added to.
+ * @member sq_ring    - mmap(2)'d submission queue ring.
+ * @member sq_ring_sz - Size in bytes of @sq_ring.
+ * @member cq_ring    - mmap(2)'d completion queue ring. Equals @sq_ring
+ *                      if kernel supports IORING_FEAT_SINGLE_MMAP.
+ * @member cq_ring_sz - Size in bytes of @cq_ring.
+ * @member sqes       - mmap(2)'d array of submission queue entries.
+ * @member sqes_sz    - Size in bytes of @sqes.
+ * @member sq_head    - Submission queue head. Written by the kernel.
+ * @member sq_tail    - Submission queue tail. Written on udo_uring_submit(3).
+ * @member sq_flags   - Submission queue flags. Written by the kernel.
+ * @member sq_array   - Indexes of submission queue entries to consume.
+ * @member sq_mask    - Mask applied to submission queue positions.
+ * @member sq_entries - Amount of submission queue entries.
+ * @member sqe_tail   - Position of the next entry udo_uring_prep(3) fills.
+ * @member sqe_head   - Position of the first entry not yet submitted.
+ * @member cq_head    - Completion queue head. Written on udo_uring_wait(3).
+ * @member cq_tail    - Completion queue tail. Written by the kernel.
+ * @member cq_mask    - Mask applied to completion queue positions.
+ * @member cqes       - Array of completion queue entries.
+ * @member reqs       - Operations in flight.
+ * @member req_count  - Amount of entries in @reqs.
+ * @member req_next   - Index to start searching @reqs for a free entry.
+ */
+struct udo_uring
+{
+	struct udo_log_error_struct err;
+	uint8_t                     free;
+	int                         fd;
+	uint8_t                     sqpoll;
+	struct udo_jpool            *jpool;
+	void                        *sq_ring;
+	size_t                      sq_ring_sz;
+	void                        *cq_ring;
+	size_t                      cq_ring_sz;
+	struct io_uring_sqe         *sqes;
+	size_t                      sqes_sz;
+	udo_atomic_u32              *sq_head;
+	udo_atomic_u32              *sq_tail;
+	udo_atomic_u32              *sq_flags;
+	uint32_t                    *sq_array;
+	uint32_t                    sq_mask;
+	uint32_t                    sq_entries;
+	uint32_t                    sqe_tail;
+	uint32_t                    sqe_head;
+	udo_atomic_u32              *cq_head;
+	udo_atomic_u32              *cq_tail;
+	uint32_t                    cq_mask;
+	struct io_uring_cqe         *cqes;
+	struct udo_uring_req        *reqs;
+	uint32_t                    req_count;
+	uint32_t                    req_next;
+};
+
+
+/*****************************************
+ * Start of global to C source functions *
+ *****************************************/
+
+UDO_STATIC_INLINE
+int
+io_uring_setup (uint32_t entries,
+                struct io_uring_params *params)
+{
+	return syscall(SYS_io_uring_setup, entries, params);
+}
+
+
+UDO_STATIC_INLINE
+int
+io_uring_enter (int fd,
+                uint32_t to_submit,
+                uint32_t min_complete,
+                uint32_t flags)
+{
+	return syscall(SYS_io_uring_enter, fd, to_submit,
+	               min_complete, flags, NULL, 0);
+}
+
+
+UDO_STATIC_INLINE
+int
+io_uring_register (int fd,
+                   uint32_t opcode,
+                   const void *arg,
+                   uint32_t nr_args)
+{
+	return syscall(SYS_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/***************************************
+ * End of global to C source functions *
+ ***************************************/
+
+
+/***************************************
+ * Start of udo_uring_create functions *
+ ***************************************/
+
+static void *
+p_uring_mmap (struct udo_uring *ring,
+              const size_t size,
+              const off_t offset)
+{
+	void *addr;
+
+	addr = mmap(NULL, size, PROT_READ|PROT_WRITE,
+	            MAP_SHARED|MAP_POPULATE, ring->fd, offset);
+	if (addr == (void*)-1) {
+		udo_log_error("mmap: %s\n", strerror(errno));
+		return NULL;
+	}
+
+	return addr;
+}
+
+
+static int
+p_uring_map_queues (struct udo_uring *ring,
+                    const struct io_uring_params *params)
+{
+	char *sq, *cq;
+
+	ring->sq_ring_sz = params->sq_off.array + \
+		(params->sq_entries * sizeof(uint32_t));
+	ring->cq_ring_sz = params->cq_off.cqes + \
+		(params->cq_entries * sizeof(struct io_uring_cqe));
+
+	/* Both rings share one mapping on kernels >= 5.4 */
+	if (params->features & IORING_FEAT_SINGLE_MMAP) {
+		ring->sq_ring_sz = ring->cq_ring_sz = \
+			UDO_MAX(ring->sq_ring_sz, ring->cq_ring_sz);
+	}
+
+	ring->sq_ring = p_uring_mmap(ring, ring->sq_ring_sz, IORING_OFF_SQ_RING);
+	if (!(ring->sq_ring))
+		return -1;
+
+	if (params->features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ring = ring->sq_ring;
+	} else {
+		ring->cq_ring = p_uring_mmap(ring, ring->cq_ring_sz, IORING_OFF_CQ_RING);
+		if (!(ring->cq_ring))
+			return -1;
+	}
+
+	ring->sqes_sz = params->sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = p_uring_mmap(ring, ring->sqes_sz, IORING_OFF_SQES);
+	if (!(ring->sqes))
+		return -1;
+
+	sq = ring->sq_ring;
+	ring->sq_head = (udo_atomic_u32 *) (sq + params->sq_off.head);
+	ring->sq_tail = (udo_atomic_u32 *) (sq + params->sq_off.tail);
+	ring->sq_flags = (udo_atomic_u32 *) (sq + params->sq_off.flags);
+	ring->sq_array = (uint32_t *) (sq + params->sq_off.array);
+	ring->sq_mask = *(uint32_t *) (sq + params->sq_off.ring_mask);
+	ring->sq_entries = params->sq_entries;
+	ring->sqe_tail = ring->sqe_head = \
+		__atomic_load_n(ring->sq_tail, __ATOMIC_RELAXED);
+
+	cq = ring->cq_ring;
+	ring->cq_head = (udo_atomic_u32 *) (cq + params->cq_off.head);
+	ring->cq_tail = (udo_atomic_u32 *) (cq + params->cq_off.tail);
+	ring->cq_mask = *(uint32_t *) (cq + params->cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) (cq + params->cq_off.cqes);
+
+	return 0;
+}
+
+
+struct udo_uring *
+udo_uring_create (struct udo_uring *p_ring,
+                  const void *p_ring_info)
+{
+	int ret = -1;
+
+	struct io_uring_params params;
+
+	struct udo_uring *ring = p_ring;
+
+	const struct udo_uring_create_info *ring_info = p_ring_info;
+
+	if (!ring_info || \
+	    !(ring_info->entries))
+	{
+		udo_log_error("Incorrect data passed\n");
+		return NULL;
+	}
+
+	if (!ring) {
+		ring = calloc(1, sizeof(struct udo_uring));
+		if (!ring) {
+			udo_log_error("calloc: %s\n", strerror(errno));
+			return NULL;
+		}
+
+		ring->free = true;
+	}
+
+	memset(&params, 0, sizeof(params));
+	if (ring_info->sqpoll) {
+		params.flags |= IORING_SETUP_SQPOLL;
+		params.sq_thread_idle = ring_info->sq_thread_idle;
+	}
+
+	ring->fd = io_uring_setup(ring_info->entries, &params);
+	if (ring->fd == -1) {
+		udo_log_error("io_uring_setup: %s\n", strerror(errno));
+		udo_uring_destroy(ring);
+		return NULL;
+	}
+
+	ring->sqpoll = ring_info->sqpoll;
+	ring->jpool = ring_info->jpool;
+
+	ret = p_uring_map_queues(ring, &params);
+	if (ret == -1) {
+		udo_uring_destroy(ring);
+		return NULL;
+	}
+
+	ring->req_count = params.cq_entries;
+	ring->reqs = calloc(ring->req_count, sizeof(struct udo_uring_req));
+	if (!(ring->reqs)) {
+		udo_log_error("calloc: %s\n", strerror(errno));
+		udo_uring_destroy(ring);
+		return NULL;
+	}
+
+	return ring;
+}
+
+/*************************************
+ * End of udo_uring_create functions *
+ *************************************/
+
+
+/*****************************************
+ * Start of udo_uring_register functions *
+ *****************************************/
+
+int
+udo_uring_register_buffers (struct udo_uring *ring,
+                            const struct iovec *iovs,
+                            const uint32_t count)
+{
+	int ret = -1;
+
+	if (!ring)
+		return -1;
+
+	if (!iovs || !count) {
+		udo_log_set_error(ring, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	ret = io_uring_register(ring->fd, IORING_REGISTER_BUFFERS, iovs, count);
+	if (ret == -1) {
+		udo_log_set_error(ring, errno, "io_uring_register: %s", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+
+int
+udo_uring_register_files (struct udo_uring *ring,
+                          const int *fds,
+                          const uint32_t count)
+{
+	int ret = -1;
+
+	if (!ring)
+		return -1;
+
+	if (!fds || !count) {
+		udo_log_set_error(ring, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	ret = io_uring_register(ring->fd, IORING_REGISTER_FILES, fds, count);
+	if (ret == -1) {
+		udo_log_set_error(ring, errno, "io_uring_register: %s", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+/***************************************
+ * End of udo_uring_register functions *
+ ***************************************/
+
+
+/*************************************
+ * Start of udo_uring_prep functions *
+ *************************************/
+
+/*
+ * Returns index of a free operation slot or -1
+ * if every completion queue entry is spoken for.
+ */
+static int
+p_uring_get_req (struct udo_uring *ring)
+{
+	uint32_t i, index, busy;
+
+	for (i = 0; i < ring->req_count; i++) {
+		busy = URING_REQ_FREE;
+		index = (ring->req_next + i) % ring->req_count;
+		if (__atomic_compare_exchange_n(&(ring->reqs[index].busy),
+		                                &busy, URING_REQ_BUSY, 0,
+		                                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			ring->req_next = index + 1;
+			return index;
+		}
+	}
+
+	return -1;
+}
+
+
+static void
+p_uring_prep_sqe (struct io_uring_sqe *sqe,
+                  const enum udo_uring_op_type op,
+                  const struct udo_uring_io_info *io_info)
+{
+	sqe->fd = io_info->fd;
+	sqe->addr = (uintptr_t) io_info->buf;
+	sqe->len = io_info->size;
+	sqe->off = (uint64_t) io_info->offset;
+
+	if (io_info->fixed_file)
+		sqe->flags |= IOSQE_FIXED_FILE;
+
+	switch (op) {
+		case UDO_URING_READ:
+			sqe->opcode = (io_info->fixed_buf) ? \
+				IORING_OP_READ_FIXED : IORING_OP_READ;
+			sqe->buf_index = io_info->buf_index;
+			break;
+		case UDO_URING_WRITE:
+			sqe->opcode = (io_info->fixed_buf) ? \
+				IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+			sqe->buf_index = io_info->buf_index;
+			break;
+		case UDO_URING_RECV:
+			sqe->opcode = IORING_OP_RECV;
+			sqe->off = 0;
+			break;
+		case UDO_URING_SEND:
+			sqe->opcode = IORING_OP_SEND;
+			sqe->off = 0;
+			break;
+		case UDO_URING_ACCEPT:
+			sqe->opcode = IORING_OP_ACCEPT;
+			sqe->addr = sqe->len = sqe->off = 0;
+			break;
+		case UDO_URING_SPLICE:
+			sqe->opcode = IORING_OP_SPLICE;
+			sqe->fd = io_info->out_fd;
+			sqe->off = (uint64_t) io_info->out_offset;
+			sqe->addr = 0;
+			sqe->splice_fd_in = io_info->fd;
+			sqe->splice_off_in = (uint64_t) io_info->offset;
+			sqe->splice_flags = SPLICE_F_MOVE | \
+				((io_info->fixed_file) ? SPLICE_F_FD_IN_FIXED : 0);
+			break;
+		case UDO_URING_FSYNC:
+			sqe->opcode = IORING_OP_FSYNC;
+			sqe->addr = sqe->len = sqe->off = 0;
+			break;
+	}
+}
+
+
+int
+udo_uring_prep (struct udo_uring *ring,
+                const enum udo_uring_op_type op,
+                const void *p_io_info)
+{
+	int index;
+	uint32_t head, pos;
+
+	struct io_uring_sqe *sqe;
+	struct udo_uring_req *req;
+	const struct udo_uring_io_info *io_info = p_io_info;
+
+	if (!ring)
+		return -1;
+
+	if (!io_info || \
+	    op > UDO_URING_FSYNC)
+	{
+		udo_log_set_error(ring, UDO_LOG_ERR_INCORRECT_DATA, "");
+		return -1;
+	}
+
+	head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	if (ring->sqe_tail - head >= ring->sq_entries) {
+		udo_log_set_error(ring, UDO_LOG_ERR_UNCOMMON,
+		                  "Submission queue full");
+		return -1;
+	}
+
+	index = p_uring_get_req(ring);
+	if (index == -1) {
+		udo_log_set_error(ring, UDO_LOG_ERR_UNCOMMON,
+		                  "Too many operations in flight");
+		return -1;
+	}
+
+	req = &(ring->reqs[index]);
+	req->func = io_info->func;
+	req->arg = io_info->arg;
+
+	pos = ring->sqe_tail & ring->sq_mask;
+	sqe = &(ring->sqes[pos]);
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	p_uring_prep_sqe(sqe, op, io_info);
+	sqe->user_data = index;
+
+	ring->sq_array[pos] = pos;
+	ring->sqe_tail++;
+
+	return 0;
+}
+
+/***********************************
+ * End of udo_uring_prep functions *
+ ***********************************/
+
+
+/***************************************
+ * Start of udo_uring_submit functions *
+ ***************************************/
+
+int
+udo_uring_submit (struct udo_uring *ring)
+{
+	int ret = -1;
+	uint32_t to_submit;
+
+	if (!ring)
+		return -1;
+
+	to_submit = ring->sqe_tail - ring->sqe_head;
+	__atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+	ring->sqe_head = ring->sqe_tail;
+
+	if (ring->sqpoll) {
+		/* Order tail store before reading whether thread sleeps */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (__atomic_load_n(ring->sq_flags, __ATOMIC_RELAXED) & \
+		    IORING_SQ_NEED_WAKEUP)
+		{
+			ret = io_uring_enter(ring->fd, 0, 0, IORING_ENTER_SQ_WAKEUP);
+			if (ret == -1) {
+				udo_log_set_error(ring, errno, "io_uring_enter: %s", strerror(errno));
+				return -1;
+			}
+		}
+
+		return to_submit;
+	}
+
+	if (!to_submit)
+		return 0;
+
+	ret = io_uring_enter(ring->fd, to_submit, 0, 0);
+	if (ret == -1) {
+		udo_log_set_error(ring, errno, "io_uring_enter: %s", strerror(errno));
+		return -1;
+	}
+
+	return ret;
+}
+
+/*************************************
+ * End of udo_uring_submit functions *
+ *************************************/
+
+
+/*************************************
+ * Start of udo_uring_wait functions *
+ *************************************/
+
+static void
+p_uring_run_req (void *arg)
+{
+	int res;
+	void *func_arg;
+	void (*func)(void *arg, const int res);
+
+	struct udo_uring_req *req = arg;
+
+	func = req->func;
+	func_arg = req->arg;
+	res = req->res;
+
+	/*
+	 * Free slot first so that func may queue another operation.
+	 * Only safe when func runs on the thread owning the ring.
+	 */
+	__atomic_store_n(&req->busy, URING_REQ_FREE, __ATOMIC_RELEASE);
+
+	if (func)
+		func(func_arg, res);
+}
+
+
+int
+udo_uring_wait (struct udo_uring *ring,
+                const uint32_t min_complete)
+{
+	int ret = -1;
+	uint32_t head, tail, count = 0;
+
+	struct io_uring_cqe *cqe;
+	struct udo_uring_req *req;
+
+	if (!ring)
+		return -1;
+
+	for (;;) {
+		head = __atomic_load_n(ring->cq_head, __ATOMIC_RELAXED);
+		tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+		for (; head != tail; head++, count++) {
+			cqe = &(ring->cqes[head & ring->cq_mask]);
+			req = &(ring->reqs[cqe->user_data]);
+			req->res = cqe->res;
+
+			/* Entry may be reused by the kernel once head moves */
+			__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+			if (!(ring->jpool) || \
+			    udo_jpool_add_job(ring->jpool, p_uring_run_req, req) == -1)
+			{
+				p_uring_run_req(req);
+			}
+		}
+
+		if (count >= min_complete)
+			break;
+
+		ret = io_uring_enter(ring->fd, 0, min_complete - count,
+		                     IORING_ENTER_GETEVENTS);
+		if (ret == -1 && errno != EINTR) {
+			udo_log_set_error(ring, errno, "io_uring_enter: %s", strerror(errno));
+			return -1;
+		}
+	}
+
+	return count;
+}
+
+/***********************************
+ * End of udo_uring_wait functions *
+ ***********************************/
+
+
+/****************************************
+ * Start of udo_uring_destroy functions *
+ ****************************************/
+
+void
+udo_uring_destroy (struct udo_uring *ring)
+{
+	if (!ring)
+		return;
+
+	if (ring->sqes)
+		munmap(ring->sqes, ring->sqes_sz);
+
+	if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+		munmap(ring->cq_ring, ring->cq_ring_sz);
+
+	if (ring->sq_ring)
+		munmap(ring->sq_ring, ring->sq_ring_sz);
+
+	if (ring->fd > 0)
+		close(ring->fd);
+
+	free(ring->reqs);
+
+	if (ring->free) {
+		free(ring);
+	} else {
+		memset(ring, 0, sizeof(struct udo_uring));
+	}
+}
+
+/**************************************
+ * End of udo_uring_destroy functions *
+ **************************************/
+
+
+/*************************************************
+ * Start of non struct udo_uring param functions *
+ *************************************************/
+
+int
+udo_uring_get_sizeof (void)
+{
+	return sizeof(struct udo_uring);
+}
+
+/***********************************************
+ * End of non struct udo_uring param functions *
+ ***********************************************/
@@ -404,6 +404,113 @@ udo_usock_tcp_send_data (const int sock_fd,
 	return ret;
 }
 
+
+ssize_t
+udo_usock_tcp_send_fd (const int sock_fd,
+                       const int fd)
+{
+	ssize_t ret = 0;
+
+	char byte = 0;
+
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+
+	union {
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} ctrl;
+
+	if (sock_fd < 0 || fd < 0)
+		return -1;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&ctrl, 0, sizeof(ctrl));
+
+	/* At least one byte of data must accompany ancillary data */
+	iov.iov_base = &byte;
+	iov.iov_len = sizeof(byte);
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctrl.buf;
+	msg.msg_controllen = sizeof(ctrl.buf);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	ret = sendmsg(sock_fd, &msg, 0);
+	if (ret == -1 && (errno == EINTR || errno == EAGAIN)) {
+		return -errno;
+	} else if (ret == -1) {
+		udo_log_error("sendmsg: %s\n", strerror(errno));
+		return -1;
+	}
+
+	return ret;
+}
+
+
+int
+udo_usock_tcp_recv_fd (const int sock_fd)
+{
+	int fd = -1;
+
+	ssize_t ret = 0;
+
+	char byte = 0;
+
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+
+	union {
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} ctrl;
+
+	if (sock_fd < 0)
+		return -1;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&ctrl, 0, sizeof(ctrl));
+
+	iov.iov_base = &byte;
+	iov.iov_len = sizeof(byte);
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctrl.buf;
+	msg.msg_controllen = sizeof(ctrl.buf);
+
+	ret = recvmsg(sock_fd, &msg, MSG_CMSG_CLOEXEC);
+	if (ret == -1 && (errno == EINTR || errno == EAGAIN)) {
+		return -errno;
+	} else if (ret == -1) {
+		udo_log_error("recvmsg: %s\n", strerror(errno));
+		return -1;
+	} else if (ret == 0) {
+		return -1;
+	}
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (!cmsg || \
+	    cmsg->cmsg_level != SOL_SOCKET || \
+	    cmsg->cmsg_type != SCM_RIGHTS)
+	{
+		udo_log_error("recvmsg: no file descriptor received\n");
+		return -1;
+	}
+
+	memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+
+	return fd;
+}
+
 /***************************************************
  * End of non struct udo_usock_tcp param functions *
  ***************************************************/
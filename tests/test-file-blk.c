@@ -0,0 +1,485 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023-2026 Underview
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/*
+ * Required by cmocka
+ */
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "log.h"
+#include "macros.h"
+#include "file-blk.h"
+
+#define TEST_FILE_BLK_FILE "/tmp/udo-test-file-blk.blk"
+#define TEST_FILE_BLK_BLOCK_SIZE 4096
+#define TEST_FILE_BLK_DATA_SIZE ((TEST_FILE_BLK_BLOCK_SIZE * 7) + 123)
+
+static unsigned char data[TEST_FILE_BLK_DATA_SIZE];
+
+static void
+fill_data (const int compressible)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = (compressible) ? (unsigned char)((i / 300) & 0xff) : \
+			(unsigned char)((i * 2654435761u) >> 13);
+}
+
+
+static void
+write_file (const uint8_t codec)
+{
+	ssize_t ret;
+	size_t i, len;
+
+	struct udo_file_blk *blk = NULL;
+
+	struct udo_file_blk_create_info blk_info;
+
+	memset(&blk_info, 0, sizeof(blk_info));
+	blk_info.fname = TEST_FILE_BLK_FILE;
+	blk_info.block_size = TEST_FILE_BLK_BLOCK_SIZE;
+	blk_info.codec = codec;
+	blk_info.write = true;
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_non_null(blk);
+
+	/* Odd sized appends so that records straddle blocks */
+	for (i = 0; i < sizeof(data); i += len) {
+		len = UDO_MIN(sizeof(data) - i, (size_t)1000);
+		ret = udo_file_blk_append(blk, data + i, len);
+		assert_int_equal(ret, len);
+	}
+
+	udo_file_blk_destroy(blk);
+}
+
+
+static void
+check_reads (struct udo_file_blk *blk)
+{
+	ssize_t ret;
+	size_t i;
+
+	unsigned char buf[TEST_FILE_BLK_BLOCK_SIZE * 3];
+
+	const size_t offsets[] = {
+		0, 1, TEST_FILE_BLK_BLOCK_SIZE - 10,
+		TEST_FILE_BLK_BLOCK_SIZE * 5 + 7,
+		TEST_FILE_BLK_DATA_SIZE - 200,
+	};
+
+	assert_int_equal(udo_file_blk_get_size(blk), TEST_FILE_BLK_DATA_SIZE);
+
+	for (i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+		ret = udo_file_blk_read(blk, offsets[i], buf, sizeof(buf));
+		assert_int_equal(ret, UDO_MIN(sizeof(buf), TEST_FILE_BLK_DATA_SIZE - offsets[i]));
+		assert_memory_equal(buf, data + offsets[i], ret);
+	}
+
+	/* Small sequential reads served from the cached block */
+	for (i = TEST_FILE_BLK_BLOCK_SIZE; i < TEST_FILE_BLK_BLOCK_SIZE * 2; i += 64) {
+		ret = udo_file_blk_read(blk, i, buf, 64);
+		assert_int_equal(ret, 64);
+		assert_memory_equal(buf, data + i, 64);
+	}
+
+	ret = udo_file_blk_read(blk, TEST_FILE_BLK_DATA_SIZE, buf, sizeof(buf));
+	assert_int_equal(ret, 0);
+}
+
+
+static void
+check_codec (const uint8_t codec)
+{
+	struct stat fstats;
+
+	struct udo_file_blk *blk = NULL;
+
+	struct udo_file_blk_create_info blk_info;
+
+	fill_data(1);
+	write_file(codec);
+
+	memset(&blk_info, 0, sizeof(blk_info));
+	blk_info.fname = TEST_FILE_BLK_FILE;
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_non_null(blk);
+
+	check_reads(blk);
+
+	udo_file_blk_destroy(blk);
+
+	assert_int_equal(stat(TEST_FILE_BLK_FILE, &fstats), 0);
+	assert_true((size_t)fstats.st_size < TEST_FILE_BLK_DATA_SIZE / 4);
+
+	remove(TEST_FILE_BLK_FILE);
+}
+
+
+/*******************************************
+ * Start of test_file_blk_create functions *
+ *******************************************/
+
+static void UDO_UNUSED
+test_file_blk_create (void UDO_UNUSED **state)
+{
+	int fd = -1;
+
+	struct udo_file_blk *blk = NULL;
+
+	struct udo_file_blk_create_info blk_info;
+
+	memset(&blk_info, 0, sizeof(blk_info));
+
+	blk = udo_file_blk_create(NULL, NULL);
+	assert_null(blk);
+
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_null(blk);
+
+	blk_info.fname = TEST_FILE_BLK_FILE;
+	blk_info.write = true;
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_null(blk);
+
+	/* Opening a file that doesn't exist doesn't create it */
+	remove(TEST_FILE_BLK_FILE);
+	blk_info.write = false;
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_null(blk);
+	assert_int_equal(access(TEST_FILE_BLK_FILE, F_OK), -1);
+
+	fd = open(TEST_FILE_BLK_FILE, O_CREAT|O_WRONLY|O_TRUNC, 0644);
+	assert_int_not_equal(fd, -1);
+	assert_int_equal(write(fd, "not a block file\n", 17), 17);
+	close(fd);
+
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_null(blk);
+
+	blk_info.block_size = TEST_FILE_BLK_BLOCK_SIZE;
+	blk_info.codec = UDO_FILE_BLK_CODEC_ZSTD + 1;
+	blk_info.write = true;
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_null(blk);
+
+	blk_info.codec = UDO_FILE_BLK_CODEC_NONE;
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_non_null(blk);
+	udo_file_blk_destroy(blk);
+
+	/* Empty block file */
+	blk_info.write = false;
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_non_null(blk);
+	assert_int_equal(udo_file_blk_get_size(blk), 0);
+	udo_file_blk_destroy(blk);
+
+	remove(TEST_FILE_BLK_FILE);
+}
+
+/*****************************************
+ * End of test_file_blk_create functions *
+ *****************************************/
+
+
+/************************************************
+ * Start of test_file_blk_append_read functions *
+ ************************************************/
+
+static void UDO_UNUSED
+test_file_blk_append_read (void UDO_UNUSED **state)
+{
+	int ret = -1;
+
+	ssize_t len;
+
+	struct stat fstats;
+
+	struct udo_file_blk *blk = NULL;
+
+	struct udo_file_blk_create_info blk_info;
+
+	fill_data(0);
+
+	memset(&blk_info, 0, sizeof(blk_info));
+	blk_info.fname = TEST_FILE_BLK_FILE;
+	blk_info.block_size = TEST_FILE_BLK_BLOCK_SIZE;
+	blk_info.write = true;
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_non_null(blk);
+
+	len = udo_file_blk_append(blk, data, sizeof(data));
+	assert_int_equal(len, sizeof(data));
+
+	/* Written blocks and the pending tail are readable */
+	check_reads(blk);
+
+	ret = udo_file_blk_finish(blk);
+	assert_int_equal(ret, 0);
+
+	ret = udo_file_blk_finish(blk);
+	assert_int_equal(ret, -1);
+
+	len = udo_file_blk_append(blk, data, 1);
+	assert_int_equal(len, -1);
+
+	check_reads(blk);
+
+	udo_file_blk_destroy(blk);
+
+	/* Random data doesn't compress. So, it's stored as is */
+	ret = stat(TEST_FILE_BLK_FILE, &fstats);
+	assert_int_equal(ret, 0);
+	assert_true((size_t)fstats.st_size > TEST_FILE_BLK_DATA_SIZE);
+
+	memset(&blk_info, 0, sizeof(blk_info));
+	blk_info.fname = TEST_FILE_BLK_FILE;
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_non_null(blk);
+
+	check_reads(blk);
+
+	len = udo_file_blk_append(blk, data, 1);
+	assert_int_equal(len, -1);
+
+	udo_file_blk_destroy(blk);
+
+	remove(TEST_FILE_BLK_FILE);
+}
+
+/**********************************************
+ * End of test_file_blk_append_read functions *
+ **********************************************/
+
+
+/*******************************************
+ * Start of test_file_blk_codecs functions *
+ *******************************************/
+
+static void UDO_UNUSED
+test_file_blk_codecs (void UDO_UNUSED **state)
+{
+	struct udo_file_blk *blk = NULL;
+
+	struct udo_file_blk_create_info blk_info;
+
+	memset(&blk_info, 0, sizeof(blk_info));
+	blk_info.fname = TEST_FILE_BLK_FILE;
+	blk_info.block_size = TEST_FILE_BLK_BLOCK_SIZE;
+	blk_info.write = true;
+
+#ifdef UDO_FILE_BLK_LZ4
+	check_codec(UDO_FILE_BLK_CODEC_LZ4);
+#else
+	blk_info.codec = UDO_FILE_BLK_CODEC_LZ4;
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_null(blk);
+#endif
+
+#ifdef UDO_FILE_BLK_ZSTD
+	check_codec(UDO_FILE_BLK_CODEC_ZSTD);
+#else
+	blk_info.codec = UDO_FILE_BLK_CODEC_ZSTD;
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_null(blk);
+#endif
+
+	(void)blk;
+	(void)check_codec;
+}
+
+/*****************************************
+ * End of test_file_blk_codecs functions *
+ *****************************************/
+
+
+/********************************************
+ * Start of test_file_blk_corrupt functions *
+ ********************************************/
+
+static void UDO_UNUSED
+test_file_blk_corrupt (void UDO_UNUSED **state)
+{
+	int fd = -1;
+
+	ssize_t ret;
+
+	struct stat fstats;
+
+	unsigned char buf[64], byte = 0;
+
+	uint64_t index_off, raw_size;
+
+	uint32_t count, block_size;
+
+	struct udo_file_blk *blk = NULL;
+
+	struct udo_file_blk_create_info blk_info;
+
+	fill_data(0);
+	write_file(UDO_FILE_BLK_CODEC_NONE);
+
+	/* Flip a byte within the second block's payload */
+	fd = open(TEST_FILE_BLK_FILE, O_RDWR);
+	assert_int_not_equal(fd, -1);
+	assert_int_equal(pread(fd, &byte, 1, TEST_FILE_BLK_BLOCK_SIZE + 100), 1);
+	byte ^= 0xff;
+	assert_int_equal(pwrite(fd, &byte, 1, TEST_FILE_BLK_BLOCK_SIZE + 100), 1);
+	close(fd);
+
+	memset(&blk_info, 0, sizeof(blk_info));
+	blk_info.fname = TEST_FILE_BLK_FILE;
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_non_null(blk);
+
+	ret = udo_file_blk_read(blk, 0, buf, sizeof(buf));
+	assert_int_equal(ret, sizeof(buf));
+	assert_memory_equal(buf, data, sizeof(buf));
+
+	ret = udo_file_blk_read(blk, TEST_FILE_BLK_BLOCK_SIZE + 200, buf, sizeof(buf));
+	assert_int_equal(ret, -1);
+
+	ret = udo_file_blk_read(blk, TEST_FILE_BLK_BLOCK_SIZE * 2, buf, sizeof(buf));
+	assert_int_equal(ret, sizeof(buf));
+	assert_memory_equal(buf, data + (TEST_FILE_BLK_BLOCK_SIZE * 2), sizeof(buf));
+
+	udo_file_blk_destroy(blk);
+
+	/* Flip a byte within the footer */
+	assert_int_equal(stat(TEST_FILE_BLK_FILE, &fstats), 0);
+	fd = open(TEST_FILE_BLK_FILE, O_RDWR);
+	assert_int_not_equal(fd, -1);
+	assert_int_equal(pread(fd, &byte, 1, fstats.st_size - 20), 1);
+	byte ^= 0xff;
+	assert_int_equal(pwrite(fd, &byte, 1, fstats.st_size - 20), 1);
+	close(fd);
+
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_null(blk);
+
+	/* Footer whose index offset wraps past the end of the file */
+	write_file(UDO_FILE_BLK_CODEC_NONE);
+	assert_int_equal(stat(TEST_FILE_BLK_FILE, &fstats), 0);
+	fd = open(TEST_FILE_BLK_FILE, O_RDWR);
+	assert_int_not_equal(fd, -1);
+	count = ((fstats.st_size - 32) / sizeof(uint64_t)) + 1;
+	index_off = (uint64_t) fstats.st_size - 32 - ((uint64_t) count * sizeof(uint64_t));
+	raw_size = count;
+	block_size = 1;
+	assert_int_equal(pwrite(fd, &index_off, 8, fstats.st_size - 32), 8);
+	assert_int_equal(pwrite(fd, &raw_size, 8, fstats.st_size - 24), 8);
+	assert_int_equal(pwrite(fd, &count, 4, fstats.st_size - 16), 4);
+	assert_int_equal(pwrite(fd, &block_size, 4, fstats.st_size - 12), 4);
+	close(fd);
+
+	blk = udo_file_blk_create(NULL, &blk_info);
+	assert_null(blk);
+
+	remove(TEST_FILE_BLK_FILE);
+}
+
+/******************************************
+ * End of test_file_blk_corrupt functions *
+ ******************************************/
+
+
+/*******************************************
+ * Start of test_file_blk_crc32c functions *
+ *******************************************/
+
+static void UDO_UNUSED
+test_file_blk_crc32c (void UDO_UNUSED **state)
+{
+	size_t i;
+	uint32_t crc;
+
+	const char check[] = "123456789";
+
+	crc = udo_file_blk_crc32c(0, check, sizeof(check)-1);
+	assert_int_equal(crc, 0xe3069283);
+
+	crc = udo_file_blk_crc32c(0, check, 4);
+	crc = udo_file_blk_crc32c(crc, check + 4, sizeof(check)-5);
+	assert_int_equal(crc, 0xe3069283);
+
+	/* Unaligned starts and lengths match a single pass */
+	fill_data(0);
+	for (i = 1; i < 16; i++) {
+		crc = udo_file_blk_crc32c(0, data, i);
+		crc = udo_file_blk_crc32c(crc, data + i, sizeof(data) - i);
+		assert_int_equal(crc, udo_file_blk_crc32c(0, data, sizeof(data)));
+	}
+
+	crc = udo_file_blk_crc32c(0, NULL, 0);
+	assert_int_equal(crc, 0);
+}
+
+/*****************************************
+ * End of test_file_blk_crc32c functions *
+ *****************************************/
+
+
+/***********************************************
+ * Start of test_file_blk_get_sizeof functions *
+ ***********************************************/
+
+static void UDO_UNUSED
+test_file_blk_get_sizeof (void UDO_UNUSED **state)
+{
+	int size = 0;
+	size = udo_file_blk_get_sizeof();
+	assert_int_not_equal(size, 0);
+}
+
+/*********************************************
+ * End of test_file_blk_get_sizeof functions *
+ *********************************************/
+
+int
+main (void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_file_blk_create),
+		cmocka_unit_test(test_file_blk_append_read),
+		cmocka_unit_test(test_file_blk_codecs),
+		cmocka_unit_test(test_file_blk_corrupt),
+		cmocka_unit_test(test_file_blk_crc32c),
+		cmocka_unit_test(test_file_blk_get_sizeof),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -23,10 +23,14 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <dirent.h>
 #include <libgen.h>
 
 /* Required by cmocka */
@@ -38,6 +42,7 @@
 
 #include "log.h"
 #include "file-ops.h"
+#include "jpool.h"
 
 /*******************************************
  * Start of test_file_ops_create functions *
@@ -106,6 +111,77 @@ test_file_ops_create_empty_file (void UDO_UNUSED **state)
  *****************************************/
 
 
+/**********************************************
+ * Start of test_file_ops_map_cache functions *
+ **********************************************/
+
+static void UDO_UNUSED
+test_file_ops_map_cache (void UDO_UNUSED **state)
+{
+	int ret = -1;
+
+	const char *data = NULL;
+
+	struct timespec times[2];
+
+	struct udo_file_ops *flops[3];
+
+	struct udo_file_ops_create_info file_info;
+
+	memset(flops, 0, sizeof(flops));
+	memset(&file_info, 0, sizeof(file_info));
+
+	remove("/tmp/test-map-cache.txt");
+
+	file_info.fname = "/tmp/test-map-cache.txt";
+	file_info.size = UDO_PAGE_SIZE;
+	flops[0] = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(flops[0]);
+	ret = udo_file_ops_append(flops[0], "cached\n", 7);
+	assert_int_equal(ret, 7);
+	udo_file_ops_destroy(flops[0], 0);
+
+	/* Read only opens of the same file share one mapping */
+	file_info.size = 0;
+	file_info.protect = 1;
+	flops[0] = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(flops[0]);
+	flops[1] = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(flops[1]);
+	assert_ptr_equal(udo_file_ops_get_data(flops[0], 0),
+	                 udo_file_ops_get_data(flops[1], 0));
+	assert_int_not_equal(udo_file_ops_get_fd(flops[0]),
+	                     udo_file_ops_get_fd(flops[1]));
+
+	/* Mapping stays valid until the last context is destroyed */
+	udo_file_ops_destroy(flops[0], 0);
+	data = udo_file_ops_get_data(flops[1], 0);
+	assert_non_null(data);
+	assert_memory_equal(data, "cached\n", 7);
+
+	/* Modified files get a new mapping */
+	times[0].tv_sec = times[1].tv_sec = 1;
+	times[0].tv_nsec = times[1].tv_nsec = 0;
+	ret = utimensat(AT_FDCWD, file_info.fname, times, 0);
+	assert_int_equal(ret, 0);
+
+	flops[2] = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(flops[2]);
+	assert_ptr_not_equal(udo_file_ops_get_data(flops[1], 0),
+	                     udo_file_ops_get_data(flops[2], 0));
+	assert_memory_equal(udo_file_ops_get_data(flops[2], 0), "cached\n", 7);
+
+	udo_file_ops_destroy(flops[1], 0);
+	udo_file_ops_destroy(flops[2], 0);
+
+	remove(file_info.fname);
+}
+
+/********************************************
+ * End of test_file_ops_map_cache functions *
+ ********************************************/
+
+
 /**********************************************
  * Start of test_file_ops_zero_copy functions *
  **********************************************/
@@ -169,11 +245,623 @@ test_file_ops_zero_copy (void UDO_UNUSED **state)
 	remove("/tmp/test-file.txt");
 }
 
+#define TEST_FILE_OPS_TRANSFER_SIZE ((1<<20) + 123)
+
+static void UDO_UNUSED
+test_file_ops_transfer (void UDO_UNUSED **state)
+{
+	pid_t pid;
+
+	int sv[2], ret = -1;
+
+	ssize_t len;
+
+	size_t i, total;
+
+	char buffer[4096];
+
+	const char *src_data = NULL, *dst_data = NULL;
+
+	struct udo_file_ops *src = NULL, *dst = NULL;
+
+	struct udo_file_ops_create_info file_info;
+	struct udo_file_ops_zero_copy_info zcopy_info;
+
+	memset(&zcopy_info, 0, sizeof(zcopy_info));
+	memset(&file_info, 0, sizeof(file_info));
+
+	remove("/tmp/test-transfer-src.txt");
+	remove("/tmp/test-transfer-dst.txt");
+
+	file_info.fname = "/tmp/test-transfer-src.txt";
+	src = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(src);
+
+	for (i = 0; i < TEST_FILE_OPS_TRANSFER_SIZE; i++) {
+		buffer[0] = 'a' + (i % 26);
+		assert_int_equal(udo_file_ops_append(src, buffer, 1), 1);
+	}
+
+	udo_file_ops_destroy(src, 0);
+	src = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(src);
+	src_data = udo_file_ops_get_data(src, 0);
+	assert_non_null(src_data);
+
+	/* Test file to file transfer larger than a pipe */
+	file_info.fname = "/tmp/test-transfer-dst.txt";
+	file_info.size = TEST_FILE_OPS_TRANSFER_SIZE;
+	dst = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(dst);
+
+	zcopy_info.size = TEST_FILE_OPS_TRANSFER_SIZE;
+	zcopy_info.in_fd = udo_file_ops_get_fd(src);
+	zcopy_info.in_off = &(off_t){0};
+	zcopy_info.out_fd = udo_file_ops_get_fd(dst);
+	zcopy_info.out_off = &(off_t){0};
+	len = udo_file_ops_transfer(src, &zcopy_info);
+	assert_int_equal(len, TEST_FILE_OPS_TRANSFER_SIZE);
+
+	/* Re-open so that data size equals file size */
+	udo_file_ops_destroy(dst, 0);
+	file_info.size = 0;
+	dst = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(dst);
+
+	dst_data = udo_file_ops_get_data(dst, 0);
+	assert_non_null(dst_data);
+	assert_memory_equal(src_data, dst_data, TEST_FILE_OPS_TRANSFER_SIZE);
+
+	/* Test file to socket transfer */
+	ret = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+	assert_int_equal(ret, 0);
+
+	pid = fork();
+	if (pid == 0) {
+		close(sv[1]);
+		zcopy_info.in_off = &(off_t){0};
+		zcopy_info.out_fd = sv[0];
+		zcopy_info.out_off = NULL;
+		len = udo_file_ops_transfer(src, &zcopy_info);
+		close(sv[0]);
+		exit(len != TEST_FILE_OPS_TRANSFER_SIZE);
+	}
+
+	close(sv[0]);
+	for (total = 0; (len = read(sv[1], buffer, sizeof(buffer))) > 0; total += len)
+		assert_memory_equal(buffer, src_data + total, len);
+
+	close(sv[1]);
+	assert_int_equal(total, TEST_FILE_OPS_TRANSFER_SIZE);
+	waitpid(pid, &ret, 0);
+	assert_int_equal(WEXITSTATUS(ret), 0);
+
+	/* Test socket to file transfer through a pipe */
+	ret = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+	assert_int_equal(ret, 0);
+
+	pid = fork();
+	if (pid == 0) {
+		close(sv[1]);
+		for (total = 0; total < TEST_FILE_OPS_TRANSFER_SIZE; total += len) {
+			len = write(sv[0], src_data + total, TEST_FILE_OPS_TRANSFER_SIZE - total);
+			if (len <= 0)
+				exit(1);
+		}
+
+		close(sv[0]);
+		exit(0);
+	}
+
+	close(sv[0]);
+	memset((char*)dst_data, 0, TEST_FILE_OPS_TRANSFER_SIZE);
+	zcopy_info.in_fd = sv[1];
+	zcopy_info.in_off = NULL;
+	zcopy_info.out_fd = udo_file_ops_get_fd(dst);
+	zcopy_info.out_off = &(off_t){0};
+	len = udo_file_ops_transfer(dst, &zcopy_info);
+	assert_int_equal(len, TEST_FILE_OPS_TRANSFER_SIZE);
+	assert_memory_equal(src_data, dst_data, TEST_FILE_OPS_TRANSFER_SIZE);
+
+	close(sv[1]);
+	waitpid(pid, &ret, 0);
+	assert_int_equal(WEXITSTATUS(ret), 0);
+
+	/* Test failed drain doesn't leak into the next transfer */
+	ret = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+	assert_int_equal(ret, 0);
+
+	assert_int_equal(write(sv[0], "stale", 5), 5);
+	zcopy_info.size = 5;
+	zcopy_info.in_fd = sv[1];
+	zcopy_info.out_fd = open("/tmp/test-transfer-dst.txt", O_RDONLY);
+	zcopy_info.out_off = &(off_t){0};
+	assert_int_not_equal(zcopy_info.out_fd, -1);
+	len = udo_file_ops_transfer(dst, &zcopy_info);
+	assert_int_equal(len, -1);
+	close(zcopy_info.out_fd);
+
+	assert_int_equal(write(sv[0], "fresh", 5), 5);
+	zcopy_info.out_fd = udo_file_ops_get_fd(dst);
+	zcopy_info.out_off = &(off_t){0};
+	len = udo_file_ops_transfer(dst, &zcopy_info);
+	assert_int_equal(len, 5);
+	assert_memory_equal(dst_data, "fresh", 5);
+
+	close(sv[0]);
+	close(sv[1]);
+
+	udo_file_ops_destroy(src, 0);
+	udo_file_ops_destroy(dst, 0);
+	remove("/tmp/test-transfer-src.txt");
+	remove("/tmp/test-transfer-dst.txt");
+}
+
+
 /********************************************
  * End of test_file_ops_zero_copy functions *
  ********************************************/
 
 
+/*******************************************
+ * Start of test_file_ops_append functions *
+ *******************************************/
+
+#define TEST_FILE_OPS_APPENDS 1000
+
+static void UDO_UNUSED
+test_file_ops_append (void UDO_UNUSED **state)
+{
+	int ret = -1;
+
+	ssize_t len;
+
+	size_t i, alloc_sz;
+
+	struct stat fstats;
+
+	const char *data = NULL;
+
+	struct udo_file_ops *flops = NULL;
+
+	struct udo_file_ops_create_info file_info;
+
+	const char line[] = "journal record : check me\n";
+
+	memset(&fstats, 0, sizeof(fstats));
+	memset(&file_info, 0, sizeof(file_info));
+
+	remove("/tmp/test-append.txt");
+
+	file_info.fname = "/tmp/test-append.txt";
+	flops = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(flops);
+
+	/* Test mapping grows past size defined at creation */
+	for (i = 0; i < TEST_FILE_OPS_APPENDS; i++) {
+		len = udo_file_ops_append(flops, line, sizeof(line)-1);
+		assert_int_equal(len, sizeof(line)-1);
+	}
+
+	assert_int_equal(udo_file_ops_get_data_size(flops),
+	                 TEST_FILE_OPS_APPENDS * (sizeof(line)-1));
+	assert_true(udo_file_ops_get_alloc_size(flops) >= \
+	            udo_file_ops_get_data_size(flops));
+
+	data = udo_file_ops_get_data(flops, 0);
+	assert_non_null(data);
+	for (i = 0; i < TEST_FILE_OPS_APPENDS; i++)
+		assert_memory_equal(data + (i * (sizeof(line)-1)), line, sizeof(line)-1);
+
+	/* Test reserve only ever grows the mapping */
+	ret = udo_file_ops_reserve(flops, (1<<20));
+	assert_int_equal(ret, 0);
+	alloc_sz = udo_file_ops_get_alloc_size(flops);
+	assert_true(alloc_sz >= (1<<20));
+	ret = udo_file_ops_reserve(flops, (1<<12));
+	assert_int_equal(ret, 0);
+	assert_int_equal(udo_file_ops_get_alloc_size(flops), alloc_sz);
+
+	len = udo_file_ops_append(flops, NULL, sizeof(line)-1);
+	assert_int_equal(len, -1);
+
+	udo_file_ops_destroy(flops, 0);
+
+	/* File is truncated to appended data */
+	ret = stat(file_info.fname, &fstats);
+	assert_int_equal(ret, 0);
+	assert_int_equal(fstats.st_size, TEST_FILE_OPS_APPENDS * (sizeof(line)-1));
+
+	/* Test appending to an existing file */
+	flops = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(flops);
+
+	len = udo_file_ops_append(flops, line, sizeof(line)-1);
+	assert_int_equal(len, sizeof(line)-1);
+	assert_int_equal(udo_file_ops_get_line_count(flops), TEST_FILE_OPS_APPENDS+1);
+
+	udo_file_ops_destroy(flops, 0);
+
+	ret = stat(file_info.fname, &fstats);
+	assert_int_equal(ret, 0);
+	assert_int_equal(fstats.st_size, (TEST_FILE_OPS_APPENDS+1) * (sizeof(line)-1));
+
+	/* Test read only mapping can't be appended to */
+	file_info.protect = 1;
+	flops = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(flops);
+
+	len = udo_file_ops_append(flops, line, sizeof(line)-1);
+	assert_int_equal(len, -1);
+
+	udo_file_ops_destroy(flops, 0);
+	remove(file_info.fname);
+}
+
+/*****************************************
+ * End of test_file_ops_append functions *
+ *****************************************/
+
+
+/************************************************
+ * Start of test_file_ops_flush_range functions *
+ ************************************************/
+
+static void UDO_UNUSED
+test_file_ops_flush_range (void UDO_UNUSED **state)
+{
+	int ret = -1;
+
+	ssize_t len;
+
+	size_t i;
+
+	struct stat fstats;
+
+	struct udo_file_ops *flops = NULL;
+
+	struct udo_file_ops_create_info file_info;
+
+	const char line[] = "flushed record : check me\n";
+
+	memset(&fstats, 0, sizeof(fstats));
+	memset(&file_info, 0, sizeof(file_info));
+
+	remove("/tmp/test-flush.txt");
+
+	file_info.fname = "/tmp/test-flush.txt";
+	file_info.size = UDO_PAGE_SIZE;
+	file_info.flush_size = UDO_PAGE_SIZE;
+	flops = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(flops);
+
+	/* Background flusher is woken every page worth of appends */
+	for (i = 0; i < TEST_FILE_OPS_APPENDS; i++) {
+		len = udo_file_ops_append(flops, line, sizeof(line)-1);
+		assert_int_equal(len, sizeof(line)-1);
+	}
+
+	ret = udo_file_ops_flush_range(flops, 0, 0, 1);
+	assert_int_equal(ret, 0);
+
+	ret = udo_file_ops_flush_range(flops, 100, sizeof(line), 0);
+	assert_int_equal(ret, 0);
+
+	ret = udo_file_ops_flush_range(flops, udo_file_ops_get_alloc_size(flops), 1, 0);
+	assert_int_equal(ret, -1);
+
+	ret = udo_file_ops_flush_range(flops, 0, udo_file_ops_get_alloc_size(flops) + 1, 1);
+	assert_int_equal(ret, -1);
+
+	udo_file_ops_destroy(flops, 0);
+
+	ret = stat(file_info.fname, &fstats);
+	assert_int_equal(ret, 0);
+	assert_int_equal(fstats.st_size, TEST_FILE_OPS_APPENDS * (sizeof(line)-1));
+
+	remove(file_info.fname);
+}
+
+/**********************************************
+ * End of test_file_ops_flush_range functions *
+ **********************************************/
+
+
+/*******************************************
+ * Start of test_file_ops_advise functions *
+ *******************************************/
+
+static void UDO_UNUSED
+test_file_ops_advise (void UDO_UNUSED **state)
+{
+	int ret = -1;
+
+	size_t size;
+
+	struct udo_file_ops *flops = NULL;
+
+	struct udo_file_ops_create_info file_info;
+
+	struct udo_file_ops_range ranges[] = {
+		{ .offset = UDO_PAGE_SIZE * 6, .size = 10 },
+		{ .offset = 0, .size = UDO_PAGE_SIZE + 1 },
+		{ .offset = UDO_PAGE_SIZE + 20, .size = 30 },
+		{ .offset = UDO_PAGE_SIZE * 3, .size = UDO_PAGE_SIZE },
+	};
+
+	memset(&file_info, 0, sizeof(file_info));
+
+	file_info.fname = "/tmp/test-advise.txt";
+	file_info.size = UDO_PAGE_SIZE * 8;
+	flops = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(flops);
+
+	size = udo_file_ops_get_alloc_size(flops);
+
+	ret = udo_file_ops_advise(flops, 0, 0, UDO_FILE_OPS_ADVISE_SEQUENTIAL);
+	assert_int_equal(ret, 0);
+
+	ret = udo_file_ops_advise(flops, 100, UDO_PAGE_SIZE, UDO_FILE_OPS_ADVISE_RANDOM);
+	assert_int_equal(ret, 0);
+
+	ret = udo_file_ops_advise(flops, UDO_PAGE_SIZE, UDO_PAGE_SIZE, UDO_FILE_OPS_ADVISE_WILLNEED);
+	assert_int_equal(ret, 0);
+
+	ret = udo_file_ops_advise(flops, 0, size, UDO_FILE_OPS_ADVISE_POPULATE_READ);
+	assert_int_equal(ret, 0);
+
+	ret = udo_file_ops_advise(flops, 0, 0, UDO_FILE_OPS_ADVISE_READAHEAD);
+	assert_int_equal(ret, 0);
+
+	ret = udo_file_ops_advise(flops, 0, 0, UDO_FILE_OPS_ADVISE_NORMAL);
+	assert_int_equal(ret, 0);
+
+	ret = udo_file_ops_advise(flops, size, 1, UDO_FILE_OPS_ADVISE_WILLNEED);
+	assert_int_equal(ret, -1);
+
+	ret = udo_file_ops_advise(flops, 0, size + 1, UDO_FILE_OPS_ADVISE_WILLNEED);
+	assert_int_equal(ret, -1);
+
+	ret = udo_file_ops_advise(flops, 0, 0, UDO_FILE_OPS_ADVISE_READAHEAD + 1);
+	assert_int_equal(ret, -1);
+
+	ret = udo_file_ops_prefetch(flops, ranges, sizeof(ranges) / sizeof(ranges[0]));
+	assert_int_equal(ret, 0);
+
+	ret = udo_file_ops_prefetch(flops, ranges, 0);
+	assert_int_equal(ret, -1);
+
+	ranges[0].offset = size;
+	ret = udo_file_ops_prefetch(flops, ranges, sizeof(ranges) / sizeof(ranges[0]));
+	assert_int_equal(ret, -1);
+
+	udo_file_ops_destroy(flops, 0);
+	remove(file_info.fname);
+}
+
+/*****************************************
+ * End of test_file_ops_advise functions *
+ *****************************************/
+
+
+/*****************************************
+ * Start of test_file_ops_iter functions *
+ *****************************************/
+
+#define TEST_FILE_OPS_ITER_LINES 2000
+
+static void UDO_UNUSED
+test_file_ops_iter (void UDO_UNUSED **state)
+{
+	int ret = -1;
+
+	size_t i, len;
+
+	char line[64], big[(1<<13)+1];
+
+	const void *ptr = NULL;
+
+	struct udo_file_ops *flops = NULL;
+	struct udo_file_ops_iter *iter = NULL;
+
+	struct udo_file_ops_create_info file_info;
+	struct udo_file_ops_iter_create_info iter_info;
+
+	memset(big, 'b', sizeof(big));
+	big[sizeof(big)-1] = '\n';
+	memset(&file_info, 0, sizeof(file_info));
+	memset(&iter_info, 0, sizeof(iter_info));
+
+	remove("/tmp/test-iter.txt");
+	file_info.fname = "/tmp/test-iter.txt";
+	flops = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(flops);
+
+	/* Lines cross window boundaries, one is larger than a window */
+	for (i = 0; i < TEST_FILE_OPS_ITER_LINES; i++) {
+		len = snprintf(line, sizeof(line), "record %zu\n", i);
+		assert_int_equal(udo_file_ops_append(flops, line, len), len);
+		if (i == (TEST_FILE_OPS_ITER_LINES >> 1))
+			assert_int_equal(udo_file_ops_append(flops, big, sizeof(big)), sizeof(big));
+	}
+
+	/* Last record without delimiter */
+	assert_int_equal(udo_file_ops_append(flops, "tail", 4), 4);
+
+	iter_info.flops = flops;
+	iter_info.window_size = UDO_PAGE_SIZE;
+	iter = udo_file_ops_iter_create(NULL, &iter_info);
+	assert_non_null(iter);
+
+	for (i = 0; i < TEST_FILE_OPS_ITER_LINES; i++) {
+		ret = udo_file_ops_iter_next(iter, &ptr, &len);
+		assert_int_equal(ret, 1);
+		assert_int_equal(len, snprintf(line, sizeof(line), "record %zu", i));
+		assert_memory_equal(ptr, line, len);
+
+		if (i == (TEST_FILE_OPS_ITER_LINES >> 1)) {
+			ret = udo_file_ops_iter_next(iter, &ptr, &len);
+			assert_int_equal(ret, 1);
+			assert_int_equal(len, sizeof(big)-1);
+			assert_memory_equal(ptr, big, len);
+		}
+	}
+
+	ret = udo_file_ops_iter_next(iter, &ptr, &len);
+	assert_int_equal(ret, 1);
+	assert_int_equal(len, 4);
+	assert_memory_equal(ptr, "tail", 4);
+
+	ret = udo_file_ops_iter_next(iter, &ptr, &len);
+	assert_int_equal(ret, 0);
+
+	udo_file_ops_iter_destroy(iter);
+
+	/* Test fixed size records */
+	iter_info.record_size = 10;
+	iter = udo_file_ops_iter_create(NULL, &iter_info);
+	assert_non_null(iter);
+
+	ret = udo_file_ops_iter_next(iter, &ptr, &len);
+	assert_int_equal(ret, 1);
+	assert_int_equal(len, 10);
+	assert_memory_equal(ptr, "record 0\nr", 10);
+
+	for (i = 10; ret == 1; i += len)
+		ret = udo_file_ops_iter_next(iter, &ptr, &len);
+
+	assert_int_equal(ret, 0);
+	assert_int_equal(i - len, udo_file_ops_get_data_size(flops));
+
+	udo_file_ops_iter_destroy(iter);
+
+	/* Test custom delimiter */
+	iter_info.record_size = 0;
+	iter_info.delim = ' ';
+	iter = udo_file_ops_iter_create(NULL, &iter_info);
+	assert_non_null(iter);
+
+	ret = udo_file_ops_iter_next(iter, &ptr, &len);
+	assert_int_equal(ret, 1);
+	assert_memory_equal(ptr, "record", len);
+	ret = udo_file_ops_iter_next(iter, &ptr, &len);
+	assert_int_equal(ret, 1);
+	assert_memory_equal(ptr, "0\nrecord", len);
+
+	udo_file_ops_iter_destroy(iter);
+	udo_file_ops_destroy(flops, 0);
+	remove(file_info.fname);
+}
+
+/***************************************
+ * End of test_file_ops_iter functions *
+ ***************************************/
+
+
+/*******************************************
+ * Start of test_file_ops_stream functions *
+ *******************************************/
+
+#define TEST_FILE_OPS_STREAM_BUF_SIZE (1<<16)
+#define TEST_FILE_OPS_STREAM_SIZE ((TEST_FILE_OPS_STREAM_BUF_SIZE * 7) / 2)
+
+static void
+test_file_ops_stream_fname (const char *fname)
+{
+	ssize_t len;
+
+	size_t i, total;
+
+	struct stat fstats;
+
+	const void *buf = NULL;
+
+	unsigned char chunk[1000];
+
+	struct udo_file_ops_stream *stream = NULL;
+
+	struct udo_file_ops_stream_create_info stream_info;
+
+	memset(&fstats, 0, sizeof(fstats));
+	memset(&stream_info, 0, sizeof(stream_info));
+
+	stream_info.fname = fname;
+	stream_info.buffer_size = TEST_FILE_OPS_STREAM_BUF_SIZE;
+	stream_info.write = 1;
+	stream_info.dontneed = 1;
+	stream = udo_file_ops_stream_create(NULL, &stream_info);
+	assert_non_null(stream);
+
+	len = udo_file_ops_stream_read(stream, &buf);
+	assert_int_equal(len, -1);
+
+	/* Chunks don't line up with buffers */
+	for (total = 0; total < TEST_FILE_OPS_STREAM_SIZE; total += len) {
+		len = UDO_MIN(sizeof(chunk), TEST_FILE_OPS_STREAM_SIZE - total);
+		for (i = 0; i < (size_t) len; i++)
+			chunk[i] = (total + i) % 251;
+		len = udo_file_ops_stream_write(stream, chunk, len);
+		assert_true(len > 0);
+
+		/* Flushing a partial page mustn't break later writes */
+		if (total == sizeof(chunk) * 100) {
+			assert_int_equal(udo_file_ops_stream_flush(stream), 0);
+			assert_int_equal(stat(fname, &fstats), 0);
+			assert_int_equal(fstats.st_size, total + len);
+		}
+	}
+
+	udo_file_ops_stream_destroy(stream);
+
+	assert_int_equal(stat(fname, &fstats), 0);
+	assert_int_equal(fstats.st_size, TEST_FILE_OPS_STREAM_SIZE);
+
+	stream_info.write = 0;
+	stream = udo_file_ops_stream_create(NULL, &stream_info);
+	assert_non_null(stream);
+
+	len = udo_file_ops_stream_write(stream, chunk, sizeof(chunk));
+	assert_int_equal(len, -1);
+
+	total = 0;
+	while ((len = udo_file_ops_stream_read(stream, &buf)) > 0) {
+		for (i = 0; i < (size_t) len; i++)
+			assert_int_equal(((const unsigned char *) buf)[i], (total + i) % 251);
+		total += len;
+	}
+
+	assert_int_equal(len, 0);
+	assert_int_equal(total, TEST_FILE_OPS_STREAM_SIZE);
+	assert_int_equal(udo_file_ops_stream_read(stream, &buf), 0);
+
+	udo_file_ops_stream_destroy(stream);
+
+	remove(fname);
+}
+
+
+static void UDO_UNUSED
+test_file_ops_stream (void UDO_UNUSED **state)
+{
+	struct udo_file_ops_stream *stream = NULL;
+
+	stream = udo_file_ops_stream_create(NULL, NULL);
+	assert_null(stream);
+
+	/* O_DIRECT capable file system */
+	test_file_ops_stream_fname("/tmp/test-stream.bin");
+
+	/* tmpfs falls back to buffered I/O */
+	test_file_ops_stream_fname("/dev/shm/test-stream.bin");
+
+	assert_int_not_equal(udo_file_ops_stream_get_sizeof(), 0);
+}
+
+/*****************************************
+ * End of test_file_ops_stream functions *
+ *****************************************/
+
+
 /****************************************
  * Start of test_file_ops_get functions *
  ****************************************/
@@ -245,9 +933,15 @@ test_file_ops_get_line (void UDO_UNUSED **state)
 }
 
 
+#define TEST_FILE_OPS_LINE_COUNT_SIZE ((1<<17) + 29)
+
 static void UDO_UNUSED
 test_file_ops_get_line_count (void UDO_UNUSED **state)
 {
+	char *buf = NULL;
+
+	size_t i, expect;
+
 	uint64_t line_count = 0;
 
 	struct udo_file_ops *flops = NULL;
@@ -264,6 +958,107 @@ test_file_ops_get_line_count (void UDO_UNUSED **state)
 	assert_int_equal(line_count, 8);
 
 	udo_file_ops_destroy(flops, 0);
+
+	/*
+	 * Large enough for the vector kernels to flush their byte
+	 * counters. First half is all newlines so counters saturate
+	 * between flushes. Tail isn't a multiple of any vector width.
+	 */
+	buf = malloc(TEST_FILE_OPS_LINE_COUNT_SIZE);
+	assert_non_null(buf);
+
+	for (i = 0, expect = 0; i < TEST_FILE_OPS_LINE_COUNT_SIZE; i++) {
+		buf[i] = (i < TEST_FILE_OPS_LINE_COUNT_SIZE / 2 || !((i * 7) % 13)) ? '\n' : 'a';
+		expect += (buf[i] == '\n');
+	}
+
+	remove("/tmp/test-line-count.txt");
+	file_info.fname = "/tmp/test-line-count.txt";
+	flops = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(flops);
+	assert_int_equal(udo_file_ops_append(flops, buf, TEST_FILE_OPS_LINE_COUNT_SIZE),
+	                 TEST_FILE_OPS_LINE_COUNT_SIZE);
+
+	line_count = udo_file_ops_get_line_count(flops);
+	assert_int_equal(line_count, expect);
+
+	udo_file_ops_destroy(flops, 0);
+	remove(file_info.fname);
+	free(buf);
+}
+
+static void UDO_UNUSED
+test_file_ops_get_line_index (void UDO_UNUSED **state)
+{
+	size_t i;
+
+	ssize_t len;
+
+	char buffer[32];
+
+	const char *data = NULL;
+
+	struct udo_file_ops *flops = NULL, *flops_two = NULL;
+
+	struct udo_file_ops_create_info file_info;
+
+	memset(&file_info, 0, sizeof(file_info));
+
+	file_info.fname = TESTER_FILE_ONE;
+	flops = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(flops);
+
+	/* Copy tester file so that it may be appended to */
+	remove("/tmp/test-line-index.txt");
+	file_info.line_index = 1;
+	file_info.fname = "/tmp/test-line-index.txt";
+	flops_two = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(flops_two);
+
+	len = udo_file_ops_append(flops_two, udo_file_ops_get_data(flops, 0),
+	                          udo_file_ops_get_data_size(flops));
+	assert_int_equal(len, udo_file_ops_get_data_size(flops));
+	udo_file_ops_destroy(flops, 0);
+
+	assert_int_equal(udo_file_ops_get_line_count(flops_two), 8);
+
+	memset(buffer, 0, sizeof(buffer));
+	data = udo_file_ops_get_line(flops_two, 4);
+	memccpy(buffer, data, '\n', sizeof(buffer));
+	assert_string_equal(buffer, "line four : check me\n");
+
+	memset(buffer, 0, sizeof(buffer));
+	data = udo_file_ops_get_line(flops_two, 8);
+	memccpy(buffer, data, '\n', sizeof(buffer));
+	assert_string_equal(buffer, "line eight\n");
+
+	/* Lines past the end match a context without an index */
+	file_info.line_index = 0;
+	flops = udo_file_ops_create(NULL, &file_info);
+	assert_non_null(flops);
+
+	for (i = 1; i < 12; i++) {
+		data = udo_file_ops_get_line(flops_two, i);
+		assert_non_null(data);
+		assert_int_equal(data - (const char *) udo_file_ops_get_data(flops_two, 0),
+		                 udo_file_ops_get_line(flops, i) - \
+		                 (const char *) udo_file_ops_get_data(flops, 0));
+	}
+
+	udo_file_ops_destroy(flops, 0);
+
+	/* Index is extended after append */
+	len = udo_file_ops_append(flops_two, "line nine\n", 10);
+	assert_int_equal(len, 10);
+	assert_int_equal(udo_file_ops_get_line_count(flops_two), 9);
+
+	memset(buffer, 0, sizeof(buffer));
+	data = udo_file_ops_get_line(flops_two, 9);
+	memccpy(buffer, data, '\n', sizeof(buffer));
+	assert_string_equal(buffer, "line nine\n");
+
+	udo_file_ops_destroy(flops_two, 0);
+	remove(file_info.fname);
 }
 
 
@@ -519,6 +1314,177 @@ test_file_ops_set_fd_flags (void UDO_UNUSED **state)
  ***********************************************/
 
 
+/*****************************************
+ * Start of test_file_ops_walk functions *
+ *****************************************/
+
+#define TEST_FILE_OPS_WALK_DIRS 8
+#define TEST_FILE_OPS_WALK_FILES 32
+
+static void
+test_file_ops_walk_create_tree (const char *root)
+{
+	int fd;
+	size_t d, s, f;
+	char path[UDO_FILE_PATH_MAX];
+
+	assert_int_equal(mkdir(root, 0755), 0);
+
+	for (d = 0; d < TEST_FILE_OPS_WALK_DIRS; d++) {
+		snprintf(path, sizeof(path), "%s/dir%zu", root, d);
+		assert_int_equal(mkdir(path, 0755), 0);
+
+		for (s = 0; s < 2; s++) {
+			snprintf(path, sizeof(path), "%s/dir%zu/sub%zu", root, d, s);
+			assert_int_equal(mkdir(path, 0755), 0);
+
+			for (f = 0; f < TEST_FILE_OPS_WALK_FILES; f++) {
+				snprintf(path, sizeof(path), "%s/dir%zu/sub%zu/file%zu", root, d, s, f);
+				fd = open(path, O_CREAT|O_WRONLY, 0644);
+				assert_int_not_equal(fd, -1);
+				close(fd);
+			}
+		}
+	}
+
+	/* Links must never be followed */
+	snprintf(path, sizeof(path), "%s/dir0/loop", root);
+	assert_int_equal(symlink(root, path), 0);
+}
+
+
+struct test_file_ops_walk_count
+{
+	udo_atomic_u32 files;
+	udo_atomic_u32 dirs;
+	uint32_t       left;
+	uint32_t       max_depth;
+};
+
+
+static int
+test_file_ops_walk_entry (void *arg,
+                          const int dirfd,
+                          const char *name,
+                          const uint8_t type,
+                          const uint32_t depth)
+{
+	struct stat st;
+	struct test_file_ops_walk_count *count = arg;
+
+	assert_int_equal(fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW), 0);
+	assert_true(depth >= 1 && depth <= 3);
+
+	if (type == DT_DIR) {
+		assert_true(S_ISDIR(st.st_mode));
+		__atomic_add_fetch(&(count->dirs), 1, __ATOMIC_RELAXED);
+	} else {
+		__atomic_add_fetch(&(count->files), 1, __ATOMIC_RELAXED);
+	}
+
+	return 0;
+}
+
+
+static int
+test_file_ops_walk_leave (void *arg,
+                          const int UDO_UNUSED dirfd,
+                          const char UDO_UNUSED *name,
+                          const uint32_t depth)
+{
+	struct test_file_ops_walk_count *count = arg;
+
+	count->left++;
+	count->max_depth = UDO_MAX(count->max_depth, depth);
+
+	return 0;
+}
+
+
+static void
+test_file_ops_walk_count (const char *root,
+                          struct udo_jpool *jpool)
+{
+	int ret = -1;
+
+	struct test_file_ops_walk_count count;
+
+	struct udo_file_ops_walk_info walk_info;
+
+	memset(&count, 0, sizeof(count));
+	memset(&walk_info, 0, sizeof(walk_info));
+
+	walk_info.entry = test_file_ops_walk_entry;
+	walk_info.leave = test_file_ops_walk_leave;
+	walk_info.arg = &count;
+	walk_info.jpool = jpool;
+	ret = udo_file_ops_walk(root, &walk_info);
+	assert_int_equal(ret, 0);
+
+	/* Symbolic link is counted as a file */
+	assert_int_equal(count.dirs, TEST_FILE_OPS_WALK_DIRS * 3);
+	assert_int_equal(count.files, (TEST_FILE_OPS_WALK_DIRS * 2 * TEST_FILE_OPS_WALK_FILES) + 1);
+	assert_int_equal(count.left, (TEST_FILE_OPS_WALK_DIRS * 3) + 1);
+	assert_int_equal(count.max_depth, 2);
+}
+
+
+static void UDO_UNUSED
+test_file_ops_walk (void UDO_UNUSED **state)
+{
+	int ret = -1;
+
+	struct stat st;
+
+	struct udo_file_ops_walk_info walk_info;
+
+	const char *root = "/tmp/test-walk";
+
+	memset(&walk_info, 0, sizeof(walk_info));
+
+	udo_file_ops_remove_dir(root);
+
+	ret = udo_file_ops_walk(root, NULL);
+	assert_int_equal(ret, -1);
+
+	ret = udo_file_ops_walk(root, &walk_info);
+	assert_int_equal(ret, -1);
+
+	test_file_ops_walk_create_tree(root);
+	test_file_ops_walk_count(root, NULL);
+
+#ifdef TEST_FILE_OPS_JPOOL
+	struct udo_jpool *jpool = NULL;
+	struct udo_jpool_create_info jpool_info;
+
+	memset(&jpool_info, 0, sizeof(jpool_info));
+	jpool_info.count = 4;
+	jpool_info.size  = UDO_PAGE_SIZE;
+	jpool = udo_jpool_create(NULL, &jpool_info);
+	assert_non_null(jpool);
+
+	test_file_ops_walk_count(root, jpool);
+
+	ret = udo_file_ops_remove_dir_jpool(root, jpool);
+#else
+	ret = udo_file_ops_remove_dir(root);
+#endif
+	assert_int_equal(ret, 0);
+	assert_int_equal(stat(root, &st), -1);
+
+	/* Symbolic link target survives */
+	assert_int_equal(stat("/tmp", &st), 0);
+
+#ifdef TEST_FILE_OPS_JPOOL
+	udo_jpool_destroy(jpool);
+#endif
+}
+
+/***************************************
+ * End of test_file_ops_walk functions *
+ ***************************************/
+
+
 /***********************************************
  * Start of test_file_ops_remove_dir functions *
  ***********************************************/
@@ -557,10 +1523,18 @@ main (void)
 	const struct CMUnitTest tests[] = {
 		cmocka_unit_test(test_file_ops_create),
 		cmocka_unit_test(test_file_ops_create_empty_file),
+		cmocka_unit_test(test_file_ops_map_cache),
 		cmocka_unit_test(test_file_ops_zero_copy),
+		cmocka_unit_test(test_file_ops_transfer),
+		cmocka_unit_test(test_file_ops_append),
+		cmocka_unit_test(test_file_ops_flush_range),
+		cmocka_unit_test(test_file_ops_advise),
+		cmocka_unit_test(test_file_ops_iter),
+		cmocka_unit_test(test_file_ops_stream),
 		cmocka_unit_test(test_file_ops_get_data),
 		cmocka_unit_test(test_file_ops_get_line),
 		cmocka_unit_test(test_file_ops_get_line_count),
+		cmocka_unit_test(test_file_ops_get_line_index),
 		cmocka_unit_test(test_file_ops_get_fd),
 		cmocka_unit_test(test_file_ops_get_alloc_size),
 		cmocka_unit_test(test_file_ops_get_data_size),
@@ -571,6 +1545,7 @@ main (void)
 		cmocka_unit_test(test_file_ops_get_sizeof),
 		cmocka_unit_test(test_file_ops_set_fd_flags),
 		cmocka_unit_test(test_file_ops_remove_dir),
+		cmocka_unit_test(test_file_ops_walk),
 	};
 
 	return cmocka_run_group_tests(tests, NULL, NULL);
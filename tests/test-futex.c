@@ -24,8 +24,11 @@
 
 #include <stdlib.h>
 #include <unistd.h>
+#include <sched.h>
 #include <errno.h>
 #include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 /* Required by cmocka */
 #include <stdarg.h>
@@ -106,6 +109,59 @@ test_futex_lock_unlock (void UDO_UNUSED **state)
  *******************************************/
 
 
+/************************************************
+ * Start of test_futex_lock_unlock_pi functions *
+ ************************************************/
+
+static void UDO_UNUSED
+test_futex_lock_unlock_pi (void UDO_UNUSED **state)
+{
+	pid_t pid;
+
+	udo_atomic_u32 *fux;
+
+	struct udo_futex_create_info futex_info;
+
+	futex_info.count = 1;
+	futex_info.size = UDO_PAGE_SIZE;
+	fux = udo_futex_create_pi(&futex_info);
+	assert_non_null(fux);
+	assert_int_equal(__atomic_load_n(fux, __ATOMIC_ACQUIRE), 0);
+
+	udo_futex_lock_pi(fux);
+	assert_int_equal(__atomic_load_n(fux, __ATOMIC_ACQUIRE), \
+	                 syscall(SYS_gettid));
+
+	pid = fork();
+	if (pid == 0) {
+		/* Blocks until parent unlocks */
+		udo_futex_lock_pi(fux);
+		udo_futex_unlock_pi(fux);
+
+		exit(0);
+	}
+
+	/*
+	 * Kernel sets FUTEX_WAITERS in the futex word
+	 * once the child is queued on the futex.
+	 */
+	while (!(__atomic_load_n(fux, __ATOMIC_ACQUIRE) & FUTEX_WAITERS))
+		sched_yield();
+
+	udo_futex_unlock_pi(fux);
+
+	wait(NULL);
+
+	assert_int_equal(__atomic_load_n(fux, __ATOMIC_ACQUIRE), 0);
+
+	udo_futex_destroy(fux, futex_info.size);
+}
+
+/**********************************************
+ * End of test_futex_lock_unlock_pi functions *
+ **********************************************/
+
+
 /***************************************************
  * Start of test_futex_lock_unlock_force functions *
  ***************************************************/
@@ -219,15 +275,79 @@ test_futex_wait_wake_cond (void UDO_UNUSED **state)
  * End of test_futex_wait_wake_cond functions *
  **********************************************/
 
+/********************************************
+ * Start of test_futex_waitv_wake functions *
+ ********************************************/
+
+static void UDO_UNUSED
+test_futex_waitv_wake (void UDO_UNUSED **state)
+{
+	int ret;
+
+	pid_t pid;
+
+	udo_atomic_u32 *fux;
+
+	struct udo_futex_waiter waiters[3];
+
+	struct udo_futex_create_info futex_info;
+
+	futex_info.count = 3;
+	futex_info.size = UDO_PAGE_SIZE;
+	fux = udo_futex_create(&futex_info);
+	assert_non_null(fux);
+
+	ret = udo_futex_waitv(NULL, 3);
+	assert_int_equal(ret, -1);
+
+	ret = udo_futex_waitv(waiters, UDO_FUTEX_WAITV_MAX + 1);
+	assert_int_equal(ret, -1);
+
+	for (ret = 0; ret < 3; ret++) {
+		waiters[ret].fux = &fux[ret];
+		waiters[ret].val = 1;
+	}
+
+	pid = fork();
+	if (pid == 0) {
+		udo_futex_wake(&fux[2], 64);
+
+		exit(0);
+	}
+
+	ret = udo_futex_waitv(waiters, 3);
+	assert_int_equal(ret, 2);
+	assert_int_equal(__atomic_load_n(&fux[2], __ATOMIC_ACQUIRE), 64);
+
+	wait(NULL);
+
+	/* Value already changed returns without sleeping */
+	ret = udo_futex_waitv(waiters, 3);
+	assert_int_equal(ret, 2);
+
+	udo_futex_unlock_force(&fux[0]);
+	ret = udo_futex_waitv(waiters, 3);
+	assert_int_equal(ret, -1);
+	assert_int_equal(errno, EINTR);
+
+	udo_futex_destroy(fux, futex_info.size);
+}
+
+/******************************************
+ * End of test_futex_waitv_wake functions *
+ ******************************************/
+
 int
 main (void)
 {
 	const struct CMUnitTest tests[] = {
 		cmocka_unit_test(test_futex_create),
 		cmocka_unit_test(test_futex_lock_unlock),
+		cmocka_unit_test(test_futex_lock_unlock_pi),
 		cmocka_unit_test(test_futex_lock_unlock_force),
 		cmocka_unit_test(test_futex_wait_wake),
 		cmocka_unit_test(test_futex_wait_wake_cond),
+		cmocka_unit_test(test_futex_waitv_wake),
 	};
 
 	return cmocka_run_group_tests(tests, NULL, NULL);
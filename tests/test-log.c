@@ -22,10 +22,13 @@
  * SOFTWARE.
  */
 
+#define _GNU_SOURCE 1
 #include <fcntl.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <pthread.h>
+#include <sched.h>
 
 /*
  * Required by cmocka
@@ -195,6 +198,312 @@ test_log_error (void UDO_UNUSED **state)
  ***********************************/
 
 
+/****************************************
+ * Start of test_log_set_sync functions *
+ ****************************************/
+
+static void UDO_UNUSED
+test_log_set_sync (void UDO_UNUSED **state)
+{
+	int ret = -1, fd = -1, fds[2];
+	ssize_t len;
+
+	char big[3000], buf[4096];
+
+	const char *test_file = "/tmp/test-log-sync.txt";
+	const char expect[] = "\e[32;1mlines 1\n\x1b[0m\e[32;1mlines 2\n\x1b[0m" \
+	                      "\e[31;1merror\n\x1b[0m\e[35;1minterval\n\x1b[0m\e[33;1m";
+
+	ret = udo_log_set_sync(UDO_LOG_SYNC_LINES, 0);
+	assert_int_equal(ret, -1);
+
+	ret = udo_log_set_sync(UDO_LOG_SYNC_INTERVAL, 0);
+	assert_int_equal(ret, -1);
+
+	ret = udo_log_set_sync(UDO_LOG_SYNC_INTERVAL + 1, 1);
+	assert_int_equal(ret, -1);
+
+	fd = open(test_file, O_CREAT|O_RDWR|O_TRUNC, 0644);
+	assert_int_not_equal(fd, -1);
+
+	udo_log_set_write_fd(fd);
+	udo_log_set_level(UDO_LOG_ALL);
+	udo_log_reset_colors();
+
+	ret = udo_log_set_sync(UDO_LOG_SYNC_LINES, 2);
+	assert_int_equal(ret, 0);
+	udo_log_print(UDO_LOG_SUCCESS, "lines %d\n", 1);
+	udo_log_print(UDO_LOG_SUCCESS, "lines %d\n", 2);
+
+	ret = udo_log_set_sync(UDO_LOG_SYNC_ERROR, 0);
+	assert_int_equal(ret, 0);
+	udo_log_print(UDO_LOG_ERROR, "error\n");
+
+	ret = udo_log_set_sync(UDO_LOG_SYNC_INTERVAL, 1);
+	assert_int_equal(ret, 0);
+	udo_log_print(UDO_LOG_INFO, "interval\n");
+
+	ret = udo_log_set_sync(UDO_LOG_SYNC_NEVER, 0);
+	assert_int_equal(ret, 0);
+
+	/* Records longer than the stack buffer aren't truncated */
+	memset(big, 'x', sizeof(big));
+	big[sizeof(big)-2] = '\n';
+	big[sizeof(big)-1] = '\0';
+	udo_log_print(UDO_LOG_WARNING, "%s", big);
+
+	memset(buf, 0, sizeof(buf));
+	len = pread(fd, buf, sizeof(buf)-1, 0);
+	assert_int_equal(len, sizeof(expect)-1 + sizeof(big)-1 + 4);
+	assert_memory_equal(buf, expect, sizeof(expect)-1);
+	assert_memory_equal(buf + sizeof(expect)-1, big, sizeof(big)-1);
+
+	close(fd);
+	remove(test_file);
+
+	/* fdatasync(2) failing on pipes is ignored */
+	ret = pipe(fds);
+	assert_int_equal(ret, 0);
+
+	udo_log_set_write_fd(fds[1]);
+	ret = udo_log_set_sync(UDO_LOG_SYNC_LINES, 1);
+	assert_int_equal(ret, 0);
+	udo_log_print(UDO_LOG_INFO, "pipe\n");
+
+	memset(buf, 0, sizeof(buf));
+	len = read(fds[0], buf, sizeof(buf)-1);
+	assert_int_equal(len, 7 + 5 + 4);
+	assert_string_equal(buf, "\e[35;1mpipe\n\x1b[0m");
+
+	udo_log_set_sync(UDO_LOG_SYNC_NEVER, 0);
+	udo_log_set_write_fd(STDOUT_FILENO);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+/**************************************
+ * End of test_log_set_sync functions *
+ **************************************/
+
+
+/*************************************
+ * Start of test_log_async functions *
+ *************************************/
+
+#define TEST_LOG_ASYNC_THREADS 4
+#define TEST_LOG_ASYNC_MSGS 2000
+
+static int log_async_started = 0;
+
+static void *
+log_async_thread (void *arg)
+{
+	int i;
+
+	for (i = 0; i < TEST_LOG_ASYNC_MSGS; i++) {
+		udo_log_info("thread %d message %d\n", *((int*)arg), i);
+		if (!i)
+			__atomic_add_fetch(&log_async_started, 1, __ATOMIC_RELEASE);
+	}
+
+	return NULL;
+}
+
+
+static void UDO_UNUSED
+test_log_async (void UDO_UNUSED **state)
+{
+	int ret = -1, fd = -1, t;
+	size_t lines = 0;
+	ssize_t len;
+
+	char buf[4096], *nl;
+
+	int args[TEST_LOG_ASYNC_THREADS];
+	pthread_t tids[TEST_LOG_ASYNC_THREADS];
+
+	struct udo_log_async_info async_info;
+
+	const char *test_file = "/tmp/test-log-async.txt";
+
+	fd = open(test_file, O_CREAT|O_RDWR|O_TRUNC, 0644);
+	assert_int_not_equal(fd, -1);
+
+	udo_log_set_write_fd(fd);
+	udo_log_set_level(UDO_LOG_ALL);
+
+	ret = udo_log_async_start(NULL);
+	assert_int_equal(ret, -1);
+
+	memset(&async_info, 0, sizeof(async_info));
+	async_info.overflow = UDO_LOG_OVERFLOW_BLOCK + 1;
+	ret = udo_log_async_start(&async_info);
+	assert_int_equal(ret, -1);
+
+	/* Small ring so that producers block on the writer */
+	async_info.entries = 60;
+	async_info.overflow = UDO_LOG_OVERFLOW_BLOCK;
+	ret = udo_log_async_start(&async_info);
+	assert_int_equal(ret, 0);
+
+	ret = udo_log_async_start(&async_info);
+	assert_int_equal(ret, -1);
+
+	for (t = 0; t < TEST_LOG_ASYNC_THREADS; t++) {
+		args[t] = t;
+		ret = pthread_create(&tids[t], NULL, log_async_thread, &args[t]);
+		assert_int_equal(ret, 0);
+	}
+
+	for (t = 0; t < TEST_LOG_ASYNC_THREADS; t++)
+		pthread_join(tids[t], NULL);
+
+	udo_log_print(UDO_LOG_SUCCESS, "last message\n");
+
+	ret = udo_log_flush();
+	assert_int_equal(ret, 0);
+	assert_int_equal(udo_log_get_dropped(), 0);
+
+	/* Every message is written whole */
+	lseek(fd, 0, SEEK_SET);
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		for (nl = buf; (nl = memchr(nl, '\n', len - (nl - buf))); nl++)
+			lines++;
+	}
+	assert_int_equal(lines, (TEST_LOG_ASYNC_THREADS * TEST_LOG_ASYNC_MSGS) + 1);
+
+	udo_log_async_stop();
+	udo_log_async_stop();
+
+	ret = udo_log_flush();
+	assert_int_equal(ret, 0);
+
+	/* Stopping while threads log neither loses nor repeats messages */
+	assert_int_equal(ftruncate(fd, 0), 0);
+	lseek(fd, 0, SEEK_SET);
+
+	ret = udo_log_async_start(&async_info);
+	assert_int_equal(ret, 0);
+
+	for (t = 0; t < TEST_LOG_ASYNC_THREADS; t++) {
+		ret = pthread_create(&tids[t], NULL, log_async_thread, &args[t]);
+		assert_int_equal(ret, 0);
+	}
+
+	/* Stop once every thread is logging through the ring */
+	while (__atomic_load_n(&log_async_started, __ATOMIC_ACQUIRE) < TEST_LOG_ASYNC_THREADS * 2)
+		sched_yield();
+
+	udo_log_async_stop();
+
+	for (t = 0; t < TEST_LOG_ASYNC_THREADS; t++)
+		pthread_join(tids[t], NULL);
+
+	lines = 0;
+	lseek(fd, 0, SEEK_SET);
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		for (nl = buf; (nl = memchr(nl, '\n', len - (nl - buf))); nl++)
+			lines++;
+	}
+	assert_int_equal(lines, TEST_LOG_ASYNC_THREADS * TEST_LOG_ASYNC_MSGS);
+
+	udo_log_set_write_fd(STDOUT_FILENO);
+	close(fd);
+	remove(test_file);
+}
+
+/***********************************
+ * End of test_log_async functions *
+ ***********************************/
+
+
+/**********************************************
+ * Start of test_log_async_overflow functions *
+ **********************************************/
+
+struct log_pipe_reader
+{
+	int    fd;
+	size_t size;
+	int    notice;
+};
+
+
+static void *
+log_pipe_read (void *arg)
+{
+	ssize_t len;
+
+	char buf[8192];
+
+	struct log_pipe_reader *reader = arg;
+
+	while ((len = read(reader->fd, buf, sizeof(buf)-1)) > 0) {
+		buf[len] = '\0';
+		reader->size += len;
+		if (strstr(buf, "log messages dropped"))
+			reader->notice = 1;
+	}
+
+	return NULL;
+}
+
+
+static void UDO_UNUSED
+test_log_async_overflow (void UDO_UNUSED **state)
+{
+	int ret = -1, i;
+
+	int fds[2];
+
+	pthread_t tid;
+
+	struct log_pipe_reader reader;
+	struct udo_log_async_info async_info;
+
+	ret = pipe(fds);
+	assert_int_equal(ret, 0);
+	fcntl(fds[1], F_SETPIPE_SZ, 4096);
+
+	udo_log_set_write_fd(fds[1]);
+	udo_log_set_level(UDO_LOG_ALL);
+
+	memset(&async_info, 0, sizeof(async_info));
+	async_info.entries = 16;
+	async_info.overflow = UDO_LOG_OVERFLOW_COUNT;
+	ret = udo_log_async_start(&async_info);
+	assert_int_equal(ret, 0);
+
+	/* Nothing reads the pipe. So, writer stalls and the ring fills */
+	for (i = 0; i < 1000; i++)
+		udo_log_warning("overflow message %d\n", i);
+
+	assert_true(udo_log_get_dropped() > 0);
+
+	memset(&reader, 0, sizeof(reader));
+	reader.fd = fds[0];
+	ret = pthread_create(&tid, NULL, log_pipe_read, &reader);
+	assert_int_equal(ret, 0);
+
+	ret = udo_log_flush();
+	assert_int_equal(ret, 0);
+
+	udo_log_async_stop();
+	udo_log_set_write_fd(STDOUT_FILENO);
+
+	close(fds[1]);
+	pthread_join(tid, NULL);
+	close(fds[0]);
+
+	assert_true(reader.size > 0);
+	assert_int_equal(reader.notice, 1);
+}
+
+/********************************************
+ * End of test_log_async_overflow functions *
+ ********************************************/
+
+
 int
 main (void)
 {
@@ -204,6 +513,9 @@ main (void)
 		cmocka_unit_test(test_log_print),
 		cmocka_unit_test(test_log_set_write_fd),
 		cmocka_unit_test(test_log_error),
+		cmocka_unit_test(test_log_set_sync),
+		cmocka_unit_test(test_log_async),
+		cmocka_unit_test(test_log_async_overflow),
 	};
 
 	return cmocka_run_group_tests(tests, NULL, NULL);
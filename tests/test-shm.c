@@ -22,8 +22,15 @@
  * SOFTWARE.
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/eventfd.h>
 
 /*
  * Required by cmocka
@@ -69,7 +76,7 @@ test_shm_create (void UDO_UNUSED **state)
 	/* Test process count invalid */
 	shm_info.shm_file   = "/kms-shm-testing";
 	shm_info.shm_size   = UDO_PAGE_SIZE;
-	shm_info.proc_count = (1<<5);
+	shm_info.proc_count = (1<<13);
 	shm = udo_shm_create(NULL, &shm_info);
 	assert_null(shm);
 
@@ -95,24 +102,39 @@ test_shm_data (void **state UDO_UNUSED)
 {
 	pid_t pid;
 
+	struct udo_shm *shm = NULL;
+
+	struct udo_shm_create_info shm_info;
+
 	struct some_data {
 		char buf[128];
 		int value;
 	};
 
+	memset(&shm_info, 0, sizeof(shm_info));
+
+	shm_info.proc_count = 2;
+	shm_info.shm_file   = "/kms-shm-testing";
+	shm_info.shm_size   = UDO_PAGE_SIZE;
+
+	/*
+	 * Reader attaches before fork(2) so the writer
+	 * can't create and unlink shared memory first.
+	 */
+	shm = udo_shm_create(NULL, &shm_info);
+	assert_non_null(shm);
+
 	pid = fork();
 	if (pid == 0) {
 		int err = -1;
 
-		struct udo_shm *shm = NULL;
+		unsigned char large[1021];
 
 		struct some_data sdata;
-		struct udo_shm_create_info shm_info;
 		struct udo_shm_data_info shm_data_info;
 
-		shm_info.proc_count = 2;
-		shm_info.shm_file   = "/kms-shm-testing";
-		shm_info.shm_size   = UDO_PAGE_SIZE;
+		memset(&shm_data_info, 0, sizeof(shm_data_info));
+
 		shm = udo_shm_create(NULL, &shm_info);
 		assert_non_null(shm);
 
@@ -125,25 +147,36 @@ test_shm_data (void **state UDO_UNUSED)
 		err = udo_shm_data_write(shm, &shm_data_info);
 		assert_int_equal(err, 0);
 
+		/* Size not a multiple of 4 with non-temporal stores */
+		memset(large, 'L', sizeof(large));
+		shm_data_info.size = sizeof(large);
+		shm_data_info.data = large;
+		shm_data_info.non_temporal = 1;
+		err = udo_shm_data_write(shm, &shm_data_info);
+		assert_int_equal(err, 0);
+
 		udo_shm_destroy(shm);
+		exit(0);
 	} else {
 		int err = -1;
 
 		char buf[128];
 
-		struct udo_shm *shm = NULL;
+		unsigned char large[1021], large_cmp[1021];
 
 		struct some_data sdata;
-		struct udo_shm_create_info shm_info;
 		struct udo_shm_data_info shm_data_info;
 
+		memset(&shm_data_info, 0, sizeof(shm_data_info));
+
 		memset(buf, 'T', sizeof(buf));
 
-		shm_info.proc_count = 2;
-		shm_info.shm_file   = "/kms-shm-testing";
-		shm_info.shm_size   = UDO_PAGE_SIZE;
-		shm = udo_shm_create(NULL, &shm_info);
-		assert_non_null(shm);
+		/* Test size larger than process segment */
+		shm_data_info.proc_index = 0;
+		shm_data_info.size = UDO_PAGE_SIZE;
+		shm_data_info.data = (void*) &sdata;
+		err = udo_shm_data_write(shm, &shm_data_info);
+		assert_int_equal(err, -1);
 
 		shm_data_info.proc_index = 0;
 		shm_data_info.size = sizeof(sdata);
@@ -153,6 +186,17 @@ test_shm_data (void **state UDO_UNUSED)
 		assert_int_equal(sdata.value, 821);
 		assert_memory_equal(sdata.buf, buf, sizeof(buf));
 
+		memset(large, 0, sizeof(large));
+		memset(large_cmp, 'L', sizeof(large_cmp));
+		shm_data_info.size = sizeof(large);
+		shm_data_info.data = large;
+		shm_data_info.non_temporal = 1;
+		err = udo_shm_data_read(shm, &shm_data_info);
+		assert_int_equal(err, 0);
+		assert_memory_equal(large, large_cmp, sizeof(large));
+
+		wait(NULL);
+
 		udo_shm_destroy(shm);
 	}
 }
@@ -162,6 +206,1270 @@ test_shm_data (void **state UDO_UNUSED)
  **********************************/
 
 
+/************************************
+ * Start of test_shm_ring functions *
+ ************************************/
+
+#define TEST_SHM_RING_RECORDS 10000
+
+static void UDO_UNUSED
+test_shm_ring (void **state UDO_UNUSED)
+{
+	pid_t pid;
+
+	ssize_t ret;
+
+	uint32_t r;
+
+	unsigned char buf[256], expect[256];
+
+	struct udo_shm *shm = NULL;
+
+	struct udo_shm_create_info shm_info;
+	struct udo_shm_data_info shm_data_info;
+
+	memset(&shm_info, 0, sizeof(shm_info));
+	memset(&shm_data_info, 0, sizeof(shm_data_info));
+
+	shm_info.proc_count = 2;
+	shm_info.shm_file   = "/kms-shm-ring-testing";
+	shm_info.shm_size   = UDO_PAGE_SIZE;
+
+	shm = udo_shm_create(NULL, &shm_info);
+	assert_non_null(shm);
+
+	pid = fork();
+	if (pid == 0) {
+		shm = udo_shm_create(NULL, &shm_info);
+		assert_non_null(shm);
+
+		shm_data_info.proc_index = 0;
+		shm_data_info.data = buf;
+
+		for (r = 0; r < TEST_SHM_RING_RECORDS; r++) {
+			memset(buf, r & 0xFF, sizeof(buf));
+			shm_data_info.size = (r % sizeof(buf)) + 1;
+			ret = udo_shm_ring_write(shm, &shm_data_info);
+			assert_int_equal(ret, shm_data_info.size);
+		}
+
+		udo_shm_destroy(shm);
+		exit(0);
+	}
+
+	/* Test record to large for ring */
+	shm_data_info.proc_index = 0;
+	shm_data_info.data = buf;
+	shm_data_info.size = UDO_PAGE_SIZE;
+	ret = udo_shm_ring_write(shm, &shm_data_info);
+	assert_int_equal(ret, -1);
+
+	for (r = 0; r < TEST_SHM_RING_RECORDS; r++) {
+		memset(expect, r & 0xFF, sizeof(expect));
+		shm_data_info.size = sizeof(buf);
+		ret = udo_shm_ring_read(shm, &shm_data_info);
+		assert_int_equal(ret, (r % sizeof(buf)) + 1);
+		assert_memory_equal(buf, expect, ret);
+	}
+
+	wait(NULL);
+
+	udo_shm_destroy(shm);
+}
+
+/**********************************
+ * End of test_shm_ring functions *
+ **********************************/
+
+
+/*****************************************
+ * Start of test_shm_ring_mpmc functions *
+ *****************************************/
+
+#define TEST_SHM_RING_MPMC_PROCS 2
+#define TEST_SHM_RING_MPMC_STOP UINT32_MAX
+
+struct test_shm_ring_mpmc_rec {
+	uint32_t producer;
+	uint32_t seq;
+	unsigned char pad[48];
+};
+
+static void
+test_shm_ring_mpmc_consume (struct udo_shm_create_info *shm_info,
+                            uint64_t *results)
+{
+	ssize_t ret;
+
+	uint32_t last[TEST_SHM_RING_MPMC_PROCS];
+
+	struct udo_shm *shm = NULL;
+	struct test_shm_ring_mpmc_rec rec;
+	struct udo_shm_data_info shm_data_info;
+
+	memset(last, 0, sizeof(last));
+	memset(&shm_data_info, 0, sizeof(shm_data_info));
+
+	shm = udo_shm_create(NULL, shm_info);
+	assert_non_null(shm);
+
+	shm_data_info.proc_index = 0;
+	shm_data_info.data = &rec;
+	shm_data_info.size = sizeof(rec);
+
+	for (;;) {
+		ret = udo_shm_ring_read(shm, &shm_data_info);
+		assert_in_range(ret, offsetof(struct test_shm_ring_mpmc_rec, pad), sizeof(rec));
+		if (rec.producer == TEST_SHM_RING_MPMC_STOP)
+			break;
+
+		/* Records of a single producer are consumed in order */
+		assert_true(rec.seq > last[rec.producer]);
+		last[rec.producer] = rec.seq;
+
+		__atomic_add_fetch(&results[0], 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&results[1], rec.seq, __ATOMIC_RELAXED);
+	}
+
+	udo_shm_destroy(shm);
+}
+
+
+static void UDO_UNUSED
+test_shm_ring_mpmc (void **state UDO_UNUSED)
+{
+	pid_t pid, producers[TEST_SHM_RING_MPMC_PROCS];
+
+	ssize_t ret;
+
+	uint32_t p, r;
+
+	uint64_t *results;
+
+	struct udo_shm *shm = NULL;
+	struct test_shm_ring_mpmc_rec rec;
+
+	struct udo_shm_create_info shm_info;
+	struct udo_shm_data_info shm_data_info;
+
+	memset(&rec, 0, sizeof(rec));
+	memset(&shm_info, 0, sizeof(shm_info));
+	memset(&shm_data_info, 0, sizeof(shm_data_info));
+
+	results = mmap(NULL, UDO_PAGE_SIZE, PROT_READ|PROT_WRITE,
+	               MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	assert_ptr_not_equal(results, MAP_FAILED);
+
+	shm_info.proc_count = (TEST_SHM_RING_MPMC_PROCS << 1) + 1;
+	shm_info.shm_file   = "/kms-shm-ring-mpmc-testing";
+	shm_info.shm_size   = UDO_PAGE_SIZE << 2;
+
+	shm = udo_shm_create(NULL, &shm_info);
+	assert_non_null(shm);
+
+	for (p = 0; p < TEST_SHM_RING_MPMC_PROCS; p++) {
+		pid = fork();
+		if (pid == 0) {
+			test_shm_ring_mpmc_consume(&shm_info, results);
+			exit(0);
+		}
+	}
+
+	for (p = 0; p < TEST_SHM_RING_MPMC_PROCS; p++) {
+		pid = fork();
+		if (pid == 0) {
+			shm = udo_shm_create(NULL, &shm_info);
+			assert_non_null(shm);
+
+			shm_data_info.proc_index = 0;
+			shm_data_info.data = &rec;
+
+			rec.producer = p;
+			for (r = 1; r <= TEST_SHM_RING_RECORDS; r++) {
+				rec.seq = r;
+				shm_data_info.size = sizeof(rec) - (r % sizeof(rec.pad));
+				ret = udo_shm_ring_write(shm, &shm_data_info);
+				assert_int_equal(ret, shm_data_info.size);
+			}
+
+			udo_shm_destroy(shm);
+			exit(0);
+		}
+
+		producers[p] = pid;
+	}
+
+	/* Consumers stop once every producer is done */
+	for (p = 0; p < TEST_SHM_RING_MPMC_PROCS; p++)
+		waitpid(producers[p], NULL, 0);
+
+	shm_data_info.proc_index = 0;
+	shm_data_info.data = &rec;
+	shm_data_info.size = sizeof(rec);
+	rec.producer = TEST_SHM_RING_MPMC_STOP;
+	for (p = 0; p < TEST_SHM_RING_MPMC_PROCS; p++) {
+		ret = udo_shm_ring_write(shm, &shm_data_info);
+		assert_int_equal(ret, sizeof(rec));
+	}
+
+	while (wait(NULL) > 0);
+
+	assert_int_equal(results[0], TEST_SHM_RING_MPMC_PROCS * TEST_SHM_RING_RECORDS);
+	assert_int_equal(results[1], TEST_SHM_RING_MPMC_PROCS * \
+		((uint64_t) TEST_SHM_RING_RECORDS * (TEST_SHM_RING_RECORDS + 1) / 2));
+
+	munmap(results, UDO_PAGE_SIZE);
+	udo_shm_destroy(shm);
+}
+
+/***************************************
+ * End of test_shm_ring_mpmc functions *
+ ***************************************/
+
+
+/********************************************
+ * Start of test_shm_ring_threads functions *
+ ********************************************/
+
+#define TEST_SHM_RING_THREADS 4
+
+struct test_shm_ring_threads_args {
+	struct udo_shm *shm;
+	uint32_t       producer;
+	uint64_t       *results;
+};
+
+static void *
+test_shm_ring_threads_produce (void *arg)
+{
+	struct test_shm_ring_threads_args *args = arg;
+
+	struct udo_shm_data_info shm_data_info;
+	struct test_shm_ring_mpmc_rec rec;
+
+	memset(&rec, 0, sizeof(rec));
+	memset(&shm_data_info, 0, sizeof(shm_data_info));
+
+	shm_data_info.proc_index = 0;
+	shm_data_info.data = &rec;
+
+	rec.producer = args->producer;
+	for (rec.seq = 1; rec.seq <= TEST_SHM_RING_RECORDS; rec.seq++) {
+		shm_data_info.size = sizeof(rec) - (rec.seq % sizeof(rec.pad));
+		if (udo_shm_ring_write(args->shm, &shm_data_info) != (ssize_t) shm_data_info.size)
+			__atomic_add_fetch(&args->results[2], 1, __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+
+static void *
+test_shm_ring_threads_consume (void *arg)
+{
+	ssize_t ret;
+
+	struct test_shm_ring_threads_args *args = arg;
+
+	struct udo_shm_data_info shm_data_info;
+	struct test_shm_ring_mpmc_rec rec;
+
+	memset(&shm_data_info, 0, sizeof(shm_data_info));
+
+	shm_data_info.proc_index = 0;
+	shm_data_info.data = &rec;
+	shm_data_info.size = sizeof(rec);
+
+	for (;;) {
+		ret = udo_shm_ring_read(args->shm, &shm_data_info);
+		if (ret < (ssize_t) offsetof(struct test_shm_ring_mpmc_rec, pad)) {
+			__atomic_add_fetch(&args->results[2], 1, __ATOMIC_RELAXED);
+			break;
+		}
+
+		if (rec.producer == TEST_SHM_RING_MPMC_STOP)
+			break;
+
+		__atomic_add_fetch(&args->results[0], 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&args->results[1], rec.seq, __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+
+static void UDO_UNUSED
+test_shm_ring_threads (void **state UDO_UNUSED)
+{
+	int err = -1;
+
+	ssize_t ret;
+
+	uint32_t t;
+
+	uint64_t results[3];
+
+	pthread_t producers[TEST_SHM_RING_THREADS];
+	pthread_t consumers[TEST_SHM_RING_THREADS];
+
+	struct udo_shm *shm = NULL;
+	struct test_shm_ring_mpmc_rec rec;
+	struct test_shm_ring_threads_args args[TEST_SHM_RING_THREADS];
+
+	struct udo_shm_create_info shm_info;
+	struct udo_shm_data_info shm_data_info;
+
+	memset(&rec, 0, sizeof(rec));
+	memset(results, 0, sizeof(results));
+	memset(&shm_info, 0, sizeof(shm_info));
+	memset(&shm_data_info, 0, sizeof(shm_data_info));
+
+	shm_info.proc_count = 1;
+	shm_info.shm_file   = "/kms-shm-ring-threads-testing";
+	shm_info.shm_size   = UDO_PAGE_SIZE << 1;
+
+	/* Every thread copies records through the same context */
+	shm = udo_shm_create(NULL, &shm_info);
+	assert_non_null(shm);
+
+	for (t = 0; t < TEST_SHM_RING_THREADS; t++) {
+		args[t].shm = shm;
+		args[t].producer = t;
+		args[t].results = results;
+
+		err = pthread_create(&consumers[t], NULL, test_shm_ring_threads_consume, &args[t]);
+		assert_int_equal(err, 0);
+		err = pthread_create(&producers[t], NULL, test_shm_ring_threads_produce, &args[t]);
+		assert_int_equal(err, 0);
+	}
+
+	for (t = 0; t < TEST_SHM_RING_THREADS; t++)
+		pthread_join(producers[t], NULL);
+
+	shm_data_info.proc_index = 0;
+	shm_data_info.data = &rec;
+	shm_data_info.size = sizeof(rec);
+	rec.producer = TEST_SHM_RING_MPMC_STOP;
+	for (t = 0; t < TEST_SHM_RING_THREADS; t++) {
+		ret = udo_shm_ring_write(shm, &shm_data_info);
+		assert_int_equal(ret, sizeof(rec));
+	}
+
+	for (t = 0; t < TEST_SHM_RING_THREADS; t++)
+		pthread_join(consumers[t], NULL);
+
+	/* No thread failed on another threads record */
+	assert_int_equal(results[2], 0);
+	assert_int_equal(results[0], TEST_SHM_RING_THREADS * TEST_SHM_RING_RECORDS);
+	assert_int_equal(results[1], TEST_SHM_RING_THREADS * \
+		((uint64_t) TEST_SHM_RING_RECORDS * (TEST_SHM_RING_RECORDS + 1) / 2));
+
+	udo_shm_destroy(shm);
+}
+
+/******************************************
+ * End of test_shm_ring_threads functions *
+ ******************************************/
+
+
+/***********************************************
+ * Start of test_shm_reserve_acquire functions *
+ ***********************************************/
+
+static void UDO_UNUSED
+test_shm_reserve_acquire (void **state UDO_UNUSED)
+{
+	pid_t pid;
+
+	int err = -1;
+
+	uint32_t r, *rec;
+
+	size_t size;
+
+	const uint32_t *data;
+
+	struct udo_shm *shm = NULL;
+
+	struct udo_shm_create_info shm_info;
+	memset(&shm_info, 0, sizeof(shm_info));
+
+	shm_info.proc_count = 2;
+	shm_info.shm_file   = "/kms-shm-ring-testing";
+	shm_info.shm_size   = UDO_PAGE_SIZE;
+
+	shm = udo_shm_create(NULL, &shm_info);
+	assert_non_null(shm);
+
+	/* Test commit/release without reserve/acquire */
+	err = udo_shm_write_commit(shm, 0);
+	assert_int_equal(err, -1);
+
+	err = udo_shm_read_release(shm, 0);
+	assert_int_equal(err, -1);
+
+	rec = udo_shm_write_reserve(shm, 0, UDO_PAGE_SIZE);
+	assert_null(rec);
+
+	/* Test second reserve before commit */
+	rec = udo_shm_write_reserve(shm, 0, sizeof(uint32_t));
+	assert_non_null(rec);
+	*rec = UINT32_MAX;
+
+	assert_null(udo_shm_write_reserve(shm, 0, sizeof(uint32_t)));
+
+	err = udo_shm_write_commit(shm, 0);
+	assert_int_equal(err, 0);
+
+	data = udo_shm_read_acquire(shm, 0, &size);
+	assert_non_null(data);
+	assert_int_equal(size, sizeof(uint32_t));
+	assert_int_equal(*data, UINT32_MAX);
+
+	err = udo_shm_read_release(shm, 0);
+	assert_int_equal(err, 0);
+
+	pid = fork();
+	if (pid == 0) {
+		shm = udo_shm_create(NULL, &shm_info);
+		assert_non_null(shm);
+
+		for (r = 0; r < TEST_SHM_RING_RECORDS; r++) {
+			rec = udo_shm_write_reserve(shm, 0, 2 * sizeof(uint32_t));
+			assert_non_null(rec);
+
+			rec[0] = r;
+			rec[1] = ~r;
+
+			err = udo_shm_write_commit(shm, 0);
+			assert_int_equal(err, 0);
+		}
+
+		udo_shm_destroy(shm);
+		exit(0);
+	}
+
+	for (r = 0; r < TEST_SHM_RING_RECORDS; r++) {
+		data = udo_shm_read_acquire(shm, 0, &size);
+		assert_non_null(data);
+		assert_int_equal(size, 2 * sizeof(uint32_t));
+		assert_int_equal(data[0], r);
+		assert_int_equal(data[1], ~r);
+
+		/* Test second acquire before release */
+		if (r == 0)
+			assert_null(udo_shm_read_acquire(shm, 0, &size));
+
+		err = udo_shm_read_release(shm, 0);
+		assert_int_equal(err, 0);
+	}
+
+	wait(NULL);
+
+	udo_shm_destroy(shm);
+}
+
+/*********************************************
+ * End of test_shm_reserve_acquire functions *
+ *********************************************/
+
+
+/*************************************
+ * Start of test_shm_bcast functions *
+ *************************************/
+
+#define TEST_SHM_BCAST_RECORDS 10000
+
+static void UDO_UNUSED
+test_shm_bcast (void **state UDO_UNUSED)
+{
+	pid_t pid;
+
+	int err = -1, r0, r1;
+
+	uint32_t r;
+
+	ssize_t ret;
+
+	size_t size;
+
+	const uint32_t *data;
+
+	struct udo_shm *shm = NULL;
+
+	struct udo_shm_create_info shm_info;
+	struct udo_shm_data_info shm_data_info;
+
+	memset(&shm_info, 0, sizeof(shm_info));
+	memset(&shm_data_info, 0, sizeof(shm_data_info));
+
+	shm_info.proc_count = 2;
+	shm_info.shm_file   = "/kms-shm-bcast-testing";
+	shm_info.shm_size   = UDO_PAGE_SIZE << 2;
+
+	shm = udo_shm_create(NULL, &shm_info);
+	assert_non_null(shm);
+
+	/* Subscribers join before producer starts writing */
+	r0 = udo_shm_bcast_subscribe(shm, 0);
+	assert_int_not_equal(r0, -1);
+
+	r1 = udo_shm_bcast_subscribe(shm, 0);
+	assert_int_not_equal(r1, -1);
+	assert_int_not_equal(r0, r1);
+
+	/* Test unknown subscriber */
+	data = udo_shm_bcast_read_acquire(shm, 0, r1+1, &size);
+	assert_null(data);
+
+	pid = fork();
+	if (pid == 0) {
+		shm = udo_shm_create(NULL, &shm_info);
+		assert_non_null(shm);
+
+		shm_data_info.proc_index = 0;
+		shm_data_info.data = &r;
+		shm_data_info.size = sizeof(r);
+
+		for (r = 0; r < TEST_SHM_BCAST_RECORDS; r++) {
+			ret = udo_shm_bcast_write(shm, &shm_data_info);
+			assert_int_equal(ret, sizeof(r));
+		}
+
+		udo_shm_destroy(shm);
+		exit(0);
+	}
+
+	/* Both subscribers see every record (backpressure) */
+	for (r = 0; r < TEST_SHM_BCAST_RECORDS; r++) {
+		data = udo_shm_bcast_read_acquire(shm, 0, r0, &size);
+		assert_non_null(data);
+		assert_int_equal(size, sizeof(r));
+		assert_int_equal(*data, r);
+
+		err = udo_shm_bcast_read_release(shm, 0, r0);
+		assert_int_equal(err, 0);
+
+		data = udo_shm_bcast_read_acquire(shm, 0, r1, &size);
+		assert_non_null(data);
+		assert_int_equal(*data, r);
+
+		err = udo_shm_bcast_read_release(shm, 0, r1);
+		assert_int_equal(err, 0);
+	}
+
+	wait(NULL);
+
+	err = udo_shm_bcast_unsubscribe(shm, 0, r0);
+	assert_int_equal(err, 0);
+
+	err = udo_shm_bcast_unsubscribe(shm, 0, r1);
+	assert_int_equal(err, 0);
+
+	err = udo_shm_bcast_unsubscribe(shm, 0, r1);
+	assert_int_equal(err, -1);
+
+	udo_shm_destroy(shm);
+}
+
+
+static void UDO_UNUSED
+test_shm_bcast_skip_slow (void **state UDO_UNUSED)
+{
+	int err = -1, r0;
+
+	uint32_t r, prev;
+
+	ssize_t ret;
+
+	size_t size;
+
+	const uint32_t *data;
+
+	struct udo_shm *shm = NULL;
+
+	struct udo_shm_create_info shm_info;
+	struct udo_shm_data_info shm_data_info;
+
+	memset(&shm_info, 0, sizeof(shm_info));
+	memset(&shm_data_info, 0, sizeof(shm_data_info));
+
+	shm_info.proc_count = 1;
+	shm_info.shm_file   = "/kms-shm-bcast-testing";
+	shm_info.shm_size   = UDO_PAGE_SIZE << 1;
+	shm_info.bcast_skip_slow = 1;
+
+	shm = udo_shm_create(NULL, &shm_info);
+	assert_non_null(shm);
+
+	r0 = udo_shm_bcast_subscribe(shm, 0);
+	assert_int_not_equal(r0, -1);
+
+	shm_data_info.proc_index = 0;
+	shm_data_info.data = &r;
+	shm_data_info.size = sizeof(r);
+
+	/* Producer never waits for a subscriber that isn't reading */
+	for (r = 0; r < TEST_SHM_BCAST_RECORDS; r++) {
+		ret = udo_shm_bcast_write(shm, &shm_data_info);
+		assert_int_equal(ret, sizeof(r));
+	}
+
+	/* Subscriber skipped ahead to oldest record still stored */
+	data = udo_shm_bcast_read_acquire(shm, 0, r0, &size);
+	assert_non_null(data);
+	assert_true(*data > 0);
+	prev = *data;
+
+	err = udo_shm_bcast_read_release(shm, 0, r0);
+	assert_int_equal(err, 0);
+
+	data = udo_shm_bcast_read_acquire(shm, 0, r0, &size);
+	assert_non_null(data);
+	assert_int_equal(*data, prev+1);
+
+	/* Record overwritten while acquired */
+	for (r = 0; r < TEST_SHM_BCAST_RECORDS; r++) {
+		ret = udo_shm_bcast_write(shm, &shm_data_info);
+		assert_int_equal(ret, sizeof(r));
+	}
+
+	err = udo_shm_bcast_read_release(shm, 0, r0);
+	assert_int_equal(err, -1);
+
+	udo_shm_destroy(shm);
+}
+
+/***********************************
+ * End of test_shm_bcast functions *
+ ***********************************/
+
+
+/**************************************
+ * Start of test_shm_latest functions *
+ **************************************/
+
+#define TEST_SHM_LATEST_VALUES 100000
+
+static void UDO_UNUSED
+test_shm_latest (void **state UDO_UNUSED)
+{
+	pid_t pid;
+
+	uint32_t v, i, prev = 0;
+
+	ssize_t ret;
+
+	struct udo_shm *shm = NULL;
+
+	struct some_data {
+		uint32_t value[32];
+	} sdata;
+
+	struct udo_shm_create_info shm_info;
+	struct udo_shm_data_info shm_data_info;
+
+	memset(&shm_info, 0, sizeof(shm_info));
+	memset(&shm_data_info, 0, sizeof(shm_data_info));
+
+	shm_info.proc_count = 2;
+	shm_info.shm_file   = "/kms-shm-latest-testing";
+	shm_info.shm_size   = UDO_PAGE_SIZE;
+
+	shm = udo_shm_create(NULL, &shm_info);
+	assert_non_null(shm);
+
+	/* Test value never written */
+	shm_data_info.proc_index = 0;
+	shm_data_info.size = sizeof(sdata);
+	shm_data_info.data = &sdata;
+	ret = udo_shm_latest_read(shm, &shm_data_info);
+	assert_int_equal(ret, 0);
+
+	pid = fork();
+	if (pid == 0) {
+		shm = udo_shm_create(NULL, &shm_info);
+		assert_non_null(shm);
+
+		for (v = 1; v <= TEST_SHM_LATEST_VALUES; v++) {
+			for (i = 0; i < (sizeof(sdata.value)/sizeof(uint32_t)); i++)
+				sdata.value[i] = v;
+
+			ret = udo_shm_latest_write(shm, &shm_data_info);
+			assert_int_equal(ret, sizeof(sdata));
+		}
+
+		udo_shm_destroy(shm);
+		exit(0);
+	}
+
+	/* Readers never observe a partially written value */
+	while (prev != TEST_SHM_LATEST_VALUES) {
+		ret = udo_shm_latest_read(shm, &shm_data_info);
+		if (ret == 0)
+			continue;
+
+		assert_int_equal(ret, sizeof(sdata));
+		assert_true(sdata.value[0] >= prev);
+		for (i = 1; i < (sizeof(sdata.value)/sizeof(uint32_t)); i++)
+			assert_int_equal(sdata.value[i], sdata.value[0]);
+
+		prev = sdata.value[0];
+	}
+
+	wait(NULL);
+
+	/* Value isn't consumed on read */
+	ret = udo_shm_latest_read(shm, &shm_data_info);
+	assert_int_equal(ret, sizeof(sdata));
+	assert_int_equal(sdata.value[0], TEST_SHM_LATEST_VALUES);
+
+	/* Test buffer smaller than value */
+	shm_data_info.size = sizeof(uint32_t);
+	ret = udo_shm_latest_read(shm, &shm_data_info);
+	assert_int_equal(ret, -1);
+
+	udo_shm_destroy(shm);
+}
+
+/************************************
+ * End of test_shm_latest functions *
+ ************************************/
+
+
+/**********************************
+ * Start of test_shm_mm functions *
+ **********************************/
+
+#define TEST_SHM_MM_ALLOCS 10000
+
+static void UDO_UNUSED
+test_shm_mm (void **state UDO_UNUSED)
+{
+	pid_t pid;
+
+	int ret, status;
+
+	uint8_t fill, *addr;
+
+	uint32_t a, i;
+
+	uint64_t off, root, *root_addr;
+
+	struct udo_shm *shm = NULL;
+
+	struct udo_shm_create_info shm_info;
+
+	memset(&shm_info, 0, sizeof(shm_info));
+
+	shm_info.proc_count = 2;
+	shm_info.shm_file   = "/kms-shm-mm-testing";
+	shm_info.shm_size   = UDO_PAGE_SIZE << 2;
+
+	shm = udo_shm_create(NULL, &shm_info);
+	assert_non_null(shm);
+
+	/* Test incorrect sizes and offsets */
+	off = udo_shm_mm_alloc(shm, 0, 0);
+	assert_int_equal(off, 0);
+	off = udo_shm_mm_alloc(shm, 0, UDO_PAGE_SIZE << 3);
+	assert_int_equal(off, 0);
+	off = udo_shm_mm_alloc(shm, 2, 8);
+	assert_int_equal(off, 0);
+	ret = udo_shm_mm_free(shm, 0, 8);
+	assert_int_equal(ret, -1);
+
+	/* Test offset and address conversion */
+	root = udo_shm_mm_alloc(shm, 0, sizeof(uint64_t));
+	assert_int_not_equal(root, 0);
+	root_addr = udo_shm_mm_get_addr(shm, 0, root);
+	assert_non_null(root_addr);
+	assert_int_equal(udo_shm_mm_get_offset(shm, 0, root_addr), root);
+	*root_addr = 0;
+
+	/* Test freed block is reused and double free caught */
+	off = udo_shm_mm_alloc(shm, 0, 100);
+	assert_int_not_equal(off, 0);
+	ret = udo_shm_mm_free(shm, 0, off);
+	assert_int_equal(ret, 0);
+	ret = udo_shm_mm_free(shm, 0, off);
+	assert_int_equal(ret, -1);
+	assert_int_equal(udo_shm_mm_alloc(shm, 0, 100), off);
+	ret = udo_shm_mm_free(shm, 0, off);
+	assert_int_equal(ret, 0);
+
+	/* Concurrent allocations never hand out the same block */
+	pid = fork();
+	fill = (pid == 0) ? 0xAA : 0x55;
+	if (pid == 0) {
+		shm = udo_shm_create(NULL, &shm_info);
+		assert_non_null(shm);
+	}
+
+	for (a = 0; a < TEST_SHM_MM_ALLOCS; a++) {
+		off = udo_shm_mm_alloc(shm, 0, 16 + (a % 64));
+		assert_int_not_equal(off, 0);
+
+		addr = udo_shm_mm_get_addr(shm, 0, off);
+		assert_non_null(addr);
+		memset(addr, fill, 16 + (a % 64));
+		for (i = 0; i < 16 + (a % 64); i++)
+			assert_int_equal(addr[i], fill);
+
+		ret = udo_shm_mm_free(shm, 0, off);
+		assert_int_equal(ret, 0);
+	}
+
+	/* Share a block with the parent through an offset */
+	if (pid == 0) {
+		off = udo_shm_mm_alloc(shm, 0, 32);
+		assert_int_not_equal(off, 0);
+		strncpy(udo_shm_mm_get_addr(shm, 0, off), "udo_shm_mm", 32);
+		root_addr = udo_shm_mm_get_addr(shm, 0, root);
+		__atomic_store_n(root_addr, off, __ATOMIC_RELEASE);
+		udo_shm_destroy(shm);
+		exit(0);
+	}
+
+	waitpid(pid, &status, 0);
+	assert_true(WIFEXITED(status));
+	assert_int_equal(WEXITSTATUS(status), 0);
+
+	off = __atomic_load_n(root_addr, __ATOMIC_ACQUIRE);
+	assert_int_not_equal(off, 0);
+	assert_string_equal(udo_shm_mm_get_addr(shm, 0, off), "udo_shm_mm");
+	ret = udo_shm_mm_free(shm, 0, off);
+	assert_int_equal(ret, 0);
+
+	udo_shm_destroy(shm);
+}
+
+/********************************
+ * End of test_shm_mm functions *
+ ********************************/
+
+
+/************************************
+ * Start of test_shm_grow functions *
+ ************************************/
+
+static void UDO_UNUSED
+test_shm_grow (void **state UDO_UNUSED)
+{
+	pid_t pid;
+
+	int err = -1;
+
+	size_t data_sz;
+
+	unsigned char *data;
+
+	struct udo_shm *shm = NULL;
+
+	const size_t proc_sizes[] = { UDO_PAGE_SIZE << 4, 64, 100 };
+
+	struct udo_shm_create_info shm_info;
+	memset(&shm_info, 0, sizeof(shm_info));
+
+	shm_info.proc_count = 3;
+	shm_info.shm_file   = "/kms-shm-grow-testing";
+	shm_info.proc_sizes = proc_sizes;
+
+	/* Test growing fixed size shared memory */
+	shm = udo_shm_create(NULL, &shm_info);
+	assert_non_null(shm);
+
+	err = udo_shm_grow(shm, 2, UDO_PAGE_SIZE);
+	assert_int_equal(err, -1);
+	assert_int_equal(udo_shm_get_data_size(shm, 2), proc_sizes[2]);
+
+	udo_shm_destroy(shm);
+
+	shm_info.growable = 1;
+	shm = udo_shm_create(NULL, &shm_info);
+	assert_non_null(shm);
+
+	/* Each process gets the segment size it asked for */
+	data_sz = udo_shm_get_data_size(shm, 0);
+	assert_int_equal(data_sz, proc_sizes[0]);
+
+	data_sz = udo_shm_get_data_size(shm, 1);
+	assert_int_equal(data_sz, proc_sizes[1]);
+
+	data_sz = udo_shm_get_data_size(shm, 2);
+	assert_int_equal(data_sz, proc_sizes[2]);
+
+	data = udo_shm_get_data(shm, 2);
+	assert_non_null(data);
+	memset(data, 'G', proc_sizes[2]);
+
+	/* Test invalid process index */
+	err = udo_shm_grow(shm, 3, UDO_PAGE_SIZE);
+	assert_int_equal(err, -1);
+
+	pid = fork();
+	if (pid == 0) {
+		shm = udo_shm_create(NULL, &shm_info);
+		assert_non_null(shm);
+
+		err = udo_shm_grow(shm, 2, UDO_PAGE_SIZE << 2);
+		assert_int_equal(err, 0);
+
+		udo_shm_destroy(shm);
+		exit(0);
+	}
+
+	wait(NULL);
+
+	/* Peer remaps after segment grown by another process */
+	data_sz = udo_shm_get_data_size(shm, 2);
+	assert_int_equal(data_sz, UDO_PAGE_SIZE << 2);
+
+	data = udo_shm_get_data(shm, 2);
+	assert_non_null(data);
+	assert_int_equal(data[0], 'G');
+	assert_int_equal(data[proc_sizes[2]-1], 'G');
+	memset(data, 'H', data_sz);
+
+	/* Segments not grown keep their size */
+	data_sz = udo_shm_get_data_size(shm, 1);
+	assert_int_equal(data_sz, proc_sizes[1]);
+
+	/* Growing to a smaller size does nothing */
+	err = udo_shm_grow(shm, 2, 1);
+	assert_int_equal(err, 0);
+
+	data_sz = udo_shm_get_data_size(shm, 2);
+	assert_int_equal(data_sz, UDO_PAGE_SIZE << 2);
+
+	udo_shm_destroy(shm);
+}
+
+
+static void UDO_UNUSED
+test_shm_grow_ring (void **state UDO_UNUSED)
+{
+	pid_t pid;
+
+	int err = -1, status;
+
+	uint32_t r, v;
+
+	ssize_t ret;
+
+	void *data;
+
+	struct udo_shm *shm = NULL;
+
+	unsigned char record[100];
+
+	struct udo_shm_create_info shm_info;
+	struct udo_shm_data_info shm_data_info;
+
+	memset(&shm_info, 0, sizeof(shm_info));
+	memset(&shm_data_info, 0, sizeof(shm_data_info));
+
+	shm_info.proc_count = 2;
+	shm_info.shm_file   = "/kms-shm-grow-ring-testing";
+	shm_info.shm_size   = UDO_PAGE_SIZE << 1;
+	shm_info.growable   = 1;
+
+	shm = udo_shm_create(NULL, &shm_info);
+	assert_non_null(shm);
+
+	shm_data_info.proc_index = 0;
+	shm_data_info.data = record;
+	shm_data_info.size = sizeof(record);
+
+	/* Wrap the ring a few times */
+	for (r = 0; r < 200; r++) {
+		memset(record, r, sizeof(record));
+		ret = udo_shm_ring_write(shm, &shm_data_info);
+		assert_int_equal(ret, sizeof(record));
+		ret = udo_shm_ring_read(shm, &shm_data_info);
+		assert_int_equal(ret, sizeof(record));
+	}
+
+	for (r = 0; r < 5; r++) {
+		memset(record, r, sizeof(record));
+		ret = udo_shm_ring_write(shm, &shm_data_info);
+		assert_int_equal(ret, sizeof(record));
+	}
+
+	/* Test growing segment with a record reserved */
+	data = udo_shm_write_reserve(shm, 0, sizeof(record));
+	assert_non_null(data);
+	memset(data, r, sizeof(record));
+	err = udo_shm_grow(shm, 0, UDO_PAGE_SIZE << 3);
+	assert_int_equal(err, -1);
+	err = udo_shm_write_commit(shm, 0);
+	assert_int_equal(err, 0);
+
+	/* Consumer sleeps on the ring while it's moved */
+	pid = fork();
+	if (pid == 0) {
+		shm = udo_shm_create(NULL, &shm_info);
+		assert_non_null(shm);
+
+		shm_data_info.proc_index = 1;
+		shm_data_info.data = &v;
+		shm_data_info.size = sizeof(v);
+		ret = udo_shm_ring_read(shm, &shm_data_info);
+		assert_int_equal(ret, sizeof(v));
+		assert_int_equal(v, 0x55);
+
+		udo_shm_destroy(shm);
+		exit(0);
+	}
+
+	/* Records stay in order after growth */
+	err = udo_shm_grow(shm, 0, UDO_PAGE_SIZE << 3);
+	assert_int_equal(err, 0);
+
+	for (r = 0; r < 6; r++) {
+		ret = udo_shm_ring_read(shm, &shm_data_info);
+		assert_int_equal(ret, sizeof(record));
+		assert_int_equal(record[0], r);
+		assert_int_equal(record[sizeof(record)-1], record[0]);
+	}
+
+	err = udo_shm_grow(shm, 1, UDO_PAGE_SIZE << 2);
+	assert_int_equal(err, 0);
+
+	v = 0x55;
+	shm_data_info.proc_index = 1;
+	shm_data_info.data = &v;
+	shm_data_info.size = sizeof(v);
+	ret = udo_shm_ring_write(shm, &shm_data_info);
+	assert_int_equal(ret, sizeof(v));
+
+	waitpid(pid, &status, 0);
+	assert_true(WIFEXITED(status));
+	assert_int_equal(WEXITSTATUS(status), 0);
+
+	udo_shm_destroy(shm);
+}
+
+/**********************************
+ * End of test_shm_grow functions *
+ **********************************/
+
+
+/*************************************
+ * Start of test_shm_memfd functions *
+ *************************************/
+
+static void UDO_UNUSED
+test_shm_memfd (void **state UDO_UNUSED)
+{
+	int err = -1, fd = -1;
+
+	char buf[128], buf_two[128];
+
+	struct udo_shm *shm = NULL, *peer = NULL;
+
+	struct udo_shm_create_info shm_info, peer_info;
+	struct udo_shm_data_info shm_data_info;
+
+	memset(&shm_info, 0, sizeof(shm_info));
+	memset(&peer_info, 0, sizeof(peer_info));
+	memset(&shm_data_info, 0, sizeof(shm_data_info));
+
+	shm_info.proc_count = 2;
+	shm_info.shm_file   = "/kms-shm-memfd-testing";
+	shm_info.shm_size   = UDO_PAGE_SIZE;
+	shm_info.memfd      = 1;
+	shm_info.populate   = 1;
+	shm_info.lock       = 1;
+
+	shm = udo_shm_create(NULL, &shm_info);
+	assert_non_null(shm);
+
+	fd = udo_shm_get_fd(shm);
+	assert_int_not_equal(fd, -1);
+
+	/* memfd_create(2) doesn't create a named file */
+	assert_int_equal(access("/dev/shm/kms-shm-memfd-testing", F_OK), -1);
+
+	/* Test attaching to descriptor that isn't shared memory */
+	peer_info.use_fd = 1;
+	peer_info.shm_fd = -1;
+	peer = udo_shm_create(NULL, &peer_info);
+	assert_null(peer);
+
+	/*
+	 * Peer would normally receive descriptor
+	 * with udo_usock_tcp_recv_fd(3).
+	 */
+	peer_info.shm_fd = fd;
+	peer = udo_shm_create(NULL, &peer_info);
+	assert_non_null(peer);
+
+	assert_int_equal(udo_shm_get_data_size(peer, 1), \
+	                 udo_shm_get_data_size(shm, 1));
+
+	memset(buf, 'M', sizeof(buf));
+	shm_data_info.proc_index = 1;
+	shm_data_info.size = sizeof(buf);
+	shm_data_info.data = buf;
+	err = udo_shm_data_write(shm, &shm_data_info);
+	assert_int_equal(err, 0);
+
+	shm_data_info.data = buf_two;
+	err = udo_shm_data_read(peer, &shm_data_info);
+	assert_int_equal(err, 0);
+	assert_memory_equal(buf, buf_two, sizeof(buf));
+
+	udo_shm_destroy(peer);
+	udo_shm_destroy(shm);
+}
+
+/***********************************
+ * End of test_shm_memfd functions *
+ ***********************************/
+
+
+/****************************************
+ * Start of test_shm_event_fd functions *
+ ****************************************/
+
+static void UDO_UNUSED
+test_shm_event_fd (void **state UDO_UNUSED)
+{
+	pid_t pid;
+
+	int err = -1, fd = -1, status;
+
+	int event_fds[2];
+
+	char buf[64], buf_two[64];
+
+	eventfd_t events;
+
+	rlim_t cur;
+
+	struct rlimit rl;
+
+	struct pollfd pfd;
+
+	struct udo_shm *shm = NULL, *peer = NULL;
+
+	struct udo_shm_create_info shm_info;
+	struct udo_shm_data_info shm_data_info;
+
+	memset(&shm_info, 0, sizeof(shm_info));
+	memset(&shm_data_info, 0, sizeof(shm_data_info));
+
+	shm_info.proc_count = 2;
+	shm_info.shm_file   = "/kms-shm-event-testing";
+	shm_info.shm_size   = UDO_PAGE_SIZE;
+
+	/* Test eventfd not requested */
+	peer = udo_shm_create(NULL, &shm_info);
+	assert_non_null(peer);
+
+	fd = udo_shm_get_event_fd(peer, 0);
+	assert_int_equal(fd, -1);
+
+	udo_shm_destroy(peer);
+
+	/* Shared by every process, second segment skipped */
+	event_fds[0] = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+	assert_int_not_equal(event_fds[0], -1);
+	event_fds[1] = -1;
+
+	shm_info.event_fds = event_fds;
+	shm = udo_shm_create(NULL, &shm_info);
+	assert_non_null(shm);
+
+	fd = udo_shm_get_event_fd(shm, 0);
+	assert_int_not_equal(fd, -1);
+	assert_int_not_equal(fd, event_fds[0]);
+	assert_int_equal(udo_shm_get_event_fd(shm, 1), -1);
+
+	/* Nothing written yet */
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	err = poll(&pfd, 1, 0);
+	assert_int_equal(err, 0);
+
+	memset(buf, 'E', sizeof(buf));
+	shm_data_info.proc_index = 0;
+	shm_data_info.size = sizeof(buf);
+	shm_data_info.data = buf;
+
+	/* Write from another process wakes the reader */
+	pid = fork();
+	if (pid == 0) {
+		peer = udo_shm_create(NULL, &shm_info);
+		assert_non_null(peer);
+		err = udo_shm_data_write(peer, &shm_data_info);
+		assert_int_equal(err, 0);
+		udo_shm_destroy(peer);
+		exit(0);
+	}
+
+	waitpid(pid, &status, 0);
+	assert_true(WIFEXITED(status));
+	assert_int_equal(WEXITSTATUS(status), 0);
+
+	err = poll(&pfd, 1, 0);
+	assert_int_equal(err, 1);
+
+	err = eventfd_read(fd, &events);
+	assert_int_equal(err, 0);
+	assert_int_equal(events, 1);
+
+	shm_data_info.data = buf_two;
+	err = udo_shm_data_read(shm, &shm_data_info);
+	assert_int_equal(err, 0);
+	assert_memory_equal(buf, buf_two, sizeof(buf));
+
+	/* Test eventfd installed after attach */
+	err = udo_shm_set_event_fd(shm, 1, event_fds[0]);
+	assert_int_equal(err, 0);
+	assert_int_not_equal(udo_shm_get_event_fd(shm, 1), -1);
+
+	udo_shm_destroy(shm);
+
+	/* Failed attach doesn't detach other processes */
+	event_fds[1] = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+	assert_int_not_equal(event_fds[1], -1);
+
+	shm = udo_shm_create(NULL, &shm_info);
+	assert_non_null(shm);
+
+	fd = dup(0);
+	close(fd);
+
+	err = getrlimit(RLIMIT_NOFILE, &rl);
+	assert_int_equal(err, 0);
+	cur = rl.rlim_cur;
+
+	/* Leaves room for the shared memory file but not every eventfd */
+	rl.rlim_cur = fd + 2;
+	err = setrlimit(RLIMIT_NOFILE, &rl);
+	assert_int_equal(err, 0);
+
+	peer = udo_shm_create(NULL, &shm_info);
+	assert_null(peer);
+
+	rl.rlim_cur = cur;
+	err = setrlimit(RLIMIT_NOFILE, &rl);
+	assert_int_equal(err, 0);
+
+	assert_int_equal(access("/dev/shm/kms-shm-event-testing", F_OK), 0);
+
+	udo_shm_destroy(shm);
+	close(event_fds[0]);
+	close(event_fds[1]);
+}
+
+/**************************************
+ * End of test_shm_event_fd functions *
+ **************************************/
+
+
 /**************************************
  * Start of test_shm_get_fd functions *
  **************************************/
@@ -263,11 +1571,20 @@ test_shm_get_data_size (void **state UDO_UNUSED)
 	data_sz = udo_shm_get_data_size(NULL, 0);
 	assert_int_equal(data_sz, -1);
 
-	data_sz = sizeof(udo_atomic_u32) + (2 * sizeof(udo_atomic_u32) * shm_info.proc_count);
-	seg_sz = (shm_info.shm_size - data_sz) / shm_info.proc_count;
+	/*
+	 * Header stores five counters/flags and the total size
+	 * followed by a cache line sized directory entry per
+	 * process. Segments are cache line aligned after the
+	 * directory.
+	 */
+	data_sz = UDO_BYTE_ALIGN((5 * sizeof(udo_atomic_u32)) + sizeof(udo_atomic_u64), \
+		UDO_CACHE_LINE_SIZE) + (UDO_CACHE_LINE_SIZE * shm_info.proc_count);
+	seg_sz = ((shm_info.shm_size - data_sz) / shm_info.proc_count) & \
+		~((size_t) UDO_CACHE_LINE_SIZE-1);
 
 	data_sz = udo_shm_get_data_size(shm, 0);
 	assert_int_equal(data_sz, seg_sz);
+	assert_int_equal(udo_shm_get_data_size(shm, 1), seg_sz);
 
 	udo_shm_destroy(shm);
 }
@@ -299,6 +1616,18 @@ main (void)
 	const struct CMUnitTest tests[] = {
 		cmocka_unit_test(test_shm_create),
 		cmocka_unit_test(test_shm_data),
+		cmocka_unit_test(test_shm_ring),
+		cmocka_unit_test(test_shm_ring_mpmc),
+		cmocka_unit_test(test_shm_ring_threads),
+		cmocka_unit_test(test_shm_reserve_acquire),
+		cmocka_unit_test(test_shm_bcast),
+		cmocka_unit_test(test_shm_bcast_skip_slow),
+		cmocka_unit_test(test_shm_latest),
+		cmocka_unit_test(test_shm_mm),
+		cmocka_unit_test(test_shm_grow),
+		cmocka_unit_test(test_shm_grow_ring),
+		cmocka_unit_test(test_shm_memfd),
+		cmocka_unit_test(test_shm_event_fd),
 		cmocka_unit_test(test_shm_get_fd),
 		cmocka_unit_test(test_shm_get_data),
 		cmocka_unit_test(test_shm_get_data_size),
@@ -0,0 +1,452 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023-2026 Underview
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+/*
+ * Required by cmocka
+ */
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "log.h"
+#include "macros.h"
+#include "uring.h"
+
+#define TEST_URING_FILE "/tmp/udo-test-uring.txt"
+
+static void
+complete_func (void *arg, const int res)
+{
+	*((int*)arg) = res;
+}
+
+
+/****************************************
+ * Start of test_uring_create functions *
+ ****************************************/
+
+static void UDO_UNUSED
+test_uring_create (void UDO_UNUSED **state)
+{
+	struct udo_uring *ring = NULL;
+
+	struct udo_uring_create_info ring_info;
+	memset(&ring_info, 0, sizeof(ring_info));
+
+	ring = udo_uring_create(NULL, NULL);
+	assert_null(ring);
+
+	ring = udo_uring_create(NULL, &ring_info);
+	assert_null(ring);
+
+	ring_info.entries = 8;
+	ring = udo_uring_create(NULL, &ring_info);
+	assert_non_null(ring);
+
+	udo_uring_destroy(ring);
+}
+
+/**************************************
+ * End of test_uring_create functions *
+ **************************************/
+
+
+/********************************************
+ * Start of test_uring_read_write functions *
+ ********************************************/
+
+static void UDO_UNUSED
+test_uring_read_write (void UDO_UNUSED **state)
+{
+	int ret, fd, i;
+	int res[4];
+	char rbuf[4][32];
+	struct iovec iov;
+	struct udo_uring *ring = NULL;
+
+	const char *data = "io_uring batched write test";
+
+	struct udo_uring_create_info ring_info;
+	struct udo_uring_io_info io_info;
+	memset(&ring_info, 0, sizeof(ring_info));
+	memset(&io_info, 0, sizeof(io_info));
+	memset(rbuf, 0, sizeof(rbuf));
+
+	fd = open(TEST_URING_FILE, O_CREAT|O_RDWR|O_TRUNC, 0644);
+	assert_int_not_equal(fd, -1);
+
+	ring_info.entries = 8;
+	ring = udo_uring_create(NULL, &ring_info);
+	assert_non_null(ring);
+
+	ret = udo_uring_prep(ring, UDO_URING_WRITE, NULL);
+	assert_int_equal(ret, -1);
+
+	/* Queue four writes at consecutive offsets then submit once */
+	for (i = 0; i < 4; i++) {
+		io_info.fd = fd;
+		io_info.buf = (void *) data;
+		io_info.size = strlen(data);
+		io_info.offset = i * strlen(data);
+		io_info.func = complete_func;
+		io_info.arg = &res[i];
+		ret = udo_uring_prep(ring, UDO_URING_WRITE, &io_info);
+		assert_int_equal(ret, 0);
+	}
+
+	ret = udo_uring_submit(ring);
+	assert_int_equal(ret, 4);
+
+	ret = udo_uring_wait(ring, 4);
+	assert_int_equal(ret, 4);
+	for (i = 0; i < 4; i++)
+		assert_int_equal(res[i], strlen(data));
+
+	io_info.fd = fd;
+	io_info.arg = &res[0];
+	ret = udo_uring_prep(ring, UDO_URING_FSYNC, &io_info);
+	assert_int_equal(ret, 0);
+	assert_int_equal(udo_uring_submit(ring), 1);
+	assert_int_equal(udo_uring_wait(ring, 1), 1);
+	assert_int_equal(res[0], 0);
+
+	/* Read back through registered file and buffer */
+	ret = udo_uring_register_files(ring, &fd, 1);
+	assert_int_equal(ret, 0);
+
+	iov.iov_base = rbuf;
+	iov.iov_len = sizeof(rbuf);
+	ret = udo_uring_register_buffers(ring, &iov, 1);
+	assert_int_equal(ret, 0);
+
+	for (i = 0; i < 4; i++) {
+		io_info.fd = 0;
+		io_info.fixed_file = 1;
+		io_info.fixed_buf = 1;
+		io_info.buf_index = 0;
+		io_info.buf = rbuf[i];
+		io_info.size = strlen(data);
+		io_info.offset = i * strlen(data);
+		io_info.arg = &res[i];
+		ret = udo_uring_prep(ring, UDO_URING_READ, &io_info);
+		assert_int_equal(ret, 0);
+	}
+
+	assert_int_equal(udo_uring_submit(ring), 4);
+	assert_int_equal(udo_uring_wait(ring, 4), 4);
+	for (i = 0; i < 4; i++) {
+		assert_int_equal(res[i], strlen(data));
+		assert_string_equal(rbuf[i], data);
+	}
+
+	udo_uring_destroy(ring);
+	close(fd);
+	unlink(TEST_URING_FILE);
+}
+
+/******************************************
+ * End of test_uring_read_write functions *
+ ******************************************/
+
+
+/****************************************
+ * Start of test_uring_splice functions *
+ ****************************************/
+
+static void UDO_UNUSED
+test_uring_splice (void UDO_UNUSED **state)
+{
+	int ret, fd, res;
+	int pfds[2];
+	char buf[32];
+	struct udo_uring *ring = NULL;
+
+	const char *data = "spliced through a pipe";
+
+	struct udo_uring_create_info ring_info;
+	struct udo_uring_io_info io_info;
+	memset(&ring_info, 0, sizeof(ring_info));
+	memset(&io_info, 0, sizeof(io_info));
+	memset(buf, 0, sizeof(buf));
+
+	fd = open(TEST_URING_FILE, O_CREAT|O_RDWR|O_TRUNC, 0644);
+	assert_int_not_equal(fd, -1);
+	assert_int_equal(write(fd, data, strlen(data)), strlen(data));
+
+	ret = pipe(pfds);
+	assert_int_equal(ret, 0);
+
+	ring_info.entries = 4;
+	ring = udo_uring_create(NULL, &ring_info);
+	assert_non_null(ring);
+
+	io_info.fd = fd;
+	io_info.offset = 0;
+	io_info.out_fd = pfds[1];
+	io_info.out_offset = -1;
+	io_info.size = strlen(data);
+	io_info.func = complete_func;
+	io_info.arg = &res;
+	ret = udo_uring_prep(ring, UDO_URING_SPLICE, &io_info);
+	assert_int_equal(ret, 0);
+
+	assert_int_equal(udo_uring_submit(ring), 1);
+	assert_int_equal(udo_uring_wait(ring, 1), 1);
+	assert_int_equal(res, strlen(data));
+
+	assert_int_equal(read(pfds[0], buf, sizeof(buf)), strlen(data));
+	assert_string_equal(buf, data);
+
+	udo_uring_destroy(ring);
+	close(pfds[0]);
+	close(pfds[1]);
+	close(fd);
+	unlink(TEST_URING_FILE);
+}
+
+/**************************************
+ * End of test_uring_splice functions *
+ **************************************/
+
+
+/*******************************************
+ * Start of test_uring_send_recv functions *
+ *******************************************/
+
+static void UDO_UNUSED
+test_uring_send_recv (void UDO_UNUSED **state)
+{
+	int ret;
+	int sfds[2], res[2];
+	char buf[32];
+	struct udo_uring *ring = NULL;
+
+	const char *data = "socket pair";
+
+	struct udo_uring_create_info ring_info;
+	struct udo_uring_io_info io_info;
+	memset(&ring_info, 0, sizeof(ring_info));
+	memset(&io_info, 0, sizeof(io_info));
+	memset(buf, 0, sizeof(buf));
+
+	ret = socketpair(AF_UNIX, SOCK_STREAM, 0, sfds);
+	assert_int_equal(ret, 0);
+
+	ring_info.entries = 4;
+	ring = udo_uring_create(NULL, &ring_info);
+	assert_non_null(ring);
+
+	io_info.fd = sfds[1];
+	io_info.buf = buf;
+	io_info.size = sizeof(buf);
+	io_info.func = complete_func;
+	io_info.arg = &res[0];
+	ret = udo_uring_prep(ring, UDO_URING_RECV, &io_info);
+	assert_int_equal(ret, 0);
+
+	io_info.fd = sfds[0];
+	io_info.buf = (void *) data;
+	io_info.size = strlen(data);
+	io_info.arg = &res[1];
+	ret = udo_uring_prep(ring, UDO_URING_SEND, &io_info);
+	assert_int_equal(ret, 0);
+
+	assert_int_equal(udo_uring_submit(ring), 2);
+	assert_int_equal(udo_uring_wait(ring, 2), 2);
+	assert_int_equal(res[0], strlen(data));
+	assert_int_equal(res[1], strlen(data));
+	assert_string_equal(buf, data);
+
+	udo_uring_destroy(ring);
+	close(sfds[0]);
+	close(sfds[1]);
+}
+
+/*****************************************
+ * End of test_uring_send_recv functions *
+ *****************************************/
+
+
+/****************************************
+ * Start of test_uring_sqpoll functions *
+ ****************************************/
+
+static void UDO_UNUSED
+test_uring_sqpoll (void UDO_UNUSED **state)
+{
+	int ret, fd, res = -1;
+	struct udo_uring *ring = NULL;
+
+	const char *data = "sqpoll";
+
+	struct udo_uring_create_info ring_info;
+	struct udo_uring_io_info io_info;
+	memset(&ring_info, 0, sizeof(ring_info));
+	memset(&io_info, 0, sizeof(io_info));
+
+	fd = open(TEST_URING_FILE, O_CREAT|O_RDWR|O_TRUNC, 0644);
+	assert_int_not_equal(fd, -1);
+
+	ring_info.entries = 4;
+	ring_info.sqpoll = 1;
+	ring_info.sq_thread_idle = 10;
+	ring = udo_uring_create(NULL, &ring_info);
+	assert_non_null(ring);
+
+	/* Let kernel thread go idle so submit must wake it */
+	usleep(50000);
+
+	io_info.fd = fd;
+	io_info.buf = (void *) data;
+	io_info.size = strlen(data);
+	io_info.func = complete_func;
+	io_info.arg = &res;
+	ret = udo_uring_prep(ring, UDO_URING_WRITE, &io_info);
+	assert_int_equal(ret, 0);
+
+	assert_int_equal(udo_uring_submit(ring), 1);
+	assert_int_equal(udo_uring_wait(ring, 1), 1);
+	assert_int_equal(res, strlen(data));
+
+	udo_uring_destroy(ring);
+	close(fd);
+	unlink(TEST_URING_FILE);
+}
+
+/**************************************
+ * End of test_uring_sqpoll functions *
+ **************************************/
+
+
+/***************************************
+ * Start of test_uring_jpool functions *
+ ***************************************/
+
+static void
+complete_func_jpool (void *arg, const int res)
+{
+	__atomic_add_fetch((int*)arg, res, __ATOMIC_RELAXED);
+}
+
+
+static void UDO_UNUSED
+test_uring_jpool (void UDO_UNUSED **state)
+{
+	int ret, fd, i, total = 0;
+	struct udo_uring *ring = NULL;
+	struct udo_jpool *jpool = NULL;
+
+	const char *data = "jpool";
+
+	struct udo_jpool_create_info jpool_info;
+	struct udo_uring_create_info ring_info;
+	struct udo_uring_io_info io_info;
+	memset(&jpool_info, 0, sizeof(jpool_info));
+	memset(&ring_info, 0, sizeof(ring_info));
+	memset(&io_info, 0, sizeof(io_info));
+
+	fd = open(TEST_URING_FILE, O_CREAT|O_RDWR|O_TRUNC, 0644);
+	assert_int_not_equal(fd, -1);
+
+	jpool_info.count = 2;
+	jpool_info.size  = UDO_PAGE_SIZE;
+	jpool = udo_jpool_create(NULL, &jpool_info);
+	assert_non_null(jpool);
+
+	ring_info.entries = 16;
+	ring_info.jpool = jpool;
+	ring = udo_uring_create(NULL, &ring_info);
+	assert_non_null(ring);
+
+	for (i = 0; i < 16; i++) {
+		io_info.fd = fd;
+		io_info.buf = (void *) data;
+		io_info.size = strlen(data);
+		io_info.offset = i * strlen(data);
+		io_info.func = complete_func_jpool;
+		io_info.arg = &total;
+		ret = udo_uring_prep(ring, UDO_URING_WRITE, &io_info);
+		assert_int_equal(ret, 0);
+	}
+
+	/* Submission queue holds 16 entries */
+	ret = udo_uring_prep(ring, UDO_URING_WRITE, &io_info);
+	assert_int_equal(ret, -1);
+
+	assert_int_equal(udo_uring_submit(ring), 16);
+	assert_int_equal(udo_uring_wait(ring, 16), 16);
+
+	udo_jpool_wait(jpool);
+	assert_int_equal(total, 16 * strlen(data));
+
+	udo_uring_destroy(ring);
+	udo_jpool_destroy(jpool);
+	close(fd);
+	unlink(TEST_URING_FILE);
+}
+
+/*************************************
+ * End of test_uring_jpool functions *
+ *************************************/
+
+
+/********************************************
+ * Start of test_uring_get_sizeof functions *
+ ********************************************/
+
+static void UDO_UNUSED
+test_uring_get_sizeof (void UDO_UNUSED **state)
+{
+	int size = 0;
+	size = udo_uring_get_sizeof();
+	assert_int_not_equal(size, 0);
+}
+
+/******************************************
+ * End of test_uring_get_sizeof functions *
+ ******************************************/
+
+int
+main (void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_uring_create),
+		cmocka_unit_test(test_uring_read_write),
+		cmocka_unit_test(test_uring_splice),
+		cmocka_unit_test(test_uring_send_recv),
+		cmocka_unit_test(test_uring_sqpoll),
+		cmocka_unit_test(test_uring_jpool),
+		cmocka_unit_test(test_uring_get_sizeof),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
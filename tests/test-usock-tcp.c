@@ -235,6 +235,97 @@ test_usock_tcp_send_recv (void UDO_UNUSED **state)
  *********************************************/
 
 
+/**************************************************
+ * Start of test_usock_tcp_send_recv_fd functions *
+ **************************************************/
+
+static void
+p_test_usock_tcp_send_recv_fd_client (void)
+{
+	int err = -1, pipe_fds[2];
+
+	ssize_t size = 0;
+
+	struct udo_usock_tcp *client = NULL;
+
+	struct udo_usock_tcp_client_create_info client_info;
+
+	client_info.unix_path = TESTING_UNIX_SOCK;
+	client = udo_usock_tcp_client_create(NULL, &client_info);
+	assert_non_null(client);
+
+	err = udo_usock_tcp_client_connect(client);
+	assert_int_equal(err, 0);
+
+	err = pipe(pipe_fds);
+	assert_int_equal(err, 0);
+
+	size = write(pipe_fds[1], "udo", 3);
+	assert_int_equal(size, 3);
+
+	/* Server reads from pipe created by this process */
+	size = udo_usock_tcp_send_fd(udo_usock_tcp_get_fd(client), pipe_fds[0]);
+	assert_int_equal(size, 1);
+
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+	udo_usock_tcp_destroy(client);
+
+	exit(0);
+}
+
+
+static void UDO_UNUSED
+test_usock_tcp_send_recv_fd (void UDO_UNUSED **state)
+{
+	pid_t pid;
+
+	int client_sock = -1, fd = -1;
+
+	char buffer[3];
+
+	ssize_t size = 0;
+
+	struct udo_usock_tcp *server = NULL;
+
+	struct udo_usock_tcp_server_create_info server_info;
+
+	server_info.connections = 1;
+	server_info.unix_path = TESTING_UNIX_SOCK;
+	server = udo_usock_tcp_server_create(NULL, &server_info);
+	assert_non_null(server);
+
+	/* Test invalid socket */
+	size = udo_usock_tcp_send_fd(-1, 0);
+	assert_int_equal(size, -1);
+
+	pid = fork();
+	if (pid == 0) {
+		p_test_usock_tcp_send_recv_fd_client();
+	}
+
+	client_sock = udo_usock_tcp_server_accept(server, NULL);
+	assert_int_not_equal(client_sock, -1);
+
+	fd = udo_usock_tcp_recv_fd(client_sock);
+	assert_true(fd >= 0);
+
+	size = read(fd, buffer, sizeof(buffer));
+	assert_int_equal(size, sizeof(buffer));
+	assert_memory_equal(buffer, "udo", sizeof(buffer));
+
+	waitpid(pid, NULL, -1);
+
+	close(fd);
+	close(client_sock);
+	udo_usock_tcp_destroy(server);
+}
+
+/************************************************
+ * End of test_usock_tcp_send_recv_fd functions *
+ ************************************************/
+
+
 /********************************************
  * Start of test_usock_tcp_get_fd functions *
  ********************************************/
@@ -322,6 +413,7 @@ main (void)
 		cmocka_unit_test(test_usock_tcp_client_create),
 		cmocka_unit_test(test_usock_tcp_accept_connect),
 		cmocka_unit_test(test_usock_tcp_send_recv),
+		cmocka_unit_test(test_usock_tcp_send_recv_fd),
 		cmocka_unit_test(test_usock_tcp_get_fd),
 		cmocka_unit_test(test_usock_tcp_get_unix_path),
 		cmocka_unit_test(test_usock_tcp_get_sizeof),